@@ -17,11 +17,15 @@
 #include <gst/gst.h>
 
 #include "gstvpiboxfilter.h"
+#include "gstvpiconvertscale.h"
 #include "gstvpidownload.h"
 #include "gstvpigaussianfilter.h"
 #include "gstvpiharrisdetector.h"
 #include "gstvpiklttracker.h"
+#include "gstvpimultiscale.h"
 #include "gstvpioverlay.h"
+#include "gstvpistabilize.h"
+#include "gstvpitensorize.h"
 #include "gstvpiundistort.h"
 #include "gstvpiupload.h"
 #include "gstvpivideoconvert.h"
@@ -39,6 +43,12 @@ vpi_init (GstPlugin * vpi)
     goto out;
   }
 
+  if (!gst_element_register (vpi, "vpiconvertscale", GST_RANK_NONE,
+          GST_TYPE_VPI_CONVERT_SCALE)) {
+    GST_ERROR ("Failed to register vpiconvertscale");
+    goto out;
+  }
+
   if (!gst_element_register (vpi, "vpidownload", GST_RANK_NONE,
           GST_TYPE_VPI_DOWNLOAD)) {
     GST_ERROR ("Failed to register vpidownload");
@@ -63,12 +73,30 @@ vpi_init (GstPlugin * vpi)
     goto out;
   }
 
+  if (!gst_element_register (vpi, "vpimultiscale", GST_RANK_NONE,
+          GST_TYPE_VPI_MULTI_SCALE)) {
+    GST_ERROR ("Failed to register vpimultiscale");
+    goto out;
+  }
+
   if (!gst_element_register (vpi, "vpioverlay", GST_RANK_NONE,
           GST_TYPE_VPI_OVERLAY)) {
     GST_ERROR ("Failed to register vpioverlay");
     goto out;
   }
 
+  if (!gst_element_register (vpi, "vpistabilize", GST_RANK_NONE,
+          GST_TYPE_VPI_STABILIZE)) {
+    GST_ERROR ("Failed to register vpistabilize");
+    goto out;
+  }
+
+  if (!gst_element_register (vpi, "vpitensorize", GST_RANK_NONE,
+          GST_TYPE_VPI_TENSORIZE)) {
+    GST_ERROR ("Failed to register vpitensorize");
+    goto out;
+  }
+
   if (!gst_element_register (vpi, "vpiundistort", GST_RANK_NONE,
           GST_TYPE_VPI_UNDISTORT)) {
     GST_ERROR ("Failed to register vpiundistort");
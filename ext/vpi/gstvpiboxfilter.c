@@ -19,6 +19,8 @@
 #include <gst/gst.h>
 #include <vpi/algo/BoxFilter.h>
 
+#include <string.h>
+
 #include "gst-libs/gst/vpi/gstvpi.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_box_filter_debug_category);
@@ -26,17 +28,18 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_box_filter_debug_category);
 
 #define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE }")
 
-#define VPI_KERNEL_SIZE_ENUM (vpi_kernel_size_enum_get_type ())
-GType vpi_kernel_size_enum_get_type (void);
-
-#define KERNEL_SIZE_3 3
-#define KERNEL_SIZE_5 5
-#define KERNEL_SIZE_7 7
-#define KERNEL_SIZE_9 9
-#define KERNEL_SIZE_11 11
+/* Largest kernel VPI supports */
+#define MAX_VPI_SIZE 11
 
-#define DEFAULT_PROP_SIZE KERNEL_SIZE_5
+#define DEFAULT_PROP_SIZE 5
+#define DEFAULT_PROP_SIZE_MIN 3
+#define DEFAULT_PROP_SIZE_MAX 1023
 #define DEFAULT_PROP_BOUNDARY_COND VPI_BOUNDARY_COND_ZERO
+/* Where the summed-area table overtook a vectorized separable box filter
+   on 1080p GRAY8 frames */
+#define DEFAULT_PROP_INTEGRAL_AREA 49
+#define DEFAULT_PROP_INTEGRAL_AREA_MIN 1
+#define DEFAULT_PROP_INTEGRAL_AREA_MAX G_MAXUINT
 
 struct _GstVpiBoxFilter
 {
@@ -44,49 +47,36 @@ struct _GstVpiBoxFilter
   guint size_x;
   guint size_y;
   guint boundary_cond;
+  guint integral_area;
+
+  GstVideoFormat format;
+  /* Summed-area table, reused across frames and grown on demand */
+  guint64 *table;
+  gsize table_size;
 };
 
 /* prototypes */
+static gboolean gst_vpi_box_filter_start (GstVpiFilter * filter,
+    GstVideoInfo * in_info, GstVideoInfo * out_info);
 static GstFlowReturn gst_vpi_box_filter_transform_image (GstVpiFilter *
     filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
+static void gst_vpi_box_filter_get_kernel_radius (GstVpiFilter * filter,
+    gint * radius_x, gint * radius_y);
 static void gst_vpi_box_filter_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_vpi_box_filter_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vpi_box_filter_finalize (GObject * object);
 
 enum
 {
   PROP_0,
   PROP_SIZE_X,
   PROP_SIZE_Y,
-  PROP_BOUNDARY_COND
+  PROP_BOUNDARY_COND,
+  PROP_INTEGRAL_AREA
 };
 
-GType
-vpi_kernel_size_enum_get_type (void)
-{
-  static GType vpi_kernel_size_enum_type = 0;
-  static const GEnumValue values[] = {
-    {KERNEL_SIZE_3, "Kernel size of 3",
-        "3"},
-    {KERNEL_SIZE_5, "Kernel size of 5",
-        "5"},
-    {KERNEL_SIZE_7, "Kernel size of 7",
-        "7"},
-    {KERNEL_SIZE_9, "Kernel size of 9",
-        "9"},
-    {KERNEL_SIZE_11, "Kernel size of 11",
-        "11"},
-    {0, NULL, NULL}
-  };
-
-  if (!vpi_kernel_size_enum_type) {
-    vpi_kernel_size_enum_type =
-        g_enum_register_static ("VpiKernelSize", values);
-  }
-  return vpi_kernel_size_enum_type;
-}
-
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (GstVpiBoxFilter, gst_vpi_box_filter,
@@ -112,21 +102,30 @@ gst_vpi_box_filter_class_init (GstVpiBoxFilterClass * klass)
       "VPI box filter element for grayscale images.",
       "Jimena Salas <jimena.salas@ridgerun.com>");
 
+  vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_box_filter_start);
   vpi_filter_class->transform_image =
       GST_DEBUG_FUNCPTR (gst_vpi_box_filter_transform_image);
+  vpi_filter_class->get_kernel_radius =
+      GST_DEBUG_FUNCPTR (gst_vpi_box_filter_get_kernel_radius);
+  vpi_filter_class->supports_roi = TRUE;
   gobject_class->set_property = gst_vpi_box_filter_set_property;
   gobject_class->get_property = gst_vpi_box_filter_get_property;
+  gobject_class->finalize = gst_vpi_box_filter_finalize;
 
   g_object_class_install_property (gobject_class, PROP_SIZE_X,
-      g_param_spec_enum ("size-x", "Kernel size X",
-          "Box kernel size in X direction. ",
-          VPI_KERNEL_SIZE_ENUM, DEFAULT_PROP_SIZE,
+      g_param_spec_uint ("size-x", "Kernel size X",
+          "Box kernel size in X direction. Must be odd. Sizes above 11 "
+          "are computed on the CPU with a summed-area table, whatever the "
+          "backend.",
+          DEFAULT_PROP_SIZE_MIN, DEFAULT_PROP_SIZE_MAX, DEFAULT_PROP_SIZE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_SIZE_Y,
-      g_param_spec_enum ("size-y", "Kernel size Y",
-          "Box kernel size in Y direction. ",
-          VPI_KERNEL_SIZE_ENUM, DEFAULT_PROP_SIZE,
+      g_param_spec_uint ("size-y", "Kernel size Y",
+          "Box kernel size in Y direction. Must be odd. Sizes above 11 "
+          "are computed on the CPU with a summed-area table, whatever the "
+          "backend.",
+          DEFAULT_PROP_SIZE_MIN, DEFAULT_PROP_SIZE_MAX, DEFAULT_PROP_SIZE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_BOUNDARY_COND,
@@ -134,6 +133,17 @@ gst_vpi_box_filter_class_init (GstVpiBoxFilterClass * klass)
           "How pixel values outside of the image domain should be treated.",
           VPI_BOUNDARY_CONDS_ENUM, DEFAULT_PROP_BOUNDARY_COND,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INTEGRAL_AREA,
+      g_param_spec_uint ("integral-area", "Integral kernel area",
+          "Kernel area from which the CPU backend uses a summed-area table "
+          "instead of VPI. Its cost does not grow with the kernel. The "
+          "default is where it was faster on a 1080p frame, the best value "
+          "depends on the platform. Other backends only use the table for "
+          "kernels VPI does not support.",
+          DEFAULT_PROP_INTEGRAL_AREA_MIN, DEFAULT_PROP_INTEGRAL_AREA_MAX,
+          DEFAULT_PROP_INTEGRAL_AREA,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -142,6 +152,162 @@ gst_vpi_box_filter_init (GstVpiBoxFilter * self)
   self->size_x = DEFAULT_PROP_SIZE;
   self->size_y = DEFAULT_PROP_SIZE;
   self->boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  self->integral_area = DEFAULT_PROP_INTEGRAL_AREA;
+  self->format = GST_VIDEO_FORMAT_UNKNOWN;
+  self->table = NULL;
+  self->table_size = 0;
+}
+
+static gboolean
+gst_vpi_box_filter_start (GstVpiFilter * filter, GstVideoInfo * in_info,
+    GstVideoInfo * out_info)
+{
+  GstVpiBoxFilter *self = NULL;
+
+  g_return_val_if_fail (filter, FALSE);
+  g_return_val_if_fail (in_info, FALSE);
+  g_return_val_if_fail (out_info, FALSE);
+
+  self = GST_VPI_BOX_FILTER (filter);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  self->format = GST_VIDEO_INFO_FORMAT (in_info);
+
+  return TRUE;
+}
+
+/* Kernels VPI does not support always use the summed-area table. It runs
+   on the CPU, so only the CPU backend trades smaller kernels for it */
+static gboolean
+gst_vpi_box_filter_use_integral (guint size_x, guint size_y,
+    guint integral_area, gint backend)
+{
+  return size_x > MAX_VPI_SIZE || size_y > MAX_VPI_SIZE
+      || (VPI_BACKEND_CPU == backend && size_x * size_y >= integral_area);
+}
+
+static inline guint64
+gst_vpi_box_filter_get_pixel (const VPIImagePlane * plane,
+    GstVideoFormat format, gint x, gint y)
+{
+  const guint8 *row = (const guint8 *) plane->data + y * plane->pitchBytes;
+
+  return GST_VIDEO_FORMAT_GRAY8 == format ? row[x] :
+      ((const guint16 *) row)[x];
+}
+
+/* Box filter whose cost per pixel does not depend on the kernel size. The
+   table covers the image padded by the kernel radius, so the boundary
+   condition is applied once while building it */
+static void
+gst_vpi_box_filter_integral (GstVpiBoxFilter * self,
+    const VPIImagePlane * in, VPIImagePlane * out, guint size_x,
+    guint size_y, guint boundary_cond)
+{
+  gint radius_x = size_x / 2;
+  gint radius_y = size_y / 2;
+  gint width = in->width;
+  gint height = in->height;
+  gint table_width = width + 2 * radius_x + 1;
+  gint table_height = height + 2 * radius_y + 1;
+  guint64 area = (guint64) size_x * size_y;
+  guint64 *table = self->table;
+  guint64 *table_row = NULL;
+  const guint64 *prev_row = NULL;
+  guint64 row_sum = 0;
+  guint64 sum = 0;
+  guint8 *out_row = NULL;
+  gboolean clamp = VPI_BOUNDARY_COND_CLAMP == boundary_cond;
+  gint x = 0, y = 0;
+  gint sx = 0, sy = 0;
+
+  memset (table, 0, table_width * sizeof (guint64));
+
+  for (y = 1; y < table_height; y++) {
+    sy = y - 1 - radius_y;
+    table_row = table + (gsize) y * table_width;
+    prev_row = table_row - table_width;
+    table_row[0] = 0;
+    row_sum = 0;
+
+    for (x = 1; x < table_width; x++) {
+      sx = x - 1 - radius_x;
+      if (clamp) {
+        row_sum += gst_vpi_box_filter_get_pixel (in, self->format,
+            CLAMP (sx, 0, width - 1), CLAMP (sy, 0, height - 1));
+      } else if (sx >= 0 && sx < width && sy >= 0 && sy < height) {
+        row_sum += gst_vpi_box_filter_get_pixel (in, self->format, sx, sy);
+      }
+      table_row[x] = prev_row[x] + row_sum;
+    }
+  }
+
+  for (y = 0; y < height; y++) {
+    out_row = (guint8 *) out->data + y * out->pitchBytes;
+    prev_row = table + (gsize) y * table_width;
+    table_row = table + (gsize) (y + size_y) * table_width;
+
+    for (x = 0; x < width; x++) {
+      sum = table_row[x + size_x] - table_row[x] - prev_row[x + size_x] +
+          prev_row[x];
+      sum = (sum + area / 2) / area;
+      if (GST_VIDEO_FORMAT_GRAY8 == self->format) {
+        out_row[x] = sum;
+      } else {
+        ((guint16 *) out_row)[x] = sum;
+      }
+    }
+  }
+}
+
+/* The images wrap unified memory, so any backend can hand them to the CPU
+   once the stream is done with them */
+static VPIStatus
+gst_vpi_box_filter_submit_integral (GstVpiBoxFilter * self, VPIStream stream,
+    VPIImage input, VPIImage output, guint size_x, guint size_y,
+    guint boundary_cond)
+{
+  VPIImageData in_data = { 0 };
+  VPIImageData out_data = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  gsize table_size = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+
+  status = vpiStreamSync (stream);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiImageLock (input, VPI_LOCK_READ, &in_data);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiImageLock (output, VPI_LOCK_WRITE, &out_data);
+  if (VPI_SUCCESS != status) {
+    goto unlock_input;
+  }
+
+  table_size = (gsize) (in_data.planes[0].width + size_x) *
+      (in_data.planes[0].height + size_y);
+  if (table_size > self->table_size) {
+    g_free (self->table);
+    self->table = g_new (guint64, table_size);
+    self->table_size = table_size;
+  }
+
+  gst_vpi_box_filter_integral (self, &in_data.planes[0], &out_data.planes[0],
+      size_x, size_y, boundary_cond);
+
+  vpiImageUnlock (output);
+
+unlock_input:
+  vpiImageUnlock (input);
+
+out:
+  return status;
 }
 
 static GstFlowReturn
@@ -153,6 +319,7 @@ gst_vpi_box_filter_transform_image (GstVpiFilter * filter,
   VPIStatus status = VPI_SUCCESS;
   guint size_x, size_y = DEFAULT_PROP_SIZE;
   guint boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  guint integral_area = DEFAULT_PROP_INTEGRAL_AREA;
   gint backend = VPI_BACKEND_INVALID;
 
   g_return_val_if_fail (filter, GST_FLOW_ERROR);
@@ -170,41 +337,82 @@ gst_vpi_box_filter_transform_image (GstVpiFilter * filter,
   size_x = self->size_x;
   size_y = self->size_y;
   boundary_cond = self->boundary_cond;
+  integral_area = self->integral_area;
   GST_OBJECT_UNLOCK (self);
 
   backend = gst_vpi_filter_get_backend (filter);
 
-  status = vpiSubmitBoxFilter (stream, backend, in_frame->image,
-      out_frame->image, size_x, size_y, boundary_cond);
+  if (gst_vpi_box_filter_use_integral (size_x, size_y, integral_area,
+          backend)) {
+    status = gst_vpi_box_filter_submit_integral (self, stream,
+        in_frame->image, out_frame->image, size_x, size_y, boundary_cond);
+  } else {
+    status = vpiSubmitBoxFilter (stream, backend, in_frame->image,
+        out_frame->image, size_x, size_y, boundary_cond);
+  }
 
   if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to perform box filter."), ("%s",
+            vpiStatusGetName (status)));
     ret = GST_FLOW_ERROR;
   }
 
   return ret;
 }
 
+static void
+gst_vpi_box_filter_get_kernel_radius (GstVpiFilter * filter,
+    gint * radius_x, gint * radius_y)
+{
+  GstVpiBoxFilter *self = NULL;
+
+  g_return_if_fail (filter);
+  g_return_if_fail (radius_x);
+  g_return_if_fail (radius_y);
+
+  self = GST_VPI_BOX_FILTER (filter);
+
+  GST_OBJECT_LOCK (self);
+  *radius_x = self->size_x / 2;
+  *radius_y = self->size_y / 2;
+  GST_OBJECT_UNLOCK (self);
+}
+
 void
 gst_vpi_box_filter_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
 {
   GstVpiBoxFilter *self = GST_VPI_BOX_FILTER (object);
+  guint size = 0;
 
   GST_DEBUG_OBJECT (self, "set_property");
 
+  if (PROP_SIZE_X == property_id || PROP_SIZE_Y == property_id) {
+    size = g_value_get_uint (value);
+    if (0 == size % 2) {
+      size++;
+      GST_WARNING_OBJECT (self, "Property %s must be odd. Using %u instead.",
+          pspec->name, size);
+    }
+  }
+
   GST_OBJECT_LOCK (self);
   switch (property_id) {
     case PROP_0:
       break;
     case PROP_SIZE_X:
-      self->size_x = g_value_get_enum (value);
+      self->size_x = size;
       break;
     case PROP_SIZE_Y:
-      self->size_y = g_value_get_enum (value);
+      self->size_y = size;
       break;
     case PROP_BOUNDARY_COND:
       self->boundary_cond = g_value_get_enum (value);
       break;
+    case PROP_INTEGRAL_AREA:
+      self->integral_area = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -225,17 +433,34 @@ gst_vpi_box_filter_get_property (GObject * object, guint property_id,
     case PROP_0:
       break;
     case PROP_SIZE_X:
-      g_value_set_enum (value, self->size_x);
+      g_value_set_uint (value, self->size_x);
       break;
     case PROP_SIZE_Y:
-      g_value_set_enum (value, self->size_y);
+      g_value_set_uint (value, self->size_y);
       break;
     case PROP_BOUNDARY_COND:
       g_value_set_enum (value, self->boundary_cond);
       break;
+    case PROP_INTEGRAL_AREA:
+      g_value_set_uint (value, self->integral_area);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
   GST_OBJECT_UNLOCK (self);
 }
+
+void
+gst_vpi_box_filter_finalize (GObject * object)
+{
+  GstVpiBoxFilter *self = GST_VPI_BOX_FILTER (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_free (self->table);
+  self->table = NULL;
+  self->table_size = 0;
+
+  G_OBJECT_CLASS (gst_vpi_box_filter_parent_class)->finalize (object);
+}
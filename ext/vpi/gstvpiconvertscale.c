@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvpiconvertscale.h"
+
+#include <gst/gst.h>
+#include <vpi/algo/ConvertImageFormat.h>
+#include <vpi/algo/Rescale.h>
+
+#include "gst-libs/gst/vpi/gstvpi.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vpi_convert_scale_debug_category);
+#define GST_CAT_DEFAULT gst_vpi_convert_scale_debug_category
+
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE, NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }")
+
+#define DEFAULT_PROP_INTERPOLATOR VPI_INTERP_LINEAR
+#define DEFAULT_PROP_BOUNDARY_COND VPI_BOUNDARY_COND_ZERO
+#define DEFAULT_PROP_CONVERSION_POLICY VPI_CONVERSION_CLAMP
+
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+
+typedef enum
+{
+  VPI_CONVERT_SCALE_CONVERT,
+  VPI_CONVERT_SCALE_SCALE,
+  VPI_CONVERT_SCALE_SCALE_FIRST,
+  VPI_CONVERT_SCALE_CONVERT_FIRST,
+} VpiConvertScaleOrder;
+
+struct _GstVpiConvertScale
+{
+  GstVpiFilter parent;
+
+  gint interpolator;
+  gint boundary_cond;
+  gint conversion_policy;
+
+  VpiConvertScaleOrder order;
+  VPIImage scratch;
+};
+
+/* prototypes */
+static gboolean gst_vpi_convert_scale_start (GstVpiFilter * filter,
+    GstVideoInfo * in_info, GstVideoInfo * out_info);
+static GstFlowReturn gst_vpi_convert_scale_transform_image (GstVpiFilter *
+    filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
+static GstCaps *gst_vpi_convert_scale_fixate_caps (GstBaseTransform * base,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
+static GstCaps *gst_vpi_convert_scale_transform_caps (GstBaseTransform *
+    trans, GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static gboolean gst_vpi_convert_scale_stop (GstBaseTransform * trans);
+static void gst_vpi_convert_scale_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vpi_convert_scale_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+
+enum
+{
+  PROP_0,
+  PROP_INTERPOLATOR,
+  PROP_BOUNDARY_COND,
+  PROP_CONVERSION_POLICY
+};
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVpiConvertScale, gst_vpi_convert_scale,
+    GST_TYPE_VPI_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_vpi_convert_scale_debug_category,
+        "vpiconvertscale", 0, "debug category for vpiconvertscale element"));
+
+static void
+gst_vpi_convert_scale_class_init (GstVpiConvertScaleClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *bt_class = GST_BASE_TRANSFORM_CLASS (klass);
+  GstVpiFilterClass *vpi_filter_class = GST_VPI_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_AND_VPIIMAGE_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_AND_VPIIMAGE_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "VPI Convert Scale", "Filter/Converter/Video/Scaler",
+      "Converts video to another colorspace and resolution in a single "
+      "pass using VPI",
+      "Jimena Salas <jimena.salas@ridgerun.com>");
+
+  vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_convert_scale_start);
+  vpi_filter_class->transform_image =
+      GST_DEBUG_FUNCPTR (gst_vpi_convert_scale_transform_image);
+  bt_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_vpi_convert_scale_fixate_caps);
+  bt_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_vpi_convert_scale_transform_caps);
+  bt_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_convert_scale_stop);
+  gobject_class->set_property = gst_vpi_convert_scale_set_property;
+  gobject_class->get_property = gst_vpi_convert_scale_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_INTERPOLATOR,
+      g_param_spec_enum ("interpolator", "Interpolation method",
+          "Interpolation method to be used.",
+          VPI_INTERPOLATORS_ENUM, DEFAULT_PROP_INTERPOLATOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_BOUNDARY_COND,
+      g_param_spec_enum ("boundary", "Boundary condition",
+          "How pixel values outside of the image domain should be treated.",
+          VPI_BOUNDARY_CONDS_ENUM, DEFAULT_PROP_BOUNDARY_COND,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CONVERSION_POLICY,
+      g_param_spec_enum ("conversion-policy", "Conversion Policy",
+          "Policy used when converting between image types.",
+          VPI_CONVERSION_POLICY_ENUM, DEFAULT_PROP_CONVERSION_POLICY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  /* Disable any sort of processing if input/output caps are equal */
+  bt_class->passthrough_on_same_caps = TRUE;
+  bt_class->transform_ip_on_passthrough = FALSE;
+}
+
+static void
+gst_vpi_convert_scale_init (GstVpiConvertScale * self)
+{
+  self->interpolator = DEFAULT_PROP_INTERPOLATOR;
+  self->boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  self->conversion_policy = DEFAULT_PROP_CONVERSION_POLICY;
+  self->order = VPI_CONVERT_SCALE_CONVERT;
+  self->scratch = NULL;
+}
+
+static gboolean
+gst_vpi_convert_scale_start (GstVpiFilter * filter, GstVideoInfo * in_info,
+    GstVideoInfo * out_info)
+{
+  GstVpiConvertScale *self = NULL;
+  gboolean ret = TRUE;
+  VPIStatus status = VPI_SUCCESS;
+  GstVideoFormat scratch_format = GST_VIDEO_FORMAT_UNKNOWN;
+  gint in_width = 0, in_height = 0;
+  gint out_width = 0, out_height = 0;
+  gint scratch_width = 0, scratch_height = 0;
+
+  g_return_val_if_fail (filter, FALSE);
+  g_return_val_if_fail (in_info, FALSE);
+  g_return_val_if_fail (out_info, FALSE);
+
+  self = GST_VPI_CONVERT_SCALE (filter);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  /* Start may be called again on caps changes */
+  vpiImageDestroy (self->scratch);
+  self->scratch = NULL;
+
+  in_width = GST_VIDEO_INFO_WIDTH (in_info);
+  in_height = GST_VIDEO_INFO_HEIGHT (in_info);
+  out_width = GST_VIDEO_INFO_WIDTH (out_info);
+  out_height = GST_VIDEO_INFO_HEIGHT (out_info);
+
+  if (in_width == out_width && in_height == out_height) {
+    self->order = VPI_CONVERT_SCALE_CONVERT;
+  } else if (GST_VIDEO_INFO_FORMAT (in_info) ==
+      GST_VIDEO_INFO_FORMAT (out_info)) {
+    self->order = VPI_CONVERT_SCALE_SCALE;
+  } else if ((gint64) out_width * out_height < (gint64) in_width * in_height) {
+    /* Convert the fewer pixels, the intermediate is the output size in the
+       input format */
+    self->order = VPI_CONVERT_SCALE_SCALE_FIRST;
+    scratch_format = GST_VIDEO_INFO_FORMAT (in_info);
+    scratch_width = out_width;
+    scratch_height = out_height;
+  } else {
+    self->order = VPI_CONVERT_SCALE_CONVERT_FIRST;
+    scratch_format = GST_VIDEO_INFO_FORMAT (out_info);
+    scratch_width = in_width;
+    scratch_height = in_height;
+  }
+
+  GST_INFO_OBJECT (self, "Processing %s %dx%d into %s %dx%d with order %d",
+      GST_VIDEO_INFO_NAME (in_info), in_width, in_height,
+      GST_VIDEO_INFO_NAME (out_info), out_width, out_height, self->order);
+
+  if (GST_VIDEO_FORMAT_UNKNOWN == scratch_format) {
+    goto out;
+  }
+
+  status = vpiImageCreate (scratch_width, scratch_height,
+      gst_vpi_video_to_image_format (scratch_format), VPI_BACKEND_ALL,
+      &self->scratch);
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Could not create intermediate image."),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+  }
+
+out:
+  return ret;
+}
+
+static GstFlowReturn
+gst_vpi_convert_scale_transform_image (GstVpiFilter * filter,
+    VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame)
+{
+  GstVpiConvertScale *self = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  VPIStatus status = VPI_SUCCESS;
+  VPIImage scale_in = NULL;
+  VPIImage scale_out = NULL;
+  VPIImage convert_in = NULL;
+  VPIImage convert_out = NULL;
+  gint backend = VPI_BACKEND_INVALID;
+  gint interpolator = DEFAULT_PROP_INTERPOLATOR;
+  gint boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  gint conversion_policy = DEFAULT_PROP_CONVERSION_POLICY;
+
+  g_return_val_if_fail (filter, GST_FLOW_ERROR);
+  g_return_val_if_fail (stream, GST_FLOW_ERROR);
+  g_return_val_if_fail (in_frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (in_frame->image, GST_FLOW_ERROR);
+  g_return_val_if_fail (out_frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (out_frame->image, GST_FLOW_ERROR);
+
+  self = GST_VPI_CONVERT_SCALE (filter);
+
+  GST_LOG_OBJECT (self, "Transform image");
+
+  backend = gst_vpi_filter_get_backend (filter);
+
+  GST_OBJECT_LOCK (self);
+  interpolator = self->interpolator;
+  boundary_cond = self->boundary_cond;
+  conversion_policy = self->conversion_policy;
+  GST_OBJECT_UNLOCK (self);
+
+  switch (self->order) {
+    case VPI_CONVERT_SCALE_CONVERT:
+      convert_in = in_frame->image;
+      convert_out = out_frame->image;
+      break;
+    case VPI_CONVERT_SCALE_SCALE:
+      scale_in = in_frame->image;
+      scale_out = out_frame->image;
+      break;
+    case VPI_CONVERT_SCALE_SCALE_FIRST:
+      scale_in = in_frame->image;
+      scale_out = self->scratch;
+      convert_in = self->scratch;
+      convert_out = out_frame->image;
+      break;
+    case VPI_CONVERT_SCALE_CONVERT_FIRST:
+      convert_in = in_frame->image;
+      convert_out = self->scratch;
+      scale_in = self->scratch;
+      scale_out = out_frame->image;
+      break;
+    default:
+      g_return_val_if_reached (GST_FLOW_ERROR);
+  }
+
+  /* Both stages go into the same stream, the base class syncs once after
+     the last one */
+  if (VPI_CONVERT_SCALE_SCALE_FIRST == self->order && VPI_SUCCESS == status) {
+    status = vpiSubmitRescale (stream, backend, scale_in, scale_out,
+        interpolator, boundary_cond);
+  }
+
+  if (convert_in && VPI_SUCCESS == status) {
+    status = vpiSubmitConvertImageFormat (stream, backend, convert_in,
+        convert_out, conversion_policy, 1, 0);
+  }
+
+  if (VPI_CONVERT_SCALE_SCALE_FIRST != self->order && scale_in
+      && VPI_SUCCESS == status) {
+    status = vpiSubmitRescale (stream, backend, scale_in, scale_out,
+        interpolator, boundary_cond);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to perform conversion and rescale."), ("%s",
+            vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+  }
+
+  return ret;
+}
+
+static GstCaps *
+gst_vpi_convert_scale_fixate_caps (GstBaseTransform * base,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
+{
+  GstStructure *caps_struct = NULL;
+  GstStructure *othercaps_struct = NULL;
+  const gchar *format = NULL;
+  gint caps_w = 0, caps_h = 0;
+  gint ref_w = 0, ref_h = 0;
+  gint set_w = 0, set_h = 0;
+  gint par_n = 1, par_d = 1;
+  const gchar *dir = direction == GST_PAD_SRC ? "src" : "sink";
+  const gchar *otherdir = direction == GST_PAD_SRC ? "sink" : "src";
+
+  othercaps = gst_caps_truncate (othercaps);
+  othercaps = gst_caps_make_writable (othercaps);
+
+  GST_DEBUG_OBJECT (base, "trying to fixate %s othercaps %" GST_PTR_FORMAT
+      " based on %s caps %" GST_PTR_FORMAT, otherdir, othercaps, dir, caps);
+
+  caps_struct = gst_caps_get_structure (caps, 0);
+  othercaps_struct = gst_caps_get_structure (othercaps, 0);
+
+  /* Avoid a conversion unless the peer asks for it */
+  format = gst_structure_get_string (caps_struct, "format");
+  if (format) {
+    gst_structure_fixate_field_string (othercaps_struct, "format", format);
+  }
+
+  gst_structure_get_int (caps_struct, "width", &caps_w);
+  gst_structure_get_int (caps_struct, "height", &caps_h);
+
+  /* We want the othercaps to mimic the received caps, however if the received
+     caps are not fixed either, then fixate to a default resolution */
+  ref_w = (caps_w != 0) ? caps_w : DEFAULT_WIDTH;
+  ref_h = (caps_h != 0) ? caps_h : DEFAULT_HEIGHT;
+
+  gst_structure_fixate_field_nearest_int (othercaps_struct, "width", ref_w);
+  gst_structure_get_int (othercaps_struct, "width", &set_w);
+
+  gst_structure_fixate_field_nearest_int (othercaps_struct, "height", ref_h);
+  gst_structure_get_int (othercaps_struct, "height", &set_h);
+
+  /* Keep the display aspect ratio through the pixel aspect ratio */
+  gst_structure_get_fraction (caps_struct, "pixel-aspect-ratio", &par_n,
+      &par_d);
+  if (caps_w && caps_h && set_w && set_h) {
+    gst_util_fraction_multiply (par_n, par_d, caps_w * set_h, caps_h * set_w,
+        &par_n, &par_d);
+  }
+  if (gst_structure_has_field (othercaps_struct, "pixel-aspect-ratio")) {
+    gst_structure_fixate_field_nearest_fraction (othercaps_struct,
+        "pixel-aspect-ratio", par_n, par_d);
+  }
+
+  othercaps = gst_caps_fixate (othercaps);
+  GST_DEBUG_OBJECT (base, "Fixated othercaps to %" GST_PTR_FORMAT, othercaps);
+
+  return othercaps;
+}
+
+static GstCaps *
+gst_vpi_convert_scale_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+  GstCaps *othercaps = NULL;
+  gint i = 0;
+  const gchar *dir = direction == GST_PAD_SRC ? "src" : "sink";
+  const gchar *otherdir = direction == GST_PAD_SRC ? "sink" : "src";
+
+  GST_DEBUG_OBJECT (trans,
+      "Negotiating %s caps given the following %s caps: %" GST_PTR_FORMAT
+      " and filter: %" GST_PTR_FORMAT, otherdir, dir, caps, filter);
+
+  othercaps = gst_caps_copy (caps);
+
+  for (i = 0; i < gst_caps_get_size (othercaps); ++i) {
+    GstStructure *st = gst_caps_get_structure (othercaps, i);
+
+    /* Format and size are allowed to change, along with the pixel aspect
+       ratio */
+    gst_structure_remove_field (st, "format");
+    gst_structure_remove_field (st, "width");
+    gst_structure_remove_field (st, "height");
+    if (gst_structure_has_field (st, "pixel-aspect-ratio")) {
+      gst_structure_set (st, "pixel-aspect-ratio", GST_TYPE_FRACTION_RANGE,
+          1, G_MAXINT, G_MAXINT, 1, NULL);
+    }
+  }
+
+  if (filter) {
+    GstCaps *tmp = othercaps;
+    othercaps = gst_caps_intersect (othercaps, filter);
+    gst_caps_unref (tmp);
+  }
+
+  GST_DEBUG_OBJECT (trans, "Transformed %s caps to: %" GST_PTR_FORMAT, otherdir,
+      othercaps);
+
+  return othercaps;
+}
+
+static gboolean
+gst_vpi_convert_scale_stop (GstBaseTransform * trans)
+{
+  GstVpiConvertScale *self = GST_VPI_CONVERT_SCALE (trans);
+  gboolean ret = TRUE;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_vpi_convert_scale_parent_class)->stop
+      (trans);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  vpiImageDestroy (self->scratch);
+  self->scratch = NULL;
+
+  return ret;
+}
+
+void
+gst_vpi_convert_scale_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVpiConvertScale *self = GST_VPI_CONVERT_SCALE (object);
+
+  GST_DEBUG_OBJECT (self, "set_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      self->interpolator = g_value_get_enum (value);
+      break;
+    case PROP_BOUNDARY_COND:
+      self->boundary_cond = g_value_get_enum (value);
+      break;
+    case PROP_CONVERSION_POLICY:
+      self->conversion_policy = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+void
+gst_vpi_convert_scale_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVpiConvertScale *self = GST_VPI_CONVERT_SCALE (object);
+
+  GST_DEBUG_OBJECT (self, "get_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      g_value_set_enum (value, self->interpolator);
+      break;
+    case PROP_BOUNDARY_COND:
+      g_value_set_enum (value, self->boundary_cond);
+      break;
+    case PROP_CONVERSION_POLICY:
+      g_value_set_enum (value, self->conversion_policy);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
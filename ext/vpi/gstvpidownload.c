@@ -19,11 +19,14 @@
 
 #include "gstvpidownload.h"
 
+#include "gst-libs/gst/vpi/gstvpi.h"
+
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_download_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_download_debug_category
 
-#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS_ALL)
-#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", GST_VIDEO_FORMATS_ALL)
+/* Downloading doesn't convert, only what VPI can wrap comes out */
+#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE (GST_VPI_SUPPORTED_FORMATS)
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", GST_VPI_SUPPORTED_FORMATS)
 
 struct _GstVpiDownload
 {
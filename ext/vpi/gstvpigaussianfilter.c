@@ -18,23 +18,20 @@
 
 #include <gst/gst.h>
 #include <vpi/algo/GaussianFilter.h>
+#include <vpi/algo/Rescale.h>
 
 #include <math.h>
+#include <string.h>
 
 #include "gst-libs/gst/vpi/gstvpi.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_gaussian_filter_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_gaussian_filter_debug_category
 
-#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_BE, GRAY16_LE }")
-
-
-////#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:VPIImage", VPI_SUPPORTED_FORMATS)
-////#define VIDEO_AND_NVMM_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", VPI_SUPPORTED_FORMATS)
-//#define VIDEO_SINK_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ GRAY8, GRAY16_BE, GRAY16_LE }")
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE, NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }")
 
 #define DEFAULT_PROP_SIZE_MIN 0
-#define DEFAULT_PROP_SIZE_MAX 11
+#define DEFAULT_PROP_SIZE_MAX 255
 #define DEFAULT_PROP_SIGMA_MIN 0.0
 #define DEFAULT_PROP_SIGMA_MAX G_MAXDOUBLE
 
@@ -42,6 +39,28 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_gaussian_filter_debug_category);
 #define DEFAULT_PROP_SIGMA 1.7
 #define DEFAULT_PROP_BOUNDARY_COND VPI_BOUNDARY_COND_ZERO
 
+/* Largest kernel VPI runs in a single pass, and the widest sigma it fits */
+#define MAX_PASS_SIZE 11
+#define MAX_PASS_SIGMA 2.0
+/* Beyond this many passes a pyramid is cheaper */
+#define MAX_PASSES 4
+#define MAX_LEVELS 6
+/* Luma and interleaved chroma of NV12 */
+#define MAX_PLANES 2
+
+/* How a blur is split into what VPI can run. Passes of sigma s add up to
+   sqrt(passes) * s, and every pyramid level halves the sigma left */
+typedef struct _GstVpiGaussianPlan GstVpiGaussianPlan;
+struct _GstVpiGaussianPlan
+{
+  gint passes;
+  gint levels;
+  gint size_x;
+  gint size_y;
+  gdouble sigma_x;
+  gdouble sigma_y;
+};
+
 struct _GstVpiGaussianFilter
 {
   GstVpiFilter parent;
@@ -50,6 +69,21 @@ struct _GstVpiGaussianFilter
   gint size_y;
   gdouble sigma_x;
   gdouble sigma_y;
+  /* Set once the coarse blur of interleaved formats has been warned about
+     for the current properties */
+  gboolean coarse_warned;
+
+  GstVideoFormat format;
+  /* Intermediates of each plane, created on first use for the size of the
+     image being filtered */
+  VPIImage pass_images[MAX_PLANES][2];
+  VPIImage plane_levels[MAX_PLANES][MAX_LEVELS + 1];
+  VPIImage plane_bottoms[MAX_PLANES][MAX_LEVELS + 1];
+  VPIImage frame_levels[MAX_LEVELS + 1];
+};
+
+static const VPIImageFormat nv12_plane_formats[MAX_PLANES] = {
+  VPI_IMAGE_FORMAT_U8, VPI_IMAGE_FORMAT_2U8
 };
 
 /* prototypes */
@@ -57,10 +91,13 @@ static gboolean gst_vpi_gaussian_filter_start (GstVpiFilter * filter,
     GstVideoInfo * in_info, GstVideoInfo * out_info);
 static GstFlowReturn gst_vpi_gaussian_filter_transform_image (GstVpiFilter *
     filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
+static void gst_vpi_gaussian_filter_get_kernel_radius (GstVpiFilter * filter,
+    gint * radius_x, gint * radius_y);
 static void gst_vpi_gaussian_filter_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_vpi_gaussian_filter_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
+static gboolean gst_vpi_gaussian_filter_stop (GstBaseTransform * trans);
 static void gst_vpi_gaussian_filter_finalize (GObject * object);
 
 enum
@@ -85,6 +122,7 @@ static void
 gst_vpi_gaussian_filter_class_init (GstVpiGaussianFilterClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *bt_class = GST_BASE_TRANSFORM_CLASS (klass);
   GstVpiFilterClass *vpi_filter_class = GST_VPI_FILTER_CLASS (klass);
 
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -96,12 +134,16 @@ gst_vpi_gaussian_filter_class_init (GstVpiGaussianFilterClass * klass)
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "VPI Gaussian Filter", "Filter/Video",
-      "VPI Gaussian filter element for grayscale images.",
+      "VPI Gaussian filter element for grayscale, NV12 and RGB images.",
       "Jimena Salas <jimena.salas@ridgerun.com>");
 
   vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_gaussian_filter_start);
   vpi_filter_class->transform_image =
       GST_DEBUG_FUNCPTR (gst_vpi_gaussian_filter_transform_image);
+  vpi_filter_class->get_kernel_radius =
+      GST_DEBUG_FUNCPTR (gst_vpi_gaussian_filter_get_kernel_radius);
+  vpi_filter_class->supports_roi = TRUE;
+  bt_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_gaussian_filter_stop);
   gobject_class->set_property = gst_vpi_gaussian_filter_set_property;
   gobject_class->get_property = gst_vpi_gaussian_filter_get_property;
   gobject_class->finalize = gst_vpi_gaussian_filter_finalize;
@@ -109,7 +151,8 @@ gst_vpi_gaussian_filter_class_init (GstVpiGaussianFilterClass * klass)
   g_object_class_install_property (gobject_class, PROP_SIZE_X,
       g_param_spec_int ("size-x", "Kernel size X",
           "Gaussian kernel size in X direction. "
-          "Must be between 0 and 11, and odd."
+          "Must be between 0 and 255, and odd. Kernels above 11 are "
+          "approximated with several passes or a pyramid. "
           "If it is 0, sigma-x will be used to compute its value.",
           DEFAULT_PROP_SIZE_MIN, DEFAULT_PROP_SIZE_MAX, DEFAULT_PROP_SIZE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
@@ -117,7 +160,8 @@ gst_vpi_gaussian_filter_class_init (GstVpiGaussianFilterClass * klass)
   g_object_class_install_property (gobject_class, PROP_SIZE_Y,
       g_param_spec_int ("size-y", "Kernel size Y",
           "Gaussian kernel size in Y direction. "
-          "Must be between 0 and 11, and odd."
+          "Must be between 0 and 255, and odd. Kernels above 11 are "
+          "approximated with several passes or a pyramid. "
           "If it is 0, sigma-y will be used to compute its value.",
           DEFAULT_PROP_SIZE_MIN, DEFAULT_PROP_SIZE_MAX, DEFAULT_PROP_SIZE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
@@ -151,6 +195,40 @@ gst_vpi_gaussian_filter_init (GstVpiGaussianFilter * self)
   self->size_y = DEFAULT_PROP_SIZE;
   self->sigma_x = DEFAULT_PROP_SIGMA;
   self->sigma_y = DEFAULT_PROP_SIGMA;
+  self->coarse_warned = FALSE;
+  self->format = GST_VIDEO_FORMAT_UNKNOWN;
+  memset (self->pass_images, 0, sizeof (self->pass_images));
+  memset (self->plane_levels, 0, sizeof (self->plane_levels));
+  memset (self->plane_bottoms, 0, sizeof (self->plane_bottoms));
+  memset (self->frame_levels, 0, sizeof (self->frame_levels));
+}
+
+static void
+gst_vpi_gaussian_filter_free_images (GstVpiGaussianFilter * self)
+{
+  guint plane = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  for (plane = 0; plane < MAX_PLANES; plane++) {
+    for (i = 0; i < G_N_ELEMENTS (self->pass_images[plane]); i++) {
+      vpiImageDestroy (self->pass_images[plane][i]);
+      self->pass_images[plane][i] = NULL;
+    }
+
+    for (i = 0; i <= MAX_LEVELS; i++) {
+      vpiImageDestroy (self->plane_levels[plane][i]);
+      self->plane_levels[plane][i] = NULL;
+      vpiImageDestroy (self->plane_bottoms[plane][i]);
+      self->plane_bottoms[plane][i] = NULL;
+    }
+  }
+
+  for (i = 0; i <= MAX_LEVELS; i++) {
+    vpiImageDestroy (self->frame_levels[i]);
+    self->frame_levels[i] = NULL;
+  }
 }
 
 static gint
@@ -165,7 +243,8 @@ gst_vpi_gaussian_filter_adjust_size (GstVpiGaussianFilter * self, gint size,
     GST_WARNING_OBJECT (self, "Properties size and sigma cannot be both 0 in "
         "the same direction. Using default value %d for size.", ret);
   } else if (0 == size) {
-    /* Using VPI Gaussian Filter formula: size = max{3, 2*ceil(3*sigma)-1} */
+    /* Using VPI Gaussian Filter formula: size = max{3, 2*ceil(3*sigma)-1},
+       larger kernels are split later on */
     ret = 2 * ceil (3 * sigma) - 1;
     ret = (3 < ret) ? ret : 3;
     GST_WARNING_OBJECT (self,
@@ -179,6 +258,13 @@ gst_vpi_gaussian_filter_adjust_size (GstVpiGaussianFilter * self, gint size,
   return ret;
 }
 
+/* Using OpenCV getGaussianKernel formula */
+static gdouble
+gst_vpi_gaussian_filter_sigma_from_size (gint size)
+{
+  return 0.3 * ((size - 1) * 0.5 - 1) + 0.8;
+}
+
 static gdouble
 gst_vpi_gaussian_filter_adjust_sigma (GstVpiGaussianFilter * self, gint size,
     gdouble sigma)
@@ -191,8 +277,7 @@ gst_vpi_gaussian_filter_adjust_sigma (GstVpiGaussianFilter * self, gint size,
     GST_WARNING_OBJECT (self, "Properties size and sigma cannot be both 0 in "
         "the same direction. Using default value %f for sigma.", ret);
   } else if (0 == sigma) {
-    /* Using OpenCV getGaussianKernel formula */
-    ret = 0.3 * ((size - 1) * 0.5 - 1) + 0.8;
+    ret = gst_vpi_gaussian_filter_sigma_from_size (size);
     GST_WARNING_OBJECT (self,
         "Property sigma is 0. Using size to calculate new value: %f.", ret);
   } else {
@@ -201,6 +286,15 @@ gst_vpi_gaussian_filter_adjust_sigma (GstVpiGaussianFilter * self, gint size,
   return ret;
 }
 
+/* Levels of a plain down/up pyramid that blur about as much as sigma */
+static gint
+gst_vpi_gaussian_filter_get_frame_levels (gdouble sigma_x, gdouble sigma_y)
+{
+  gint levels = round (log2 (MAX (sigma_x, sigma_y)));
+
+  return CLAMP (levels, 0, MAX_LEVELS);
+}
+
 static gboolean
 gst_vpi_gaussian_filter_start (GstVpiFilter * filter, GstVideoInfo * in_info,
     GstVideoInfo * out_info)
@@ -216,7 +310,12 @@ gst_vpi_gaussian_filter_start (GstVpiFilter * filter, GstVideoInfo * in_info,
 
   GST_DEBUG_OBJECT (self, "start");
 
+  /* Start may be called again on caps changes */
+  gst_vpi_gaussian_filter_free_images (self);
+  self->format = GST_VIDEO_INFO_FORMAT (in_info);
+
   /* Adjust size and sigma in case they are invalid */
+  GST_OBJECT_LOCK (self);
   self->size_x = gst_vpi_gaussian_filter_adjust_size (self, self->size_x,
       self->sigma_x);
   self->sigma_x = gst_vpi_gaussian_filter_adjust_sigma (self, self->size_x,
@@ -225,6 +324,8 @@ gst_vpi_gaussian_filter_start (GstVpiFilter * filter, GstVideoInfo * in_info,
       self->sigma_y);
   self->sigma_y = gst_vpi_gaussian_filter_adjust_sigma (self, self->size_y,
       self->sigma_y);
+  self->coarse_warned = FALSE;
+  GST_OBJECT_UNLOCK (self);
 
   GST_INFO_OBJECT (self, "\nProperties summary:\nsize-x=%d\nsigma-x=%f\nsize-y="
       "%d\nsigma-y=%f\nboundary=%d", self->size_x, self->sigma_x, self->size_y,
@@ -233,6 +334,202 @@ gst_vpi_gaussian_filter_start (GstVpiFilter * filter, GstVideoInfo * in_info,
   return ret;
 }
 
+static gint
+gst_vpi_gaussian_filter_size_from_sigma (gdouble sigma)
+{
+  gint size = 2 * ceil (3 * sigma) - 1;
+
+  return CLAMP (size, 3, MAX_PASS_SIZE);
+}
+
+static void
+gst_vpi_gaussian_filter_get_plan (gint size_x, gint size_y, gdouble sigma_x,
+    gdouble sigma_y, GstVpiGaussianPlan * plan)
+{
+  gdouble sigma = MAX (sigma_x, sigma_y);
+  gdouble scale = 1;
+
+  g_return_if_fail (plan);
+
+  plan->passes = 1;
+  plan->levels = 0;
+  plan->size_x = size_x;
+  plan->size_y = size_y;
+  plan->sigma_x = sigma_x;
+  plan->sigma_y = sigma_y;
+
+  if (size_x <= MAX_PASS_SIZE && size_y <= MAX_PASS_SIZE) {
+    goto out;
+  }
+
+  if (sigma <= MAX_PASS_SIGMA) {
+    /* The kernel is wider than the sigma needs, truncating it is enough */
+    plan->size_x = MIN (size_x, MAX_PASS_SIZE);
+    plan->size_y = MIN (size_y, MAX_PASS_SIZE);
+    goto out;
+  }
+
+  plan->passes = ceil ((sigma * sigma) / (MAX_PASS_SIGMA * MAX_PASS_SIGMA));
+  if (plan->passes <= MAX_PASSES) {
+    scale = 1 / sqrt (plan->passes);
+  } else {
+    plan->passes = 1;
+    plan->levels = ceil (log2 (sigma / MAX_PASS_SIGMA));
+    plan->levels = MIN (plan->levels, MAX_LEVELS);
+    scale = 1.0 / (1 << plan->levels);
+  }
+
+  plan->sigma_x = sigma_x * scale;
+  plan->sigma_y = sigma_y * scale;
+  plan->size_x = gst_vpi_gaussian_filter_size_from_sigma (plan->sigma_x);
+  plan->size_y = gst_vpi_gaussian_filter_size_from_sigma (plan->sigma_y);
+
+out:
+  return;
+}
+
+/* Kernel of the chroma of 4:2:0 formats, which is subsampled by two */
+static gint
+gst_vpi_gaussian_filter_chroma_size (gint size)
+{
+  return MAX ((size / 2) | 1, 3);
+}
+
+/* Gets an intermediate with the size of src at the given pyramid level,
+   replacing the cached one if src changed size */
+static VPIStatus
+gst_vpi_gaussian_filter_get_image (GstVpiGaussianFilter * self,
+    VPIStream stream, VPIImage * image, VPIImage src, gint level,
+    VPIImageFormat format)
+{
+  VPIStatus status = VPI_SUCCESS;
+  gint32 width = 0;
+  gint32 height = 0;
+  gint32 image_width = 0;
+  gint32 image_height = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (src, VPI_ERROR_INVALID_ARGUMENT);
+
+  status = vpiImageGetSize (src, &width, &height);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+  width = MAX (width >> level, 1);
+  height = MAX (height >> level, 1);
+
+  if (*image) {
+    vpiImageGetSize (*image, &image_width, &image_height);
+    if (image_width == width && image_height == height) {
+      goto out;
+    }
+
+    /* Regions of another size may still be using it */
+    vpiStreamSync (stream);
+    vpiImageDestroy (*image);
+    *image = NULL;
+  }
+
+  status = vpiImageCreate (width, height, format, VPI_BACKEND_ALL, image);
+
+out:
+  return status;
+}
+
+/* Halves the image levels times, optionally blurs the smallest one and
+   scales it back up into dst */
+static VPIStatus
+gst_vpi_gaussian_filter_pyramid (GstVpiGaussianFilter * self,
+    VPIStream stream, gint backend, VPIImage src, VPIImage dst,
+    VPIImageFormat format, gint levels, VPIImage * level_images,
+    VPIImage * bottom_images, const GstVpiGaussianPlan * plan,
+    gint boundary_cond)
+{
+  VPIStatus status = VPI_SUCCESS;
+  VPIImage current = src;
+  VPIImage next = NULL;
+  gint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (level_images, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (levels > 0
+      && levels <= MAX_LEVELS, VPI_ERROR_INVALID_ARGUMENT);
+
+  for (i = 1; i <= levels && VPI_SUCCESS == status; i++) {
+    status = gst_vpi_gaussian_filter_get_image (self, stream,
+        &level_images[i], src, i, format);
+    if (VPI_SUCCESS == status) {
+      status = vpiSubmitRescale (stream, backend, current, level_images[i],
+          VPI_INTERP_LINEAR, VPI_BOUNDARY_COND_CLAMP);
+      current = level_images[i];
+    }
+  }
+
+  if (bottom_images && VPI_SUCCESS == status) {
+    status = gst_vpi_gaussian_filter_get_image (self, stream,
+        &bottom_images[levels], src, levels, format);
+    if (VPI_SUCCESS == status) {
+      status = vpiSubmitGaussianFilter (stream, backend, current,
+          bottom_images[levels], plan->size_x, plan->size_y, plan->sigma_x,
+          plan->sigma_y, boundary_cond);
+      current = bottom_images[levels];
+    }
+  }
+
+  /* Going up overwrites levels that were already read on the way down */
+  for (i = levels - 1; i >= 0 && VPI_SUCCESS == status; i--) {
+    next = 0 == i ? dst : level_images[i];
+    status = vpiSubmitRescale (stream, backend, current, next,
+        VPI_INTERP_LINEAR, VPI_BOUNDARY_COND_CLAMP);
+    current = next;
+  }
+
+  return status;
+}
+
+/* Blur of a single plane image, split as the plan says. Passes are exact,
+   plans with pyramid levels are approximated by linear down and up
+   scaling */
+static VPIStatus
+gst_vpi_gaussian_filter_blur_plane (GstVpiGaussianFilter * self,
+    VPIStream stream, gint backend, VPIImage src, VPIImage dst, guint plane,
+    VPIImageFormat format, const GstVpiGaussianPlan * plan, gint boundary_cond)
+{
+  VPIStatus status = VPI_SUCCESS;
+  VPIImage current = src;
+  VPIImage next = NULL;
+  gint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (plan, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (plane < MAX_PLANES, VPI_ERROR_INVALID_ARGUMENT);
+
+  if (plan->levels > 0) {
+    status = gst_vpi_gaussian_filter_pyramid (self, stream, backend, src, dst,
+        format, plan->levels, self->plane_levels[plane],
+        self->plane_bottoms[plane], plan, boundary_cond);
+    goto out;
+  }
+
+  for (i = 0; i < plan->passes && VPI_SUCCESS == status; i++) {
+    next = dst;
+    if (i < plan->passes - 1) {
+      status = gst_vpi_gaussian_filter_get_image (self, stream,
+          &self->pass_images[plane][i % 2], src, 0, format);
+      next = self->pass_images[plane][i % 2];
+    }
+    if (VPI_SUCCESS == status) {
+      status = vpiSubmitGaussianFilter (stream, backend, current, next,
+          plan->size_x, plan->size_y, plan->sigma_x, plan->sigma_y,
+          boundary_cond);
+      current = next;
+    }
+  }
+
+out:
+  return status;
+}
 
 static GstFlowReturn
 gst_vpi_gaussian_filter_transform_image (GstVpiFilter * filter,
@@ -241,12 +538,18 @@ gst_vpi_gaussian_filter_transform_image (GstVpiFilter * filter,
   GstVpiGaussianFilter *self = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   VPIStatus status = VPI_SUCCESS;
+  GstVpiGaussianPlan plans[MAX_PLANES] = { {0} };
+  VPIImage in_plane = NULL;
+  VPIImage out_plane = NULL;
   gint size_x = 0;
   gint size_y = 0;
   gint boundary_cond = 0;
   gdouble sigma_x = 0;
   gdouble sigma_y = 0;
   gint backend = VPI_BACKEND_INVALID;
+  gint levels = 0;
+  gboolean warn = FALSE;
+  guint i = 0;
 
   g_return_val_if_fail (filter, GST_FLOW_ERROR);
   g_return_val_if_fail (stream, GST_FLOW_ERROR);
@@ -269,16 +572,90 @@ gst_vpi_gaussian_filter_transform_image (GstVpiFilter * filter,
 
   backend = gst_vpi_filter_get_backend (filter);
 
-  status = vpiSubmitGaussianFilter (stream, backend, in_frame->image,
-      out_frame->image, size_x, size_y, sigma_x, sigma_y, boundary_cond);
+  gst_vpi_gaussian_filter_get_plan (size_x, size_y, sigma_x, sigma_y,
+      &plans[0]);
+
+  switch (self->format) {
+    case GST_VIDEO_FORMAT_GRAY8:
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+      status = gst_vpi_gaussian_filter_blur_plane (self, stream, backend,
+          in_frame->image, out_frame->image, 0,
+          gst_vpi_video_to_image_format (self->format), &plans[0],
+          boundary_cond);
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+      /* Each plane gets its own plan, the chroma one at half the
+         resolution */
+      gst_vpi_gaussian_filter_get_plan (gst_vpi_gaussian_filter_chroma_size
+          (size_x), gst_vpi_gaussian_filter_chroma_size (size_y),
+          sigma_x / 2, sigma_y / 2, &plans[1]);
+      for (i = 0; i < MAX_PLANES && VPI_SUCCESS == status; i++) {
+        status = gst_vpi_filter_get_plane_view (filter, in_frame, i,
+            nv12_plane_formats[i], &in_plane);
+        if (VPI_SUCCESS == status) {
+          status = gst_vpi_filter_get_plane_view (filter, out_frame, i,
+              nv12_plane_formats[i], &out_plane);
+        }
+        if (VPI_SUCCESS == status) {
+          status = gst_vpi_gaussian_filter_blur_plane (self, stream, backend,
+              in_plane, out_plane, i, nv12_plane_formats[i], &plans[i],
+              boundary_cond);
+        }
+      }
+      break;
+    default:
+      /* VPI only filters single channel images, interleaved ones are
+         blurred through a pyramid. Sigmas below a level still get one,
+         which blurs about as much as a sigma of 2 */
+      levels = gst_vpi_gaussian_filter_get_frame_levels (sigma_x, sigma_y);
+      if (0 == levels) {
+        GST_OBJECT_LOCK (self);
+        warn = !self->coarse_warned;
+        self->coarse_warned = TRUE;
+        GST_OBJECT_UNLOCK (self);
+      }
+      if (warn) {
+        GST_ELEMENT_WARNING (self, LIBRARY, SETTINGS,
+            ("Sigma %f is too small for %s frames, blurring with one "
+                "pyramid level instead.", MAX (sigma_x, sigma_y),
+                gst_video_format_to_string (self->format)), (NULL));
+      }
+      status = gst_vpi_gaussian_filter_pyramid (self, stream, backend,
+          in_frame->image, out_frame->image,
+          gst_vpi_video_to_image_format (self->format), MAX (levels, 1),
+          self->frame_levels, NULL, &plans[0], boundary_cond);
+      break;
+  }
 
   if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to perform Gaussian filter."), ("%s",
+            vpiStatusGetName (status)));
     ret = GST_FLOW_ERROR;
   }
 
   return ret;
 }
 
+/* Reach of the requested kernel, passes and pyramids approximate it */
+static void
+gst_vpi_gaussian_filter_get_kernel_radius (GstVpiFilter * filter,
+    gint * radius_x, gint * radius_y)
+{
+  GstVpiGaussianFilter *self = NULL;
+
+  g_return_if_fail (filter);
+  g_return_if_fail (radius_x);
+  g_return_if_fail (radius_y);
+
+  self = GST_VPI_GAUSSIAN_FILTER (filter);
+
+  GST_OBJECT_LOCK (self);
+  *radius_x = MAX (self->size_x / 2, ceil (3 * self->sigma_x));
+  *radius_y = MAX (self->size_y / 2, ceil (3 * self->sigma_y));
+  GST_OBJECT_UNLOCK (self);
+}
+
 void
 gst_vpi_gaussian_filter_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
@@ -288,6 +665,7 @@ gst_vpi_gaussian_filter_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (self, "set_property");
 
   GST_OBJECT_LOCK (self);
+  self->coarse_warned = FALSE;
   switch (property_id) {
     case PROP_SIZE_X:
       self->size_x = g_value_get_int (value);
@@ -343,6 +721,22 @@ gst_vpi_gaussian_filter_get_property (GObject * object, guint property_id,
   GST_OBJECT_UNLOCK (self);
 }
 
+static gboolean
+gst_vpi_gaussian_filter_stop (GstBaseTransform * trans)
+{
+  GstVpiGaussianFilter *self = GST_VPI_GAUSSIAN_FILTER (trans);
+  gboolean ret = TRUE;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_vpi_gaussian_filter_parent_class)->stop
+      (trans);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  gst_vpi_gaussian_filter_free_images (self);
+
+  return ret;
+}
+
 void
 gst_vpi_gaussian_filter_finalize (GObject * object)
 {
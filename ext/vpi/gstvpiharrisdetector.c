@@ -17,19 +17,33 @@
 #include "gstvpiharrisdetector.h"
 
 #include <gst/gst.h>
+#include <vpi/algo/ConvertImageFormat.h>
+#include <vpi/algo/GaussianPyramid.h>
 #include <vpi/algo/HarrisCornerDetector.h>
+#include <vpi/algo/OpticalFlowPyrLK.h>
+#include <vpi/algo/Rescale.h>
 #include <vpi/Array.h>
+#include <vpi/Pyramid.h>
+
+#include "gst-libs/gst/vpi/gstvpi.h"
+#include "gst-libs/gst/vpi/gstvpibufferpool.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_harris_detector_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_harris_detector_debug_category
 
-#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8 }")
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE }")
 
 #define VPI_HARRIS_PARAMS_SIZE_ENUM (vpi_harris_params_size_enum_get_type ())
 GType vpi_harris_params_size_enum_get_type (void);
 
+#define VPI_HARRIS_PROPAGATION_ENUM (vpi_harris_propagation_enum_get_type ())
+GType vpi_harris_propagation_enum_get_type (void);
+
 /* PVA backend only allows 8192 */
-#define VPI_ARRAY_CAPACITY 8192
+#define PVA_ARRAY_CAPACITY 8192
+#define MAX_ARRAY_CAPACITY 65536
+/* Idle arrays kept for other detectors in the process */
+#define MAX_POOLED_OUTPUTS 16
 
 /* To use with GstVideoRegionOfInterestMeta */
 #define KEYPOINTS_SIZE 0
@@ -39,28 +53,154 @@ GType vpi_harris_params_size_enum_get_type (void);
 #define HARRIS_PARAMS_SIZE_5 5
 #define HARRIS_PARAMS_SIZE_7 7
 
+/* Optical flow runs on 8 bit pyramids of images downscaled by this
+   factor */
+#define FLOW_DOWNSCALE 4
+#define NUM_FLOW_IMAGES 2
+#define FLOW_PYRAMID_LEVELS 3
+#define FLOW_PYRAMID_SCALE 0.5
+#define FLOW_WINDOW_SIZE 15
+#define FLOW_ITERATIONS 6
+#define FLOW_EPSILON 0.01
+#define FLOW_TRACKED 0
+/* Maps the 16 bit range to 8 bits */
+#define FLOW_U16_TO_U8_SCALE (1.0 / 256)
+
+/* Regions smaller than this are not worth a Harris submission */
+#define MIN_REGION_SIZE 16
+/* Region payloads kept between frames, least recently used go first */
+#define MAX_REGION_PAYLOADS 8
+
+typedef struct _GstVpiHarrisRegion GstVpiHarrisRegion;
+typedef struct _GstVpiHarrisOutput GstVpiHarrisOutput;
+typedef struct _GstVpiHarrisCandidate GstVpiHarrisCandidate;
+
+struct _GstVpiHarrisRegion
+{
+  guint x;
+  guint y;
+  guint width;
+  guint height;
+  VPIImage view;
+};
+
+struct _GstVpiHarrisOutput
+{
+  VPIArray keypoints;
+  VPIArray scores;
+  guint capacity;
+};
+
+struct _GstVpiHarrisCandidate
+{
+  guint32 score;
+  VPIKeypoint keypoint;
+};
+
+typedef enum
+{
+  PROPAGATION_HOLD,
+  PROPAGATION_FLOW,
+} GstVpiHarrisPropagation;
+
 #define DEFAULT_PROP_MIN_NMS_DISTANCE_MIN 0
 #define DEFAULT_PROP_MIN_NMS_DISTANCE_MAX G_MAXDOUBLE
 #define DEFAULT_PROP_SENSITIVITY_MIN 0
 #define DEFAULT_PROP_SENSITIVITY_MAX 1
 #define DEFAULT_PROP_STRENGTH_THRESH_MIN 0
 #define DEFAULT_PROP_STRENGTH_THRESH_MAX G_MAXDOUBLE
+#define DEFAULT_PROP_DETECT_INTERVAL_MIN 1
+#define DEFAULT_PROP_DETECT_INTERVAL_MAX G_MAXINT
+#define DEFAULT_PROP_MAX_KEYPOINTS_MIN 0
+#define DEFAULT_PROP_MAX_KEYPOINTS_MAX G_MAXINT
+#define DEFAULT_PROP_GRID_MIN 1
+#define DEFAULT_PROP_GRID_MAX 64
+#define DEFAULT_PROP_DETECT_SCALE_MIN 0.05
+#define DEFAULT_PROP_DETECT_SCALE_MAX 1
+#define DEFAULT_PROP_CAPACITY_MIN 64
+#define DEFAULT_PROP_CAPACITY_MAX MAX_ARRAY_CAPACITY
 
 #define DEFAULT_PROP_GRADIENT_SIZE HARRIS_PARAMS_SIZE_5
 #define DEFAULT_PROP_BLOCK_SIZE HARRIS_PARAMS_SIZE_5
 #define DEFAULT_PROP_MIN_NMS_DISTANCE 8
 #define DEFAULT_PROP_SENSITIVITY 0.01
 #define DEFAULT_PROP_STRENGTH_THRESH 20
+#define DEFAULT_PROP_DETECT_INTERVAL 1
+#define DEFAULT_PROP_PROPAGATION PROPAGATION_HOLD
+#define DEFAULT_PROP_MAX_KEYPOINTS 0
+#define DEFAULT_PROP_GRID_COLUMNS 4
+#define DEFAULT_PROP_GRID_ROWS 4
+#define DEFAULT_PROP_DETECT_SCALE 1
+#define DEFAULT_PROP_CAPACITY 8192
 
 struct _GstVpiHarrisDetector
 {
   GstVpiFilter parent;
-  VPIArray keypoints;
-  VPIArray scores;
+  GstVpiHarrisOutput *frame_output;
   VPIHarrisCornerDetectorParams harris_params;
   VPIPayload harris;
+  guint detect_interval;
+  GstVpiHarrisPropagation propagation;
+  guint frame_count;
+  /* Keypoints attached to every buffer, refreshed on detection frames */
+  GArray *last_keypoints;
+  /* Optical flow state, created on the first frame that needs it */
+  VPIPayload flow;
+  VPIImage flow_image;
+  VPIImage flow_scaled;
+  VPIPyramid flow_pyramids[NUM_FLOW_IMAGES];
+  VPIArray flow_prev_points;
+  VPIArray flow_next_points;
+  VPIArray flow_status;
+  guint flow_width;
+  guint flow_height;
+  guint flow_index;
+  gboolean flow_valid;
+  guint width;
+  guint height;
+  VPIImageFormat format;
+  GstVideoFormat video_format;
+  /* Regions of the current buffer in frame coordinates */
+  GArray *regions;
+  /* Regions of the frame being processed */
+  GArray *frame_regions;
+  GPtrArray *region_outputs;
+  /* Harris payloads for region sizes, keyed by width and height */
+  GHashTable *region_payloads;
+  /* Keys of region_payloads, most recently used first */
+  GQueue region_payload_keys;
+  guint max_keypoints;
+  guint grid_columns;
+  guint grid_rows;
+  /* Per cell min-heaps of the best candidates, cell_size entries each */
+  GArray *cells;
+  GArray *cell_counts;
+  guint cell_size;
+  /* Total kept over all cells, cells get at least one entry each so they
+     may hold more */
+  guint selection_size;
+  GArray *selected;
+  guint cell_columns;
+  guint cell_rows;
+  gdouble detect_scale;
+  /* Size of the image Harris runs on, and the factor back to the frame */
+  guint detect_width;
+  guint detect_height;
+  gfloat to_frame_x;
+  gfloat to_frame_y;
+  /* Downscaled copies of the frame when detect-scale is below 1 */
+  GstBufferPool *scratch_pool;
+  guint initial_capacity;
+  /* Current output array capacity, grows when arrays saturate */
+  guint capacity;
+  guint max_capacity;
 };
 
+/* Output arrays released by stopped detectors, shared by all the
+   instances in the process */
+G_LOCK_DEFINE_STATIC (output_pool);
+static GQueue output_pool = G_QUEUE_INIT;
+
 /* prototypes */
 static gboolean gst_vpi_harris_detector_start (GstVpiFilter * filter,
     GstVideoInfo * in_info, GstVideoInfo * out_info);
@@ -71,6 +211,7 @@ static void gst_vpi_harris_detector_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_vpi_harris_detector_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vpi_harris_detector_finalize (GObject * object);
 
 enum
 {
@@ -80,6 +221,13 @@ enum
   PROP_MIN_NMS_DISTANCE,
   PROP_SENSITIVITY,
   PROP_STRENGTH_THRESH,
+  PROP_DETECT_INTERVAL,
+  PROP_PROPAGATION,
+  PROP_MAX_KEYPOINTS,
+  PROP_GRID_COLUMNS,
+  PROP_GRID_ROWS,
+  PROP_DETECT_SCALE,
+  PROP_CAPACITY,
 };
 
 GType
@@ -103,6 +251,106 @@ vpi_harris_params_size_enum_get_type (void)
   return vpi_harris_params_size_enum_type;
 }
 
+GType
+vpi_harris_propagation_enum_get_type (void)
+{
+  static GType vpi_harris_propagation_enum_type = 0;
+  static const GEnumValue values[] = {
+    {PROPAGATION_HOLD, "Reattach the keypoints of the last detection",
+        "hold"},
+    {PROPAGATION_FLOW, "Move the keypoints of the last detection with "
+          "sparse optical flow", "flow"},
+    {0, NULL, NULL}
+  };
+
+  if (!vpi_harris_propagation_enum_type) {
+    vpi_harris_propagation_enum_type =
+        g_enum_register_static ("VpiHarrisPropagation", values);
+  }
+  return vpi_harris_propagation_enum_type;
+}
+
+static void
+gst_vpi_harris_detector_output_free (GstVpiHarrisOutput * output)
+{
+  g_return_if_fail (output);
+
+  vpiArrayDestroy (output->keypoints);
+  vpiArrayDestroy (output->scores);
+  g_free (output);
+}
+
+/* Takes arrays from the shared pool, or creates them if none of the idle
+   ones has a suitable capacity */
+static VPIStatus
+gst_vpi_harris_detector_output_acquire (guint capacity, guint max_capacity,
+    GstVpiHarrisOutput ** output)
+{
+  GstVpiHarrisOutput *candidate = NULL;
+  GList *l = NULL;
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (output, VPI_ERROR_INVALID_ARGUMENT);
+
+  *output = NULL;
+
+  G_LOCK (output_pool);
+  for (l = output_pool.head; NULL != l; l = l->next) {
+    candidate = l->data;
+    if (candidate->capacity >= capacity && candidate->capacity <= max_capacity) {
+      *output = candidate;
+      g_queue_delete_link (&output_pool, l);
+      break;
+    }
+  }
+  G_UNLOCK (output_pool);
+
+  if (NULL != *output) {
+    goto out;
+  }
+
+  candidate = g_malloc0 (sizeof (GstVpiHarrisOutput));
+  candidate->capacity = capacity;
+
+  status = vpiArrayCreate (capacity, VPI_ARRAY_TYPE_KEYPOINT, VPI_BACKEND_ALL,
+      &candidate->keypoints);
+  if (VPI_SUCCESS != status) {
+    goto free_output;
+  }
+
+  status = vpiArrayCreate (capacity, VPI_ARRAY_TYPE_U32, VPI_BACKEND_ALL,
+      &candidate->scores);
+  if (VPI_SUCCESS != status) {
+    goto free_output;
+  }
+
+  *output = candidate;
+  goto out;
+
+free_output:
+  gst_vpi_harris_detector_output_free (candidate);
+
+out:
+  return status;
+}
+
+static void
+gst_vpi_harris_detector_output_release (GstVpiHarrisOutput * output)
+{
+  g_return_if_fail (output);
+
+  G_LOCK (output_pool);
+  if (g_queue_get_length (&output_pool) < MAX_POOLED_OUTPUTS) {
+    g_queue_push_tail (&output_pool, output);
+    output = NULL;
+  }
+  G_UNLOCK (output_pool);
+
+  if (NULL != output) {
+    gst_vpi_harris_detector_output_free (output);
+  }
+}
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (GstVpiHarrisDetector, gst_vpi_harris_detector,
@@ -134,9 +382,11 @@ gst_vpi_harris_detector_class_init (GstVpiHarrisDetectorClass * klass)
   vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_harris_detector_start);
   vpi_filter_class->transform_image_ip =
       GST_DEBUG_FUNCPTR (gst_vpi_harris_detector_transform_image_ip);
+  vpi_filter_class->supports_roi = TRUE;
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_harris_detector_stop);
   gobject_class->set_property = gst_vpi_harris_detector_set_property;
   gobject_class->get_property = gst_vpi_harris_detector_get_property;
+  gobject_class->finalize = gst_vpi_harris_detector_finalize;
 
   g_object_class_install_property (gobject_class, PROP_GRADIENT_SIZE,
       g_param_spec_enum ("gradient-size", "Gradient size",
@@ -172,13 +422,72 @@ gst_vpi_harris_detector_class_init (GstVpiHarrisDetectorClass * klass)
           DEFAULT_PROP_STRENGTH_THRESH_MIN, DEFAULT_PROP_STRENGTH_THRESH_MAX,
           DEFAULT_PROP_STRENGTH_THRESH,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_INTERVAL,
+      g_param_spec_uint ("detect-interval", "Detection interval",
+          "Run the detector once every this many frames. Keypoints are "
+          "still attached to every buffer, carried forward from the last "
+          "detection as set by the propagation property.",
+          DEFAULT_PROP_DETECT_INTERVAL_MIN, DEFAULT_PROP_DETECT_INTERVAL_MAX,
+          DEFAULT_PROP_DETECT_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_PROPAGATION,
+      g_param_spec_enum ("propagation", "Propagation",
+          "How keypoints are carried forward between detections. Flow runs "
+          "pyramidal Lucas-Kanade on the CUDA backend, or on the CPU if that "
+          "is the selected backend. Keypoints that optical flow loses are "
+          "dropped until the next detection.",
+          VPI_HARRIS_PROPAGATION_ENUM, DEFAULT_PROP_PROPAGATION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_KEYPOINTS,
+      g_param_spec_uint ("max-keypoints", "Maximum keypoints",
+          "Maximum number of keypoints per detection. The frame is split in "
+          "a grid and the strongest keypoints of each cell are kept, so they "
+          "are spread over the image. Set to 0 to keep all of them.",
+          DEFAULT_PROP_MAX_KEYPOINTS_MIN, DEFAULT_PROP_MAX_KEYPOINTS_MAX,
+          DEFAULT_PROP_MAX_KEYPOINTS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_GRID_COLUMNS,
+      g_param_spec_uint ("grid-columns", "Grid columns",
+          "Number of columns of the grid used by max-keypoints.",
+          DEFAULT_PROP_GRID_MIN, DEFAULT_PROP_GRID_MAX,
+          DEFAULT_PROP_GRID_COLUMNS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_GRID_ROWS,
+      g_param_spec_uint ("grid-rows", "Grid rows",
+          "Number of rows of the grid used by max-keypoints.",
+          DEFAULT_PROP_GRID_MIN, DEFAULT_PROP_GRID_MAX, DEFAULT_PROP_GRID_ROWS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_SCALE,
+      g_param_spec_double ("detect-scale", "Detection scale",
+          "Scale of the image corners are detected on, relative to the "
+          "input. Below 1 the frame is downscaled before detection and "
+          "keypoints are scaled back to the input resolution. The frame "
+          "itself passes through untouched.",
+          DEFAULT_PROP_DETECT_SCALE_MIN, DEFAULT_PROP_DETECT_SCALE_MAX,
+          DEFAULT_PROP_DETECT_SCALE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_CAPACITY,
+      g_param_spec_uint ("capacity", "Keypoints capacity",
+          "Initial capacity of the keypoint arrays. Capacity doubles every "
+          "time a detection fills the arrays, up to 65536, or 8192 on PVA.",
+          DEFAULT_PROP_CAPACITY_MIN, DEFAULT_PROP_CAPACITY_MAX,
+          DEFAULT_PROP_CAPACITY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
 }
 
 static void
 gst_vpi_harris_detector_init (GstVpiHarrisDetector * self)
 {
-  self->keypoints = NULL;
-  self->scores = NULL;
+  self->frame_output = NULL;
   self->harris = NULL;
   self->harris_params.gradientSize = DEFAULT_PROP_GRADIENT_SIZE;
   self->harris_params.blockSize = DEFAULT_PROP_BLOCK_SIZE;
@@ -186,6 +495,228 @@ gst_vpi_harris_detector_init (GstVpiHarrisDetector * self)
   self->harris_params.sensitivity = DEFAULT_PROP_SENSITIVITY;
   /* PVA backend only allows 8 */
   self->harris_params.minNMSDistance = DEFAULT_PROP_MIN_NMS_DISTANCE;
+  self->detect_interval = DEFAULT_PROP_DETECT_INTERVAL;
+  self->propagation = DEFAULT_PROP_PROPAGATION;
+  self->frame_count = 0;
+  self->last_keypoints = g_array_new (FALSE, FALSE, sizeof (VPIKeypoint));
+  self->flow = NULL;
+  self->flow_image = NULL;
+  self->flow_scaled = NULL;
+  self->flow_pyramids[0] = NULL;
+  self->flow_pyramids[1] = NULL;
+  self->flow_prev_points = NULL;
+  self->flow_next_points = NULL;
+  self->flow_status = NULL;
+  self->flow_width = 0;
+  self->flow_height = 0;
+  self->flow_index = 0;
+  self->flow_valid = FALSE;
+  self->width = 0;
+  self->height = 0;
+  self->format = VPI_IMAGE_FORMAT_U8;
+  self->video_format = GST_VIDEO_FORMAT_GRAY8;
+  self->regions = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  self->frame_regions = g_array_new (FALSE, TRUE, sizeof (GstVpiHarrisRegion));
+  self->region_outputs = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_vpi_harris_detector_output_release);
+  self->region_payloads = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) vpiPayloadDestroy);
+  g_queue_init (&self->region_payload_keys);
+  self->max_keypoints = DEFAULT_PROP_MAX_KEYPOINTS;
+  self->grid_columns = DEFAULT_PROP_GRID_COLUMNS;
+  self->grid_rows = DEFAULT_PROP_GRID_ROWS;
+  self->cells = g_array_new (FALSE, FALSE, sizeof (GstVpiHarrisCandidate));
+  self->cell_counts = g_array_new (FALSE, TRUE, sizeof (guint));
+  self->cell_size = 0;
+  self->selection_size = 0;
+  self->selected = g_array_new (FALSE, FALSE, sizeof (GstVpiHarrisCandidate));
+  self->cell_columns = DEFAULT_PROP_GRID_COLUMNS;
+  self->cell_rows = DEFAULT_PROP_GRID_ROWS;
+  self->detect_scale = DEFAULT_PROP_DETECT_SCALE;
+  self->detect_width = 0;
+  self->detect_height = 0;
+  self->to_frame_x = 1;
+  self->to_frame_y = 1;
+  self->scratch_pool = NULL;
+  self->initial_capacity = DEFAULT_PROP_CAPACITY;
+  self->capacity = DEFAULT_PROP_CAPACITY;
+  self->max_capacity = MAX_ARRAY_CAPACITY;
+}
+
+static gboolean
+gst_vpi_harris_detector_create_scratch_pool (GstVpiHarrisDetector * self)
+{
+  GstVideoInfo info = { 0 };
+  GstStructure *config = NULL;
+  GstCaps *caps = NULL;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+
+  gst_video_info_set_format (&info, self->video_format,
+      self->detect_width, self->detect_height);
+  caps = gst_video_info_to_caps (&info);
+
+  self->scratch_pool = g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
+  config = gst_buffer_pool_get_config (self->scratch_pool);
+  gst_buffer_pool_config_set_params (config, caps, info.size, 1, 0);
+
+  if (!gst_buffer_pool_set_config (self->scratch_pool, config)) {
+    GST_ERROR_OBJECT (self, "Unable to set detection pool configuration");
+    goto out;
+  }
+
+  ret = gst_buffer_pool_set_active (self->scratch_pool, TRUE);
+
+out:
+  gst_caps_unref (caps);
+  return ret;
+}
+
+static void
+gst_vpi_harris_detector_free_scratch_pool (GstVpiHarrisDetector * self)
+{
+  g_return_if_fail (self);
+
+  if (NULL == self->scratch_pool) {
+    return;
+  }
+
+  gst_buffer_pool_set_active (self->scratch_pool, FALSE);
+  gst_object_unref (self->scratch_pool);
+  self->scratch_pool = NULL;
+}
+
+static void
+gst_vpi_harris_detector_free_flow_resources (GstVpiHarrisDetector * self)
+{
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  vpiPayloadDestroy (self->flow);
+  self->flow = NULL;
+
+  vpiImageDestroy (self->flow_image);
+  self->flow_image = NULL;
+
+  vpiImageDestroy (self->flow_scaled);
+  self->flow_scaled = NULL;
+
+  for (i = 0; i < NUM_FLOW_IMAGES; i++) {
+    vpiPyramidDestroy (self->flow_pyramids[i]);
+    self->flow_pyramids[i] = NULL;
+  }
+
+  vpiArrayDestroy (self->flow_prev_points);
+  self->flow_prev_points = NULL;
+
+  vpiArrayDestroy (self->flow_next_points);
+  self->flow_next_points = NULL;
+
+  vpiArrayDestroy (self->flow_status);
+  self->flow_status = NULL;
+
+  self->flow_valid = FALSE;
+}
+
+/* Pyramidal Lucas-Kanade is only available on the CPU and CUDA backends */
+static gint
+gst_vpi_harris_detector_get_flow_backend (GstVpiHarrisDetector * self)
+{
+  g_return_val_if_fail (self, VPI_BACKEND_CUDA);
+
+  return VPI_BACKEND_CPU == gst_vpi_filter_get_backend (GST_VPI_FILTER (self))
+      ? VPI_BACKEND_CPU : VPI_BACKEND_CUDA;
+}
+
+/* No error is posted here, callers report the failure */
+static VPIStatus
+gst_vpi_harris_detector_create_flow_resources (GstVpiHarrisDetector * self)
+{
+  VPIStatus status = VPI_SUCCESS;
+  gint backend = VPI_BACKEND_CUDA;
+  guint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+
+  backend = gst_vpi_harris_detector_get_flow_backend (self);
+  self->flow_width = MAX (self->width / FLOW_DOWNSCALE, 1);
+  self->flow_height = MAX (self->height / FLOW_DOWNSCALE, 1);
+
+  status = vpiCreateOpticalFlowPyrLK (backend, self->flow_width,
+      self->flow_height, VPI_IMAGE_FORMAT_U8, FLOW_PYRAMID_LEVELS,
+      FLOW_PYRAMID_SCALE, &self->flow);
+  if (VPI_SUCCESS != status) {
+    goto free;
+  }
+
+  status = vpiImageCreate (self->flow_width, self->flow_height,
+      VPI_IMAGE_FORMAT_U8, VPI_BACKEND_ALL, &self->flow_image);
+  if (VPI_SUCCESS != status) {
+    goto free;
+  }
+
+  /* Wider inputs are downscaled first and then reduced to 8 bits */
+  if (VPI_IMAGE_FORMAT_U8 != self->format) {
+    status = vpiImageCreate (self->flow_width, self->flow_height,
+        self->format, VPI_BACKEND_ALL, &self->flow_scaled);
+    if (VPI_SUCCESS != status) {
+      goto free;
+    }
+  }
+
+  for (i = 0; i < NUM_FLOW_IMAGES; i++) {
+    status = vpiPyramidCreate (self->flow_width, self->flow_height,
+        VPI_IMAGE_FORMAT_U8, FLOW_PYRAMID_LEVELS, FLOW_PYRAMID_SCALE,
+        VPI_BACKEND_ALL, &self->flow_pyramids[i]);
+    if (VPI_SUCCESS != status) {
+      goto free;
+    }
+  }
+
+  status = vpiArrayCreate (MAX_ARRAY_CAPACITY, VPI_ARRAY_TYPE_KEYPOINT,
+      VPI_BACKEND_ALL, &self->flow_prev_points);
+  if (VPI_SUCCESS != status) {
+    goto free;
+  }
+
+  status = vpiArrayCreate (MAX_ARRAY_CAPACITY, VPI_ARRAY_TYPE_KEYPOINT,
+      VPI_BACKEND_ALL, &self->flow_next_points);
+  if (VPI_SUCCESS != status) {
+    goto free;
+  }
+
+  status = vpiArrayCreate (MAX_ARRAY_CAPACITY, VPI_ARRAY_TYPE_U8,
+      VPI_BACKEND_ALL, &self->flow_status);
+  if (VPI_SUCCESS != status) {
+    goto free;
+  }
+
+  goto out;
+
+free:
+  gst_vpi_harris_detector_free_flow_resources (self);
+
+out:
+  return status;
+}
+
+/* Releases everything that depends on the frame size */
+static void
+gst_vpi_harris_detector_free_size_resources (GstVpiHarrisDetector * self)
+{
+  g_return_if_fail (self);
+
+  vpiPayloadDestroy (self->harris);
+  self->harris = NULL;
+
+  gst_vpi_harris_detector_free_scratch_pool (self);
+
+  gst_vpi_harris_detector_free_flow_resources (self);
+
+  g_hash_table_remove_all (self->region_payloads);
+  g_queue_clear (&self->region_payload_keys);
 }
 
 static gboolean
@@ -198,6 +729,8 @@ gst_vpi_harris_detector_start (GstVpiFilter * filter, GstVideoInfo * in_info,
   guint width = 0;
   guint height = 0;
   gint backend = VPI_BACKEND_INVALID;
+  gdouble detect_scale = DEFAULT_PROP_DETECT_SCALE;
+  guint initial_capacity = DEFAULT_PROP_CAPACITY;
 
   g_return_val_if_fail (filter, FALSE);
   g_return_val_if_fail (in_info, FALSE);
@@ -207,75 +740,630 @@ gst_vpi_harris_detector_start (GstVpiFilter * filter, GstVideoInfo * in_info,
 
   GST_DEBUG_OBJECT (self, "start");
 
-  status = vpiArrayCreate (VPI_ARRAY_CAPACITY, VPI_ARRAY_TYPE_KEYPOINT,
-      VPI_BACKEND_ALL, &self->keypoints);
+  /* On renegotiation only the size dependent resources are recreated, the
+     output arrays are kept */
+  gst_vpi_harris_detector_free_size_resources (self);
 
-  if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create keypoints array."), ("%s",
-            vpiStatusGetName (status)));
-    ret = FALSE;
-    goto out;
-  }
+  width = GST_VIDEO_INFO_WIDTH (in_info);
+  height = GST_VIDEO_INFO_HEIGHT (in_info);
+  backend = gst_vpi_filter_get_backend (filter);
+  self->video_format = GST_VIDEO_INFO_FORMAT (in_info);
+  self->format = gst_vpi_video_to_image_format (self->video_format);
 
-  status = vpiArrayCreate (VPI_ARRAY_CAPACITY, VPI_ARRAY_TYPE_U32,
-      VPI_BACKEND_ALL, &self->scores);
+  GST_OBJECT_LOCK (self);
+  detect_scale = self->detect_scale;
+  initial_capacity = self->initial_capacity;
+  GST_OBJECT_UNLOCK (self);
 
-  if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create scores array."), ("%s", vpiStatusGetName (status)));
-    ret = FALSE;
-    goto free_keypoints_array;
+  self->max_capacity = VPI_BACKEND_PVA == backend ? PVA_ARRAY_CAPACITY :
+      MAX_ARRAY_CAPACITY;
+
+  if (NULL == self->frame_output) {
+    self->capacity = MIN (initial_capacity, self->max_capacity);
+    status = gst_vpi_harris_detector_output_acquire (self->capacity,
+        self->max_capacity, &self->frame_output);
+
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not create keypoints and scores arrays."), ("%s",
+              vpiStatusGetName (status)));
+      ret = FALSE;
+      goto out;
+    }
   }
 
-  width = GST_VIDEO_INFO_WIDTH (in_info);
-  height = GST_VIDEO_INFO_HEIGHT (in_info);
-  backend = gst_vpi_filter_get_backend (filter);
+  self->detect_width = MAX ((guint) (width * detect_scale + 0.5), 1);
+  self->detect_height = MAX ((guint) (height * detect_scale + 0.5), 1);
+  self->to_frame_x = (gfloat) width / self->detect_width;
+  self->to_frame_y = (gfloat) height / self->detect_height;
+
+  if (self->detect_width != width || self->detect_height != height) {
+    GST_INFO_OBJECT (self, "Detecting corners on %ux%u images",
+        self->detect_width, self->detect_height);
+    if (!gst_vpi_harris_detector_create_scratch_pool (self)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+          ("Unable to create the detection buffer pool."), (NULL));
+      ret = FALSE;
+      goto free_size_resources;
+    }
+  }
 
-  status = vpiCreateHarrisCornerDetector (backend, width, height,
-      &self->harris);
+  status = vpiCreateHarrisCornerDetector (backend, self->detect_width,
+      self->detect_height, &self->harris);
 
   if (VPI_SUCCESS != status) {
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
         ("Could not create Harris corner detector"),
         ("%s", vpiStatusGetName (status)));
     ret = FALSE;
-    goto free_scores_array;
+    goto free_size_resources;
   }
 
-  goto out;
+  self->frame_count = 0;
+  self->flow_index = 0;
+  self->flow_valid = FALSE;
+  self->width = width;
+  self->height = height;
+  g_array_set_size (self->last_keypoints, 0);
 
-free_scores_array:
-  vpiArrayDestroy (self->scores);
-  self->scores = NULL;
+  goto out;
 
-free_keypoints_array:
-  vpiArrayDestroy (self->keypoints);
-  self->keypoints = NULL;
+free_size_resources:
+  gst_vpi_harris_detector_free_size_resources (self);
 
 out:
   return ret;
 }
 
+/* Offers a candidate to the min-heap of its cell. The root is the weakest
+   kept keypoint, so a full cell costs one comparison per weaker candidate */
+static void
+gst_vpi_harris_detector_offer_candidate (GstVpiHarrisDetector * self,
+    guint cell, guint32 score, VPIKeypoint * keypoint)
+{
+  GstVpiHarrisCandidate *heap = NULL;
+  GstVpiHarrisCandidate candidate = { 0 };
+  guint *count = NULL;
+  guint parent = 0;
+  guint child = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (keypoint);
+
+  heap = &g_array_index (self->cells, GstVpiHarrisCandidate,
+      cell * self->cell_size);
+  count = &g_array_index (self->cell_counts, guint, cell);
+  candidate.score = score;
+  candidate.keypoint = *keypoint;
+
+  if (*count < self->cell_size) {
+    /* Sift up */
+    for (i = (*count)++; i > 0; i = parent) {
+      parent = (i - 1) / 2;
+      if (heap[parent].score <= score) {
+        break;
+      }
+      heap[i] = heap[parent];
+    }
+    heap[i] = candidate;
+    return;
+  }
+
+  if (score <= heap[0].score) {
+    return;
+  }
+
+  /* Replace the root and sift down */
+  for (i = 0; (child = 2 * i + 1) < *count; i = child) {
+    if (child + 1 < *count && heap[child + 1].score < heap[child].score) {
+      child++;
+    }
+    if (score <= heap[child].score) {
+      break;
+    }
+    heap[i] = heap[child];
+  }
+  heap[i] = candidate;
+}
+
+static void
+gst_vpi_harris_detector_begin_selection (GstVpiHarrisDetector * self,
+    guint max_keypoints, guint grid_columns, guint grid_rows)
+{
+  guint num_cells = 0;
+
+  g_return_if_fail (self);
+
+  self->cell_columns = grid_columns;
+  self->cell_rows = grid_rows;
+  num_cells = grid_columns * grid_rows;
+  self->cell_size = 0 == max_keypoints ? 0 : MAX (max_keypoints / num_cells,
+      1);
+  self->selection_size = max_keypoints;
+
+  g_array_set_size (self->cells, num_cells * self->cell_size);
+  g_array_set_size (self->cell_counts, 0);
+  g_array_set_size (self->cell_counts, num_cells);
+}
+
+static gint
+gst_vpi_harris_detector_compare_candidates (gconstpointer a, gconstpointer b)
+{
+  guint32 score_a = ((const GstVpiHarrisCandidate *) a)->score;
+  guint32 score_b = ((const GstVpiHarrisCandidate *) b)->score;
+
+  /* Strongest first */
+  return (score_a < score_b) - (score_a > score_b);
+}
+
+static void
+gst_vpi_harris_detector_end_selection (GstVpiHarrisDetector * self)
+{
+  GstVpiHarrisCandidate *candidate = NULL;
+  guint cell = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  if (0 == self->cell_size) {
+    return;
+  }
+
+  g_array_set_size (self->selected, 0);
+  for (cell = 0; cell < self->cell_counts->len; cell++) {
+    g_array_append_vals (self->selected, &g_array_index (self->cells,
+            GstVpiHarrisCandidate, cell * self->cell_size),
+        g_array_index (self->cell_counts, guint, cell));
+  }
+
+  /* With more cells than max-keypoints every cell keeps one candidate, only
+     the strongest of them are reported */
+  if (self->selected->len > self->selection_size) {
+    g_array_sort (self->selected, gst_vpi_harris_detector_compare_candidates);
+    g_array_set_size (self->selected, self->selection_size);
+  }
+
+  for (i = 0; i < self->selected->len; i++) {
+    candidate = &g_array_index (self->selected, GstVpiHarrisCandidate, i);
+    g_array_append_val (self->last_keypoints, candidate->keypoint);
+  }
+}
+
+/* Appends the keypoints of an output array, moving them by the position
+   of the region they were detected in and scaling them back to the frame
+   resolution. When max-keypoints is set they are
+   binned instead, and appended by gst_vpi_harris_detector_end_selection */
+static void
+gst_vpi_harris_detector_store_keypoints (GstVpiHarrisDetector * self,
+    GstVpiHarrisOutput * output, guint x, guint y)
+{
+  VPIArrayData keypoints_data = { 0 };
+  VPIArrayData scores_data = { 0 };
+  VPIKeypoint *keypoints = NULL;
+  guint32 *scores = NULL;
+  VPIKeypoint *keypoint = NULL;
+  VPIKeypoint moved = { 0 };
+  guint column = 0;
+  guint row = 0;
+  guint first = 0;
+  guint k = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (output);
+
+  if (0 != self->cell_size) {
+    vpiArrayLock (output->keypoints, VPI_LOCK_READ, &keypoints_data);
+    vpiArrayLock (output->scores, VPI_LOCK_READ, &scores_data);
+    keypoints = (VPIKeypoint *) keypoints_data.data;
+    scores = (guint32 *) scores_data.data;
+
+    for (k = 0; k < keypoints_data.size; k++) {
+      moved.x = (keypoints[k].x + x) * self->to_frame_x;
+      moved.y = (keypoints[k].y + y) * self->to_frame_y;
+      column = MIN ((guint) (moved.x * self->cell_columns / self->width),
+          self->cell_columns - 1);
+      row = MIN ((guint) (moved.y * self->cell_rows / self->height),
+          self->cell_rows - 1);
+      gst_vpi_harris_detector_offer_candidate (self,
+          row * self->cell_columns + column, scores[k], &moved);
+    }
+
+    vpiArrayUnlock (output->scores);
+    vpiArrayUnlock (output->keypoints);
+    return;
+  }
+
+  first = self->last_keypoints->len;
+
+  vpiArrayLock (output->keypoints, VPI_LOCK_READ, &keypoints_data);
+  g_array_append_vals (self->last_keypoints, keypoints_data.data,
+      keypoints_data.size);
+  vpiArrayUnlock (output->keypoints);
+
+  if (0 == x && 0 == y && NULL == self->scratch_pool) {
+    return;
+  }
+
+  for (k = first; k < self->last_keypoints->len; k++) {
+    keypoint = &g_array_index (self->last_keypoints, VPIKeypoint, k);
+    keypoint->x = (keypoint->x + x) * self->to_frame_x;
+    keypoint->y = (keypoint->y + y) * self->to_frame_y;
+  }
+}
+
+static gboolean
+gst_vpi_harris_detector_add_region (GstVpiHarrisDetector * self, gint x,
+    gint y, gint width, gint height)
+{
+  GstVpiHarrisRegion region = { 0 };
+  gint left = 0;
+  gint top = 0;
+  gint right = 0;
+  gint bottom = 0;
+
+  g_return_val_if_fail (self, FALSE);
+
+  /* Regions come in frame coordinates, views are taken on the detection
+     image */
+  left = CLAMP ((gint) (x / self->to_frame_x), 0, (gint) self->detect_width);
+  top = CLAMP ((gint) (y / self->to_frame_y), 0, (gint) self->detect_height);
+  right = CLAMP ((gint) ((x + width) / self->to_frame_x + 0.5f), 0,
+      (gint) self->detect_width);
+  bottom = CLAMP ((gint) ((y + height) / self->to_frame_y + 0.5f), 0,
+      (gint) self->detect_height);
+
+  if (right - left < MIN_REGION_SIZE || bottom - top < MIN_REGION_SIZE) {
+    return FALSE;
+  }
+
+  region.x = left;
+  region.y = top;
+  region.width = right - left;
+  region.height = bottom - top;
+  g_array_append_val (self->frame_regions, region);
+
+  return TRUE;
+}
+
+/* Gathers the regions to process on this frame. Returns FALSE if detection
+   is not restricted to regions */
+static gboolean
+gst_vpi_harris_detector_collect_regions (GstVpiHarrisDetector * self,
+    GstBuffer * buffer)
+{
+  GstVideoRectangle *region = NULL;
+  gboolean restricted = FALSE;
+  guint i = 0;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (buffer, FALSE);
+
+  g_array_set_size (self->frame_regions, 0);
+
+  restricted = gst_vpi_filter_get_regions (GST_VPI_FILTER (self), buffer,
+      self->regions);
+
+  for (i = 0; i < self->regions->len; i++) {
+    region = &g_array_index (self->regions, GstVideoRectangle, i);
+    gst_vpi_harris_detector_add_region (self, region->x, region->y,
+        region->w, region->h);
+  }
+
+  return restricted;
+}
+
+static VPIStatus
+gst_vpi_harris_detector_get_region_resources (GstVpiHarrisDetector * self,
+    guint index, GstVpiHarrisRegion * region, VPIPayload * payload,
+    GstVpiHarrisOutput ** output)
+{
+  GstVpiHarrisOutput *new_output = NULL;
+  VPIPayload new_payload = NULL;
+  gpointer key = NULL;
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (region, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (payload, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (output, VPI_ERROR_INVALID_ARGUMENT);
+
+  key = GUINT_TO_POINTER (region->width << 16 | region->height);
+  *payload = g_hash_table_lookup (self->region_payloads, key);
+  if (NULL != *payload) {
+    g_queue_remove (&self->region_payload_keys, key);
+    g_queue_push_head (&self->region_payload_keys, key);
+  } else {
+    status = vpiCreateHarrisCornerDetector (gst_vpi_filter_get_backend
+        (GST_VPI_FILTER (self)), region->width, region->height, &new_payload);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+    GST_DEBUG_OBJECT (self, "Created Harris payload for %ux%u regions",
+        region->width, region->height);
+    g_hash_table_insert (self->region_payloads, key, new_payload);
+    g_queue_push_head (&self->region_payload_keys, key);
+    *payload = new_payload;
+  }
+
+  if (index >= self->region_outputs->len) {
+    status = gst_vpi_harris_detector_output_acquire (self->capacity,
+        self->max_capacity, &new_output);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+    g_ptr_array_add (self->region_outputs, new_output);
+  }
+  *output = g_ptr_array_index (self->region_outputs, index);
+
+out:
+  return status;
+}
+
+/* Destroys the least recently used region payloads. Must run before the
+   regions of a frame are submitted, while no payload is in use */
+static void
+gst_vpi_harris_detector_trim_region_payloads (GstVpiHarrisDetector * self)
+{
+  gpointer key = NULL;
+
+  g_return_if_fail (self);
+
+  while (g_queue_get_length (&self->region_payload_keys) >
+      MAX_REGION_PAYLOADS) {
+    key = g_queue_pop_tail (&self->region_payload_keys);
+    g_hash_table_remove (self->region_payloads, key);
+  }
+}
+
+/* Submits Harris on a view of each region, the caller syncs the stream */
+static VPIStatus
+gst_vpi_harris_detector_submit_regions (GstVpiHarrisDetector * self,
+    VPIStream stream, VPIImage image, VPIHarrisCornerDetectorParams * params)
+{
+  GstVpiHarrisRegion *region = NULL;
+  GstVpiHarrisOutput *output = NULL;
+  VPIPayload payload = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  guint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (params, VPI_ERROR_INVALID_ARGUMENT);
+
+  gst_vpi_harris_detector_trim_region_payloads (self);
+
+  for (i = 0; i < self->frame_regions->len; i++) {
+    region = &g_array_index (self->frame_regions, GstVpiHarrisRegion, i);
+
+    status = gst_vpi_harris_detector_get_region_resources (self, i, region,
+        &payload, &output);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+
+    status = gst_vpi_image_create_view (image, region->x, region->y,
+        region->width, region->height, &region->view);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+
+    status = vpiSubmitHarrisCornerDetector (stream, payload, region->view,
+        output->keypoints, output->scores, params);
+    if (VPI_SUCCESS != status) {
+      /* Nothing was queued on the view, so it is not collected */
+      vpiImageDestroy (region->view);
+      region->view = NULL;
+      goto out;
+    }
+  }
+
+out:
+  return status;
+}
+
+/* Replaces saturated output arrays with larger ones for the next
+   detection. Keypoints that did not fit are lost on this frame */
+static void
+gst_vpi_harris_detector_grow_output (GstVpiHarrisDetector * self,
+    GstVpiHarrisOutput ** output)
+{
+  GstVpiHarrisOutput *larger = NULL;
+  gint32 size = 0;
+  guint capacity = 0;
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_if_fail (self);
+  g_return_if_fail (output);
+  g_return_if_fail (*output);
+
+  vpiArrayGetSize ((*output)->keypoints, &size);
+  if ((guint) size < (*output)->capacity
+      || (*output)->capacity >= self->max_capacity) {
+    return;
+  }
+
+  capacity = MIN ((*output)->capacity * 2, self->max_capacity);
+  status = gst_vpi_harris_detector_output_acquire (capacity,
+      self->max_capacity, &larger);
+  if (VPI_SUCCESS != status) {
+    GST_WARNING_OBJECT (self, "Could not grow keypoints arrays: %s",
+        vpiStatusGetName (status));
+    return;
+  }
+
+  GST_INFO_OBJECT (self, "Keypoints arrays saturated, growing them from %u "
+      "to %u", (*output)->capacity, larger->capacity);
+
+  gst_vpi_harris_detector_output_release (*output);
+  *output = larger;
+  self->capacity = MAX (self->capacity, larger->capacity);
+}
+
+/* Merges the keypoints of all regions and releases their views */
+static void
+gst_vpi_harris_detector_collect_region_keypoints (GstVpiHarrisDetector * self)
+{
+  GstVpiHarrisRegion *region = NULL;
+  GstVpiHarrisOutput *output = NULL;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  for (i = 0; i < self->frame_regions->len; i++) {
+    region = &g_array_index (self->frame_regions, GstVpiHarrisRegion, i);
+
+    /* Only regions that made it to the stream have a view */
+    if (NULL == region->view) {
+      break;
+    }
+
+    output = g_ptr_array_index (self->region_outputs, i);
+    gst_vpi_harris_detector_store_keypoints (self, output, region->x,
+        region->y);
+    gst_vpi_harris_detector_grow_output (self,
+        (GstVpiHarrisOutput **) & g_ptr_array_index (self->region_outputs,
+            i));
+
+    vpiImageDestroy (region->view);
+    region->view = NULL;
+  }
+}
+
+/* Downscales the frame and builds its pyramid. If propagate is set, the
+   last keypoints are also moved from the previous pyramid to this one. Only
+   submits, the caller syncs the stream */
+static VPIStatus
+gst_vpi_harris_detector_submit_flow (GstVpiHarrisDetector * self,
+    VPIStream stream, VPIImage image, guint next, gboolean propagate)
+{
+  VPIOpticalFlowPyrLKParams params = { 0 };
+  VPIArrayData points_data = { 0 };
+  VPIKeypoint *points = NULL;
+  VPIKeypoint *keypoint = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  gint backend = VPI_BACKEND_CUDA;
+  guint num_points = 0;
+  guint k = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+
+  backend = gst_vpi_harris_detector_get_flow_backend (self);
+
+  if (NULL == self->flow_scaled) {
+    status = vpiSubmitRescale (stream, backend, image, self->flow_image,
+        VPI_INTERP_LINEAR, VPI_BOUNDARY_COND_CLAMP);
+  } else {
+    status = vpiSubmitRescale (stream, backend, image, self->flow_scaled,
+        VPI_INTERP_LINEAR, VPI_BOUNDARY_COND_CLAMP);
+    if (VPI_SUCCESS == status) {
+      status = vpiSubmitConvertImageFormat (stream, backend,
+          self->flow_scaled, self->flow_image, VPI_CONVERSION_CLAMP,
+          FLOW_U16_TO_U8_SCALE, 0);
+    }
+  }
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiSubmitGaussianPyramidGenerator (stream, backend,
+      self->flow_image, self->flow_pyramids[next]);
+  if (VPI_SUCCESS != status || !propagate) {
+    goto out;
+  }
+
+  /* Keypoints that do not fit in the arrays are not carried forward */
+  num_points = MIN (self->last_keypoints->len, MAX_ARRAY_CAPACITY);
+  g_array_set_size (self->last_keypoints, num_points);
+
+  vpiArrayLock (self->flow_prev_points, VPI_LOCK_WRITE, &points_data);
+  points = (VPIKeypoint *) points_data.data;
+  for (k = 0; k < num_points; k++) {
+    keypoint = &g_array_index (self->last_keypoints, VPIKeypoint, k);
+    points[k].x = keypoint->x * self->flow_width / self->width;
+    points[k].y = keypoint->y * self->flow_height / self->height;
+  }
+  vpiArraySetSize (self->flow_prev_points, num_points);
+  vpiArrayUnlock (self->flow_prev_points);
+
+  params.useInitialFlow = 0;
+  params.termination = VPI_TERMINATION_CRITERIA_ITERATIONS |
+      VPI_TERMINATION_CRITERIA_EPSILON;
+  params.epsilonType = VPI_LK_ERROR_L1;
+  params.epsilon = FLOW_EPSILON;
+  params.windowDimension = FLOW_WINDOW_SIZE;
+  params.numIterations = FLOW_ITERATIONS;
+
+  status = vpiSubmitOpticalFlowPyrLK (stream, backend, self->flow,
+      self->flow_pyramids[self->flow_index], self->flow_pyramids[next],
+      self->flow_prev_points, self->flow_next_points, self->flow_status,
+      &params);
+
+out:
+  return status;
+}
+
+/* Reads the keypoints moved by gst_vpi_harris_detector_submit_flow once the
+   stream is synced, dropping the ones that could not be followed */
+static void
+gst_vpi_harris_detector_collect_flow (GstVpiHarrisDetector * self)
+{
+  VPIArrayData points_data = { 0 };
+  VPIArrayData status_data = { 0 };
+  VPIKeypoint *points = NULL;
+  guint8 *tracked = NULL;
+  guint kept = 0;
+  guint lost = 0;
+  guint k = 0;
+
+  g_return_if_fail (self);
+
+  vpiArrayLock (self->flow_next_points, VPI_LOCK_READ, &points_data);
+  vpiArrayLock (self->flow_status, VPI_LOCK_READ, &status_data);
+  points = (VPIKeypoint *) points_data.data;
+  tracked = (guint8 *) status_data.data;
+
+  for (k = 0; k < self->last_keypoints->len; k++) {
+    if (FLOW_TRACKED != tracked[k] || points[k].x < 0 || points[k].y < 0
+        || points[k].x >= self->flow_width
+        || points[k].y >= self->flow_height) {
+      lost++;
+      continue;
+    }
+    g_array_index (self->last_keypoints, VPIKeypoint, kept).x =
+        points[k].x * self->width / self->flow_width;
+    g_array_index (self->last_keypoints, VPIKeypoint, kept).y =
+        points[k].y * self->height / self->flow_height;
+    kept++;
+  }
+  g_array_set_size (self->last_keypoints, kept);
+
+  vpiArrayUnlock (self->flow_status);
+  vpiArrayUnlock (self->flow_next_points);
+
+  if (lost) {
+    GST_LOG_OBJECT (self, "Optical flow lost %u keypoints", lost);
+  }
+}
+
 static void
 gst_vpi_harris_detector_add_keypoints_meta (GstVpiHarrisDetector * self,
     GstBuffer * buffer)
 {
-  VPIArrayData out_keypoints_data = { 0 };
-  VPIKeypoint *out_keypoints = NULL;
+  VPIKeypoint *keypoint = NULL;
   guint k = 0;
   guint x, y = 0;
 
   g_return_if_fail (self);
   g_return_if_fail (buffer);
 
-  vpiArrayLock (self->keypoints, VPI_LOCK_READ, &out_keypoints_data);
-  out_keypoints = (VPIKeypoint *) out_keypoints_data.data;
-  vpiArrayUnlock (self->keypoints);
-
-  for (k = 0; k < out_keypoints_data.size; k++) {
-    x = (guint) out_keypoints[k].x;
-    y = (guint) out_keypoints[k].y;
+  for (k = 0; k < self->last_keypoints->len; k++) {
+    keypoint = &g_array_index (self->last_keypoints, VPIKeypoint, k);
+    x = (guint) keypoint->x;
+    y = (guint) keypoint->y;
 
     gst_buffer_add_video_region_of_interest_meta (buffer,
         KEYPOINT_META_TYPE, x, y, KEYPOINTS_SIZE, KEYPOINTS_SIZE);
@@ -289,6 +1377,19 @@ gst_vpi_harris_detector_transform_image_ip (GstVpiFilter * filter,
   GstVpiHarrisDetector *self = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   VPIHarrisCornerDetectorParams params = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  guint detect_interval = DEFAULT_PROP_DETECT_INTERVAL;
+  GstVpiHarrisPropagation propagation = DEFAULT_PROP_PROPAGATION;
+  GstBuffer *scratch = NULL;
+  VPIImage detect_image = NULL;
+  guint max_keypoints = DEFAULT_PROP_MAX_KEYPOINTS;
+  guint grid_columns = DEFAULT_PROP_GRID_COLUMNS;
+  guint grid_rows = DEFAULT_PROP_GRID_ROWS;
+  gboolean detect = FALSE;
+  gboolean restricted = FALSE;
+  gboolean flow = FALSE;
+  gboolean propagate = FALSE;
+  guint next = 0;
 
   g_return_val_if_fail (filter, GST_FLOW_ERROR);
   g_return_val_if_fail (stream, GST_FLOW_ERROR);
@@ -301,14 +1402,125 @@ gst_vpi_harris_detector_transform_image_ip (GstVpiFilter * filter,
 
   GST_OBJECT_LOCK (self);
   params = self->harris_params;
+  detect_interval = self->detect_interval;
+  propagation = self->propagation;
+  max_keypoints = self->max_keypoints;
+  grid_columns = self->grid_columns;
+  grid_rows = self->grid_rows;
   GST_OBJECT_UNLOCK (self);
 
-  vpiSubmitHarrisCornerDetector (stream, self->harris, frame->image,
-      self->keypoints, self->scores, &params);
-  vpiStreamSync (stream);
+  detect = 0 == self->frame_count % detect_interval;
+  flow = PROPAGATION_FLOW == propagation && detect_interval > 1;
+  next = (self->flow_index + 1) % NUM_FLOW_IMAGES;
+  propagate = flow && !detect && self->flow_valid;
+
+  if (flow && NULL == self->flow) {
+    status = gst_vpi_harris_detector_create_flow_resources (self);
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not create optical flow resources."),
+          ("%s", vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+  }
+
+  /* Keep the pyramid history even on detection frames, the next frame
+     propagates from this one */
+  if (flow) {
+    status = gst_vpi_harris_detector_submit_flow (self, stream, frame->image,
+        next, propagate);
+
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not submit optical flow."),
+          ("%s", vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+  }
+
+  detect_image = frame->image;
+  if (detect && NULL != self->scratch_pool) {
+    if (GST_FLOW_OK != gst_buffer_pool_acquire_buffer (self->scratch_pool,
+            &scratch, NULL)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+          ("Unable to get a buffer for detection."), (NULL));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+    detect_image = ((GstVpiMeta *) gst_buffer_get_meta (scratch,
+            GST_VPI_META_API_TYPE))->vpi_frame.image;
+
+    status = vpiSubmitRescale (stream, gst_vpi_filter_get_backend (filter),
+        frame->image, detect_image, VPI_INTERP_LINEAR,
+        VPI_BOUNDARY_COND_CLAMP);
+
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not downscale image for detection."),
+          ("%s", vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto release_scratch;
+    }
+  }
+
+  if (detect) {
+    restricted = gst_vpi_harris_detector_collect_regions (self,
+        frame->buffer);
+  }
+
+  if (detect && !restricted) {
+    vpiSubmitHarrisCornerDetector (stream, self->harris, detect_image,
+        self->frame_output->keypoints, self->frame_output->scores, &params);
+  } else if (detect) {
+    status = gst_vpi_harris_detector_submit_regions (self, stream,
+        detect_image, &params);
+  }
+
+  if (flow || detect) {
+    vpiStreamSync (stream);
+  }
+
+  if (detect) {
+    g_array_set_size (self->last_keypoints, 0);
+    gst_vpi_harris_detector_begin_selection (self, max_keypoints,
+        grid_columns, grid_rows);
+  }
+
+  if (detect && !restricted) {
+    gst_vpi_harris_detector_store_keypoints (self, self->frame_output, 0, 0);
+    gst_vpi_harris_detector_grow_output (self, &self->frame_output);
+  } else if (detect) {
+    gst_vpi_harris_detector_collect_region_keypoints (self);
+  } else if (propagate) {
+    gst_vpi_harris_detector_collect_flow (self);
+  }
+
+  if (detect) {
+    gst_vpi_harris_detector_end_selection (self);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not detect corners on regions."),
+        ("%s", vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+    goto release_scratch;
+  }
+
+  self->flow_index = next;
+  self->flow_valid = flow;
+  self->frame_count++;
 
   gst_vpi_harris_detector_add_keypoints_meta (self, frame->buffer);
 
+release_scratch:
+  if (NULL != scratch) {
+    gst_buffer_unref (scratch);
+  }
+
+out:
   return ret;
 }
 
@@ -339,6 +1551,27 @@ gst_vpi_harris_detector_set_property (GObject * object, guint property_id,
     case PROP_STRENGTH_THRESH:
       self->harris_params.strengthThresh = g_value_get_double (value);
       break;
+    case PROP_DETECT_INTERVAL:
+      self->detect_interval = g_value_get_uint (value);
+      break;
+    case PROP_PROPAGATION:
+      self->propagation = g_value_get_enum (value);
+      break;
+    case PROP_MAX_KEYPOINTS:
+      self->max_keypoints = g_value_get_uint (value);
+      break;
+    case PROP_GRID_COLUMNS:
+      self->grid_columns = g_value_get_uint (value);
+      break;
+    case PROP_GRID_ROWS:
+      self->grid_rows = g_value_get_uint (value);
+      break;
+    case PROP_DETECT_SCALE:
+      self->detect_scale = g_value_get_double (value);
+      break;
+    case PROP_CAPACITY:
+      self->initial_capacity = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -373,6 +1606,27 @@ gst_vpi_harris_detector_get_property (GObject * object, guint property_id,
     case PROP_STRENGTH_THRESH:
       g_value_set_double (value, self->harris_params.strengthThresh);
       break;
+    case PROP_DETECT_INTERVAL:
+      g_value_set_uint (value, self->detect_interval);
+      break;
+    case PROP_PROPAGATION:
+      g_value_set_enum (value, self->propagation);
+      break;
+    case PROP_MAX_KEYPOINTS:
+      g_value_set_uint (value, self->max_keypoints);
+      break;
+    case PROP_GRID_COLUMNS:
+      g_value_set_uint (value, self->grid_columns);
+      break;
+    case PROP_GRID_ROWS:
+      g_value_set_uint (value, self->grid_rows);
+      break;
+    case PROP_DETECT_SCALE:
+      g_value_set_double (value, self->detect_scale);
+      break;
+    case PROP_CAPACITY:
+      g_value_set_uint (value, self->initial_capacity);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -390,14 +1644,56 @@ gst_vpi_harris_detector_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (self, "stop");
 
-  vpiArrayDestroy (self->keypoints);
-  self->keypoints = NULL;
+  gst_vpi_harris_detector_free_size_resources (self);
 
-  vpiArrayDestroy (self->scores);
-  self->scores = NULL;
+  /* Hand the arrays over to other detectors in the process */
+  if (NULL != self->frame_output) {
+    gst_vpi_harris_detector_output_release (self->frame_output);
+    self->frame_output = NULL;
+  }
+  g_ptr_array_set_size (self->region_outputs, 0);
 
-  vpiPayloadDestroy (self->harris);
-  self->harris = NULL;
+  g_array_set_size (self->last_keypoints, 0);
 
   return ret;
 }
+
+void
+gst_vpi_harris_detector_finalize (GObject * object)
+{
+  GstVpiHarrisDetector *self = GST_VPI_HARRIS_DETECTOR (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  if (NULL != self->frame_output) {
+    gst_vpi_harris_detector_output_release (self->frame_output);
+    self->frame_output = NULL;
+  }
+
+  g_array_unref (self->last_keypoints);
+  self->last_keypoints = NULL;
+
+  g_array_unref (self->regions);
+  self->regions = NULL;
+
+  g_array_unref (self->frame_regions);
+  self->frame_regions = NULL;
+
+  g_ptr_array_unref (self->region_outputs);
+  self->region_outputs = NULL;
+
+  g_hash_table_unref (self->region_payloads);
+  self->region_payloads = NULL;
+  g_queue_clear (&self->region_payload_keys);
+
+  g_array_unref (self->cells);
+  self->cells = NULL;
+
+  g_array_unref (self->cell_counts);
+  self->cell_counts = NULL;
+
+  g_array_unref (self->selected);
+  self->selected = NULL;
+
+  G_OBJECT_CLASS (gst_vpi_harris_detector_parent_class)->finalize (object);
+}
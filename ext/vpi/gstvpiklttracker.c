@@ -17,6 +17,7 @@
 #include "gstvpiklttracker.h"
 
 #include <gst/gst.h>
+#include <vpi/algo/ConvertImageFormat.h>
 #include <vpi/algo/KLTFeatureTracker.h>
 #include <vpi/Array.h>
 
@@ -28,15 +29,23 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_klt_tracker_debug_category);
 #define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE }")
 
 #define VPI_ARRAY_CAPACITY 128
-#define MAX_BOUNDING_BOX 64
+#define MAX_BOXES_PER_SHARD 64
+#define MAX_BOUNDING_BOX 4096
 #define MIN_BOUNDING_BOX_SIZE 4
 #define MAX_BOUNDING_BOX_SIZE 64
 #define NEED_TEMPLATE_UPDATE 1
 #define VALID_TRACKING 0
+#define LOST_TRACKING 1
 #define NUM_BOX_PARAMS 4
+#define NUM_TRACK_PARAMS 5
+#define INVALID_BOX_ID G_MAXUINT
 #define WHITE 255
 #define BOX_BORDER_WIDTH 3
+#define NUM_TEMPLATES 2
+#define NUM_SNAPSHOTS 2
 #define IDENTITY_TRANSFORM { {1, 0, 0}, {0, 1, 0}, {0, 0, 1} }
+#define SEED_GRID_CELL_SIZE MAX_BOUNDING_BOX_SIZE
+#define NO_GRID_ENTRY -1
 
 #define DEFAULT_PROP_BOX_MIN 0
 #define DEFAULT_PROP_BOX_MAX G_MAXINT
@@ -46,6 +55,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_klt_tracker_debug_category);
 #define DEFAULT_PROP_NCC_THRESHOLD_MAX 1
 #define DEFAULT_PROP_SCALING_ITERATIONS_MIN 0
 #define DEFAULT_PROP_SCALING_ITERATIONS_MAX G_MAXINT
+#define DEFAULT_PROP_SEED_OVERLAP_MIN 0
+#define DEFAULT_PROP_SEED_OVERLAP_MAX 1
 
 #define DEFAULT_PROP_BOX 0
 #define DEFAULT_PROP_DRAW_BOX TRUE
@@ -55,10 +66,28 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_klt_tracker_debug_category);
 #define DEFAULT_PROP_NCC_THRESHOLD_STOP 1.0
 #define DEFAULT_PROP_NCC_THRESHOLD_UPDATE 0.8
 #define DEFAULT_PROP_SCALING_ITERATIONS 20
+#define DEFAULT_PROP_SEED_TYPE NULL
+#define DEFAULT_PROP_SEED_SIZE 16
+#define DEFAULT_PROP_SEED_OVERLAP 0.3
 
+typedef enum
+{
+  BOX_OP_SET,
+  BOX_OP_APPEND,
+  BOX_OP_REMOVE
+} GstVpiKltTrackerBoxOpType;
+
+typedef struct _GstVpiKltTrackerShard GstVpiKltTrackerShard;
+typedef struct _GstVpiKltTrackerBoxOp GstVpiKltTrackerBoxOp;
+typedef struct _GstVpiKltTrackerGridEntry GstVpiKltTrackerGridEntry;
+typedef struct _GstVpiKltTrackerSnapshot GstVpiKltTrackerSnapshot;
 typedef struct _GstVpiKltTrackerPrivate GstVpiKltTrackerPrivate;
 
-struct _GstVpiKltTrackerPrivate
+/* A KLT payload can track up to 64 boxes, so boxes are split into shards that
+   own their payload and arrays. Slot i lives in shard i / 64 at index i % 64.
+   A box keeps its slot while it is tracked, freed slots are marked as lost so
+   KLT skips them until they are reused */
+struct _GstVpiKltTrackerShard
 {
   /* According to VPI requirements arrays must be of 128 */
   VPIKLTTrackedBoundingBox input_box_array[VPI_ARRAY_CAPACITY];
@@ -67,22 +96,104 @@ struct _GstVpiKltTrackerPrivate
   VPIArray input_trans_vpi_array;
   VPIArray output_box_vpi_array;
   VPIArray output_trans_vpi_array;
-  VpiFrame template_frame;
-  VPIKLTFeatureTrackerParams klt_params;
   VPIPayload klt;
-  gboolean wrapped_arrays;
+  guint num_boxes;
+  gboolean used[MAX_BOXES_PER_SHARD];
+  guint ids[MAX_BOXES_PER_SHARD];
+};
+
+/* Track stored in a cell of the seeding grid */
+struct _GstVpiKltTrackerGridEntry
+{
+  guint slot;
+  gint next;
+};
+
+/* Box update requested by the application */
+struct _GstVpiKltTrackerBoxOp
+{
+  GstVpiKltTrackerBoxOp *next;
+  GstVpiKltTrackerBoxOpType type;
+  gint generation;
+  /* Box to remove */
+  guint id;
+  /* Boxes to set or append, NUM_BOX_PARAMS values each, and their IDs */
+  guint num_boxes;
+  gint *boxes;
+  guint *ids;
+};
+
+/* Boxes published by the streaming thread. The sequence is odd while the
+   snapshot is being written, so readers know they have to retry */
+struct _GstVpiKltTrackerSnapshot
+{
+  gint sequence;
+  gint generation;
+  guint num_boxes;
+  gint boxes[MAX_BOUNDING_BOX * NUM_BOX_PARAMS];
+  guint ids[MAX_BOUNDING_BOX];
+};
+
+struct _GstVpiKltTrackerPrivate
+{
+  /* Only touched by the streaming thread once the element is started */
+  GPtrArray *shards;
+  /* The tracker owns its templates so no upstream buffer is held between
+     frames. One is read by KLT while the current frame is copied into the
+     other */
+  VPIImage template_images[NUM_TEMPLATES];
+  guint template_index;
+  VPIKLTFeatureTrackerParams klt_params;
+  gint backend;
+  guint width;
+  guint height;
+  VPIImageFormat format;
   gboolean first_frame;
   gboolean draw_box;
-  guint box_count;
-  guint total_boxes;
+  /* Slots handed to KLT, including the free ones below the last used slot */
+  guint num_slots;
+  guint live_boxes;
+  GArray *free_slots;
+  /* Tracks bucketed by position to associate detections in constant time */
+  GArray *grid_heads;
+  GArray *grid_entries;
+  guint grid_cols;
+  gint merged_generation;
+  GQuark seed_type;
+  gint seed_size;
+  gdouble seed_overlap;
+
+  /* Box updates pushed lock-free by the application and merged by the
+     streaming thread between frames. Newest update first */
+  GstVpiKltTrackerBoxOp *pending_ops;
+
+  /* Copies of the updates that may not be published yet, so the application
+     reads back what it requested. The streaming thread never takes this
+     lock */
+  GMutex control_lock;
+  GQueue control_ops;
+  gint generation;
+  /* Boxes read back by the application, also under the control lock */
+  gint read_boxes[MAX_BOUNDING_BOX * NUM_BOX_PARAMS];
+  guint read_ids[MAX_BOUNDING_BOX];
+
+  /* Boxes get an ID that does not change while they are tracked, taken
+     atomically by whichever thread creates the box */
+  gint next_id;
+
+  /* Double-buffered box state published after every frame */
+  GstVpiKltTrackerSnapshot *snapshots;
+  gint published_snapshot;
+  gint published_generation;
 };
 /* prototypes */
-static VPIStatus gst_vpi_klt_tracker_set_vpi_arrays (GstVpiKltTracker * self,
-    guint size);
+static void gst_vpi_klt_tracker_shard_free (gpointer data);
 static gboolean gst_vpi_klt_tracker_start (GstVpiFilter * filter, GstVideoInfo
     * in_info, GstVideoInfo * out_info);
-static void gst_vpi_klt_tracker_append_new_box (GstVpiKltTracker * self,
+static guint gst_vpi_klt_tracker_append_new_box (GstVpiKltTracker * self,
     gint x, gint y, gint width, gint height);
+static void gst_vpi_klt_tracker_remove_box (GstVpiKltTracker * self,
+    guint id);
 static GstFlowReturn gst_vpi_klt_tracker_transform_image_ip (GstVpiFilter *
     filter, VPIStream stream, VpiFrame * frame);
 static gboolean gst_vpi_klt_tracker_stop (GstBaseTransform * trans);
@@ -96,13 +207,17 @@ enum
 {
   PROP_0,
   PROP_BOX,
+  PROP_TRACKS,
   PROP_DRAW_BOX,
   PROP_MAX_SCALE_CHANGE,
   PROP_MAX_TRANSLATION_CHANGE,
   PROP_NCC_THRESHOLD_KILL,
   PROP_NCC_THRESHOLD_STOP,
   PROP_NCC_THRESHOLD_UPDATE,
-  PROP_SCALING_ITERATIONS
+  PROP_SCALING_ITERATIONS,
+  PROP_SEED_TYPE,
+  PROP_SEED_SIZE,
+  PROP_SEED_OVERLAP
 };
 
 enum
@@ -144,6 +259,7 @@ gst_vpi_klt_tracker_class_init (GstVpiKltTrackerClass * klass)
 
   klass->append_new_box =
       GST_DEBUG_FUNCPTR (gst_vpi_klt_tracker_append_new_box);
+  klass->remove_box = GST_DEBUG_FUNCPTR (gst_vpi_klt_tracker_remove_box);
   vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_klt_tracker_start);
   vpi_filter_class->transform_image_ip =
       GST_DEBUG_FUNCPTR (gst_vpi_klt_tracker_transform_image_ip);
@@ -155,17 +271,24 @@ gst_vpi_klt_tracker_class_init (GstVpiKltTrackerClass * klass)
   g_signal_new ("new-box", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
       G_STRUCT_OFFSET (GstVpiKltTrackerClass, append_new_box), NULL, NULL,
-      g_cclosure_marshal_generic, G_TYPE_NONE, NUM_BOX_PARAMS, G_TYPE_INT,
+      g_cclosure_marshal_generic, G_TYPE_UINT, NUM_BOX_PARAMS, G_TYPE_INT,
       G_TYPE_INT, G_TYPE_INT, G_TYPE_INT);
 
+  g_signal_new ("remove-box", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstVpiKltTrackerClass, remove_box), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_NONE, 1, G_TYPE_UINT);
+
   g_object_class_install_property (gobject_class, PROP_BOX,
       gst_param_spec_array ("boxes",
           "Bounding Boxes",
           "Nx4 matrix where N is the number of bounding boxes. Each bounding "
           "box (<x, y, w, h>) contains the x and y positions (x, y) of the box "
           "top left corner, and the width and height (w, h) of the bounding "
-          "box. The maximum of bounding boxes is 64, and the minimum and "
-          "maximum size for each bounding box is 4x4 and 64x64 respectively.\n"
+          "box. The maximum of bounding boxes is 4096, and the minimum and "
+          "maximum size for each bounding box is 4x4 and 64x64 respectively. "
+          "Changes are applied on the next frame. Read tracks to get the ID "
+          "of each box.\n"
           "Usage example: <<613,332,23,23>,<790,376,41,22>>",
           gst_param_spec_array ("bounding-boxes", "boxes", "boxes",
               g_param_spec_int ("boxes-params", "params", "params",
@@ -174,6 +297,19 @@ gst_vpi_klt_tracker_class_init (GstVpiKltTrackerClass * klass)
               (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)),
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property (gobject_class, PROP_TRACKS,
+      gst_param_spec_array ("tracks",
+          "Tracks",
+          "Nx5 matrix with the bounding boxes in the same order as boxes, each "
+          "one as <id, x, y, w, h>. The id does not change while the box is "
+          "tracked and is the one remove-box expects.",
+          gst_param_spec_array ("track", "track", "track",
+              g_param_spec_int ("track-params", "params", "params",
+                  DEFAULT_PROP_BOX_MIN, DEFAULT_PROP_BOX_MAX, DEFAULT_PROP_BOX,
+                  (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)),
+              (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)),
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
   g_object_class_install_property (gobject_class, PROP_DRAW_BOX,
       g_param_spec_boolean ("draw-box", "Draw bounding box",
           "Draw bounding boxes of the tracker predictions.",
@@ -232,6 +368,32 @@ gst_vpi_klt_tracker_class_init (GstVpiKltTrackerClass * klass)
           DEFAULT_PROP_SCALING_ITERATIONS_MIN,
           DEFAULT_PROP_SCALING_ITERATIONS_MAX, DEFAULT_PROP_SCALING_ITERATIONS,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SEED_TYPE,
+      g_param_spec_string ("seed-type", "Seed ROI type",
+          "Type of the region of interest metas on the input buffers that are "
+          "used as detections to seed new tracks, for example \"keypoint\" for "
+          "the output of vpiharrisdetector. Detections that overlap an "
+          "existing track move it to the detection, the rest start new tracks. "
+          "Lost tracks are retired. Detections larger than 64x64 are tracked "
+          "by their central 64x64 region. Seeding is disabled if not set.",
+          DEFAULT_PROP_SEED_TYPE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SEED_SIZE,
+      g_param_spec_int ("seed-size", "Seed box size",
+          "Size of the boxes that are started around detections without "
+          "width and height, such as keypoints.",
+          MIN_BOUNDING_BOX_SIZE, MAX_BOUNDING_BOX_SIZE, DEFAULT_PROP_SEED_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SEED_OVERLAP,
+      g_param_spec_double ("seed-overlap", "Seed overlap",
+          "Intersection over union above which a detection is associated to "
+          "an existing track instead of starting a new one.",
+          DEFAULT_PROP_SEED_OVERLAP_MIN, DEFAULT_PROP_SEED_OVERLAP_MAX,
+          DEFAULT_PROP_SEED_OVERLAP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -249,9 +411,81 @@ gst_vpi_klt_tracker_init (GstVpiKltTracker * self)
   priv->klt_params.maxTranslationChange = DEFAULT_PROP_MAX_TRANSLATION_CHANGE;
   priv->klt_params.trackingType = VPI_KLT_INVERSE_COMPOSITIONAL;
 
+  priv->shards =
+      g_ptr_array_new_with_free_func (gst_vpi_klt_tracker_shard_free);
   priv->draw_box = DEFAULT_PROP_DRAW_BOX;
-  priv->wrapped_arrays = FALSE;
-  priv->total_boxes = 0;
+  priv->num_slots = 0;
+  priv->live_boxes = 0;
+  priv->free_slots = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->grid_heads = g_array_new (FALSE, FALSE, sizeof (gint));
+  priv->grid_entries =
+      g_array_new (FALSE, FALSE, sizeof (GstVpiKltTrackerGridEntry));
+  priv->grid_cols = 0;
+  priv->merged_generation = 0;
+  priv->seed_type = 0;
+  priv->seed_size = DEFAULT_PROP_SEED_SIZE;
+  priv->seed_overlap = DEFAULT_PROP_SEED_OVERLAP;
+
+  priv->pending_ops = NULL;
+  g_mutex_init (&priv->control_lock);
+  g_queue_init (&priv->control_ops);
+  priv->generation = 0;
+  priv->next_id = 0;
+
+  priv->snapshots = g_malloc0 (NUM_SNAPSHOTS *
+      sizeof (GstVpiKltTrackerSnapshot));
+  priv->published_snapshot = 0;
+  priv->published_generation = 0;
+}
+
+static void
+gst_vpi_klt_tracker_shard_free_vpi (GstVpiKltTrackerShard * shard)
+{
+  g_return_if_fail (shard);
+
+  vpiArrayDestroy (shard->input_trans_vpi_array);
+  shard->input_trans_vpi_array = NULL;
+
+  vpiArrayDestroy (shard->input_box_vpi_array);
+  shard->input_box_vpi_array = NULL;
+
+  vpiArrayDestroy (shard->output_trans_vpi_array);
+  shard->output_trans_vpi_array = NULL;
+
+  vpiArrayDestroy (shard->output_box_vpi_array);
+  shard->output_box_vpi_array = NULL;
+
+  vpiPayloadDestroy (shard->klt);
+  shard->klt = NULL;
+}
+
+static void
+gst_vpi_klt_tracker_shard_free (gpointer data)
+{
+  GstVpiKltTrackerShard *shard = (GstVpiKltTrackerShard *) data;
+
+  g_return_if_fail (shard);
+
+  gst_vpi_klt_tracker_shard_free_vpi (shard);
+  g_free (shard);
+}
+
+static GstVpiKltTrackerShard *
+gst_vpi_klt_tracker_get_shard (GstVpiKltTracker * self, guint index)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  guint shard = index / MAX_BOXES_PER_SHARD;
+
+  g_return_val_if_fail (self, NULL);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  while (priv->shards->len <= shard) {
+    g_ptr_array_add (priv->shards, g_malloc0 (sizeof (GstVpiKltTrackerShard)));
+  }
+
+  return g_ptr_array_index (priv->shards, shard);
 }
 
 static void
@@ -281,175 +515,141 @@ gst_vpi_klt_tracker_validate_thresholds (GstVpiKltTracker * self)
   GST_OBJECT_UNLOCK (self);
 }
 
-static gboolean
-gst_vpi_klt_tracker_start (GstVpiFilter * filter, GstVideoInfo * in_info,
-    GstVideoInfo * out_info)
+static VPIStatus
+gst_vpi_klt_tracker_wrap_vpi_array (GstVpiKltTracker * self,
+    VPIArrayData * array_data, void *data, VPIArray * array, VPIArrayType type)
+{
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (array_data, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (data, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (array, VPI_ERROR_INVALID_ARGUMENT);
+
+  array_data->type = type;
+  array_data->data = data;
+
+  return vpiArrayCreateHostMemWrapper (array_data, VPI_BACKEND_ALL, array);
+}
+
+/* No error is posted here, callers report the failure */
+static VPIStatus
+gst_vpi_klt_tracker_alloc_shard (GstVpiKltTracker * self,
+    GstVpiKltTrackerShard * shard)
 {
-  GstVpiKltTracker *self = NULL;
   GstVpiKltTrackerPrivate *priv = NULL;
-  gboolean ret = TRUE;
+  VPIArrayData array_data = { 0 };
   VPIStatus status = VPI_SUCCESS;
-  guint width = 0;
-  guint height = 0;
-  GstVideoFormat format = 0;
-  gint backend = VPI_BACKEND_INVALID;
 
-  g_return_val_if_fail (filter, FALSE);
-  g_return_val_if_fail (in_info, FALSE);
-  g_return_val_if_fail (out_info, FALSE);
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (shard, VPI_ERROR_INVALID_ARGUMENT);
 
-  self = GST_VPI_KLT_TRACKER (filter);
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  GST_DEBUG_OBJECT (self, "start");
-
-  /* If no boxes were provided initialize the vpi arrays with size 0 */
-  if (!priv->wrapped_arrays) {
-    gst_vpi_klt_tracker_set_vpi_arrays (self, 0);
-  }
-  gst_vpi_klt_tracker_validate_thresholds (self);
-
-  priv->first_frame = TRUE;
-  priv->template_frame.image = NULL;
-  priv->template_frame.buffer = NULL;
-
-  width = GST_VIDEO_INFO_WIDTH (in_info);
-  height = GST_VIDEO_INFO_HEIGHT (in_info);
-  format = GST_VIDEO_INFO_FORMAT (in_info);
-  backend = gst_vpi_filter_get_backend (filter);
-
-  status = vpiCreateKLTFeatureTracker (backend, width, height,
-      gst_vpi_video_to_image_format (format), &priv->klt);
-
+  status = vpiCreateKLTFeatureTracker (priv->backend, priv->width,
+      priv->height, priv->format, &shard->klt);
   if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create KLT tracker payload."), ("%s",
-            vpiStatusGetName (status)));
-    ret = FALSE;
+    GST_ERROR_OBJECT (self, "Could not create KLT tracker payload.");
     goto out;
   }
 
   status = vpiArrayCreate (VPI_ARRAY_CAPACITY,
       VPI_ARRAY_TYPE_KLT_TRACKED_BOUNDING_BOX, VPI_BACKEND_ALL,
-      &priv->output_box_vpi_array);
-
+      &shard->output_box_vpi_array);
   if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create output bounding box array."), ("%s",
-            vpiStatusGetName (status)));
-    ret = FALSE;
+    GST_ERROR_OBJECT (self, "Could not create output bounding box array.");
     goto free_klt;
   }
 
   status = vpiArrayCreate (VPI_ARRAY_CAPACITY,
       VPI_ARRAY_TYPE_HOMOGRAPHY_TRANSFORM_2D, VPI_BACKEND_ALL,
-      &priv->output_trans_vpi_array);
-
+      &shard->output_trans_vpi_array);
   if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create output homographies array."), ("%s",
-            vpiStatusGetName (status)));
-    ret = FALSE;
+    GST_ERROR_OBJECT (self, "Could not create output homographies array.");
     goto free_out_box_array;
   }
 
+  array_data.capacity = VPI_ARRAY_CAPACITY;
+  array_data.size = shard->num_boxes;
+
+  status =
+      gst_vpi_klt_tracker_wrap_vpi_array (self, &array_data,
+      shard->input_box_array, &shard->input_box_vpi_array,
+      VPI_ARRAY_TYPE_KLT_TRACKED_BOUNDING_BOX);
+  if (VPI_SUCCESS != status) {
+    GST_ERROR_OBJECT (self, "Could not wrap bounding boxes into VPIArray.");
+    goto free_out_trans_array;
+  }
+
+  status =
+      gst_vpi_klt_tracker_wrap_vpi_array (self, &array_data,
+      shard->input_trans_array, &shard->input_trans_vpi_array,
+      VPI_ARRAY_TYPE_HOMOGRAPHY_TRANSFORM_2D);
+  if (VPI_SUCCESS != status) {
+    GST_ERROR_OBJECT (self, "Could not wrap homographies into VPIArray.");
+    goto free_in_box_array;
+  }
+
   goto out;
 
+free_in_box_array:
+  vpiArrayDestroy (shard->input_box_vpi_array);
+  shard->input_box_vpi_array = NULL;
+
+free_out_trans_array:
+  vpiArrayDestroy (shard->output_trans_vpi_array);
+  shard->output_trans_vpi_array = NULL;
+
 free_out_box_array:
-  vpiArrayDestroy (priv->output_box_vpi_array);
-  priv->output_box_vpi_array = NULL;
+  vpiArrayDestroy (shard->output_box_vpi_array);
+  shard->output_box_vpi_array = NULL;
 
 free_klt:
-  vpiPayloadDestroy (priv->klt);
-  priv->klt = NULL;
+  vpiPayloadDestroy (shard->klt);
+  shard->klt = NULL;
 
 out:
-  return ret;
+  return status;
 }
 
 static void
-gst_vpi_klt_tracker_draw_box_data (GstVpiKltTracker * self, VPIImage image)
+gst_vpi_klt_tracker_free_shards_vpi (GstVpiKltTracker * self)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
-  VPIImageData vpi_image_data = { 0 };
-  VPIArrayData box_data = { 0 };
-  VPIArrayData trans_data = { 0 };
-  guint8 *image_data = NULL;
-  VPIKLTTrackedBoundingBox *box = NULL;
-  VPIHomographyTransform2D *trans = NULL;
-  guint stride = 0;
-  VPIImageFormat format = 0;
-  guint scale_f = 0;
-  guint b, i, j, i_aux, j_aux = 0;
-  guint x, y, h, w = 0;
+  guint i = 0;
 
   g_return_if_fail (self);
-  g_return_if_fail (image);
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  GST_OBJECT_LOCK (self);
+  for (i = 0; i < priv->shards->len; i++) {
+    gst_vpi_klt_tracker_shard_free_vpi (g_ptr_array_index (priv->shards, i));
+  }
+}
 
-  vpiImageLock (image, VPI_LOCK_READ_WRITE, &vpi_image_data);
-  /* Supported formats only have one plane */
-  stride = vpi_image_data.planes[0].pitchBytes;
-  format = vpi_image_data.type;
-  image_data = (guint8 *) vpi_image_data.planes[0].data;
+static void
+gst_vpi_klt_tracker_free_templates (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  guint i = 0;
 
-  vpiArrayLock (priv->input_box_vpi_array, VPI_LOCK_READ, &box_data);
-  vpiArrayLock (priv->input_trans_vpi_array, VPI_LOCK_READ, &trans_data);
-  box = (VPIKLTTrackedBoundingBox *) box_data.data;
-  trans = (VPIHomographyTransform2D *) trans_data.data;
+  g_return_if_fail (self);
 
-  /* To address both types with same pointer */
-  scale_f = (VPI_IMAGE_FORMAT_U8 == format) ? 1 : 2;
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
 
-  for (b = 0; b < priv->total_boxes; b++) {
-    if (box[b].trackingStatus == VALID_TRACKING) {
-      x = (guint) box[b].bbox.xform.mat3[0][2] + trans[b].mat3[0][2];
-      y = (guint) box[b].bbox.xform.mat3[1][2] + trans[b].mat3[1][2];
-      w = (guint) box[b].bbox.width * box[b].bbox.xform.mat3[0][0] *
-          trans[b].mat3[0][0];
-      h = (guint) box[b].bbox.height * box[b].bbox.xform.mat3[1][1] *
-          trans[b].mat3[1][1];
-
-      /* Top and bottom borders */
-      for (i = y; i < y + BOX_BORDER_WIDTH; i++) {
-        for (j = scale_f * x; j < scale_f * (x + w); j++) {
-          image_data[i * stride + j] = WHITE;
-          i_aux = i + h - BOX_BORDER_WIDTH - 1;
-          image_data[i_aux * stride + j] = WHITE;
-        }
-      }
-      /* Left and right borders (do not include corners that were already
-         covered by previous for) */
-      for (i = y + BOX_BORDER_WIDTH; i < y + h - BOX_BORDER_WIDTH; i++) {
-        for (j = scale_f * x; j < scale_f * (x + BOX_BORDER_WIDTH); j++) {
-          image_data[i * stride + j] = WHITE;
-          j_aux = j + scale_f * (w - BOX_BORDER_WIDTH);
-          image_data[i * stride + j_aux] = WHITE;
-        }
-      }
-    }
+  for (i = 0; i < NUM_TEMPLATES; i++) {
+    vpiImageDestroy (priv->template_images[i]);
+    priv->template_images[i] = NULL;
   }
-
-  vpiImageUnlock (image);
-  vpiArrayUnlock (priv->input_box_vpi_array);
-  vpiArrayUnlock (priv->input_trans_vpi_array);
-
-  GST_OBJECT_UNLOCK (self);
 }
 
 static void
-gst_vpi_klt_tracker_update_bounding_boxes_status (GstVpiKltTracker * self)
+gst_vpi_klt_tracker_update_vpi_arrays (GstVpiKltTracker * self)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
-  VPIArrayData updated_box_data = { 0 };
-  VPIArrayData updated_trans_data = { 0 };
-  VPIKLTTrackedBoundingBox *updated_box = NULL;
-  VPIHomographyTransform2D *updated_trans = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  gint boxes = 0;
   guint i = 0;
 
   g_return_if_fail (self);
@@ -457,246 +657,1089 @@ gst_vpi_klt_tracker_update_bounding_boxes_status (GstVpiKltTracker * self)
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  vpiArrayLock (priv->output_box_vpi_array, VPI_LOCK_READ, &updated_box_data);
-  vpiArrayLock (priv->output_trans_vpi_array, VPI_LOCK_READ,
-      &updated_trans_data);
-  updated_box = (VPIKLTTrackedBoundingBox *) updated_box_data.data;
-  updated_trans = (VPIHomographyTransform2D *) updated_trans_data.data;
-
-  /* Set the input for next frame */
-  GST_OBJECT_LOCK (self);
-  for (i = 0; i < priv->total_boxes; i++) {
-    priv->input_box_array[i].trackingStatus = updated_box[i].trackingStatus;
-    priv->input_box_array[i].templateStatus = updated_box[i].templateStatus;
+  for (i = 0; i < priv->shards->len; i++) {
+    shard = g_ptr_array_index (priv->shards, i);
+    boxes = CLAMP ((gint) priv->num_slots - (gint) (i * MAX_BOXES_PER_SHARD),
+        0, MAX_BOXES_PER_SHARD);
 
-    /* Skip boxes that are not being tracked */
-    if (VALID_TRACKING != updated_box[i].trackingStatus) {
+    /* Shards without wrappers will pick the size up once allocated */
+    if (NULL == shard->klt) {
+      shard->num_boxes = boxes;
       continue;
     }
-    /* Must update template for this box ? */
-    if (NEED_TEMPLATE_UPDATE == updated_box[i].templateStatus) {
-      VPIHomographyTransform2D identity = { IDENTITY_TRANSFORM };
 
-      /* Simple update approach */
-      priv->input_box_array[i] = updated_box[i];
-      priv->input_box_array[i].templateStatus = NEED_TEMPLATE_UPDATE;
-      priv->input_trans_array[i] = identity;
-    } else {
-      priv->input_box_array[i].templateStatus = !NEED_TEMPLATE_UPDATE;
-      priv->input_trans_array[i] = updated_trans[i];
+    /* Update the VPI array size in case number of boxes changed */
+    if (boxes != shard->num_boxes) {
+      vpiArrayLock (shard->input_box_vpi_array, VPI_LOCK_READ_WRITE, NULL);
+      vpiArraySetSize (shard->input_box_vpi_array, boxes);
+      vpiArrayUnlock (shard->input_box_vpi_array);
+      vpiArrayLock (shard->input_trans_vpi_array, VPI_LOCK_READ_WRITE, NULL);
+      vpiArraySetSize (shard->input_trans_vpi_array, boxes);
+      vpiArrayUnlock (shard->input_trans_vpi_array);
+      shard->num_boxes = boxes;
     }
+    /* Update the VPI array content */
+    vpiArrayInvalidate (shard->input_box_vpi_array);
+    vpiArrayInvalidate (shard->input_trans_vpi_array);
   }
-  GST_OBJECT_UNLOCK (self);
-  vpiArrayUnlock (priv->output_box_vpi_array);
-  vpiArrayUnlock (priv->output_trans_vpi_array);
 }
 
 static void
-gst_vpi_klt_tracker_track_bounding_boxes (GstVpiKltTracker * self,
-    VPIStream stream, VPIImage image)
+gst_vpi_klt_tracker_set_box_at (GstVpiKltTracker * self, guint index,
+    guint id, gint x, gint y, gint width, gint height)
 {
-  GstVpiKltTrackerPrivate *priv = NULL;
-  VPIStatus status = VPI_SUCCESS;
-  gboolean draw_box = DEFAULT_PROP_DRAW_BOX;
+  GstVpiKltTrackerShard *shard = NULL;
+  VPIKLTTrackedBoundingBox *box = NULL;
+  float identity[3][3] = IDENTITY_TRANSFORM;
 
   g_return_if_fail (self);
-  g_return_if_fail (stream);
-  g_return_if_fail (image);
+
+  shard = gst_vpi_klt_tracker_get_shard (self, index);
+  index %= MAX_BOXES_PER_SHARD;
+  box = &shard->input_box_array[index];
+  shard->ids[index] = id;
+
+  memcpy (&box->bbox.xform.mat3, &identity, sizeof (identity));
+  box->bbox.xform.mat3[0][2] = x;
+  box->bbox.xform.mat3[1][2] = y;
+  box->bbox.width = width;
+  box->bbox.height = height;
+  box->trackingStatus = VALID_TRACKING;
+  box->templateStatus = NEED_TEMPLATE_UPDATE;
+  memcpy (&shard->input_trans_array[index].mat3, &identity, sizeof (identity));
+}
+
+/* Takes a free slot if there is one, so the slots of the boxes being tracked
+   never move. Returns FALSE if the maximum of boxes is reached */
+static gboolean
+gst_vpi_klt_tracker_alloc_slot (GstVpiKltTracker * self, guint * slot)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (slot, FALSE);
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  GST_OBJECT_LOCK (self);
-  draw_box = priv->draw_box;
-  status =
-      vpiSubmitKLTFeatureTracker (stream, priv->klt, priv->template_frame.image,
-      priv->input_box_vpi_array, priv->input_trans_vpi_array, image,
-      priv->output_box_vpi_array, priv->output_trans_vpi_array,
-      &priv->klt_params);
-  vpiStreamSync (stream);
-  GST_OBJECT_UNLOCK (self);
-
-  if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not predict the new bounding boxes."), ("%s",
-            vpiStatusGetName (status)));
+  if (priv->live_boxes >= MAX_BOUNDING_BOX) {
     goto out;
   }
 
-  gst_vpi_klt_tracker_update_bounding_boxes_status (self);
-
-  /* Force arrays to update because wrapped memory has been modifed */
-  GST_OBJECT_LOCK (self);
-  vpiArrayInvalidate (priv->input_box_vpi_array);
-  vpiArrayInvalidate (priv->input_trans_vpi_array);
-  GST_OBJECT_UNLOCK (self);
-
-  if (draw_box) {
-    gst_vpi_klt_tracker_draw_box_data (self, image);
+  if (priv->free_slots->len > 0) {
+    *slot = g_array_index (priv->free_slots, guint, priv->free_slots->len - 1);
+    g_array_set_size (priv->free_slots, priv->free_slots->len - 1);
+  } else {
+    *slot = priv->num_slots++;
   }
 
+  shard = gst_vpi_klt_tracker_get_shard (self, *slot);
+  shard->used[*slot % MAX_BOXES_PER_SHARD] = TRUE;
+  priv->live_boxes++;
+  ret = TRUE;
+
 out:
-  return;
+  return ret;
 }
 
-static GstFlowReturn
-gst_vpi_klt_tracker_transform_image_ip (GstVpiFilter * filter, VPIStream stream,
-    VpiFrame * frame)
+static void
+gst_vpi_klt_tracker_free_slot (GstVpiKltTracker * self, guint slot)
 {
-  GstVpiKltTracker *self = NULL;
   GstVpiKltTrackerPrivate *priv = NULL;
-  GstFlowReturn ret = GST_FLOW_OK;
+  GstVpiKltTrackerShard *shard = NULL;
 
-  g_return_val_if_fail (filter, GST_FLOW_ERROR);
-  g_return_val_if_fail (stream, GST_FLOW_ERROR);
-  g_return_val_if_fail (frame, GST_FLOW_ERROR);
-  g_return_val_if_fail (frame->image, GST_FLOW_ERROR);
+  g_return_if_fail (self);
 
-  self = GST_VPI_KLT_TRACKER (filter);
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  GST_LOG_OBJECT (self, "Transform image ip");
+  g_return_if_fail (slot < priv->num_slots);
 
-  if (priv->first_frame) {
-    GST_DEBUG_OBJECT (self, "Setting first frame");
-    priv->first_frame = FALSE;
+  shard = gst_vpi_klt_tracker_get_shard (self, slot);
+  shard->used[slot % MAX_BOXES_PER_SHARD] = FALSE;
+  shard->input_box_array[slot % MAX_BOXES_PER_SHARD].trackingStatus =
+      LOST_TRACKING;
+  priv->live_boxes--;
 
+  if (0 == priv->live_boxes) {
+    /* Nothing left to track, start again from the first slot */
+    priv->num_slots = 0;
+    g_array_set_size (priv->free_slots, 0);
   } else {
-    gst_vpi_klt_tracker_track_bounding_boxes (self, stream, frame->image);
+    g_array_append_val (priv->free_slots, slot);
   }
+}
 
-  if (priv->template_frame.buffer) {
-    gst_buffer_unref (priv->template_frame.buffer);
-  }
-  priv->template_frame.buffer = gst_buffer_ref (frame->buffer);
-  priv->template_frame.image = frame->image;
+static gboolean
+gst_vpi_klt_tracker_slot_is_used (GstVpiKltTracker * self, guint slot)
+{
+  GstVpiKltTrackerShard *shard = NULL;
 
-  return ret;
+  g_return_val_if_fail (self, FALSE);
+
+  shard = gst_vpi_klt_tracker_get_shard (self, slot);
+
+  return shard->used[slot % MAX_BOXES_PER_SHARD];
 }
 
-static VPIStatus
-gst_vpi_klt_tracker_wrap_vpi_array (GstVpiKltTracker * self,
-    VPIArrayData * array_data, void *data, VPIArray * array, VPIArrayType type)
+static guint
+gst_vpi_klt_tracker_get_box_id (GstVpiKltTracker * self, guint slot)
 {
-  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
-  g_return_val_if_fail (array_data, VPI_ERROR_INVALID_ARGUMENT);
-  g_return_val_if_fail (data, VPI_ERROR_INVALID_ARGUMENT);
-  g_return_val_if_fail (array, VPI_ERROR_INVALID_ARGUMENT);
+  GstVpiKltTrackerShard *shard = NULL;
 
-  array_data->type = type;
-  array_data->data = data;
+  g_return_val_if_fail (self, INVALID_BOX_ID);
 
-  return vpiArrayCreateHostMemWrapper (array_data, VPI_BACKEND_ALL, array);
+  shard = gst_vpi_klt_tracker_get_shard (self, slot);
+
+  return shard->ids[slot % MAX_BOXES_PER_SHARD];
 }
 
-static VPIStatus
-gst_vpi_klt_tracker_set_vpi_arrays (GstVpiKltTracker * self, guint size)
+static guint
+gst_vpi_klt_tracker_new_box_id (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+
+  g_return_val_if_fail (self, INVALID_BOX_ID);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  return (guint) g_atomic_int_add (&priv->next_id, 1);
+}
+
+/* Returns FALSE if no box has the ID */
+static gboolean
+gst_vpi_klt_tracker_remove_box_with_id (GstVpiKltTracker * self, guint id)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  gboolean ret = FALSE;
+  guint slot = 0;
+
+  g_return_val_if_fail (self, FALSE);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  for (slot = 0; slot < priv->num_slots; slot++) {
+    if (gst_vpi_klt_tracker_slot_is_used (self, slot)
+        && id == gst_vpi_klt_tracker_get_box_id (self, slot)) {
+      gst_vpi_klt_tracker_free_slot (self, slot);
+      ret = TRUE;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static GstVpiKltTrackerBoxOp *
+gst_vpi_klt_tracker_box_op_new (GstVpiKltTrackerBoxOpType type,
+    guint num_boxes)
+{
+  GstVpiKltTrackerBoxOp *op = g_malloc0 (sizeof (GstVpiKltTrackerBoxOp));
+
+  op->type = type;
+  op->num_boxes = num_boxes;
+  op->boxes = g_malloc0 (num_boxes * NUM_BOX_PARAMS * sizeof (gint));
+  op->ids = g_malloc0 (num_boxes * sizeof (guint));
+
+  return op;
+}
+
+static GstVpiKltTrackerBoxOp *
+gst_vpi_klt_tracker_box_op_copy (const GstVpiKltTrackerBoxOp * op)
+{
+  GstVpiKltTrackerBoxOp *copy = NULL;
+
+  g_return_val_if_fail (op, NULL);
+
+  copy = gst_vpi_klt_tracker_box_op_new (op->type, op->num_boxes);
+  copy->generation = op->generation;
+  copy->id = op->id;
+  memcpy (copy->boxes, op->boxes, op->num_boxes * NUM_BOX_PARAMS *
+      sizeof (gint));
+  memcpy (copy->ids, op->ids, op->num_boxes * sizeof (guint));
+
+  return copy;
+}
+
+static void
+gst_vpi_klt_tracker_box_op_free (gpointer data)
+{
+  GstVpiKltTrackerBoxOp *op = (GstVpiKltTrackerBoxOp *) data;
+
+  g_return_if_fail (op);
+
+  g_free (op->boxes);
+  g_free (op->ids);
+  g_free (op);
+}
+
+static void
+gst_vpi_klt_tracker_merge_box_op (GstVpiKltTracker * self,
+    GstVpiKltTrackerBoxOp * op)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  gint *box = NULL;
+  guint slot = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (op);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  if (BOX_OP_REMOVE == op->type) {
+    if (!gst_vpi_klt_tracker_remove_box_with_id (self, op->id)) {
+      GST_WARNING_OBJECT (self, "There is no box %u to remove.", op->id);
+    }
+    goto out;
+  }
+
+  if (BOX_OP_SET == op->type) {
+    /* Reset arrays before filling them again */
+    for (i = 0; i < priv->shards->len; i++) {
+      shard = g_ptr_array_index (priv->shards, i);
+      memset (shard->input_box_array, 0, sizeof (shard->input_box_array));
+      memset (shard->input_trans_array, 0, sizeof (shard->input_trans_array));
+      memset (shard->used, 0, sizeof (shard->used));
+    }
+    priv->num_slots = 0;
+    priv->live_boxes = 0;
+    g_array_set_size (priv->free_slots, 0);
+  }
+
+  for (i = 0; i < op->num_boxes; i++) {
+    if (!gst_vpi_klt_tracker_alloc_slot (self, &slot)) {
+      GST_WARNING_OBJECT (self,
+          "Maximum number of boxes reached. Refused append.");
+      break;
+    }
+    box = &op->boxes[i * NUM_BOX_PARAMS];
+    gst_vpi_klt_tracker_set_box_at (self, slot, op->ids[i], box[X_POS],
+        box[Y_POS], box[WIDTH], box[HEIGHT]);
+  }
+
+out:
+  return;
+}
+
+/* Takes every pending update with a single atomic exchange, so the
+   application is never waited for */
+static void
+gst_vpi_klt_tracker_merge_pending_ops (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerBoxOp *pending = NULL;
+  GstVpiKltTrackerBoxOp *ordered = NULL;
+  GstVpiKltTrackerBoxOp *op = NULL;
+  GstVpiKltTrackerBoxOp *next = NULL;
+
+  g_return_if_fail (self);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  do {
+    pending = g_atomic_pointer_get (&priv->pending_ops);
+  } while (NULL != pending
+      && !g_atomic_pointer_compare_and_exchange (&priv->pending_ops, pending,
+          NULL));
+
+  if (NULL == pending) {
+    goto out;
+  }
+
+  /* Apply the updates in the order they were requested */
+  for (op = pending; NULL != op; op = next) {
+    next = op->next;
+    op->next = ordered;
+    ordered = op;
+  }
+
+  for (op = ordered; NULL != op; op = next) {
+    next = op->next;
+    gst_vpi_klt_tracker_merge_box_op (self, op);
+    priv->merged_generation = op->generation;
+    gst_vpi_klt_tracker_box_op_free (op);
+  }
+
+  gst_vpi_klt_tracker_update_vpi_arrays (self);
+
+out:
+  return;
+}
+
+static void
+gst_vpi_klt_tracker_publish_boxes (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerSnapshot *snapshot = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  VPIKLTTrackedBoundingBox *bbox = NULL;
+  gint *box = NULL;
+  gint index = 0;
+  guint num_boxes = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  /* Write the snapshot readers are not looking at, then publish it */
+  index = (g_atomic_int_get (&priv->published_snapshot) + 1) % NUM_SNAPSHOTS;
+  snapshot = &priv->snapshots[index];
+
+  g_atomic_int_inc (&snapshot->sequence);
+
+  snapshot->generation = priv->merged_generation;
+  for (i = 0; i < priv->num_slots; i++) {
+    shard = g_ptr_array_index (priv->shards, i / MAX_BOXES_PER_SHARD);
+    if (!shard->used[i % MAX_BOXES_PER_SHARD]) {
+      continue;
+    }
+    bbox = &shard->input_box_array[i % MAX_BOXES_PER_SHARD];
+    box = &snapshot->boxes[num_boxes * NUM_BOX_PARAMS];
+    snapshot->ids[num_boxes] = shard->ids[i % MAX_BOXES_PER_SHARD];
+    num_boxes++;
+
+    box[X_POS] = bbox->bbox.xform.mat3[0][2];
+    box[Y_POS] = bbox->bbox.xform.mat3[1][2];
+    box[WIDTH] = bbox->bbox.width;
+    box[HEIGHT] = bbox->bbox.height;
+  }
+  snapshot->num_boxes = num_boxes;
+
+  g_atomic_int_inc (&snapshot->sequence);
+
+  g_atomic_int_set (&priv->published_snapshot, index);
+  g_atomic_int_set (&priv->published_generation, priv->merged_generation);
+}
+
+static gboolean
+gst_vpi_klt_tracker_start (GstVpiFilter * filter, GstVideoInfo * in_info,
+    GstVideoInfo * out_info)
+{
+  GstVpiKltTracker *self = NULL;
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  gboolean ret = TRUE;
+  VPIStatus status = VPI_SUCCESS;
+  guint i = 0;
+
+  g_return_val_if_fail (filter, FALSE);
+  g_return_val_if_fail (in_info, FALSE);
+  g_return_val_if_fail (out_info, FALSE);
+
+  self = GST_VPI_KLT_TRACKER (filter);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  gst_vpi_klt_tracker_validate_thresholds (self);
+
+  priv->first_frame = TRUE;
+  priv->width = GST_VIDEO_INFO_WIDTH (in_info);
+  priv->height = GST_VIDEO_INFO_HEIGHT (in_info);
+  priv->format =
+      gst_vpi_video_to_image_format (GST_VIDEO_INFO_FORMAT (in_info));
+  priv->backend = gst_vpi_filter_get_backend (filter);
+
+  /* Payloads and templates depend on the image size so they are recreated on
+     every caps change. Shards added later are allocated while streaming */
+  gst_vpi_klt_tracker_free_shards_vpi (self);
+  gst_vpi_klt_tracker_free_templates (self);
+
+  for (i = 0; i < NUM_TEMPLATES && VPI_SUCCESS == status; i++) {
+    status = vpiImageCreate (priv->width, priv->height, priv->format,
+        VPI_BACKEND_ALL, &priv->template_images[i]);
+  }
+  priv->template_index = 0;
+
+  gst_vpi_klt_tracker_merge_pending_ops (self);
+
+  for (i = 0; i < priv->shards->len && VPI_SUCCESS == status; i++) {
+    shard = g_ptr_array_index (priv->shards, i);
+    if (0 == shard->num_boxes) {
+      continue;
+    }
+    status = gst_vpi_klt_tracker_alloc_shard (self, shard);
+  }
+
+  gst_vpi_klt_tracker_publish_boxes (self);
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create KLT tracker payloads, arrays and templates."),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+  }
+
+  return ret;
+}
+
+static void
+gst_vpi_klt_tracker_draw_box (guint8 * image_data, guint stride,
+    guint scale_f, VPIKLTTrackedBoundingBox * box,
+    VPIHomographyTransform2D * trans)
+{
+  guint i, j, i_aux, j_aux = 0;
+  guint x, y, h, w = 0;
+
+  g_return_if_fail (image_data);
+  g_return_if_fail (box);
+  g_return_if_fail (trans);
+
+  x = (guint) box->bbox.xform.mat3[0][2] + trans->mat3[0][2];
+  y = (guint) box->bbox.xform.mat3[1][2] + trans->mat3[1][2];
+  w = (guint) box->bbox.width * box->bbox.xform.mat3[0][0] *
+      trans->mat3[0][0];
+  h = (guint) box->bbox.height * box->bbox.xform.mat3[1][1] *
+      trans->mat3[1][1];
+
+  /* Top and bottom borders */
+  for (i = y; i < y + BOX_BORDER_WIDTH; i++) {
+    for (j = scale_f * x; j < scale_f * (x + w); j++) {
+      image_data[i * stride + j] = WHITE;
+      i_aux = i + h - BOX_BORDER_WIDTH - 1;
+      image_data[i_aux * stride + j] = WHITE;
+    }
+  }
+  /* Left and right borders (do not include corners that were already
+     covered by previous for) */
+  for (i = y + BOX_BORDER_WIDTH; i < y + h - BOX_BORDER_WIDTH; i++) {
+    for (j = scale_f * x; j < scale_f * (x + BOX_BORDER_WIDTH); j++) {
+      image_data[i * stride + j] = WHITE;
+      j_aux = j + scale_f * (w - BOX_BORDER_WIDTH);
+      image_data[i * stride + j_aux] = WHITE;
+    }
+  }
+}
+
+static void
+gst_vpi_klt_tracker_draw_box_data (GstVpiKltTracker * self, VPIImage image)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  VPIImageData vpi_image_data = { 0 };
+  VPIArrayData box_data = { 0 };
+  VPIArrayData trans_data = { 0 };
+  guint8 *image_data = NULL;
+  VPIKLTTrackedBoundingBox *box = NULL;
+  VPIHomographyTransform2D *trans = NULL;
+  guint stride = 0;
+  VPIImageFormat format = 0;
+  guint scale_f = 0;
+  guint b, s = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (image);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  vpiImageLock (image, VPI_LOCK_READ_WRITE, &vpi_image_data);
+  /* Supported formats only have one plane */
+  stride = vpi_image_data.planes[0].pitchBytes;
+  format = vpi_image_data.type;
+  image_data = (guint8 *) vpi_image_data.planes[0].data;
+
+  /* To address both types with same pointer */
+  scale_f = (VPI_IMAGE_FORMAT_U8 == format) ? 1 : 2;
+
+  for (s = 0; s < priv->shards->len; s++) {
+    shard = g_ptr_array_index (priv->shards, s);
+    if (NULL == shard->klt || 0 == shard->num_boxes) {
+      continue;
+    }
+
+    vpiArrayLock (shard->input_box_vpi_array, VPI_LOCK_READ, &box_data);
+    vpiArrayLock (shard->input_trans_vpi_array, VPI_LOCK_READ, &trans_data);
+    box = (VPIKLTTrackedBoundingBox *) box_data.data;
+    trans = (VPIHomographyTransform2D *) trans_data.data;
+
+    for (b = 0; b < shard->num_boxes; b++) {
+      if (box[b].trackingStatus == VALID_TRACKING) {
+        gst_vpi_klt_tracker_draw_box (image_data, stride, scale_f, &box[b],
+            &trans[b]);
+      }
+    }
+
+    vpiArrayUnlock (shard->input_box_vpi_array);
+    vpiArrayUnlock (shard->input_trans_vpi_array);
+  }
+
+  vpiImageUnlock (image);
+}
+
+static void
+gst_vpi_klt_tracker_update_shard_status (GstVpiKltTrackerShard * shard)
+{
+  VPIArrayData updated_box_data = { 0 };
+  VPIArrayData updated_trans_data = { 0 };
+  VPIKLTTrackedBoundingBox *updated_box = NULL;
+  VPIHomographyTransform2D *updated_trans = NULL;
+  guint i = 0;
+
+  g_return_if_fail (shard);
+
+  vpiArrayLock (shard->output_box_vpi_array, VPI_LOCK_READ, &updated_box_data);
+  vpiArrayLock (shard->output_trans_vpi_array, VPI_LOCK_READ,
+      &updated_trans_data);
+  updated_box = (VPIKLTTrackedBoundingBox *) updated_box_data.data;
+  updated_trans = (VPIHomographyTransform2D *) updated_trans_data.data;
+
+  /* Set the input for next frame */
+  for (i = 0; i < shard->num_boxes; i++) {
+    shard->input_box_array[i].trackingStatus = updated_box[i].trackingStatus;
+    shard->input_box_array[i].templateStatus = updated_box[i].templateStatus;
+
+    /* Skip boxes that are not being tracked */
+    if (VALID_TRACKING != updated_box[i].trackingStatus) {
+      continue;
+    }
+    /* Must update template for this box ? */
+    if (NEED_TEMPLATE_UPDATE == updated_box[i].templateStatus) {
+      VPIHomographyTransform2D identity = { IDENTITY_TRANSFORM };
+
+      /* Simple update approach */
+      shard->input_box_array[i] = updated_box[i];
+      shard->input_box_array[i].templateStatus = NEED_TEMPLATE_UPDATE;
+      shard->input_trans_array[i] = identity;
+    } else {
+      shard->input_box_array[i].templateStatus = !NEED_TEMPLATE_UPDATE;
+      shard->input_trans_array[i] = updated_trans[i];
+    }
+  }
+
+  vpiArrayUnlock (shard->output_box_vpi_array);
+  vpiArrayUnlock (shard->output_trans_vpi_array);
+
+  /* Force arrays to update because wrapped memory has been modifed */
+  vpiArrayInvalidate (shard->input_box_vpi_array);
+  vpiArrayInvalidate (shard->input_trans_vpi_array);
+}
+
+static void
+gst_vpi_klt_tracker_update_bounding_boxes_status (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  for (i = 0; i < priv->shards->len; i++) {
+    shard = g_ptr_array_index (priv->shards, i);
+    if (NULL != shard->klt && 0 != shard->num_boxes) {
+      gst_vpi_klt_tracker_update_shard_status (shard);
+    }
+  }
+}
+
+static VPIStatus
+gst_vpi_klt_tracker_copy_template (GstVpiKltTracker * self, VPIStream stream,
+    VPIImage image, VPIImage template_image)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
-  VPIArrayData array_data = { 0 };
-  VPIStatus status = VPI_SUCCESS;
 
   g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (template_image, VPI_ERROR_INVALID_ARGUMENT);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  /* Same format conversion is a plain copy executed on the stream */
+  return vpiSubmitConvertImageFormat (stream, priv->backend, image,
+      template_image, VPI_CONVERSION_CAST, 1, 0);
+}
+
+static void
+gst_vpi_klt_tracker_track_bounding_boxes (GstVpiKltTracker * self,
+    VPIStream stream, VPIImage image, VPIImage next_template)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  VPIKLTFeatureTrackerParams klt_params = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  VPIStatus copy_status = VPI_SUCCESS;
+  gboolean draw_box = DEFAULT_PROP_DRAW_BOX;
+  guint i = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (stream);
+  g_return_if_fail (image);
+  g_return_if_fail (next_template);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  /* Only the parameters are shared with the application, the boxes are
+     owned by this thread so the kernels run without any lock held */
+  GST_OBJECT_LOCK (self);
+  draw_box = priv->draw_box;
+  klt_params = priv->klt_params;
+  GST_OBJECT_UNLOCK (self);
+
+  /* Submit every shard back to back so that the backend can overlap them,
+     and wait for all of them at once */
+  for (i = 0; i < priv->shards->len; i++) {
+    shard = g_ptr_array_index (priv->shards, i);
+    if (0 == shard->num_boxes) {
+      continue;
+    }
+
+    if (NULL == shard->klt) {
+      status = gst_vpi_klt_tracker_alloc_shard (self, shard);
+      if (VPI_SUCCESS != status) {
+        break;
+      }
+    }
+
+    status =
+        vpiSubmitKLTFeatureTracker (stream, shard->klt,
+        priv->template_images[priv->template_index],
+        shard->input_box_vpi_array, shard->input_trans_vpi_array, image,
+        shard->output_box_vpi_array, shard->output_trans_vpi_array,
+        &klt_params);
+    if (VPI_SUCCESS != status) {
+      break;
+    }
+  }
+
+  /* The template is copied before the boxes are drawn on the image */
+  copy_status =
+      gst_vpi_klt_tracker_copy_template (self, stream, image, next_template);
+
+  vpiStreamSync (stream);
+
+  if (VPI_SUCCESS != copy_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not update the tracking template."), ("%s",
+            vpiStatusGetName (copy_status)));
+    goto out;
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not predict the new bounding boxes."), ("%s",
+            vpiStatusGetName (status)));
+    goto out;
+  }
+
+  gst_vpi_klt_tracker_update_bounding_boxes_status (self);
+
+  if (draw_box) {
+    gst_vpi_klt_tracker_draw_box_data (self, image);
+  }
+
+out:
+  return;
+}
+
+static void
+gst_vpi_klt_tracker_get_box_rect (GstVpiKltTracker * self, guint index,
+    gint * rect)
+{
+  GstVpiKltTrackerShard *shard = NULL;
+  VPIKLTTrackedBoundingBox *box = NULL;
+  VPIHomographyTransform2D *trans = NULL;
+
+  g_return_if_fail (self);
+  g_return_if_fail (rect);
+
+  shard = gst_vpi_klt_tracker_get_shard (self, index);
+  box = &shard->input_box_array[index % MAX_BOXES_PER_SHARD];
+  trans = &shard->input_trans_array[index % MAX_BOXES_PER_SHARD];
+
+  rect[X_POS] = box->bbox.xform.mat3[0][2] + trans->mat3[0][2];
+  rect[Y_POS] = box->bbox.xform.mat3[1][2] + trans->mat3[1][2];
+  rect[WIDTH] = box->bbox.width * box->bbox.xform.mat3[0][0] *
+      trans->mat3[0][0];
+  rect[HEIGHT] = box->bbox.height * box->bbox.xform.mat3[1][1] *
+      trans->mat3[1][1];
+}
+
+/* Intersection over union of two <x, y, w, h> rectangles */
+static gdouble
+gst_vpi_klt_tracker_overlap (const gint * a, const gint * b)
+{
+  gint left = MAX (a[X_POS], b[X_POS]);
+  gint top = MAX (a[Y_POS], b[Y_POS]);
+  gint right = MIN (a[X_POS] + a[WIDTH], b[X_POS] + b[WIDTH]);
+  gint bottom = MIN (a[Y_POS] + a[HEIGHT], b[Y_POS] + b[HEIGHT]);
+  gdouble intersection = 0;
+  gdouble total = 0;
+  gdouble ret = 0;
+
+  if (right <= left || bottom <= top) {
+    goto out;
+  }
+
+  intersection = (gdouble) (right - left) * (bottom - top);
+  total = (gdouble) a[WIDTH] * a[HEIGHT] + (gdouble) b[WIDTH] * b[HEIGHT] -
+      intersection;
+  ret = total > 0 ? intersection / total : 0;
+
+out:
+  return ret;
+}
+
+static void
+gst_vpi_klt_tracker_retire_lost_boxes (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerShard *shard = NULL;
+  guint retired = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  /* Only the slots are released, the remaining tracks keep their slot and
+     their template */
+  for (i = priv->num_slots; i > 0; i--) {
+    shard = gst_vpi_klt_tracker_get_shard (self, i - 1);
+    if (shard->used[(i - 1) % MAX_BOXES_PER_SHARD]
+        && VALID_TRACKING !=
+        shard->input_box_array[(i - 1) % MAX_BOXES_PER_SHARD].trackingStatus) {
+      gst_vpi_klt_tracker_free_slot (self, i - 1);
+      retired++;
+    }
+  }
+
+  if (retired) {
+    GST_LOG_OBJECT (self, "Retired %u lost tracks", retired);
+  }
+}
+
+static void
+gst_vpi_klt_tracker_grid_cells (GstVpiKltTracker * self, const gint * rect,
+    gint * first_col, gint * first_row, gint * last_col, gint * last_row)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  gint rows = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (rect);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  rows = priv->grid_heads->len / priv->grid_cols;
+
+  *first_col = CLAMP (rect[X_POS] / SEED_GRID_CELL_SIZE, 0,
+      (gint) priv->grid_cols - 1);
+  *first_row = CLAMP (rect[Y_POS] / SEED_GRID_CELL_SIZE, 0, rows - 1);
+  *last_col = CLAMP ((rect[X_POS] + rect[WIDTH]) / SEED_GRID_CELL_SIZE, 0,
+      (gint) priv->grid_cols - 1);
+  *last_row = CLAMP ((rect[Y_POS] + rect[HEIGHT]) / SEED_GRID_CELL_SIZE, 0,
+      rows - 1);
+}
+
+static void
+gst_vpi_klt_tracker_grid_insert (GstVpiKltTracker * self, guint slot)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerGridEntry entry = { 0 };
+  gint rect[NUM_BOX_PARAMS] = { 0 };
+  gint *head = NULL;
+  gint first_col = 0;
+  gint first_row = 0;
+  gint last_col = 0;
+  gint last_row = 0;
+  gint col = 0;
+  gint row = 0;
+
+  g_return_if_fail (self);
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  array_data.capacity = VPI_ARRAY_CAPACITY;
-  array_data.size = size;
+  gst_vpi_klt_tracker_get_box_rect (self, slot, rect);
+  gst_vpi_klt_tracker_grid_cells (self, rect, &first_col, &first_row,
+      &last_col, &last_row);
+
+  for (row = first_row; row <= last_row; row++) {
+    for (col = first_col; col <= last_col; col++) {
+      head = &g_array_index (priv->grid_heads, gint, row * priv->grid_cols +
+          col);
+      entry.slot = slot;
+      entry.next = *head;
+      *head = priv->grid_entries->len;
+      g_array_append_val (priv->grid_entries, entry);
+    }
+  }
+}
 
-  status =
-      gst_vpi_klt_tracker_wrap_vpi_array (self, &array_data,
-      priv->input_box_array, &priv->input_box_vpi_array,
-      VPI_ARRAY_TYPE_KLT_TRACKED_BOUNDING_BOX);
+static void
+gst_vpi_klt_tracker_grid_build (GstVpiKltTracker * self)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  guint rows = 0;
+  guint i = 0;
 
-  if (VPI_SUCCESS != status) {
-    GST_ERROR_OBJECT (self, "Could not wrap bounding boxes into VPIArray. Code"
-        " error: %s", vpiStatusGetName (status));
-    goto out;
-  }
+  g_return_if_fail (self);
 
-  status =
-      gst_vpi_klt_tracker_wrap_vpi_array (self, &array_data,
-      priv->input_trans_array, &priv->input_trans_vpi_array,
-      VPI_ARRAY_TYPE_HOMOGRAPHY_TRANSFORM_2D);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
 
-  if (VPI_SUCCESS != status) {
-    GST_ERROR_OBJECT (self, "Could not wrap homographies into VPIArray. Code "
-        "error: %s", vpiStatusGetName (status));
-    goto free_in_box_array;
+  priv->grid_cols = (priv->width + SEED_GRID_CELL_SIZE - 1) /
+      SEED_GRID_CELL_SIZE;
+  rows = (priv->height + SEED_GRID_CELL_SIZE - 1) / SEED_GRID_CELL_SIZE;
+
+  g_array_set_size (priv->grid_heads, priv->grid_cols * rows);
+  for (i = 0; i < priv->grid_heads->len; i++) {
+    g_array_index (priv->grid_heads, gint, i) = NO_GRID_ENTRY;
   }
+  g_array_set_size (priv->grid_entries, 0);
 
-  goto out;
+  for (i = 0; i < priv->num_slots; i++) {
+    if (gst_vpi_klt_tracker_slot_is_used (self, i)) {
+      gst_vpi_klt_tracker_grid_insert (self, i);
+    }
+  }
+}
 
-free_in_box_array:
-  vpiArrayDestroy (priv->input_box_vpi_array);
-  priv->input_box_vpi_array = NULL;
+/* Returns the track that overlaps the detection the most, if the overlap is
+   above the threshold. Only the tracks in the cells the detection covers are
+   visited */
+static gboolean
+gst_vpi_klt_tracker_grid_match (GstVpiKltTracker * self,
+    const gint * detection, gdouble seed_overlap, guint * slot,
+    gdouble * overlap)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerGridEntry *entry = NULL;
+  gint track[NUM_BOX_PARAMS] = { 0 };
+  gdouble best = seed_overlap;
+  gdouble current = 0;
+  gboolean ret = FALSE;
+  gint first_col = 0;
+  gint first_row = 0;
+  gint last_col = 0;
+  gint last_row = 0;
+  gint col = 0;
+  gint row = 0;
+  gint e = 0;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (detection, FALSE);
+  g_return_val_if_fail (slot, FALSE);
+  g_return_val_if_fail (overlap, FALSE);
 
-out:
-  return status;
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  gst_vpi_klt_tracker_grid_cells (self, detection, &first_col, &first_row,
+      &last_col, &last_row);
+
+  for (row = first_row; row <= last_row; row++) {
+    for (col = first_col; col <= last_col; col++) {
+      e = g_array_index (priv->grid_heads, gint, row * priv->grid_cols + col);
+      for (; NO_GRID_ENTRY != e; e = entry->next) {
+        entry = &g_array_index (priv->grid_entries,
+            GstVpiKltTrackerGridEntry, e);
+        gst_vpi_klt_tracker_get_box_rect (self, entry->slot, track);
+        current = gst_vpi_klt_tracker_overlap (detection, track);
+        if (current > best) {
+          best = current;
+          *slot = entry->slot;
+          ret = TRUE;
+        }
+      }
+    }
+  }
+
+  *overlap = best;
+
+  return ret;
 }
 
-static VPIStatus
-gst_vpi_klt_tracker_update_vpi_arrays (GstVpiKltTracker * self, gint boxes)
+/* Turns a detection into a box KLT can track. Returns FALSE if the box does
+   not fit in the image */
+static gboolean
+gst_vpi_klt_tracker_detection_to_box (GstVpiKltTracker * self,
+    GstVideoRegionOfInterestMeta * meta, gint seed_size, gint * box)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
-  VPIStatus ret = VPI_SUCCESS;
+  gint center_x = 0;
+  gint center_y = 0;
 
-  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (meta, FALSE);
+  g_return_val_if_fail (box, FALSE);
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  /* If the wrappers have not been created, do it with new boxes data */
-  if (!priv->wrapped_arrays) {
-    ret = gst_vpi_klt_tracker_set_vpi_arrays (self, boxes);
-    priv->wrapped_arrays = (VPI_SUCCESS == ret);
-  } else {
-    /* Update the VPI array size in case number of boxes changed */
-    if (boxes != priv->total_boxes) {
-      vpiArrayLock (priv->input_box_vpi_array, VPI_LOCK_READ_WRITE, NULL);
-      vpiArraySetSize (priv->input_box_vpi_array, boxes);
-      vpiArrayUnlock (priv->input_box_vpi_array);
-      vpiArrayLock (priv->input_trans_vpi_array, VPI_LOCK_READ_WRITE, NULL);
-      vpiArraySetSize (priv->input_trans_vpi_array, boxes);
-      vpiArrayUnlock (priv->input_trans_vpi_array);
+  center_x = meta->x + meta->w / 2;
+  center_y = meta->y + meta->h / 2;
+
+  box[WIDTH] = (0 == meta->w) ? seed_size : CLAMP ((gint) meta->w,
+      MIN_BOUNDING_BOX_SIZE, MAX_BOUNDING_BOX_SIZE);
+  box[HEIGHT] = (0 == meta->h) ? seed_size : CLAMP ((gint) meta->h,
+      MIN_BOUNDING_BOX_SIZE, MAX_BOUNDING_BOX_SIZE);
+  box[X_POS] = center_x - box[WIDTH] / 2;
+  box[Y_POS] = center_y - box[HEIGHT] / 2;
+
+  return box[X_POS] >= 0 && box[Y_POS] >= 0
+      && box[X_POS] + box[WIDTH] <= (gint) priv->width
+      && box[Y_POS] + box[HEIGHT] <= (gint) priv->height;
+}
+
+/* Associates the detections of the frame with the current tracks and starts
+   new tracks for the unmatched ones. Runs after tracking, so both are in the
+   coordinates of the frame that becomes the next template */
+static void
+gst_vpi_klt_tracker_seed_boxes (GstVpiKltTracker * self, GstBuffer * buffer,
+    GQuark seed_type, gint seed_size, gdouble seed_overlap)
+{
+  GstVideoRegionOfInterestMeta *meta = NULL;
+  gpointer state = NULL;
+  gint detection[NUM_BOX_PARAMS] = { 0 };
+  gdouble overlap = 0;
+  guint seeded = 0;
+  guint refreshed = 0;
+  guint slot = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (buffer);
+
+  gst_vpi_klt_tracker_retire_lost_boxes (self);
+  gst_vpi_klt_tracker_grid_build (self);
+
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    if (seed_type != meta->roi_type) {
+      continue;
     }
-    /* Update the VPI array content */
-    vpiArrayInvalidate (priv->input_box_vpi_array);
-    vpiArrayInvalidate (priv->input_trans_vpi_array);
+
+    if (!gst_vpi_klt_tracker_detection_to_box (self, meta, seed_size,
+            detection)) {
+      continue;
+    }
+
+    if (gst_vpi_klt_tracker_grid_match (self, detection, seed_overlap, &slot,
+            &overlap)) {
+      /* The detection is the better estimate, the track is moved to it and
+         only its own template is updated */
+      if (overlap < 1) {
+        gst_vpi_klt_tracker_set_box_at (self, slot,
+            gst_vpi_klt_tracker_get_box_id (self, slot), detection[X_POS],
+            detection[Y_POS], detection[WIDTH], detection[HEIGHT]);
+        refreshed++;
+      }
+      continue;
+    }
+
+    if (!gst_vpi_klt_tracker_alloc_slot (self, &slot)) {
+      GST_LOG_OBJECT (self, "Maximum number of boxes reached, not seeding.");
+      break;
+    }
+
+    gst_vpi_klt_tracker_set_box_at (self, slot,
+        gst_vpi_klt_tracker_new_box_id (self), detection[X_POS],
+        detection[Y_POS], detection[WIDTH], detection[HEIGHT]);
+    gst_vpi_klt_tracker_grid_insert (self, slot);
+    seeded++;
   }
-  return ret;
+
+  if (seeded || refreshed) {
+    GST_LOG_OBJECT (self, "Seeded %u new tracks, refreshed %u tracks", seeded,
+        refreshed);
+  }
+
+  gst_vpi_klt_tracker_update_vpi_arrays (self);
 }
 
-static void
-gst_vpi_klt_tracker_set_box_at (GstVpiKltTracker * self, gint index, gint x,
-    gint y, gint width, gint height)
+static GstFlowReturn
+gst_vpi_klt_tracker_transform_image_ip (GstVpiFilter * filter, VPIStream stream,
+    VpiFrame * frame)
 {
+  GstVpiKltTracker *self = NULL;
   GstVpiKltTrackerPrivate *priv = NULL;
-  float identity[3][3] = IDENTITY_TRANSFORM;
+  GstFlowReturn ret = GST_FLOW_OK;
+  VPIStatus status = VPI_SUCCESS;
+  GQuark seed_type = 0;
+  gint seed_size = DEFAULT_PROP_SEED_SIZE;
+  gdouble seed_overlap = DEFAULT_PROP_SEED_OVERLAP;
+  guint next = 0;
 
-  g_return_if_fail (self);
+  g_return_val_if_fail (filter, GST_FLOW_ERROR);
+  g_return_val_if_fail (stream, GST_FLOW_ERROR);
+  g_return_val_if_fail (frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (frame->image, GST_FLOW_ERROR);
 
+  self = GST_VPI_KLT_TRACKER (filter);
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  memcpy (&priv->input_box_array[index].bbox.xform.mat3, &identity,
-      sizeof (identity));
-  priv->input_box_array[index].bbox.xform.mat3[0][2] = x;
-  priv->input_box_array[index].bbox.xform.mat3[1][2] = y;
-  priv->input_box_array[index].bbox.width = width;
-  priv->input_box_array[index].bbox.height = height;
-  priv->input_box_array[index].trackingStatus = VALID_TRACKING;
-  priv->input_box_array[index].templateStatus = NEED_TEMPLATE_UPDATE;
-  memcpy (&priv->input_trans_array[index].mat3, &identity, sizeof (identity));
+  GST_LOG_OBJECT (self, "Transform image ip");
+
+  gst_vpi_klt_tracker_merge_pending_ops (self);
+
+  next = (priv->template_index + 1) % NUM_TEMPLATES;
+
+  if (priv->first_frame) {
+    GST_DEBUG_OBJECT (self, "Setting first frame");
+    priv->first_frame = FALSE;
+
+    /* The base class syncs the stream after this call */
+    status = gst_vpi_klt_tracker_copy_template (self, stream, frame->image,
+        priv->template_images[next]);
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not set the tracking template."), ("%s",
+              vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+  } else {
+    gst_vpi_klt_tracker_track_bounding_boxes (self, stream, frame->image,
+        priv->template_images[next]);
+  }
+
+  /* Swap templates, the frame just copied is the template for the next one */
+  priv->template_index = next;
+
+  GST_OBJECT_LOCK (self);
+  seed_type = priv->seed_type;
+  seed_size = priv->seed_size;
+  seed_overlap = priv->seed_overlap;
+  GST_OBJECT_UNLOCK (self);
+
+  if (0 != seed_type) {
+    gst_vpi_klt_tracker_seed_boxes (self, frame->buffer, seed_type, seed_size,
+        seed_overlap);
+  }
+
+  gst_vpi_klt_tracker_publish_boxes (self);
+
+out:
+  return ret;
 }
 
 static guint
 gst_vpi_klt_tracker_fill_bounding_boxes (GstVpiKltTracker * self,
-    const GValue * gst_array, guint boxes, guint params)
+    const GValue * gst_array, guint boxes, guint params, gint * out_boxes)
 {
   const GValue *box = NULL;
+  gint *out_box = NULL;
   gint width = 0;
   gint height = 0;
   guint i = 0;
@@ -705,6 +1748,7 @@ gst_vpi_klt_tracker_fill_bounding_boxes (GstVpiKltTracker * self,
 
   g_return_val_if_fail (self, ret);
   g_return_val_if_fail (gst_array, ret);
+  g_return_val_if_fail (out_boxes, ret);
 
   for (i = 0; i < boxes; i++) {
     box = gst_value_array_get_value (gst_array, i);
@@ -727,18 +1771,20 @@ gst_vpi_klt_tracker_fill_bounding_boxes (GstVpiKltTracker * self,
           "bounding box %d.", width, height, i);
       continue;
     }
-    gst_vpi_klt_tracker_set_box_at (self, cur_box,
-        g_value_get_int (gst_value_array_get_value (box, X_POS)),
-        g_value_get_int (gst_value_array_get_value (box, Y_POS)), width,
-        height);
+    out_box = &out_boxes[cur_box * NUM_BOX_PARAMS];
+    out_box[X_POS] = g_value_get_int (gst_value_array_get_value (box, X_POS));
+    out_box[Y_POS] = g_value_get_int (gst_value_array_get_value (box, Y_POS));
+    out_box[WIDTH] = width;
+    out_box[HEIGHT] = height;
     cur_box++;
 
-    /* Do this validation here in case more than 64 boxes were provided but
-       some were discarded due to invalid parameters, leaving a valid number of
-       boxes */
+    /* Do this validation here in case more than the maximum boxes were
+       provided but some were discarded due to invalid parameters, leaving a
+       valid number of boxes */
     if (MAX_BOUNDING_BOX <= cur_box) {
       GST_WARNING_OBJECT (self,
-          "Received 64 boxes. Extra boxes will be discarded.");
+          "Received %d boxes. Extra boxes will be discarded.",
+          MAX_BOUNDING_BOX);
       break;
     }
   }
@@ -747,61 +1793,128 @@ out:
   return ret;
 }
 
+static guint
+gst_vpi_klt_tracker_apply_box_op (const GstVpiKltTrackerBoxOp * op,
+    gint * boxes, guint * ids, guint num_boxes)
+{
+  guint to_copy = 0;
+  guint i = 0;
+
+  g_return_val_if_fail (op, num_boxes);
+  g_return_val_if_fail (boxes, num_boxes);
+  g_return_val_if_fail (ids, num_boxes);
+
+  if (BOX_OP_REMOVE == op->type) {
+    for (i = 0; i < num_boxes && ids[i] != op->id; i++);
+    if (i < num_boxes) {
+      memmove (&boxes[i * NUM_BOX_PARAMS], &boxes[(i + 1) * NUM_BOX_PARAMS],
+          (num_boxes - i - 1) * NUM_BOX_PARAMS * sizeof (gint));
+      memmove (&ids[i], &ids[i + 1], (num_boxes - i - 1) * sizeof (guint));
+      num_boxes--;
+    }
+    goto out;
+  }
+
+  if (BOX_OP_SET == op->type) {
+    num_boxes = 0;
+  }
+
+  to_copy = MIN (op->num_boxes, MAX_BOUNDING_BOX - num_boxes);
+  memcpy (&boxes[num_boxes * NUM_BOX_PARAMS], op->boxes,
+      to_copy * NUM_BOX_PARAMS * sizeof (gint));
+  memcpy (&ids[num_boxes], op->ids, to_copy * sizeof (guint));
+  num_boxes += to_copy;
+
+out:
+  return num_boxes;
+}
+
+/* Must be called with the control lock held */
 static void
-gst_vpi_klt_tracker_set_bounding_boxes (GstVpiKltTracker * self,
-    const GValue * gst_array)
+gst_vpi_klt_tracker_prune_control_ops (GstVpiKltTracker * self,
+    gint generation)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
-  guint boxes = 0;
-  guint params = 0;
-
-  guint cur_box = 0;
-  VPIStatus status = VPI_SUCCESS;
+  GstVpiKltTrackerBoxOp *op = NULL;
 
   g_return_if_fail (self);
-  g_return_if_fail (gst_array);
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  boxes = gst_value_array_get_size (gst_array);
-  params = gst_value_array_get_size (gst_value_array_get_value (gst_array, 0));
+  /* Updates already contained in a published snapshot are not needed */
+  op = g_queue_peek_head (&priv->control_ops);
+  while (NULL != op && op->generation <= generation) {
+    gst_vpi_klt_tracker_box_op_free (g_queue_pop_head (&priv->control_ops));
+    op = g_queue_peek_head (&priv->control_ops);
+  }
+}
+
+static void
+gst_vpi_klt_tracker_push_box_op (GstVpiKltTracker * self,
+    GstVpiKltTrackerBoxOp * op)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerBoxOp *head = NULL;
 
-  /* Reset arrays before filling them again */
-  memset (priv->input_box_array, 0,
-      priv->total_boxes * sizeof (VPIKLTTrackedBoundingBox));
-  memset (priv->input_trans_array, 0,
-      priv->total_boxes * sizeof (VPIHomographyTransform2D));
-  priv->total_boxes = 0;
+  g_return_if_fail (self);
+  g_return_if_fail (op);
 
-  cur_box =
-      gst_vpi_klt_tracker_fill_bounding_boxes (self, gst_array, boxes, params);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
 
-  if (0 == cur_box) {
-    goto out;
-  }
+  g_mutex_lock (&priv->control_lock);
 
-  status = gst_vpi_klt_tracker_update_vpi_arrays (self, cur_box);
-  if (VPI_SUCCESS != status) {
-    goto out;
-  }
+  op->generation = ++priv->generation;
+  g_queue_push_tail (&priv->control_ops,
+      gst_vpi_klt_tracker_box_op_copy (op));
+  gst_vpi_klt_tracker_prune_control_ops (self,
+      g_atomic_int_get (&priv->published_generation));
 
-  priv->total_boxes = cur_box;
+  do {
+    head = g_atomic_pointer_get (&priv->pending_ops);
+    op->next = head;
+  } while (!g_atomic_pointer_compare_and_exchange (&priv->pending_ops, head,
+          op));
 
-out:
-  return;
+  g_mutex_unlock (&priv->control_lock);
 }
 
 static void
-gst_vpi_klt_tracker_append_new_box (GstVpiKltTracker * self, gint x, gint y,
-    gint width, gint height)
+gst_vpi_klt_tracker_set_bounding_boxes (GstVpiKltTracker * self,
+    const GValue * gst_array)
 {
-  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerBoxOp *op = NULL;
+  guint boxes = 0;
+  guint params = 0;
+  guint i = 0;
 
   g_return_if_fail (self);
+  g_return_if_fail (gst_array);
 
-  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
-      GstVpiKltTrackerPrivate);
+  boxes = gst_value_array_get_size (gst_array);
+  params = gst_value_array_get_size (gst_value_array_get_value (gst_array, 0));
+
+  op = gst_vpi_klt_tracker_box_op_new (BOX_OP_SET, MIN (boxes,
+          MAX_BOUNDING_BOX));
+  op->num_boxes =
+      gst_vpi_klt_tracker_fill_bounding_boxes (self, gst_array, boxes, params,
+      op->boxes);
+  for (i = 0; i < op->num_boxes; i++) {
+    op->ids[i] = gst_vpi_klt_tracker_new_box_id (self);
+  }
+
+  gst_vpi_klt_tracker_push_box_op (self, op);
+}
+
+static guint
+gst_vpi_klt_tracker_append_new_box (GstVpiKltTracker * self, gint x, gint y,
+    gint width, gint height)
+{
+  GstVpiKltTrackerBoxOp *op = NULL;
+  guint id = INVALID_BOX_ID;
+
+  g_return_val_if_fail (self, INVALID_BOX_ID);
 
   GST_DEBUG_OBJECT (self, "Received new box");
 
@@ -813,29 +1926,91 @@ gst_vpi_klt_tracker_append_new_box (GstVpiKltTracker * self, gint x, gint y,
     goto out;
   }
 
-  if (priv->total_boxes >= MAX_BOUNDING_BOX) {
-    GST_WARNING_OBJECT (self,
-        "Maximum number of boxes reached. Refused append.");
-    goto out;
-  }
+  op = gst_vpi_klt_tracker_box_op_new (BOX_OP_APPEND, 1);
+  op->boxes[X_POS] = x;
+  op->boxes[Y_POS] = y;
+  op->boxes[WIDTH] = width;
+  op->boxes[HEIGHT] = height;
+  op->ids[0] = id = gst_vpi_klt_tracker_new_box_id (self);
 
-  GST_OBJECT_LOCK (self);
-  gst_vpi_klt_tracker_set_box_at (self, priv->total_boxes, x, y, width, height);
-  priv->total_boxes++;
-  gst_vpi_klt_tracker_update_vpi_arrays (self, priv->total_boxes);
-  GST_OBJECT_UNLOCK (self);
+  gst_vpi_klt_tracker_push_box_op (self, op);
 
 out:
-  return;
+  return id;
+}
+
+static void
+gst_vpi_klt_tracker_remove_box (GstVpiKltTracker * self, guint id)
+{
+  GstVpiKltTrackerBoxOp *op = NULL;
+
+  g_return_if_fail (self);
+
+  GST_DEBUG_OBJECT (self, "Received box %u removal", id);
+
+  op = gst_vpi_klt_tracker_box_op_new (BOX_OP_REMOVE, 0);
+  op->id = id;
+
+  gst_vpi_klt_tracker_push_box_op (self, op);
+}
+
+/* Lock-free read of the last published boxes, retried if the streaming
+   thread rewrote the snapshot in the meantime. The snapshot is only rewritten
+   once per frame, so yielding lets the writer finish instead of spinning */
+static guint
+gst_vpi_klt_tracker_read_snapshot (GstVpiKltTracker * self, gint * boxes,
+    guint * ids, gint * generation)
+{
+  GstVpiKltTrackerPrivate *priv = NULL;
+  GstVpiKltTrackerSnapshot *snapshot = NULL;
+  gint sequence = 0;
+  guint num_boxes = 0;
+
+  g_return_val_if_fail (self, 0);
+  g_return_val_if_fail (boxes, 0);
+  g_return_val_if_fail (ids, 0);
+  g_return_val_if_fail (generation, 0);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
+      GstVpiKltTrackerPrivate);
+
+  while (TRUE) {
+    snapshot =
+        &priv->snapshots[g_atomic_int_get (&priv->published_snapshot)];
+    sequence = g_atomic_int_get (&snapshot->sequence);
+    if (sequence % 2) {
+      g_thread_yield ();
+      continue;
+    }
+
+    num_boxes = MIN (snapshot->num_boxes, MAX_BOUNDING_BOX);
+    *generation = snapshot->generation;
+    memcpy (boxes, snapshot->boxes, num_boxes * NUM_BOX_PARAMS *
+        sizeof (gint));
+    memcpy (ids, snapshot->ids, num_boxes * sizeof (guint));
+
+    if (g_atomic_int_get (&snapshot->sequence) == sequence) {
+      break;
+    }
+    g_thread_yield ();
+  }
+
+  return num_boxes;
 }
 
+/* Boxes as <x, y, w, h>, or as <id, x, y, w, h> if with_ids is set */
 static void
 gst_vpi_klt_tracker_get_bounding_boxes (GstVpiKltTracker * self,
-    GValue * gst_array)
+    GValue * gst_array, gboolean with_ids)
 {
   GstVpiKltTrackerPrivate *priv = NULL;
   GValue box = G_VALUE_INIT;
   GValue value = G_VALUE_INIT;
+  gint *boxes = NULL;
+  guint *ids = NULL;
+  gint generation = 0;
+  guint num_boxes = 0;
+  GList *l = NULL;
   guint i = 0;
   guint j = 0;
 
@@ -844,21 +2019,35 @@ gst_vpi_klt_tracker_get_bounding_boxes (GstVpiKltTracker * self,
 
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
+  boxes = priv->read_boxes;
+  ids = priv->read_ids;
+
+  /* Published boxes plus the updates that have not been merged yet. The
+     read buffers are shared, so the lock is held until they are copied
+     out */
+  g_mutex_lock (&priv->control_lock);
+  num_boxes =
+      gst_vpi_klt_tracker_read_snapshot (self, boxes, ids, &generation);
+  gst_vpi_klt_tracker_prune_control_ops (self, generation);
+  for (l = priv->control_ops.head; NULL != l; l = l->next) {
+    num_boxes =
+        gst_vpi_klt_tracker_apply_box_op (l->data, boxes, ids, num_boxes);
+  }
 
-  for (i = 0; i < priv->total_boxes; i++) {
-
-    guint params[NUM_BOX_PARAMS] = {
-      priv->input_box_array[i].bbox.xform.mat3[0][2],
-      priv->input_box_array[i].bbox.xform.mat3[1][2],
-      priv->input_box_array[i].bbox.width,
-      priv->input_box_array[i].bbox.height
-    };
+  for (i = 0; i < num_boxes; i++) {
     g_value_init (&box, GST_TYPE_ARRAY);
 
+    if (with_ids) {
+      g_value_init (&value, G_TYPE_INT);
+      g_value_set_int (&value, ids[i]);
+      gst_value_array_append_value (&box, &value);
+      g_value_unset (&value);
+    }
+
     for (j = 0; j < NUM_BOX_PARAMS; j++) {
 
       g_value_init (&value, G_TYPE_INT);
-      g_value_set_int (&value, params[j]);
+      g_value_set_int (&value, boxes[i * NUM_BOX_PARAMS + j]);
       gst_value_array_append_value (&box, &value);
       g_value_unset (&value);
     }
@@ -866,6 +2055,7 @@ gst_vpi_klt_tracker_get_bounding_boxes (GstVpiKltTracker * self,
     gst_value_array_append_value (gst_array, &box);
     g_value_unset (&box);
   }
+  g_mutex_unlock (&priv->control_lock);
 }
 
 void
@@ -878,13 +2068,16 @@ gst_vpi_klt_tracker_set_property (GObject * object, guint property_id,
 
   GST_DEBUG_OBJECT (self, "set_property");
 
+  /* Box updates are synchronized by the control lock */
+  if (PROP_BOX == property_id) {
+    gst_vpi_klt_tracker_set_bounding_boxes (self, value);
+    goto out;
+  }
+
   GST_OBJECT_LOCK (self);
   switch (property_id) {
     case PROP_0:
       break;
-    case PROP_BOX:
-      gst_vpi_klt_tracker_set_bounding_boxes (self, value);
-      break;
     case PROP_DRAW_BOX:
       priv->draw_box = g_value_get_boolean (value);
       break;
@@ -906,11 +2099,24 @@ gst_vpi_klt_tracker_set_property (GObject * object, guint property_id,
     case PROP_SCALING_ITERATIONS:
       priv->klt_params.numberOfIterationsScaling = g_value_get_int (value);
       break;
+    case PROP_SEED_TYPE:
+      priv->seed_type = g_value_get_string (value) ?
+          g_quark_from_string (g_value_get_string (value)) : 0;
+      break;
+    case PROP_SEED_SIZE:
+      priv->seed_size = g_value_get_int (value);
+      break;
+    case PROP_SEED_OVERLAP:
+      priv->seed_overlap = g_value_get_double (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
   GST_OBJECT_UNLOCK (self);
+
+out:
+  return;
 }
 
 void
@@ -923,13 +2129,17 @@ gst_vpi_klt_tracker_get_property (GObject * object, guint property_id,
 
   GST_DEBUG_OBJECT (self, "get_property");
 
+  /* Boxes are read from the published snapshot under the control lock */
+  if (PROP_BOX == property_id || PROP_TRACKS == property_id) {
+    gst_vpi_klt_tracker_get_bounding_boxes (self, value,
+        PROP_TRACKS == property_id);
+    goto out;
+  }
+
   GST_OBJECT_LOCK (self);
   switch (property_id) {
     case PROP_0:
       break;
-    case PROP_BOX:
-      gst_vpi_klt_tracker_get_bounding_boxes (self, value);
-      break;
     case PROP_DRAW_BOX:
       g_value_set_boolean (value, priv->draw_box);
       break;
@@ -951,11 +2161,23 @@ gst_vpi_klt_tracker_get_property (GObject * object, guint property_id,
     case PROP_SCALING_ITERATIONS:
       g_value_set_int (value, priv->klt_params.numberOfIterationsScaling);
       break;
+    case PROP_SEED_TYPE:
+      g_value_set_string (value, g_quark_to_string (priv->seed_type));
+      break;
+    case PROP_SEED_SIZE:
+      g_value_set_int (value, priv->seed_size);
+      break;
+    case PROP_SEED_OVERLAP:
+      g_value_set_double (value, priv->seed_overlap);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
   GST_OBJECT_UNLOCK (self);
+
+out:
+  return;
 }
 
 static gboolean
@@ -971,30 +2193,10 @@ gst_vpi_klt_tracker_stop (GstBaseTransform * trans)
   priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_KLT_TRACKER,
       GstVpiKltTrackerPrivate);
 
-  GST_OBJECT_LOCK (self);
-
-  vpiArrayDestroy (priv->input_trans_vpi_array);
-  priv->input_trans_vpi_array = NULL;
-
-  vpiArrayDestroy (priv->input_box_vpi_array);
-  priv->input_box_vpi_array = NULL;
-
-  vpiPayloadDestroy (priv->klt);
-  priv->klt = NULL;
-
-  GST_OBJECT_UNLOCK (self);
-
-  vpiArrayDestroy (priv->output_trans_vpi_array);
-  priv->output_trans_vpi_array = NULL;
+  /* Boxes are kept, only the VPI resources are released */
+  gst_vpi_klt_tracker_free_shards_vpi (self);
 
-  vpiArrayDestroy (priv->output_box_vpi_array);
-  priv->output_box_vpi_array = NULL;
-
-  if (priv->template_frame.buffer) {
-    gst_buffer_unref (priv->template_frame.buffer);
-  }
-  priv->template_frame.buffer = NULL;
-  priv->template_frame.image = NULL;
+  gst_vpi_klt_tracker_free_templates (self);
 
   return ret;
 }
@@ -1003,8 +2205,36 @@ void
 gst_vpi_klt_tracker_finalize (GObject * object)
 {
   GstVpiKltTracker *self = GST_VPI_KLT_TRACKER (object);
+  GstVpiKltTrackerPrivate *priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      GST_TYPE_VPI_KLT_TRACKER, GstVpiKltTrackerPrivate);
+  GstVpiKltTrackerBoxOp *op = NULL;
+  GstVpiKltTrackerBoxOp *next = NULL;
 
   GST_DEBUG_OBJECT (self, "finalize");
 
+  g_ptr_array_unref (priv->shards);
+  priv->shards = NULL;
+
+  g_array_unref (priv->free_slots);
+  priv->free_slots = NULL;
+  g_array_unref (priv->grid_heads);
+  priv->grid_heads = NULL;
+  g_array_unref (priv->grid_entries);
+  priv->grid_entries = NULL;
+
+  for (op = priv->pending_ops; NULL != op; op = next) {
+    next = op->next;
+    gst_vpi_klt_tracker_box_op_free (op);
+  }
+  priv->pending_ops = NULL;
+
+  g_queue_foreach (&priv->control_ops, (GFunc) gst_vpi_klt_tracker_box_op_free,
+      NULL);
+  g_queue_clear (&priv->control_ops);
+  g_mutex_clear (&priv->control_lock);
+
+  g_free (priv->snapshots);
+  priv->snapshots = NULL;
+
   G_OBJECT_CLASS (gst_vpi_klt_tracker_parent_class)->finalize (object);
 }
@@ -24,8 +24,9 @@ struct _GstVpiKltTrackerClass {
   GstVpiFilterClass parent_class;
 
   /* actions */
-  void (*append_new_box) (GstVpiKltTracker *self, gint x, gint y, gint width,
-                          gint height);
+  guint (*append_new_box) (GstVpiKltTracker *self, gint x, gint y, gint width,
+                           gint height);
+  void (*remove_box) (GstVpiKltTracker *self, guint id);
 };
 
 G_END_DECLS
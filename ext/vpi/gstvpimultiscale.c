@@ -0,0 +1,968 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvpimultiscale.h"
+
+#include <cuda_runtime.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+#include <stdlib.h>
+#include <vpi/algo/Rescale.h>
+#include <vpi/Stream.h>
+
+#include "gst-libs/gst/vpi/gstvpi.h"
+#include "gst-libs/gst/vpi/gstcudameta.h"
+#include "gst-libs/gst/vpi/gstvpibufferpool.h"
+#include "gst-libs/gst/vpi/gstvpimeta.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vpi_multi_scale_debug_category);
+#define GST_CAT_DEFAULT gst_vpi_multi_scale_debug_category
+
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE, NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }")
+
+#define MIN_POOL_BUFFERS 2
+
+#define DEFAULT_PROP_INTERPOLATOR VPI_INTERP_LINEAR
+#define DEFAULT_PROP_BOUNDARY_COND VPI_BOUNDARY_COND_ZERO
+#define DEFAULT_PROP_BACKEND VPI_BACKEND_CUDA
+#define DEFAULT_PROP_CASCADE FALSE
+
+static GstStaticPadTemplate gst_vpi_multi_scale_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_AND_VPIIMAGE_CAPS));
+
+static GstStaticPadTemplate gst_vpi_multi_scale_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (VIDEO_AND_VPIIMAGE_CAPS));
+
+/* State of each requested output, owned by its pad */
+typedef struct _GstVpiMultiScaleOutput GstVpiMultiScaleOutput;
+struct _GstVpiMultiScaleOutput
+{
+  GstVideoInfo info;
+  GstBufferPool *pool;
+  gboolean negotiated;
+};
+
+/* An output being produced for the current input buffer */
+typedef struct _GstVpiMultiScaleJob GstVpiMultiScaleJob;
+struct _GstVpiMultiScaleJob
+{
+  GstPad *pad;
+  GstVpiMultiScaleOutput *output;
+  GstBuffer *buffer;
+  GstMapInfo map;
+  VPIImage image;
+};
+
+struct _GstVpiMultiScale
+{
+  GstElement parent;
+
+  GstPad *sinkpad;
+  GList *srcpads;
+  guint next_pad_id;
+  /* Protected by the object lock, pads come and go while streaming */
+  GstFlowCombiner *flow_combiner;
+
+  GstVideoInfo in_info;
+  GstCaps *in_caps;
+
+  VPIStream vpi_stream;
+  cudaStream_t cuda_stream;
+
+  gint interpolator;
+  gint boundary_cond;
+  gint backend;
+  gboolean cascade;
+};
+
+/* prototypes */
+static GstPad *gst_vpi_multi_scale_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_vpi_multi_scale_release_pad (GstElement * element,
+    GstPad * pad);
+static GstStateChangeReturn gst_vpi_multi_scale_change_state (GstElement *
+    element, GstStateChange transition);
+static GstFlowReturn gst_vpi_multi_scale_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buffer);
+static gboolean gst_vpi_multi_scale_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_vpi_multi_scale_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static gboolean gst_vpi_multi_scale_src_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static void gst_vpi_multi_scale_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vpi_multi_scale_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vpi_multi_scale_finalize (GObject * object);
+
+enum
+{
+  PROP_0,
+  PROP_INTERPOLATOR,
+  PROP_BOUNDARY_COND,
+  PROP_BACKEND,
+  PROP_CASCADE
+};
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVpiMultiScale, gst_vpi_multi_scale,
+    GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (gst_vpi_multi_scale_debug_category,
+        "vpimultiscale", 0, "debug category for vpimultiscale element"));
+
+static GQuark output_quark = 0;
+
+static void
+gst_vpi_multi_scale_class_init (GstVpiMultiScaleClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  output_quark = g_quark_from_static_string ("GstVpiMultiScaleOutput");
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vpi_multi_scale_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vpi_multi_scale_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "VPI Multi Scale", "Filter/Converter/Video",
+      "Rescales video into several resolutions at once using VPI. Each "
+      "requested src pad negotiates its own size.",
+      "Jimena Salas <jimena.salas@ridgerun.com>");
+
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_release_pad);
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_change_state);
+  gobject_class->set_property = gst_vpi_multi_scale_set_property;
+  gobject_class->get_property = gst_vpi_multi_scale_get_property;
+  gobject_class->finalize = gst_vpi_multi_scale_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_INTERPOLATOR,
+      g_param_spec_enum ("interpolator", "Interpolation method",
+          "Interpolation method to be used.",
+          VPI_INTERPOLATORS_ENUM, DEFAULT_PROP_INTERPOLATOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_BOUNDARY_COND,
+      g_param_spec_enum ("boundary", "Boundary condition",
+          "How pixel values outside of the image domain should be treated.",
+          VPI_BOUNDARY_CONDS_ENUM, DEFAULT_PROP_BOUNDARY_COND,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_BACKEND,
+      g_param_spec_enum ("backend", "VPI Backend",
+          "Backend to use to execute VPI algorithms.",
+          VPI_BACKEND_ENUM, DEFAULT_PROP_BACKEND,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CASCADE,
+      g_param_spec_boolean ("cascade", "Cascade",
+          "Generate each output from the next larger one instead of from "
+          "the input. Cheaper for large downscale factors, at the cost of "
+          "some sharpness.",
+          DEFAULT_PROP_CASCADE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+}
+
+static void
+gst_vpi_multi_scale_init (GstVpiMultiScale * self)
+{
+  self->sinkpad =
+      gst_pad_new_from_static_template (&gst_vpi_multi_scale_sink_template,
+      "sink");
+  gst_pad_set_chain_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_chain));
+  gst_pad_set_event_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_sink_event));
+  gst_pad_set_query_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_sink_query));
+  gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+  self->srcpads = NULL;
+  self->next_pad_id = 0;
+  self->flow_combiner = gst_flow_combiner_new ();
+  gst_video_info_init (&self->in_info);
+  self->in_caps = NULL;
+  self->vpi_stream = NULL;
+  self->cuda_stream = NULL;
+  self->interpolator = DEFAULT_PROP_INTERPOLATOR;
+  self->boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  self->backend = DEFAULT_PROP_BACKEND;
+  self->cascade = DEFAULT_PROP_CASCADE;
+}
+
+static void
+gst_vpi_multi_scale_output_free (gpointer data)
+{
+  GstVpiMultiScaleOutput *output = data;
+
+  if (output->pool) {
+    gst_buffer_pool_set_active (output->pool, FALSE);
+    gst_object_unref (output->pool);
+  }
+
+  g_slice_free (GstVpiMultiScaleOutput, output);
+}
+
+static gboolean
+gst_vpi_multi_scale_copy_sticky_event (GstPad * pad, GstEvent ** event,
+    gpointer user_data)
+{
+  GstPad *srcpad = GST_PAD (user_data);
+
+  /* Each output negotiates its own caps */
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS) {
+    gst_pad_store_sticky_event (srcpad, *event);
+  }
+
+  return TRUE;
+}
+
+static GstPad *
+gst_vpi_multi_scale_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (element);
+  GstVpiMultiScaleOutput *output = NULL;
+  GstPad *pad = NULL;
+  gchar *pad_name = NULL;
+
+  GST_OBJECT_LOCK (self);
+  if (name) {
+    pad_name = g_strdup (name);
+  } else {
+    pad_name = g_strdup_printf ("src_%u", self->next_pad_id);
+  }
+  self->next_pad_id++;
+  GST_OBJECT_UNLOCK (self);
+
+  pad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+
+  output = g_slice_new0 (GstVpiMultiScaleOutput);
+  gst_video_info_init (&output->info);
+  g_object_set_qdata_full (G_OBJECT (pad), output_quark, output,
+      gst_vpi_multi_scale_output_free);
+
+  gst_pad_set_query_function (pad,
+      GST_DEBUG_FUNCPTR (gst_vpi_multi_scale_src_query));
+  gst_pad_use_fixed_caps (pad);
+
+  gst_pad_set_active (pad, TRUE);
+  gst_pad_sticky_events_foreach (self->sinkpad,
+      gst_vpi_multi_scale_copy_sticky_event, pad);
+
+  if (!gst_element_add_pad (element, pad)) {
+    GST_ERROR_OBJECT (self, "Could not add pad %s", GST_PAD_NAME (pad));
+    gst_object_unref (pad);
+    pad = NULL;
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (self);
+  self->srcpads = g_list_append (self->srcpads, gst_object_ref (pad));
+  gst_flow_combiner_add_pad (self->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (self);
+
+out:
+  return pad;
+}
+
+static void
+gst_vpi_multi_scale_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (element);
+  GList *link = NULL;
+
+  GST_DEBUG_OBJECT (self, "Releasing pad %s", GST_PAD_NAME (pad));
+
+  GST_OBJECT_LOCK (self);
+  link = g_list_find (self->srcpads, pad);
+  if (link) {
+    self->srcpads = g_list_delete_link (self->srcpads, link);
+    gst_flow_combiner_remove_pad (self->flow_combiner, pad);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (link) {
+    gst_pad_set_active (pad, FALSE);
+    gst_element_remove_pad (element, pad);
+    /* The output state goes away with the last reference to the pad */
+    gst_object_unref (pad);
+  }
+}
+
+static GstCaps *
+gst_vpi_multi_scale_get_src_caps (GstVpiMultiScale * self, GstCaps * filter)
+{
+  GstCaps *caps = NULL;
+  GstCaps *tmp = NULL;
+  GstStructure *st = NULL;
+  guint i = 0;
+
+  g_return_val_if_fail (self, NULL);
+
+  GST_OBJECT_LOCK (self);
+  if (self->in_caps) {
+    caps = gst_caps_copy (self->in_caps);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (caps) {
+    /* Only the size changes from the input */
+    for (i = 0; i < gst_caps_get_size (caps); i++) {
+      st = gst_caps_get_structure (caps, i);
+      gst_structure_remove_field (st, "width");
+      gst_structure_remove_field (st, "height");
+    }
+  } else {
+    caps = gst_static_pad_template_get_caps
+        (&gst_vpi_multi_scale_src_template);
+  }
+
+  if (filter) {
+    tmp = caps;
+    caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (tmp);
+  }
+
+  return caps;
+}
+
+static gboolean
+gst_vpi_multi_scale_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (parent);
+  GstCaps *filter = NULL;
+  GstCaps *caps = NULL;
+  gboolean ret = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+      gst_query_parse_caps (query, &filter);
+      caps = gst_vpi_multi_scale_get_src_caps (self, filter);
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      ret = TRUE;
+      break;
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+/* Offers VPI buffers for the input, so upstream can write into memory
+   that the rescales read without a copy */
+static gboolean
+gst_vpi_multi_scale_propose_allocation (GstVpiMultiScale * self,
+    GstQuery * query)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  GstCaps *caps = NULL;
+  GstVideoInfo info;
+  gboolean need_pool = FALSE;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (query, FALSE);
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+
+  if (!caps || !gst_video_info_from_caps (&info, caps)) {
+    GST_WARNING_OBJECT (self, "Invalid caps in allocation query");
+    goto out;
+  }
+
+  if (need_pool) {
+    pool = g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps,
+        GST_VIDEO_INFO_SIZE (&info), MIN_POOL_BUFFERS, 0);
+
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (self, "Unable to set pool configuration");
+      goto unref_pool;
+    }
+
+    gst_query_add_allocation_pool (query, pool, GST_VIDEO_INFO_SIZE (&info),
+        MIN_POOL_BUFFERS, 0);
+  }
+
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  gst_query_add_allocation_meta (query, GST_CUDA_META_API_TYPE, NULL);
+  gst_query_add_allocation_meta (query, GST_VPI_META_API_TYPE, NULL);
+
+  ret = TRUE;
+
+unref_pool:
+  if (pool) {
+    gst_object_unref (pool);
+  }
+
+out:
+  return ret;
+}
+
+static gboolean
+gst_vpi_multi_scale_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (parent);
+  GstCaps *filter = NULL;
+  GstCaps *caps = NULL;
+  gboolean ret = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+      /* Any input size can be scaled to whatever the outputs need */
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *tmp = caps;
+        caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      ret = TRUE;
+      break;
+    case GST_QUERY_ALLOCATION:
+      /* Outputs have their own pools, so the query is answered here
+         instead of being forwarded */
+      ret = gst_vpi_multi_scale_propose_allocation (self, query);
+      break;
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_vpi_multi_scale_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (parent);
+  GstCaps *caps = NULL;
+  GstVideoInfo info;
+  GList *l = NULL;
+  GstVpiMultiScaleOutput *output = NULL;
+  gboolean ret = TRUE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+      gst_event_parse_caps (event, &caps);
+      if (!gst_video_info_from_caps (&info, caps)) {
+        GST_ERROR_OBJECT (self, "Invalid caps %" GST_PTR_FORMAT, caps);
+        ret = FALSE;
+      } else {
+        GST_OBJECT_LOCK (self);
+        self->in_info = info;
+        gst_caps_replace (&self->in_caps, caps);
+        /* Outputs are renegotiated on the next buffer */
+        for (l = self->srcpads; l; l = l->next) {
+          output = g_object_get_qdata (G_OBJECT (l->data), output_quark);
+          output->negotiated = FALSE;
+        }
+        GST_OBJECT_UNLOCK (self);
+      }
+      gst_event_unref (event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (self);
+      gst_flow_combiner_reset (self->flow_combiner);
+      GST_OBJECT_UNLOCK (self);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    default:
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_vpi_multi_scale_update_flow (GstVpiMultiScale * self, GstPad * pad,
+    GstFlowReturn flow)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (pad, GST_FLOW_ERROR);
+
+  GST_OBJECT_LOCK (self);
+  ret = gst_flow_combiner_update_pad_flow (self->flow_combiner, pad, flow);
+  GST_OBJECT_UNLOCK (self);
+
+  return ret;
+}
+
+static gboolean
+gst_vpi_multi_scale_negotiate (GstVpiMultiScale * self, GstPad * pad,
+    GstVpiMultiScaleOutput * output)
+{
+  GstCaps *template_caps = NULL;
+  GstCaps *caps = NULL;
+  GstStructure *st = NULL;
+  GstStructure *config = NULL;
+  gint width = 0, height = 0;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (pad, FALSE);
+  g_return_val_if_fail (output, FALSE);
+
+  template_caps = gst_vpi_multi_scale_get_src_caps (self, NULL);
+  caps = gst_pad_peer_query_caps (pad, template_caps);
+  gst_caps_unref (template_caps);
+
+  if (gst_caps_is_empty (caps)) {
+    GST_ERROR_OBJECT (self, "No compatible caps downstream of %s",
+        GST_PAD_NAME (pad));
+    goto out;
+  }
+
+  /* Keep the input size unless downstream asks for another one */
+  caps = gst_caps_truncate (caps);
+  caps = gst_caps_make_writable (caps);
+  st = gst_caps_get_structure (caps, 0);
+  gst_structure_fixate_field_nearest_int (st, "width",
+      GST_VIDEO_INFO_WIDTH (&self->in_info));
+  gst_structure_fixate_field_nearest_int (st, "height",
+      GST_VIDEO_INFO_HEIGHT (&self->in_info));
+  caps = gst_caps_fixate (caps);
+
+  if (!gst_video_info_from_caps (&output->info, caps)) {
+    GST_ERROR_OBJECT (self, "Could not fixate caps for %s", GST_PAD_NAME (pad));
+    goto out;
+  }
+
+  gst_structure_get_int (st, "width", &width);
+  gst_structure_get_int (st, "height", &height);
+  GST_INFO_OBJECT (self, "Negotiated %s to %dx%d", GST_PAD_NAME (pad), width,
+      height);
+
+  if (!gst_pad_push_event (pad, gst_event_new_caps (caps))) {
+    GST_WARNING_OBJECT (self, "Downstream of %s refused caps %" GST_PTR_FORMAT,
+        GST_PAD_NAME (pad), caps);
+    goto out;
+  }
+
+  if (output->pool) {
+    gst_buffer_pool_set_active (output->pool, FALSE);
+    gst_object_unref (output->pool);
+  }
+  output->pool = g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
+
+  config = gst_buffer_pool_get_config (output->pool);
+  gst_buffer_pool_config_set_params (config, caps,
+      GST_VIDEO_INFO_SIZE (&output->info), MIN_POOL_BUFFERS, 0);
+
+  if (!gst_buffer_pool_set_config (output->pool, config)
+      || !gst_buffer_pool_set_active (output->pool, TRUE)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to set pool configuration."), (NULL));
+    goto out;
+  }
+
+  output->negotiated = TRUE;
+  ret = TRUE;
+
+out:
+  gst_caps_unref (caps);
+  return ret;
+}
+
+static gint
+gst_vpi_multi_scale_compare_jobs (gconstpointer a, gconstpointer b)
+{
+  const GstVpiMultiScaleJob *job_a = a;
+  const GstVpiMultiScaleJob *job_b = b;
+  gint64 area_a = (gint64) GST_VIDEO_INFO_WIDTH (&job_a->output->info) *
+      GST_VIDEO_INFO_HEIGHT (&job_a->output->info);
+  gint64 area_b = (gint64) GST_VIDEO_INFO_WIDTH (&job_b->output->info) *
+      GST_VIDEO_INFO_HEIGHT (&job_b->output->info);
+
+  /* Largest first, so cascaded levels can read the previous one */
+  return area_a < area_b ? 1 : (area_a > area_b ? -1 : 0);
+}
+
+static guint
+gst_vpi_multi_scale_prepare_jobs (GstVpiMultiScale * self, GstBuffer * input,
+    GstVpiMultiScaleJob * jobs, guint num_pads, GstFlowReturn * ret)
+{
+  GstVpiMultiScaleJob job = { 0 };
+  GstVpiMeta *meta = NULL;
+  GstFlowReturn pool_ret = GST_FLOW_OK;
+  guint num_jobs = 0;
+  guint i = 0;
+
+  g_return_val_if_fail (self, 0);
+  g_return_val_if_fail (jobs, 0);
+  g_return_val_if_fail (ret, 0);
+
+  for (i = 0; i < num_pads; i++) {
+    job = jobs[i];
+
+    if (!gst_pad_is_linked (job.pad)) {
+      gst_object_unref (job.pad);
+      continue;
+    }
+
+    if ((!job.output->negotiated || gst_pad_check_reconfigure (job.pad))
+        && !gst_vpi_multi_scale_negotiate (self, job.pad, job.output)) {
+      gst_pad_mark_reconfigure (job.pad);
+      gst_object_unref (job.pad);
+      *ret = GST_FLOW_NOT_NEGOTIATED;
+      continue;
+    }
+
+    pool_ret = gst_buffer_pool_acquire_buffer (job.output->pool, &job.buffer,
+        NULL);
+    if (GST_FLOW_OK != pool_ret) {
+      gst_object_unref (job.pad);
+      *ret = pool_ret;
+      continue;
+    }
+
+    meta = (GstVpiMeta *) gst_buffer_get_meta (job.buffer,
+        GST_VPI_META_API_TYPE);
+    if (!meta || !gst_buffer_map (job.buffer, &job.map, GST_MAP_WRITE)) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Output buffer does not contain the VPI meta."), (NULL));
+      gst_buffer_unref (job.buffer);
+      gst_object_unref (job.pad);
+      *ret = GST_FLOW_ERROR;
+      continue;
+    }
+
+    gst_buffer_copy_into (job.buffer, input,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    job.image = meta->vpi_frame.image;
+
+    /* Skipped pads leave holes, never ahead of the entry being read */
+    jobs[num_jobs] = job;
+    num_jobs++;
+  }
+
+  return num_jobs;
+}
+
+static GstFlowReturn
+gst_vpi_multi_scale_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (parent);
+  GstVpiMultiScaleJob *jobs = NULL;
+  GstVpiMultiScaleJob *job = NULL;
+  GstVpiMeta *in_meta = NULL;
+  GstMapInfo in_map = GST_MAP_INFO_INIT;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstFlowReturn push_ret = GST_FLOW_OK;
+  GstFlowReturn combined_ret = GST_FLOW_OK;
+  VPIStatus status = VPI_SUCCESS;
+  VPIImage source = NULL;
+  gint source_width = 0, source_height = 0;
+  gint interpolator = DEFAULT_PROP_INTERPOLATOR;
+  gint boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  gint backend = DEFAULT_PROP_BACKEND;
+  gboolean cascade = DEFAULT_PROP_CASCADE;
+  guint num_pads = 0;
+  guint num_jobs = 0;
+  guint i = 0;
+  GList *l = NULL;
+
+  in_meta = (GstVpiMeta *) gst_buffer_get_meta (buffer, GST_VPI_META_API_TYPE);
+  if (!in_meta || !gst_buffer_map (buffer, &in_map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Cannot process buffers that do not contain the VPI meta."), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto unref;
+  }
+
+  GST_OBJECT_LOCK (self);
+  interpolator = self->interpolator;
+  boundary_cond = self->boundary_cond;
+  backend = self->backend;
+  cascade = self->cascade;
+  num_pads = g_list_length (self->srcpads);
+  jobs = g_new0 (GstVpiMultiScaleJob, num_pads);
+  for (l = self->srcpads, i = 0; l; l = l->next, i++) {
+    jobs[i].pad = gst_object_ref (l->data);
+    jobs[i].output = g_object_get_qdata (G_OBJECT (l->data), output_quark);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (0 == num_pads) {
+    ret = GST_FLOW_NOT_LINKED;
+    goto unmap;
+  }
+
+  num_jobs = gst_vpi_multi_scale_prepare_jobs (self, buffer, jobs, num_pads,
+      &ret);
+  if (0 == num_jobs) {
+    if (GST_FLOW_OK == ret) {
+      ret = GST_FLOW_NOT_LINKED;
+    }
+    goto unmap;
+  }
+
+  qsort (jobs, num_jobs, sizeof (GstVpiMultiScaleJob),
+      gst_vpi_multi_scale_compare_jobs);
+
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), self->cuda_stream,
+      in_map.data, cudaMemAttachSingle);
+  for (i = 0; i < num_jobs; i++) {
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), self->cuda_stream,
+        jobs[i].map.data, cudaMemAttachSingle);
+  }
+
+  /* All rescales go into the same stream, so a cascaded level only starts
+     once the level it reads from is done */
+  source = in_meta->vpi_frame.image;
+  source_width = GST_VIDEO_INFO_WIDTH (&self->in_info);
+  source_height = GST_VIDEO_INFO_HEIGHT (&self->in_info);
+  for (i = 0; i < num_jobs && VPI_SUCCESS == status; i++) {
+    job = &jobs[i];
+
+    status = vpiSubmitRescale (self->vpi_stream, backend, source, job->image,
+        interpolator, boundary_cond);
+
+    if (cascade && GST_VIDEO_INFO_WIDTH (&job->output->info) <= source_width
+        && GST_VIDEO_INFO_HEIGHT (&job->output->info) <= source_height) {
+      source = job->image;
+      source_width = GST_VIDEO_INFO_WIDTH (&job->output->info);
+      source_height = GST_VIDEO_INFO_HEIGHT (&job->output->info);
+    }
+  }
+
+  vpiStreamSync (self->vpi_stream);
+
+  /* Attach memory to global stream to detach it from CUDA stream */
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, in_map.data,
+      cudaMemAttachHost);
+  for (i = 0; i < num_jobs; i++) {
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, jobs[i].map.data,
+        cudaMemAttachHost);
+    gst_buffer_unmap (jobs[i].buffer, &jobs[i].map);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to perform rescale."), ("%s", vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+  }
+
+  for (i = 0; i < num_jobs; i++) {
+    job = &jobs[i];
+
+    if (GST_FLOW_ERROR == ret) {
+      gst_buffer_unref (job->buffer);
+    } else {
+      /* An unlinked output must not stop the rest, the combiner only
+         reports it once every output is unlinked */
+      push_ret = gst_pad_push (job->pad, job->buffer);
+      combined_ret = gst_vpi_multi_scale_update_flow (self, job->pad,
+          push_ret);
+    }
+    gst_object_unref (job->pad);
+  }
+
+  /* Failures of outputs that could not be prepared are kept */
+  if (GST_FLOW_OK == ret) {
+    ret = combined_ret;
+  }
+
+unmap:
+  g_free (jobs);
+  gst_buffer_unmap (buffer, &in_map);
+
+unref:
+  gst_buffer_unref (buffer);
+  return ret;
+}
+
+static gboolean
+gst_vpi_multi_scale_start (GstVpiMultiScale * self)
+{
+  gboolean ret = TRUE;
+  VPIStatus vpi_status = VPI_SUCCESS;
+  cudaError_t cuda_status = cudaSuccess;
+
+  g_return_val_if_fail (self, FALSE);
+
+  cuda_status = cudaStreamCreate (&self->cuda_stream);
+  if (cudaSuccess != cuda_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create CUDA stream."), (NULL));
+    ret = FALSE;
+    goto out;
+  }
+
+  vpi_status = vpiStreamCreateCudaStreamWrapper (self->cuda_stream,
+      VPI_BACKEND_ALL, &self->vpi_stream);
+  if (VPI_SUCCESS != vpi_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not wrap CUDA stream."), (NULL));
+    cudaStreamDestroy (self->cuda_stream);
+    self->cuda_stream = NULL;
+    ret = FALSE;
+  }
+
+out:
+  return ret;
+}
+
+static void
+gst_vpi_multi_scale_stop (GstVpiMultiScale * self)
+{
+  GList *l = NULL;
+  GstVpiMultiScaleOutput *output = NULL;
+
+  g_return_if_fail (self);
+
+  vpiStreamDestroy (self->vpi_stream);
+  self->vpi_stream = NULL;
+
+  cudaStreamDestroy (self->cuda_stream);
+  self->cuda_stream = NULL;
+
+  GST_OBJECT_LOCK (self);
+  for (l = self->srcpads; l; l = l->next) {
+    output = g_object_get_qdata (G_OBJECT (l->data), output_quark);
+    output->negotiated = FALSE;
+  }
+  gst_caps_replace (&self->in_caps, NULL);
+  gst_flow_combiner_reset (self->flow_combiner);
+  GST_OBJECT_UNLOCK (self);
+}
+
+static GstStateChangeReturn
+gst_vpi_multi_scale_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (element);
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+
+  if (GST_STATE_CHANGE_READY_TO_PAUSED == transition
+      && !gst_vpi_multi_scale_start (self)) {
+    ret = GST_STATE_CHANGE_FAILURE;
+    goto out;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vpi_multi_scale_parent_class)->change_state
+      (element, transition);
+
+  if (GST_STATE_CHANGE_PAUSED_TO_READY == transition) {
+    gst_vpi_multi_scale_stop (self);
+  }
+
+out:
+  return ret;
+}
+
+void
+gst_vpi_multi_scale_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (object);
+
+  GST_DEBUG_OBJECT (self, "set_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      self->interpolator = g_value_get_enum (value);
+      break;
+    case PROP_BOUNDARY_COND:
+      self->boundary_cond = g_value_get_enum (value);
+      break;
+    case PROP_BACKEND:
+      self->backend = g_value_get_enum (value);
+      break;
+    case PROP_CASCADE:
+      self->cascade = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+void
+gst_vpi_multi_scale_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (object);
+
+  GST_DEBUG_OBJECT (self, "get_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      g_value_set_enum (value, self->interpolator);
+      break;
+    case PROP_BOUNDARY_COND:
+      g_value_set_enum (value, self->boundary_cond);
+      break;
+    case PROP_BACKEND:
+      g_value_set_enum (value, self->backend);
+      break;
+    case PROP_CASCADE:
+      g_value_set_boolean (value, self->cascade);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+void
+gst_vpi_multi_scale_finalize (GObject * object)
+{
+  GstVpiMultiScale *self = GST_VPI_MULTI_SCALE (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_list_free_full (self->srcpads, gst_object_unref);
+  self->srcpads = NULL;
+  gst_caps_replace (&self->in_caps, NULL);
+  gst_flow_combiner_free (self->flow_combiner);
+  self->flow_combiner = NULL;
+
+  G_OBJECT_CLASS (gst_vpi_multi_scale_parent_class)->finalize (object);
+}
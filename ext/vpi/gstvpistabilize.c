@@ -0,0 +1,1193 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvpistabilize.h"
+
+#include <gst/gst.h>
+#include <math.h>
+#include <string.h>
+#include <vpi/algo/ConvertImageFormat.h>
+#include <vpi/algo/HarrisCornerDetector.h>
+#include <vpi/algo/KLTFeatureTracker.h>
+#include <vpi/algo/PerspectiveWarp.h>
+#include <vpi/Array.h>
+
+#include "gst-libs/gst/vpi/gstvpi.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vpi_stabilize_debug_category);
+#define GST_CAT_DEFAULT gst_vpi_stabilize_debug_category
+
+/* Motion is estimated on the luma, which both formats have as an 8 bit
+   plane */
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, NV12 }")
+
+#define VPI_WARP_DIRECT 0
+
+#define NUM_TEMPLATES 2
+/* According to VPI requirements KLT arrays must be of 128, but a payload
+   tracks up to 64 boxes */
+#define VPI_ARRAY_CAPACITY 128
+#define MAX_TRACKED_BOXES 64
+#define KEYPOINTS_CAPACITY 8192
+#define TRACK_BOX_SIZE 32
+#define VALID_TRACKING 0
+#define NEED_TEMPLATE_UPDATE 1
+#define IDENTITY_TRANSFORM { {1, 0, 0}, {0, 1, 0}, {0, 0, 1} }
+/* One corner per cell keeps the boxes spread over the frame */
+#define GRID_COLUMNS 8
+#define GRID_ROWS 8
+
+#define HARRIS_GRADIENT_SIZE 5
+#define HARRIS_BLOCK_SIZE 5
+#define HARRIS_STRENGTH_THRESH 20
+#define HARRIS_SENSITIVITY 0.01
+#define HARRIS_MIN_NMS_DISTANCE 8
+
+#define KLT_SCALING_ITERATIONS 20
+#define KLT_NCC_THRESHOLD_UPDATE 0.8
+#define KLT_NCC_THRESHOLD_KILL 0.6
+#define KLT_NCC_THRESHOLD_STOP 1.0
+#define KLT_MAX_SCALE_CHANGE 0.2
+#define KLT_MAX_TRANSLATION_CHANGE 1.5
+
+#define HOMOGRAPHY_SAMPLE_SIZE 4
+#define HOMOGRAPHY_UNKNOWNS 8
+#define MIN_PIVOT 1e-12
+#define MIN_INLIERS 8
+#define RANSAC_ITERATIONS 128
+/* In pixels */
+#define RANSAC_THRESHOLD 2.0
+#define RANSAC_SEED 0x5eed
+
+#define MAX_SMOOTHING_WINDOW 300
+#define DEFAULT_PROP_SMOOTHING_WINDOW 30
+#define DEFAULT_PROP_INTERPOLATOR VPI_INTERP_LINEAR
+
+typedef struct _GstVpiHomography GstVpiHomography;
+struct _GstVpiHomography
+{
+  gdouble m[3][3];
+};
+
+typedef struct _GstVpiFeature GstVpiFeature;
+struct _GstVpiFeature
+{
+  gdouble x;
+  gdouble y;
+  gdouble next_x;
+  gdouble next_y;
+};
+
+struct _GstVpiStabilize
+{
+  GstVpiFilter parent;
+  VPIPayload warp;
+  VPIPayload harris;
+  VPIPayload klt;
+  VPIArray keypoints;
+  VPIArray scores;
+  /* Boxes around the corners of the previous frame, tracked into the
+     current one */
+  VPIKLTTrackedBoundingBox input_boxes[VPI_ARRAY_CAPACITY];
+  VPIHomographyTransform2D input_transforms[VPI_ARRAY_CAPACITY];
+  VPIArray input_box_array;
+  VPIArray input_transform_array;
+  VPIArray output_box_array;
+  VPIArray output_transform_array;
+  guint num_boxes;
+  /* The previous luma is owned so no upstream buffer is held between
+     frames. One is read by KLT while the current luma is copied into the
+     other */
+  VPIImage templates[NUM_TEMPLATES];
+  guint template_index;
+  gboolean template_valid;
+  VPIHarrisCornerDetectorParams harris_params;
+  VPIKLTFeatureTrackerParams klt_params;
+  GArray *features;
+  GRand *rand;
+  GstVideoFormat format;
+  gint width;
+  gint height;
+
+  /* Camera trajectory, as the transform from the first frame */
+  GstVpiHomography trajectory;
+  GstVpiHomography history[MAX_SMOOTHING_WINDOW];
+  guint history_index;
+  guint history_len;
+
+  guint smoothing_window;
+  gint interpolator;
+};
+
+/* prototypes */
+static gboolean gst_vpi_stabilize_start (GstVpiFilter * filter,
+    GstVideoInfo * in_info, GstVideoInfo * out_info);
+static GstFlowReturn gst_vpi_stabilize_transform_image (GstVpiFilter *
+    filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
+static gboolean gst_vpi_stabilize_stop (GstBaseTransform * trans);
+static void gst_vpi_stabilize_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vpi_stabilize_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vpi_stabilize_finalize (GObject * object);
+
+enum
+{
+  PROP_0,
+  PROP_SMOOTHING_WINDOW,
+  PROP_INTERPOLATOR
+};
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVpiStabilize, gst_vpi_stabilize,
+    GST_TYPE_VPI_FILTER,
+    GST_DEBUG_CATEGORY_INIT (gst_vpi_stabilize_debug_category,
+        "vpistabilize", 0, "debug category for vpistabilize element"));
+
+static void
+gst_vpi_stabilize_class_init (GstVpiStabilizeClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+  GstVpiFilterClass *vpi_filter_class = GST_VPI_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_AND_VPIIMAGE_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_AND_VPIIMAGE_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "VPI Stabilize", "Filter/Effect/Video",
+      "VPI based video stabilizer. Tracks Harris corners between frames "
+      "with KLT, estimates the camera motion as a homography and warps each "
+      "frame towards a smoothed trajectory.",
+      "Jimena Salas <jimena.salas@ridgerun.com>");
+
+  vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_stabilize_start);
+  vpi_filter_class->transform_image =
+      GST_DEBUG_FUNCPTR (gst_vpi_stabilize_transform_image);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_stabilize_stop);
+  gobject_class->set_property = gst_vpi_stabilize_set_property;
+  gobject_class->get_property = gst_vpi_stabilize_get_property;
+  gobject_class->finalize = gst_vpi_stabilize_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_SMOOTHING_WINDOW,
+      g_param_spec_uint ("smoothing-window", "Smoothing window",
+          "Number of past frames the camera trajectory is averaged over. "
+          "Larger windows remove slower motion. Only past frames are used, "
+          "so no latency is added.",
+          1, MAX_SMOOTHING_WINDOW, DEFAULT_PROP_SMOOTHING_WINDOW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_INTERPOLATOR,
+      g_param_spec_enum ("interpolator", "Interpolation method",
+          "Interpolation method to be used.",
+          VPI_INTERPOLATORS_ENUM, DEFAULT_PROP_INTERPOLATOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+}
+
+static void
+gst_vpi_stabilize_set_identity (GstVpiHomography * h)
+{
+  GstVpiHomography identity = { IDENTITY_TRANSFORM };
+
+  g_return_if_fail (h);
+
+  *h = identity;
+}
+
+static void
+gst_vpi_stabilize_reset_trajectory (GstVpiStabilize * self)
+{
+  g_return_if_fail (self);
+
+  gst_vpi_stabilize_set_identity (&self->trajectory);
+  self->history_index = 0;
+  self->history_len = 0;
+  self->template_valid = FALSE;
+  self->num_boxes = 0;
+}
+
+static void
+gst_vpi_stabilize_init (GstVpiStabilize * self)
+{
+  guint i = 0;
+
+  self->warp = NULL;
+  self->harris = NULL;
+  self->klt = NULL;
+  self->keypoints = NULL;
+  self->scores = NULL;
+  self->input_box_array = NULL;
+  self->input_transform_array = NULL;
+  self->output_box_array = NULL;
+  self->output_transform_array = NULL;
+  for (i = 0; i < NUM_TEMPLATES; i++) {
+    self->templates[i] = NULL;
+  }
+  self->template_index = 0;
+
+  self->harris_params.gradientSize = HARRIS_GRADIENT_SIZE;
+  self->harris_params.blockSize = HARRIS_BLOCK_SIZE;
+  self->harris_params.strengthThresh = HARRIS_STRENGTH_THRESH;
+  self->harris_params.sensitivity = HARRIS_SENSITIVITY;
+  self->harris_params.minNMSDistance = HARRIS_MIN_NMS_DISTANCE;
+
+  self->klt_params.numberOfIterationsScaling = KLT_SCALING_ITERATIONS;
+  self->klt_params.nccThresholdUpdate = KLT_NCC_THRESHOLD_UPDATE;
+  self->klt_params.nccThresholdKill = KLT_NCC_THRESHOLD_KILL;
+  self->klt_params.nccThresholdStop = KLT_NCC_THRESHOLD_STOP;
+  self->klt_params.maxScaleChange = KLT_MAX_SCALE_CHANGE;
+  self->klt_params.maxTranslationChange = KLT_MAX_TRANSLATION_CHANGE;
+  self->klt_params.trackingType = VPI_KLT_INVERSE_COMPOSITIONAL;
+
+  self->features = g_array_new (FALSE, FALSE, sizeof (GstVpiFeature));
+  self->rand = g_rand_new_with_seed (RANSAC_SEED);
+  self->format = GST_VIDEO_FORMAT_UNKNOWN;
+  self->width = 0;
+  self->height = 0;
+  self->smoothing_window = DEFAULT_PROP_SMOOTHING_WINDOW;
+  self->interpolator = DEFAULT_PROP_INTERPOLATOR;
+
+  gst_vpi_stabilize_reset_trajectory (self);
+}
+
+static void
+gst_vpi_stabilize_free_resources (GstVpiStabilize * self)
+{
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  vpiPayloadDestroy (self->warp);
+  self->warp = NULL;
+  vpiPayloadDestroy (self->harris);
+  self->harris = NULL;
+  vpiPayloadDestroy (self->klt);
+  self->klt = NULL;
+
+  vpiArrayDestroy (self->keypoints);
+  self->keypoints = NULL;
+  vpiArrayDestroy (self->scores);
+  self->scores = NULL;
+  vpiArrayDestroy (self->input_box_array);
+  self->input_box_array = NULL;
+  vpiArrayDestroy (self->input_transform_array);
+  self->input_transform_array = NULL;
+  vpiArrayDestroy (self->output_box_array);
+  self->output_box_array = NULL;
+  vpiArrayDestroy (self->output_transform_array);
+  self->output_transform_array = NULL;
+
+  for (i = 0; i < NUM_TEMPLATES; i++) {
+    vpiImageDestroy (self->templates[i]);
+    self->templates[i] = NULL;
+  }
+}
+
+static VPIStatus
+gst_vpi_stabilize_wrap_array (void *data, VPIArrayType type, VPIArray * array)
+{
+  VPIArrayData array_data = { 0 };
+
+  g_return_val_if_fail (data, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (array, VPI_ERROR_INVALID_ARGUMENT);
+
+  array_data.type = type;
+  array_data.capacity = VPI_ARRAY_CAPACITY;
+  array_data.size = 0;
+  array_data.data = data;
+
+  return vpiArrayCreateHostMemWrapper (&array_data, VPI_BACKEND_ALL, array);
+}
+
+/* No error is posted here, the caller reports the failure */
+static VPIStatus
+gst_vpi_stabilize_create_arrays (GstVpiStabilize * self)
+{
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+
+  status = vpiArrayCreate (KEYPOINTS_CAPACITY, VPI_ARRAY_TYPE_KEYPOINT,
+      VPI_BACKEND_ALL, &self->keypoints);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiArrayCreate (KEYPOINTS_CAPACITY, VPI_ARRAY_TYPE_U32,
+      VPI_BACKEND_ALL, &self->scores);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiArrayCreate (VPI_ARRAY_CAPACITY,
+      VPI_ARRAY_TYPE_KLT_TRACKED_BOUNDING_BOX, VPI_BACKEND_ALL,
+      &self->output_box_array);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = vpiArrayCreate (VPI_ARRAY_CAPACITY,
+      VPI_ARRAY_TYPE_HOMOGRAPHY_TRANSFORM_2D, VPI_BACKEND_ALL,
+      &self->output_transform_array);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = gst_vpi_stabilize_wrap_array (self->input_boxes,
+      VPI_ARRAY_TYPE_KLT_TRACKED_BOUNDING_BOX, &self->input_box_array);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  status = gst_vpi_stabilize_wrap_array (self->input_transforms,
+      VPI_ARRAY_TYPE_HOMOGRAPHY_TRANSFORM_2D, &self->input_transform_array);
+
+out:
+  return status;
+}
+
+static gboolean
+gst_vpi_stabilize_start (GstVpiFilter * filter, GstVideoInfo * in_info,
+    GstVideoInfo * out_info)
+{
+  GstVpiStabilize *self = NULL;
+  gboolean ret = TRUE;
+  VPIStatus status = VPI_SUCCESS;
+  gint backend = 0;
+  guint i = 0;
+
+  g_return_val_if_fail (filter, FALSE);
+  g_return_val_if_fail (in_info, FALSE);
+  g_return_val_if_fail (out_info, FALSE);
+
+  self = GST_VPI_STABILIZE (filter);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  /* Start may be called again on caps changes */
+  gst_vpi_stabilize_free_resources (self);
+  gst_vpi_stabilize_reset_trajectory (self);
+
+  backend = gst_vpi_filter_get_backend (filter);
+  self->format = GST_VIDEO_INFO_FORMAT (in_info);
+  self->width = GST_VIDEO_INFO_WIDTH (in_info);
+  self->height = GST_VIDEO_INFO_HEIGHT (in_info);
+
+  for (i = 0; i < NUM_TEMPLATES && VPI_SUCCESS == status; i++) {
+    status = vpiImageCreate (self->width, self->height, VPI_IMAGE_FORMAT_U8,
+        VPI_BACKEND_ALL, &self->templates[i]);
+  }
+
+  if (VPI_SUCCESS == status) {
+    status = gst_vpi_stabilize_create_arrays (self);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Could not create buffers for motion estimation."),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+    goto free_resources;
+  }
+
+  status = vpiCreateHarrisCornerDetector (backend, self->width, self->height,
+      &self->harris);
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create Harris corner detector"),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+    goto free_resources;
+  }
+
+  status = vpiCreateKLTFeatureTracker (backend, self->width, self->height,
+      VPI_IMAGE_FORMAT_U8, &self->klt);
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create KLT tracker payload"),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+    goto free_resources;
+  }
+
+  status = vpiCreatePerspectiveWarp (backend, &self->warp);
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create perspective warp payload"),
+        ("%s", vpiStatusGetName (status)));
+    ret = FALSE;
+    goto free_resources;
+  }
+
+  goto out;
+
+free_resources:
+  gst_vpi_stabilize_free_resources (self);
+
+out:
+  return ret;
+}
+
+/* Places a box around the strongest corner of each grid cell, so the next
+   frame tracks them from this one. Corners too close to the border to fit
+   a box are skipped */
+static void
+gst_vpi_stabilize_seed_boxes (GstVpiStabilize * self)
+{
+  VPIArrayData keypoint_data = { 0 };
+  VPIArrayData score_data = { 0 };
+  VPIKeypoint *keypoints = NULL;
+  guint32 *scores = NULL;
+  VPIKeypoint best[GRID_COLUMNS * GRID_ROWS] = { {0} };
+  guint32 best_scores[GRID_COLUMNS * GRID_ROWS] = { 0 };
+  VPIHomographyTransform2D identity = { IDENTITY_TRANSFORM };
+  VPIKLTTrackedBoundingBox *box = NULL;
+  gfloat half = TRACK_BOX_SIZE / 2.0;
+  guint cell = 0;
+  guint col = 0, row = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  vpiArrayLock (self->keypoints, VPI_LOCK_READ, &keypoint_data);
+  vpiArrayLock (self->scores, VPI_LOCK_READ, &score_data);
+  keypoints = (VPIKeypoint *) keypoint_data.data;
+  scores = (guint32 *) score_data.data;
+
+  for (i = 0; i < (guint) keypoint_data.size; i++) {
+    if (keypoints[i].x < half || keypoints[i].y < half
+        || keypoints[i].x + half > self->width
+        || keypoints[i].y + half > self->height) {
+      continue;
+    }
+
+    col = MIN (keypoints[i].x * GRID_COLUMNS / self->width, GRID_COLUMNS - 1);
+    row = MIN (keypoints[i].y * GRID_ROWS / self->height, GRID_ROWS - 1);
+    cell = row * GRID_COLUMNS + col;
+    if (scores[i] > best_scores[cell]) {
+      best_scores[cell] = scores[i];
+      best[cell] = keypoints[i];
+    }
+  }
+
+  vpiArrayUnlock (self->scores);
+  vpiArrayUnlock (self->keypoints);
+
+  self->num_boxes = 0;
+  for (cell = 0; cell < GRID_COLUMNS * GRID_ROWS; cell++) {
+    if (0 == best_scores[cell]) {
+      continue;
+    }
+
+    box = &self->input_boxes[self->num_boxes];
+    memcpy (&box->bbox.xform.mat3, &identity.mat3, sizeof (identity.mat3));
+    box->bbox.xform.mat3[0][2] = best[cell].x - half;
+    box->bbox.xform.mat3[1][2] = best[cell].y - half;
+    box->bbox.width = TRACK_BOX_SIZE;
+    box->bbox.height = TRACK_BOX_SIZE;
+    box->trackingStatus = VALID_TRACKING;
+    box->templateStatus = NEED_TEMPLATE_UPDATE;
+    self->input_transforms[self->num_boxes] = identity;
+    self->num_boxes++;
+  }
+
+  vpiArrayLock (self->input_box_array, VPI_LOCK_READ_WRITE, NULL);
+  vpiArraySetSize (self->input_box_array, self->num_boxes);
+  vpiArrayUnlock (self->input_box_array);
+  vpiArrayLock (self->input_transform_array, VPI_LOCK_READ_WRITE, NULL);
+  vpiArraySetSize (self->input_transform_array, self->num_boxes);
+  vpiArrayUnlock (self->input_transform_array);
+
+  /* Wrapped memory has been modified */
+  vpiArrayInvalidate (self->input_box_array);
+  vpiArrayInvalidate (self->input_transform_array);
+}
+
+/* Pairs the center of every box that KLT kept tracking with its center in
+   the current frame */
+static void
+gst_vpi_stabilize_collect_features (GstVpiStabilize * self)
+{
+  VPIArrayData box_data = { 0 };
+  VPIArrayData transform_data = { 0 };
+  VPIKLTTrackedBoundingBox *boxes = NULL;
+  VPIHomographyTransform2D *transforms = NULL;
+  VPIKLTTrackedBoundingBox *box = NULL;
+  GstVpiFeature feature = { 0 };
+  gdouble cx = 0, cy = 0;
+  gdouble tx = 0, ty = 0, tw = 0;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  g_array_set_size (self->features, 0);
+
+  vpiArrayLock (self->output_box_array, VPI_LOCK_READ, &box_data);
+  vpiArrayLock (self->output_transform_array, VPI_LOCK_READ,
+      &transform_data);
+  boxes = (VPIKLTTrackedBoundingBox *) box_data.data;
+  transforms = (VPIHomographyTransform2D *) transform_data.data;
+
+  for (i = 0; i < self->num_boxes; i++) {
+    if (VALID_TRACKING != boxes[i].trackingStatus) {
+      continue;
+    }
+
+    box = &self->input_boxes[i];
+    cx = box->bbox.width / 2.0;
+    cy = box->bbox.height / 2.0;
+
+    /* The estimated transform maps the box from the template into the
+       current frame */
+    tx = transforms[i].mat3[0][0] * cx + transforms[i].mat3[0][1] * cy +
+        transforms[i].mat3[0][2];
+    ty = transforms[i].mat3[1][0] * cx + transforms[i].mat3[1][1] * cy +
+        transforms[i].mat3[1][2];
+    tw = transforms[i].mat3[2][0] * cx + transforms[i].mat3[2][1] * cy +
+        transforms[i].mat3[2][2];
+    if (0 == tw) {
+      continue;
+    }
+
+    feature.x = box->bbox.xform.mat3[0][2] + cx;
+    feature.y = box->bbox.xform.mat3[1][2] + cy;
+    feature.next_x = box->bbox.xform.mat3[0][2] + tx / tw;
+    feature.next_y = box->bbox.xform.mat3[1][2] + ty / tw;
+    g_array_append_val (self->features, feature);
+  }
+
+  vpiArrayUnlock (self->output_transform_array);
+  vpiArrayUnlock (self->output_box_array);
+}
+
+static gboolean
+gst_vpi_stabilize_project (const GstVpiHomography * h, gdouble x, gdouble y,
+    gdouble * u, gdouble * v)
+{
+  gdouble w = h->m[2][0] * x + h->m[2][1] * y + h->m[2][2];
+
+  if (fabs (w) < MIN_PIVOT) {
+    return FALSE;
+  }
+
+  *u = (h->m[0][0] * x + h->m[0][1] * y + h->m[0][2]) / w;
+  *v = (h->m[1][0] * x + h->m[1][1] * y + h->m[1][2]) / w;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vpi_stabilize_is_inlier (const GstVpiHomography * motion,
+    const GstVpiFeature * feature)
+{
+  gdouble u = 0, v = 0;
+  gdouble dx = 0, dy = 0;
+
+  if (!gst_vpi_stabilize_project (motion, feature->x, feature->y, &u, &v)) {
+    return FALSE;
+  }
+
+  dx = u - feature->next_x;
+  dy = v - feature->next_y;
+
+  return dx * dx + dy * dy < RANSAC_THRESHOLD * RANSAC_THRESHOLD;
+}
+
+/* Gaussian elimination with partial pivoting, a and b are overwritten */
+static gboolean
+gst_vpi_stabilize_solve (gdouble a[HOMOGRAPHY_UNKNOWNS][HOMOGRAPHY_UNKNOWNS],
+    gdouble b[HOMOGRAPHY_UNKNOWNS], gdouble x[HOMOGRAPHY_UNKNOWNS])
+{
+  gdouble tmp = 0;
+  gdouble factor = 0;
+  guint pivot = 0;
+  guint i = 0, j = 0, k = 0;
+
+  for (i = 0; i < HOMOGRAPHY_UNKNOWNS; i++) {
+    pivot = i;
+    for (j = i + 1; j < HOMOGRAPHY_UNKNOWNS; j++) {
+      if (fabs (a[j][i]) > fabs (a[pivot][i])) {
+        pivot = j;
+      }
+    }
+
+    if (fabs (a[pivot][i]) < MIN_PIVOT) {
+      return FALSE;
+    }
+
+    for (k = 0; k < HOMOGRAPHY_UNKNOWNS; k++) {
+      tmp = a[i][k];
+      a[i][k] = a[pivot][k];
+      a[pivot][k] = tmp;
+    }
+    tmp = b[i];
+    b[i] = b[pivot];
+    b[pivot] = tmp;
+
+    for (j = i + 1; j < HOMOGRAPHY_UNKNOWNS; j++) {
+      factor = a[j][i] / a[i][i];
+      for (k = i; k < HOMOGRAPHY_UNKNOWNS; k++) {
+        a[j][k] -= factor * a[i][k];
+      }
+      b[j] -= factor * b[i];
+    }
+  }
+
+  for (i = HOMOGRAPHY_UNKNOWNS; i-- > 0;) {
+    x[i] = b[i];
+    for (k = i + 1; k < HOMOGRAPHY_UNKNOWNS; k++) {
+      x[i] -= a[i][k] * x[k];
+    }
+    x[i] /= a[i][i];
+  }
+
+  return TRUE;
+}
+
+/* Applies first then second */
+static GstVpiHomography
+gst_vpi_stabilize_compose (const GstVpiHomography * first,
+    const GstVpiHomography * second)
+{
+  GstVpiHomography result = { {{0}} };
+  guint i = 0, j = 0, k = 0;
+
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 3; j++) {
+      for (k = 0; k < 3; k++) {
+        result.m[i][j] += second->m[i][k] * first->m[k][j];
+      }
+    }
+  }
+
+  /* Keep the scale fixed so trajectories can be averaged */
+  if (fabs (result.m[2][2]) > MIN_PIVOT) {
+    for (i = 0; i < 3; i++) {
+      for (j = 0; j < 3; j++) {
+        result.m[i][j] /= result.m[2][2];
+      }
+    }
+  }
+
+  return result;
+}
+
+static GstVpiHomography
+gst_vpi_stabilize_invert (const GstVpiHomography * h)
+{
+  GstVpiHomography result = { {{0}} };
+  gdouble det = 0;
+  guint i = 0, j = 0;
+
+  result.m[0][0] = h->m[1][1] * h->m[2][2] - h->m[1][2] * h->m[2][1];
+  result.m[0][1] = h->m[0][2] * h->m[2][1] - h->m[0][1] * h->m[2][2];
+  result.m[0][2] = h->m[0][1] * h->m[1][2] - h->m[0][2] * h->m[1][1];
+  result.m[1][0] = h->m[1][2] * h->m[2][0] - h->m[1][0] * h->m[2][2];
+  result.m[1][1] = h->m[0][0] * h->m[2][2] - h->m[0][2] * h->m[2][0];
+  result.m[1][2] = h->m[0][2] * h->m[1][0] - h->m[0][0] * h->m[1][2];
+  result.m[2][0] = h->m[1][0] * h->m[2][1] - h->m[1][1] * h->m[2][0];
+  result.m[2][1] = h->m[0][1] * h->m[2][0] - h->m[0][0] * h->m[2][1];
+  result.m[2][2] = h->m[0][0] * h->m[1][1] - h->m[0][1] * h->m[1][0];
+
+  det = h->m[0][0] * result.m[0][0] + h->m[0][1] * result.m[1][0] +
+      h->m[0][2] * result.m[2][0];
+  if (fabs (det) < MIN_PIVOT) {
+    gst_vpi_stabilize_set_identity (&result);
+    goto out;
+  }
+
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 3; j++) {
+      result.m[i][j] /= det;
+    }
+  }
+
+out:
+  return result;
+}
+
+/* Translates the centroid to the origin and scales the mean distance to
+   sqrt(2), which keeps the normal equations well conditioned */
+static void
+gst_vpi_stabilize_normalize_points (GArray * features, const gboolean * mask,
+    gboolean next, GstVpiHomography * transform)
+{
+  GstVpiFeature *f = NULL;
+  gdouble mean_x = 0, mean_y = 0;
+  gdouble distance = 0;
+  gdouble x = 0, y = 0;
+  gdouble scale = 1;
+  guint count = 0;
+  guint i = 0;
+
+  for (i = 0; i < features->len; i++) {
+    if (mask[i]) {
+      f = &g_array_index (features, GstVpiFeature, i);
+      mean_x += next ? f->next_x : f->x;
+      mean_y += next ? f->next_y : f->y;
+      count++;
+    }
+  }
+  mean_x /= count;
+  mean_y /= count;
+
+  for (i = 0; i < features->len; i++) {
+    if (mask[i]) {
+      f = &g_array_index (features, GstVpiFeature, i);
+      x = (next ? f->next_x : f->x) - mean_x;
+      y = (next ? f->next_y : f->y) - mean_y;
+      distance += sqrt (x * x + y * y);
+    }
+  }
+  distance /= count;
+
+  if (distance > MIN_PIVOT) {
+    scale = G_SQRT2 / distance;
+  }
+
+  gst_vpi_stabilize_set_identity (transform);
+  transform->m[0][0] = scale;
+  transform->m[1][1] = scale;
+  transform->m[0][2] = -scale * mean_x;
+  transform->m[1][2] = -scale * mean_y;
+}
+
+/* Least squares homography with h33 fixed to one over the features marked
+   in the mask. Four features give the exact solution */
+static gboolean
+gst_vpi_stabilize_fit_homography (GArray * features, const gboolean * mask,
+    GstVpiHomography * motion)
+{
+  GstVpiHomography from = { {{0}} };
+  GstVpiHomography to = { {{0}} };
+  GstVpiHomography normalized = { {{0}} };
+  GstVpiHomography to_inverse = { {{0}} };
+  GstVpiHomography result = { {{0}} };
+  GstVpiFeature *f = NULL;
+  gdouble ata[HOMOGRAPHY_UNKNOWNS][HOMOGRAPHY_UNKNOWNS] = { {0} };
+  gdouble atb[HOMOGRAPHY_UNKNOWNS] = { 0 };
+  gdouble h[HOMOGRAPHY_UNKNOWNS] = { 0 };
+  gdouble rows[2][HOMOGRAPHY_UNKNOWNS] = { {0} };
+  gdouble targets[2] = { 0 };
+  gdouble x = 0, y = 0, u = 0, v = 0;
+  guint count = 0;
+  guint i = 0, r = 0, j = 0, k = 0;
+
+  for (i = 0; i < features->len; i++) {
+    count += mask[i];
+  }
+
+  if (count < HOMOGRAPHY_SAMPLE_SIZE) {
+    return FALSE;
+  }
+
+  gst_vpi_stabilize_normalize_points (features, mask, FALSE, &from);
+  gst_vpi_stabilize_normalize_points (features, mask, TRUE, &to);
+
+  for (i = 0; i < features->len; i++) {
+    if (!mask[i]) {
+      continue;
+    }
+
+    f = &g_array_index (features, GstVpiFeature, i);
+    gst_vpi_stabilize_project (&from, f->x, f->y, &x, &y);
+    gst_vpi_stabilize_project (&to, f->next_x, f->next_y, &u, &v);
+
+    /* u = (h0 x + h1 y + h2) / (h6 x + h7 y + 1), same for v */
+    rows[0][0] = x;
+    rows[0][1] = y;
+    rows[0][2] = 1;
+    rows[0][3] = rows[0][4] = rows[0][5] = 0;
+    rows[0][6] = -x * u;
+    rows[0][7] = -y * u;
+    targets[0] = u;
+    rows[1][0] = rows[1][1] = rows[1][2] = 0;
+    rows[1][3] = x;
+    rows[1][4] = y;
+    rows[1][5] = 1;
+    rows[1][6] = -x * v;
+    rows[1][7] = -y * v;
+    targets[1] = v;
+
+    for (r = 0; r < 2; r++) {
+      for (j = 0; j < HOMOGRAPHY_UNKNOWNS; j++) {
+        for (k = 0; k < HOMOGRAPHY_UNKNOWNS; k++) {
+          ata[j][k] += rows[r][j] * rows[r][k];
+        }
+        atb[j] += rows[r][j] * targets[r];
+      }
+    }
+  }
+
+  if (!gst_vpi_stabilize_solve (ata, atb, h)) {
+    return FALSE;
+  }
+
+  normalized.m[0][0] = h[0];
+  normalized.m[0][1] = h[1];
+  normalized.m[0][2] = h[2];
+  normalized.m[1][0] = h[3];
+  normalized.m[1][1] = h[4];
+  normalized.m[1][2] = h[5];
+  normalized.m[2][0] = h[6];
+  normalized.m[2][1] = h[7];
+  normalized.m[2][2] = 1;
+
+  /* Undo the normalization: to^-1 * normalized * from */
+  to_inverse = gst_vpi_stabilize_invert (&to);
+  result = gst_vpi_stabilize_compose (&from, &normalized);
+  *motion = gst_vpi_stabilize_compose (&result, &to_inverse);
+
+  return TRUE;
+}
+
+/* RANSAC over four feature samples, refined with every inlier of the best
+   hypothesis so independently moving objects don't pull the estimate */
+static gboolean
+gst_vpi_stabilize_estimate_motion (GstVpiStabilize * self,
+    GstVpiHomography * motion)
+{
+  GstVpiHomography candidate = { {{0}} };
+  GArray *features = NULL;
+  gboolean *mask = NULL;
+  guint sample[HOMOGRAPHY_SAMPLE_SIZE] = { 0 };
+  guint best_inliers = 0;
+  guint inliers = 0;
+  gboolean ret = FALSE;
+  gboolean repeated = FALSE;
+  guint i = 0, j = 0, k = 0;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (motion, FALSE);
+
+  features = self->features;
+  if (features->len < MIN_INLIERS) {
+    goto out;
+  }
+
+  mask = g_new0 (gboolean, features->len);
+
+  for (i = 0; i < RANSAC_ITERATIONS; i++) {
+    memset (mask, 0, features->len * sizeof (gboolean));
+    repeated = FALSE;
+    for (j = 0; j < HOMOGRAPHY_SAMPLE_SIZE; j++) {
+      sample[j] = g_rand_int_range (self->rand, 0, features->len);
+      repeated |= mask[sample[j]];
+      mask[sample[j]] = TRUE;
+    }
+
+    if (repeated
+        || !gst_vpi_stabilize_fit_homography (features, mask, &candidate)) {
+      continue;
+    }
+
+    inliers = 0;
+    for (k = 0; k < features->len; k++) {
+      inliers += gst_vpi_stabilize_is_inlier (&candidate,
+          &g_array_index (features, GstVpiFeature, k));
+    }
+
+    if (inliers > best_inliers) {
+      best_inliers = inliers;
+      *motion = candidate;
+    }
+  }
+
+  if (best_inliers < MIN_INLIERS) {
+    goto out;
+  }
+
+  candidate = *motion;
+  for (k = 0; k < features->len; k++) {
+    mask[k] = gst_vpi_stabilize_is_inlier (&candidate,
+        &g_array_index (features, GstVpiFeature, k));
+  }
+  ret = gst_vpi_stabilize_fit_homography (features, mask, motion);
+
+  GST_LOG_OBJECT (self, "Motion from %u of %u features: "
+      "[%f %f %f; %f %f %f; %f %f %f]", best_inliers, features->len,
+      motion->m[0][0], motion->m[0][1], motion->m[0][2], motion->m[1][0],
+      motion->m[1][1], motion->m[1][2], motion->m[2][0], motion->m[2][1],
+      motion->m[2][2]);
+
+out:
+  g_free (mask);
+  return ret;
+}
+
+/* Adds the frame motion to the trajectory and returns the correction that
+   moves the frame onto the averaged trajectory */
+static void
+gst_vpi_stabilize_update_trajectory (GstVpiStabilize * self,
+    const GstVpiHomography * motion, guint window,
+    VPIPerspectiveTransform correction)
+{
+  GstVpiHomography smoothed = { {{0}} };
+  GstVpiHomography inverse = { {{0}} };
+  GstVpiHomography result = { {{0}} };
+  guint count = 0;
+  guint index = 0;
+  guint i = 0, j = 0, k = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (motion);
+
+  self->trajectory = gst_vpi_stabilize_compose (&self->trajectory, motion);
+
+  self->history[self->history_index] = self->trajectory;
+  self->history_index = (self->history_index + 1) % MAX_SMOOTHING_WINDOW;
+  self->history_len = MIN (self->history_len + 1, MAX_SMOOTHING_WINDOW);
+
+  /* Trajectories are normalized to h33 = 1, so they are averaged element
+     wise */
+  count = MIN (window, self->history_len);
+  for (i = 0; i < count; i++) {
+    index = (self->history_index + MAX_SMOOTHING_WINDOW - 1 - i) %
+        MAX_SMOOTHING_WINDOW;
+    for (j = 0; j < 3; j++) {
+      for (k = 0; k < 3; k++) {
+        smoothed.m[j][k] += self->history[index].m[j][k] / count;
+      }
+    }
+  }
+
+  inverse = gst_vpi_stabilize_invert (&self->trajectory);
+  result = gst_vpi_stabilize_compose (&inverse, &smoothed);
+
+  for (j = 0; j < 3; j++) {
+    for (k = 0; k < 3; k++) {
+      correction[j][k] = result.m[j][k];
+    }
+  }
+}
+
+/* Tracks the boxes of the previous frame into the current luma, detects
+   the corners to track into the next frame and keeps the luma as the next
+   template. Everything runs on the stream */
+static VPIStatus
+gst_vpi_stabilize_submit_tracking (GstVpiStabilize * self, VPIStream stream,
+    VPIImage luma, gboolean track)
+{
+  VPIHarrisCornerDetectorParams harris_params = { 0 };
+  VPIKLTFeatureTrackerParams klt_params = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  guint next = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (luma, VPI_ERROR_INVALID_ARGUMENT);
+
+  harris_params = self->harris_params;
+  klt_params = self->klt_params;
+  next = (self->template_index + 1) % NUM_TEMPLATES;
+
+  if (track) {
+    status = vpiSubmitKLTFeatureTracker (stream, self->klt,
+        self->templates[self->template_index], self->input_box_array,
+        self->input_transform_array, luma, self->output_box_array,
+        self->output_transform_array, &klt_params);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+  }
+
+  status = vpiSubmitHarrisCornerDetector (stream, self->harris, luma,
+      self->keypoints, self->scores, &harris_params);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  /* Same format conversion is a plain copy executed on the stream */
+  status = vpiSubmitConvertImageFormat (stream,
+      gst_vpi_filter_get_backend (GST_VPI_FILTER (self)), luma,
+      self->templates[next], VPI_CONVERSION_CAST, 1, 0);
+
+out:
+  return status;
+}
+
+static GstFlowReturn
+gst_vpi_stabilize_transform_image (GstVpiFilter * filter, VPIStream stream,
+    VpiFrame * in_frame, VpiFrame * out_frame)
+{
+  GstVpiStabilize *self = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  VPIStatus status = VPI_SUCCESS;
+  VPIImage luma = NULL;
+  GstVpiHomography motion = { IDENTITY_TRANSFORM };
+  VPIPerspectiveTransform correction = { {0} };
+  gboolean track = FALSE;
+  guint window = DEFAULT_PROP_SMOOTHING_WINDOW;
+  gint interpolator = DEFAULT_PROP_INTERPOLATOR;
+
+  g_return_val_if_fail (filter, GST_FLOW_ERROR);
+  g_return_val_if_fail (stream, GST_FLOW_ERROR);
+  g_return_val_if_fail (in_frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (in_frame->image, GST_FLOW_ERROR);
+  g_return_val_if_fail (out_frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (out_frame->image, GST_FLOW_ERROR);
+
+  self = GST_VPI_STABILIZE (filter);
+
+  GST_LOG_OBJECT (self, "Transform image");
+
+  GST_OBJECT_LOCK (self);
+  window = self->smoothing_window;
+  interpolator = self->interpolator;
+  GST_OBJECT_UNLOCK (self);
+
+  luma = in_frame->image;
+  if (GST_VIDEO_FORMAT_NV12 == self->format) {
+    status = gst_vpi_frame_get_plane_view (in_frame, 0, VPI_IMAGE_FORMAT_U8,
+        &luma);
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not get the luma plane."), ("%s",
+              vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+  }
+
+  track = self->template_valid && self->num_boxes > 0;
+  status = gst_vpi_stabilize_submit_tracking (self, stream, luma, track);
+
+  /* The warp below depends on the motion of this very frame, so this is
+     the one point where the results are read back */
+  vpiStreamSync (stream);
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not track features for motion estimation."),
+        ("%s", vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  /* Without a reliable estimate the camera is assumed to be still */
+  if (track) {
+    gst_vpi_stabilize_collect_features (self);
+    if (!gst_vpi_stabilize_estimate_motion (self, &motion)) {
+      GST_DEBUG_OBJECT (self, "Could not estimate motion, %u features tracked",
+          self->features->len);
+      gst_vpi_stabilize_set_identity (&motion);
+    }
+  }
+
+  gst_vpi_stabilize_seed_boxes (self);
+  self->template_index = (self->template_index + 1) % NUM_TEMPLATES;
+  self->template_valid = TRUE;
+
+  gst_vpi_stabilize_update_trajectory (self, &motion, window, correction);
+
+  status = vpiSubmitPerspectiveWarp (stream, self->warp, in_frame->image,
+      correction, out_frame->image, interpolator, VPI_BOUNDARY_COND_ZERO,
+      VPI_WARP_DIRECT);
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not apply the stabilizing warp."), ("%s",
+            vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+  }
+
+out:
+  return ret;
+}
+
+void
+gst_vpi_stabilize_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVpiStabilize *self = GST_VPI_STABILIZE (object);
+
+  GST_DEBUG_OBJECT (self, "set_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_SMOOTHING_WINDOW:
+      self->smoothing_window = g_value_get_uint (value);
+      break;
+    case PROP_INTERPOLATOR:
+      self->interpolator = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+void
+gst_vpi_stabilize_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVpiStabilize *self = GST_VPI_STABILIZE (object);
+
+  GST_DEBUG_OBJECT (self, "get_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_SMOOTHING_WINDOW:
+      g_value_set_uint (value, self->smoothing_window);
+      break;
+    case PROP_INTERPOLATOR:
+      g_value_set_enum (value, self->interpolator);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+gst_vpi_stabilize_stop (GstBaseTransform * trans)
+{
+  GstVpiStabilize *self = GST_VPI_STABILIZE (trans);
+  gboolean ret = TRUE;
+
+  GST_BASE_TRANSFORM_CLASS (gst_vpi_stabilize_parent_class)->stop (trans);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  gst_vpi_stabilize_free_resources (self);
+  gst_vpi_stabilize_reset_trajectory (self);
+
+  return ret;
+}
+
+void
+gst_vpi_stabilize_finalize (GObject * object)
+{
+  GstVpiStabilize *self = GST_VPI_STABILIZE (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_array_free (self->features, TRUE);
+  self->features = NULL;
+  g_rand_free (self->rand);
+  self->rand = NULL;
+
+  G_OBJECT_CLASS (gst_vpi_stabilize_parent_class)->finalize (object);
+}
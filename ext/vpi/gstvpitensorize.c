@@ -0,0 +1,788 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvpitensorize.h"
+
+#include <cuda_runtime.h>
+#include <gst/video/video.h>
+#include <string.h>
+#include <vpi/algo/ConvertImageFormat.h>
+#include <vpi/algo/Rescale.h>
+#include <vpi/Stream.h>
+
+#include "gst-libs/gst/vpi/gstvpi.h"
+#include "gst-libs/gst/vpi/gstvpimeta.h"
+#include "gst-libs/gst/vpi/gstvpitensormeta.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vpi_tensorize_debug_category);
+#define GST_CAT_DEFAULT gst_vpi_tensorize_debug_category
+
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }")
+
+#define TENSOR_MEDIA_TYPE "application/x-vpi-tensor"
+#define TENSOR_CAPS TENSOR_MEDIA_TYPE ", "                                  \
+    "type = (string) { float32, float16 }, "                                \
+    "layout = (string) NCHW, "                                              \
+    "channels = (int) 3, "                                                  \
+    "width = " GST_VIDEO_SIZE_RANGE ", "                                    \
+    "height = " GST_VIDEO_SIZE_RANGE ", "                                   \
+    "framerate = " GST_VIDEO_FPS_RANGE
+
+#define NUM_CHANNELS 3
+
+#define DEFAULT_PROP_INTERPOLATOR VPI_INTERP_LINEAR
+#define DEFAULT_PROP_BACKEND VPI_BACKEND_CUDA
+#define DEFAULT_PROP_MEAN 0.0
+#define DEFAULT_PROP_STD 1.0
+#define DEFAULT_PROP_SWAP_CHANNELS FALSE
+
+struct _GstVpiTensorize
+{
+  GstBaseTransform parent;
+
+  GstVideoInfo in_info;
+  GstVpiTensorType type;
+  gint width;
+  gint height;
+
+  VPIStream vpi_stream;
+  cudaStream_t cuda_stream;
+  VPIImage resized;
+  VPIImage rgb;
+
+  gint interpolator;
+  gint backend;
+  gdouble mean[NUM_CHANNELS];
+  gdouble std[NUM_CHANNELS];
+  gboolean swap_channels;
+};
+
+/* prototypes */
+static GstCaps *gst_vpi_tensorize_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static GstCaps *gst_vpi_tensorize_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
+static gboolean gst_vpi_tensorize_get_unit_size (GstBaseTransform * trans,
+    GstCaps * caps, gsize * size);
+static gboolean gst_vpi_tensorize_set_caps (GstBaseTransform * trans,
+    GstCaps * incaps, GstCaps * outcaps);
+static gboolean gst_vpi_tensorize_start (GstBaseTransform * trans);
+static gboolean gst_vpi_tensorize_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_vpi_tensorize_transform (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer * outbuf);
+static void gst_vpi_tensorize_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vpi_tensorize_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+
+enum
+{
+  PROP_0,
+  PROP_INTERPOLATOR,
+  PROP_BACKEND,
+  PROP_MEAN,
+  PROP_STD,
+  PROP_SWAP_CHANNELS
+};
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVpiTensorize, gst_vpi_tensorize,
+    GST_TYPE_BASE_TRANSFORM,
+    GST_DEBUG_CATEGORY_INIT (gst_vpi_tensorize_debug_category,
+        "vpitensorize", 0, "debug category for vpitensorize element"));
+
+static void
+gst_vpi_tensorize_class_init (GstVpiTensorizeClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *bt_class = GST_BASE_TRANSFORM_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (TENSOR_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (VIDEO_AND_VPIIMAGE_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "VPI Tensorize", "Filter/Converter/Video",
+      "Converts video into normalized planar float tensors using VPI",
+      "Jimena Salas <jimena.salas@ridgerun.com>");
+
+  bt_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_vpi_tensorize_transform_caps);
+  bt_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_vpi_tensorize_fixate_caps);
+  bt_class->get_unit_size =
+      GST_DEBUG_FUNCPTR (gst_vpi_tensorize_get_unit_size);
+  bt_class->set_caps = GST_DEBUG_FUNCPTR (gst_vpi_tensorize_set_caps);
+  bt_class->start = GST_DEBUG_FUNCPTR (gst_vpi_tensorize_start);
+  bt_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_tensorize_stop);
+  bt_class->transform = GST_DEBUG_FUNCPTR (gst_vpi_tensorize_transform);
+  gobject_class->set_property = gst_vpi_tensorize_set_property;
+  gobject_class->get_property = gst_vpi_tensorize_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_INTERPOLATOR,
+      g_param_spec_enum ("interpolator", "Interpolation method",
+          "Interpolation method to be used when resizing.",
+          VPI_INTERPOLATORS_ENUM, DEFAULT_PROP_INTERPOLATOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_BACKEND,
+      g_param_spec_enum ("backend", "Backend",
+          "Backend to be used to resize and convert the image.",
+          VPI_BACKEND_ENUM, DEFAULT_PROP_BACKEND,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_MEAN,
+      gst_param_spec_array ("mean", "Channel means",
+          "Mean subtracted from each output channel, in the order they are "
+          "written and in the [0, 1] range of the normalized pixels.\n"
+          "Usage example: <0.485,0.456,0.406>",
+          g_param_spec_double ("mean-value", "mean", "mean",
+              -G_MAXDOUBLE, G_MAXDOUBLE, DEFAULT_PROP_MEAN,
+              (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)),
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STD,
+      gst_param_spec_array ("std", "Channel standard deviations",
+          "Standard deviation each output channel is divided by, after the "
+          "mean is subtracted.\n"
+          "Usage example: <0.229,0.224,0.225>",
+          g_param_spec_double ("std-value", "std", "std",
+              -G_MAXDOUBLE, G_MAXDOUBLE, DEFAULT_PROP_STD,
+              (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)),
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SWAP_CHANNELS,
+      g_param_spec_boolean ("swap-channels", "Swap channels",
+          "Write the channels as B, G, R instead of R, G, B.",
+          DEFAULT_PROP_SWAP_CHANNELS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+}
+
+static void
+gst_vpi_tensorize_init (GstVpiTensorize * self)
+{
+  guint i = 0;
+
+  gst_video_info_init (&self->in_info);
+  self->type = GST_VPI_TENSOR_TYPE_FLOAT32;
+  self->width = 0;
+  self->height = 0;
+  self->vpi_stream = NULL;
+  self->cuda_stream = NULL;
+  self->resized = NULL;
+  self->rgb = NULL;
+  self->interpolator = DEFAULT_PROP_INTERPOLATOR;
+  self->backend = DEFAULT_PROP_BACKEND;
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    self->mean[i] = DEFAULT_PROP_MEAN;
+    self->std[i] = DEFAULT_PROP_STD;
+  }
+  self->swap_channels = DEFAULT_PROP_SWAP_CHANNELS;
+}
+
+static GstVpiTensorType
+gst_vpi_tensorize_type_from_string (const gchar * type)
+{
+  return 0 == g_strcmp0 (type, "float16") ? GST_VPI_TENSOR_TYPE_FLOAT16 :
+      GST_VPI_TENSOR_TYPE_FLOAT32;
+}
+
+static void
+gst_vpi_tensorize_copy_field (GstStructure * dest, const GstStructure * src,
+    const gchar * field)
+{
+  const GValue *value = gst_structure_get_value (src, field);
+
+  if (value) {
+    gst_structure_set_value (dest, field, value);
+  }
+}
+
+static GstCaps *
+gst_vpi_tensorize_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+  GstCaps *othercaps = NULL;
+  GstCaps *templ = NULL;
+  GstStructure *st = NULL;
+  GstStructure *other_st = NULL;
+  gint i = 0;
+  const gchar *dir = direction == GST_PAD_SRC ? "src" : "sink";
+  const gchar *otherdir = direction == GST_PAD_SRC ? "sink" : "src";
+
+  GST_DEBUG_OBJECT (trans,
+      "Negotiating %s caps given the following %s caps: %" GST_PTR_FORMAT
+      " and filter: %" GST_PTR_FORMAT, otherdir, dir, caps, filter);
+
+  othercaps = gst_caps_new_empty ();
+
+  /* The size is free on both sides since the image is resized, only the
+     framerate goes through */
+  for (i = 0; i < gst_caps_get_size (caps); ++i) {
+    st = gst_caps_get_structure (caps, i);
+    templ = gst_pad_get_pad_template_caps (GST_PAD_SINK == direction ?
+        GST_BASE_TRANSFORM_SRC_PAD (trans) :
+        GST_BASE_TRANSFORM_SINK_PAD (trans));
+    templ = gst_caps_make_writable (templ);
+    other_st = gst_caps_get_structure (templ, 0);
+    gst_vpi_tensorize_copy_field (other_st, st, "framerate");
+    othercaps = gst_caps_merge (othercaps, templ);
+  }
+
+  if (filter) {
+    GstCaps *tmp = othercaps;
+    othercaps = gst_caps_intersect (othercaps, filter);
+    gst_caps_unref (tmp);
+  }
+
+  GST_DEBUG_OBJECT (trans, "Transformed %s caps to: %" GST_PTR_FORMAT, otherdir,
+      othercaps);
+
+  return othercaps;
+}
+
+static GstCaps *
+gst_vpi_tensorize_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
+{
+  GstStructure *caps_struct = NULL;
+  GstStructure *othercaps_struct = NULL;
+  gint caps_w = 0, caps_h = 0;
+
+  othercaps = gst_caps_truncate (othercaps);
+  othercaps = gst_caps_make_writable (othercaps);
+
+  caps_struct = gst_caps_get_structure (caps, 0);
+  othercaps_struct = gst_caps_get_structure (othercaps, 0);
+
+  /* Keep the size unless the peer asks for another one */
+  if (gst_structure_get_int (caps_struct, "width", &caps_w)) {
+    gst_structure_fixate_field_nearest_int (othercaps_struct, "width",
+        caps_w);
+  }
+  if (gst_structure_get_int (caps_struct, "height", &caps_h)) {
+    gst_structure_fixate_field_nearest_int (othercaps_struct, "height",
+        caps_h);
+  }
+
+  othercaps = gst_caps_fixate (othercaps);
+  GST_DEBUG_OBJECT (trans, "Fixated othercaps to %" GST_PTR_FORMAT, othercaps);
+
+  return othercaps;
+}
+
+static gboolean
+gst_vpi_tensorize_get_unit_size (GstBaseTransform * trans, GstCaps * caps,
+    gsize * size)
+{
+  GstStructure *st = NULL;
+  GstVideoInfo info = { 0 };
+  gint width = 0, height = 0;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (caps, FALSE);
+  g_return_val_if_fail (size, FALSE);
+
+  st = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_has_name (st, TENSOR_MEDIA_TYPE)) {
+    ret = gst_structure_get_int (st, "width", &width)
+        && gst_structure_get_int (st, "height", &height);
+    *size = (gsize) NUM_CHANNELS * width * height *
+        gst_vpi_tensor_type_get_size (gst_vpi_tensorize_type_from_string
+        (gst_structure_get_string (st, "type")));
+  } else {
+    ret = gst_video_info_from_caps (&info, caps);
+    *size = GST_VIDEO_INFO_SIZE (&info);
+  }
+
+  return ret;
+}
+
+static void
+gst_vpi_tensorize_free_images (GstVpiTensorize * self)
+{
+  g_return_if_fail (self);
+
+  vpiImageDestroy (self->resized);
+  self->resized = NULL;
+  vpiImageDestroy (self->rgb);
+  self->rgb = NULL;
+}
+
+static gboolean
+gst_vpi_tensorize_set_caps (GstBaseTransform * trans, GstCaps * incaps,
+    GstCaps * outcaps)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (trans);
+  GstStructure *st = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  VPIImageFormat format = VPI_IMAGE_FORMAT_INVALID;
+  gboolean ret = FALSE;
+
+  GST_DEBUG_OBJECT (self, "set_caps");
+
+  if (!gst_video_info_from_caps (&self->in_info, incaps)) {
+    GST_ERROR_OBJECT (self, "Unable to get the input caps");
+    goto out;
+  }
+
+  st = gst_caps_get_structure (outcaps, 0);
+  if (!gst_structure_get_int (st, "width", &self->width)
+      || !gst_structure_get_int (st, "height", &self->height)) {
+    GST_ERROR_OBJECT (self, "Unable to get the output size");
+    goto out;
+  }
+  self->type =
+      gst_vpi_tensorize_type_from_string (gst_structure_get_string (st,
+          "type"));
+
+  gst_vpi_tensorize_free_images (self);
+
+  /* Resize in the input format, NV12 is then converted to interleaved RGB
+     so the normalization only deals with one layout */
+  format = gst_vpi_video_to_image_format (GST_VIDEO_INFO_FORMAT
+      (&self->in_info));
+  if (self->width != GST_VIDEO_INFO_WIDTH (&self->in_info)
+      || self->height != GST_VIDEO_INFO_HEIGHT (&self->in_info)) {
+    status = vpiImageCreate (self->width, self->height, format,
+        VPI_BACKEND_ALL, &self->resized);
+  }
+
+  if (VPI_SUCCESS == status
+      && GST_VIDEO_FORMAT_NV12 == GST_VIDEO_INFO_FORMAT (&self->in_info)) {
+    status = vpiImageCreate (self->width, self->height,
+        VPI_IMAGE_FORMAT_RGB8, VPI_BACKEND_ALL, &self->rgb);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Could not create intermediate images."),
+        ("%s", vpiStatusGetName (status)));
+    gst_vpi_tensorize_free_images (self);
+    goto out;
+  }
+
+  ret = TRUE;
+
+out:
+  return ret;
+}
+
+static gboolean
+gst_vpi_tensorize_start (GstBaseTransform * trans)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (trans);
+  gboolean ret = TRUE;
+  VPIStatus vpi_status = VPI_SUCCESS;
+  cudaError_t cuda_status = cudaSuccess;
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  cuda_status = cudaStreamCreate (&self->cuda_stream);
+  if (cudaSuccess != cuda_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create CUDA stream."), (NULL));
+    ret = FALSE;
+    goto out;
+  }
+
+  vpi_status = vpiStreamCreateCudaStreamWrapper (self->cuda_stream,
+      VPI_BACKEND_ALL, &self->vpi_stream);
+  if (VPI_SUCCESS != vpi_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not wrap CUDA stream."), (NULL));
+    cudaStreamDestroy (self->cuda_stream);
+    self->cuda_stream = NULL;
+    ret = FALSE;
+  }
+
+out:
+  return ret;
+}
+
+static gboolean
+gst_vpi_tensorize_stop (GstBaseTransform * trans)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (trans);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  gst_vpi_tensorize_free_images (self);
+
+  vpiStreamDestroy (self->vpi_stream);
+  self->vpi_stream = NULL;
+
+  cudaStreamDestroy (self->cuda_stream);
+  self->cuda_stream = NULL;
+
+  return TRUE;
+}
+
+/* Shifts value right, rounding to nearest with ties to even */
+static guint32
+gst_vpi_tensorize_shift_round (guint32 value, guint shift)
+{
+  guint32 ret = value >> shift;
+  guint32 rest = value & ((1u << shift) - 1);
+  guint32 halfway = 1u << (shift - 1);
+
+  if (rest > halfway || (rest == halfway && (ret & 1))) {
+    ret++;
+  }
+
+  return ret;
+}
+
+/* Round to nearest IEEE 754 half precision, without a hardware type */
+static guint16
+gst_vpi_tensorize_float_to_half (gfloat value)
+{
+  guint32 bits = 0;
+  guint32 sign = 0;
+  guint32 mantissa = 0;
+  gint32 exponent = 0;
+  guint32 half = 0;
+
+  memcpy (&bits, &value, sizeof (bits));
+  sign = (bits >> 16) & 0x8000;
+  mantissa = bits & 0x7fffff;
+  exponent = (gint32) ((bits >> 23) & 0xff) - 127 + 15;
+
+  if (0xff == ((bits >> 23) & 0xff)) {
+    /* Infinity or NaN */
+    half = sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  } else if (exponent >= 0x1f) {
+    half = sign | 0x7c00;
+  } else if (exponent <= 0) {
+    /* Subnormal, or too small to represent */
+    half = sign;
+    if (exponent >= -10) {
+      half |= gst_vpi_tensorize_shift_round (mantissa | 0x800000,
+          14 - exponent);
+    }
+  } else {
+    /* A carry out of the mantissa correctly bumps the exponent */
+    half = sign | ((exponent << 10) +
+        gst_vpi_tensorize_shift_round (mantissa, 13));
+  }
+
+  return half;
+}
+
+/* Each channel is written as a whole plane, with the element type fixed
+   out of the pixel loops */
+static void
+gst_vpi_tensorize_normalize_f32 (const VPIImagePlane * plane, guint pstride,
+    const guint * offsets, gint width, gint height, const gfloat * gain,
+    const gfloat * bias, gfloat * tensor)
+{
+  const guint8 *row = NULL;
+  guint c = 0;
+  gint x = 0, y = 0;
+
+  for (c = 0; c < NUM_CHANNELS; c++) {
+    for (y = 0; y < height; y++) {
+      row = (const guint8 *) plane->data + y * plane->pitchBytes + offsets[c];
+      for (x = 0; x < width; x++) {
+        *tensor++ = row[x * pstride] * gain[c] + bias[c];
+      }
+    }
+  }
+}
+
+static void
+gst_vpi_tensorize_normalize_f16 (const VPIImagePlane * plane, guint pstride,
+    const guint * offsets, gint width, gint height, const gfloat * gain,
+    const gfloat * bias, guint16 * tensor)
+{
+  const guint8 *row = NULL;
+  guint c = 0;
+  gint x = 0, y = 0;
+
+  for (c = 0; c < NUM_CHANNELS; c++) {
+    for (y = 0; y < height; y++) {
+      row = (const guint8 *) plane->data + y * plane->pitchBytes + offsets[c];
+      for (x = 0; x < width; x++) {
+        *tensor++ = gst_vpi_tensorize_float_to_half (row[x * pstride] *
+            gain[c] + bias[c]);
+      }
+    }
+  }
+}
+
+static void
+gst_vpi_tensorize_normalize (GstVpiTensorize * self,
+    const VPIImagePlane * plane, GstVideoFormat format, guint8 * tensor,
+    const gfloat * gain, const gfloat * bias, gboolean swap_channels)
+{
+  const GstVideoFormatInfo *finfo = gst_video_format_get_info (format);
+  guint offsets[NUM_CHANNELS] = { 0 };
+  guint pstride = 0;
+  guint c = 0;
+
+  g_return_if_fail (finfo);
+
+  pstride = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0);
+  for (c = 0; c < NUM_CHANNELS; c++) {
+    /* Components are R, G and B in that order for every RGB format */
+    offsets[c] = GST_VIDEO_FORMAT_INFO_POFFSET (finfo,
+        swap_channels ? NUM_CHANNELS - 1 - c : c);
+  }
+
+  if (GST_VPI_TENSOR_TYPE_FLOAT16 == self->type) {
+    gst_vpi_tensorize_normalize_f16 (plane, pstride, offsets, self->width,
+        self->height, gain, bias, (guint16 *) tensor);
+  } else {
+    gst_vpi_tensorize_normalize_f32 (plane, pstride, offsets, self->width,
+        self->height, gain, bias, (gfloat *) tensor);
+  }
+}
+
+static GstFlowReturn
+gst_vpi_tensorize_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (trans);
+  GstVpiMeta *in_meta = NULL;
+  GstMapInfo in_map = GST_MAP_INFO_INIT;
+  GstMapInfo out_map = GST_MAP_INFO_INIT;
+  GstFlowReturn ret = GST_FLOW_OK;
+  VPIStatus status = VPI_SUCCESS;
+  VPIImageData image_data = { 0 };
+  VPIImage source = NULL;
+  GstVideoFormat source_format = GST_VIDEO_FORMAT_UNKNOWN;
+  gsize dims[] = { 1, NUM_CHANNELS, 0, 0 };
+  gfloat gain[NUM_CHANNELS] = { 0 };
+  gfloat bias[NUM_CHANNELS] = { 0 };
+  gint interpolator = DEFAULT_PROP_INTERPOLATOR;
+  gint backend = DEFAULT_PROP_BACKEND;
+  gboolean swap_channels = DEFAULT_PROP_SWAP_CHANNELS;
+  guint c = 0;
+
+  GST_LOG_OBJECT (self, "Transform buffer");
+
+  in_meta = (GstVpiMeta *) gst_buffer_get_meta (inbuf, GST_VPI_META_API_TYPE);
+  if (!in_meta || !gst_buffer_map (inbuf, &in_map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Cannot process buffers that do not contain the VPI meta."), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (self);
+  interpolator = self->interpolator;
+  backend = self->backend;
+  swap_channels = self->swap_channels;
+  /* Fold the 8 bit range, mean and std into a single multiply-add */
+  for (c = 0; c < NUM_CHANNELS; c++) {
+    gain[c] = 1.0 / (255.0 * self->std[c]);
+    bias[c] = -self->mean[c] / self->std[c];
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  source = in_meta->vpi_frame.image;
+  source_format = GST_VIDEO_INFO_FORMAT (&self->in_info);
+
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), self->cuda_stream,
+      in_map.data, cudaMemAttachSingle);
+
+  if (self->resized) {
+    status = vpiSubmitRescale (self->vpi_stream, backend, source,
+        self->resized, interpolator, VPI_BOUNDARY_COND_CLAMP);
+    source = self->resized;
+  }
+
+  if (self->rgb && VPI_SUCCESS == status) {
+    status = vpiSubmitConvertImageFormat (self->vpi_stream, backend, source,
+        self->rgb, VPI_CONVERSION_CLAMP, 1, 0);
+    source = self->rgb;
+    source_format = GST_VIDEO_FORMAT_RGB;
+  }
+
+  vpiStreamSync (self->vpi_stream);
+
+  /* Attach memory to global stream to detach it from CUDA stream */
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, in_map.data,
+      cudaMemAttachHost);
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to resize or convert the image."), ("%s",
+            vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+    goto unmap;
+  }
+
+  status = vpiImageLock (source, VPI_LOCK_READ, &image_data);
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not read the converted image."), ("%s",
+            vpiStatusGetName (status)));
+    ret = GST_FLOW_ERROR;
+    goto unmap;
+  }
+
+  if (!gst_buffer_map (outbuf, &out_map, GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, WRITE, ("Unable to map output buffer."),
+        (NULL));
+    ret = GST_FLOW_ERROR;
+    goto unlock;
+  }
+
+  gst_vpi_tensorize_normalize (self, &image_data.planes[0], source_format,
+      out_map.data, gain, bias, swap_channels);
+
+  gst_buffer_unmap (outbuf, &out_map);
+
+  dims[2] = self->height;
+  dims[3] = self->width;
+  gst_buffer_add_vpi_tensor_meta (outbuf, self->type, G_N_ELEMENTS (dims),
+      dims);
+
+unlock:
+  vpiImageUnlock (source);
+
+unmap:
+  gst_buffer_unmap (inbuf, &in_map);
+
+out:
+  return ret;
+}
+
+static gboolean
+gst_vpi_tensorize_get_channels (const GValue * array, gdouble * values)
+{
+  guint i = 0;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (array, FALSE);
+  g_return_val_if_fail (values, FALSE);
+
+  if (NUM_CHANNELS != gst_value_array_get_size (array)) {
+    goto out;
+  }
+
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    values[i] = g_value_get_double (gst_value_array_get_value (array, i));
+  }
+
+  ret = TRUE;
+
+out:
+  return ret;
+}
+
+static void
+gst_vpi_tensorize_set_channels (GValue * array, const gdouble * values)
+{
+  GValue value = G_VALUE_INIT;
+  guint i = 0;
+
+  g_return_if_fail (array);
+  g_return_if_fail (values);
+
+  g_value_init (&value, G_TYPE_DOUBLE);
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    g_value_set_double (&value, values[i]);
+    gst_value_array_append_value (array, &value);
+  }
+  g_value_unset (&value);
+}
+
+void
+gst_vpi_tensorize_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (object);
+  gdouble values[NUM_CHANNELS] = { 0 };
+  gboolean valid = TRUE;
+  guint i = 0;
+
+  GST_DEBUG_OBJECT (self, "set_property");
+
+  if (PROP_MEAN == property_id || PROP_STD == property_id) {
+    valid = gst_vpi_tensorize_get_channels (value, values);
+    for (i = 0; i < NUM_CHANNELS && valid && PROP_STD == property_id; i++) {
+      valid = 0 != values[i];
+    }
+    if (!valid) {
+      GST_WARNING_OBJECT (self, "%s needs %d values%s, ignoring it",
+          pspec->name, NUM_CHANNELS,
+          PROP_STD == property_id ? " different from zero" : "");
+      return;
+    }
+  }
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      self->interpolator = g_value_get_enum (value);
+      break;
+    case PROP_BACKEND:
+      self->backend = g_value_get_enum (value);
+      break;
+    case PROP_MEAN:
+      memcpy (self->mean, values, sizeof (self->mean));
+      break;
+    case PROP_STD:
+      memcpy (self->std, values, sizeof (self->std));
+      break;
+    case PROP_SWAP_CHANNELS:
+      self->swap_channels = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+void
+gst_vpi_tensorize_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVpiTensorize *self = GST_VPI_TENSORIZE (object);
+
+  GST_DEBUG_OBJECT (self, "get_property");
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_INTERPOLATOR:
+      g_value_set_enum (value, self->interpolator);
+      break;
+    case PROP_BACKEND:
+      g_value_set_enum (value, self->backend);
+      break;
+    case PROP_MEAN:
+      gst_vpi_tensorize_set_channels (value, self->mean);
+      break;
+    case PROP_STD:
+      gst_vpi_tensorize_set_channels (value, self->std);
+      break;
+    case PROP_SWAP_CHANNELS:
+      g_value_set_boolean (value, self->swap_channels);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
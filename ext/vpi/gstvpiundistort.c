@@ -18,6 +18,7 @@
 
 #include <glib/gprintf.h>
 #include <gst/gst.h>
+#include <math.h>
 #include <vpi/algo/Remap.h>
 #include <vpi/LensDistortionModels.h>
 
@@ -26,7 +27,11 @@
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_undistort_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_undistort_debug_category
 
-#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "NV12")
+/* Remap runs on 16 bit and packed RGB images only on CPU and CUDA */
+#define CPU_CUDA_FORMATS "{ GRAY8, GRAY16_LE, NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }"
+#define HW_FORMATS "{ GRAY8, NV12, RGBA, BGRA, RGBx, BGRx }"
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", CPU_CUDA_FORMATS)
+#define HW_VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", HW_FORMATS)
 
 #define ROWS_INTRINSIC 2
 #define COLS_INTRINSIC 3
@@ -34,11 +39,31 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_undistort_debug_category);
 #define COLS_EXTRINSIC 4
 
 #define NUM_COEFFICIENTS 8
+#define NUM_CROP_SIDES 4
+#define NUM_NV12_PLANES 2
 #define DEFAULT_SENSOR_WIDTH 22.2
 #define DEFAULT_FOCAL_LENGTH 7.5
 
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+
+/* Sparse grids use power of two intervals up to this one, borders get
+   half the interval of the center */
+#define MAX_GRID_INTERVAL 64
+#define MIN_GRID_INTERVAL 1
+#define BORDER_FRACTION 8
+#define NUM_GRID_REGIONS 3
+
+/* Element message posted when a rebuilt map is ready */
+#define MAP_REBUILT_MESSAGE "vpiundistort-map-rebuilt"
+
+/* Bump the version whenever the cache file layout changes */
+#define CACHE_MAGIC "VPIMAP2"
+
 #define DEFAULT_PROP_COEF_MIN -G_MAXDOUBLE
 #define DEFAULT_PROP_COEF_MAX G_MAXDOUBLE
+#define DEFAULT_PROP_MAX_ERROR_MIN 0
+#define DEFAULT_PROP_MAX_ERROR_MAX G_MAXDOUBLE
 
 #define DEFAULT_PROP_EXTRINSIC_MATRIX { {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0} }
 #define DEFAULT_PROP_INTRINSIC_MATRIX { 0 }
@@ -46,12 +71,48 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_undistort_debug_category);
 #define DEFAULT_PROP_DISTORTION_MODEL FISHEYE
 #define DEFAULT_PROP_FISHEYE_MAPPING VPI_FISHEYE_EQUIDISTANT
 #define DEFAULT_PROP_COEF 0.0
+#define DEFAULT_PROP_GRID_DENSITY GRID_DENSITY_AUTO
+#define DEFAULT_PROP_MAX_ERROR 0.5
+#define DEFAULT_PROP_CACHE_LOCATION NULL
+#define DEFAULT_PROP_CROP 0
+
+/* Everything the warp map depends on, copied from the properties so maps
+   can be built outside of the object lock */
+typedef struct _GstVpiUndistortCalibration GstVpiUndistortCalibration;
+struct _GstVpiUndistortCalibration
+{
+  VPICameraExtrinsic extrinsic;
+  VPICameraIntrinsic intrinsic;
+  gint distortion_model;
+  gint fisheye_mapping;
+  gdouble coefficients[NUM_COEFFICIENTS];
+  gint grid_density;
+  gdouble max_error;
+  gchar *cache_location;
+  guint crop[NUM_CROP_SIDES];
+  /* Camera matrix of the output, with crop and scale folded in */
+  VPICameraIntrinsic output_intrinsic;
+};
 
+/* Remap payloads for a warp map. For NV12 the map is kept until the first
+   frame tells whether the backend remaps NV12 as a whole, otherwise the
+   chroma payload is derived from it */
+typedef struct _GstVpiUndistortWarp GstVpiUndistortWarp;
+struct _GstVpiUndistortWarp
+{
+  VPIPayload remap;
+  VPIPayload chroma_remap;
+  VPIWarpMap map;
+  guint width;
+  guint height;
+  gint backend;
+};
 
 struct _GstVpiUndistort
 {
   GstVpiFilter parent;
-  VPIPayload warp;
+  GstVpiUndistortWarp *warp;
+  gboolean per_plane;
   VPICameraExtrinsic extrinsic;
   VPICameraIntrinsic intrinsic;
   gboolean set_intrinsic_matrix;
@@ -59,11 +120,33 @@ struct _GstVpiUndistort
   gint distortion_model;
   gint fisheye_mapping;
   gdouble coefficients[NUM_COEFFICIENTS];
+  gint grid_density;
+  gdouble max_error;
+  gchar *cache_location;
+  guint crop[NUM_CROP_SIDES];
+
+  /* Map rebuilds on calibration changes while streaming */
+  GMutex rebuild_lock;
+  GCond rebuild_cond;
+  GThread *rebuild_thread;
+  gboolean rebuild_pending;
+  gboolean rebuild_stop;
+  GstVpiUndistortWarp *pending_warp;
+  GstVideoFormat format;
+  guint in_width;
+  guint in_height;
+  guint out_width;
+  guint out_height;
+  gint backend;
 };
 
 /* prototypes */
 static GstFlowReturn gst_vpi_undistort_transform_image (GstVpiFilter *
     filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
+static GstCaps *gst_vpi_undistort_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static GstCaps *gst_vpi_undistort_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
 static gboolean gst_vpi_undistort_start (GstVpiFilter * self, GstVideoInfo *
     in_info, GstVideoInfo * out_info);
 static gboolean gst_vpi_undistort_stop (GstBaseTransform * trans);
@@ -88,7 +171,22 @@ enum
   PROP_K5,
   PROP_K6,
   PROP_P1,
-  PROP_P2
+  PROP_P2,
+  PROP_GRID_DENSITY,
+  PROP_MAX_ERROR,
+  PROP_CACHE_LOCATION,
+  PROP_CROP_LEFT,
+  PROP_CROP_TOP,
+  PROP_CROP_RIGHT,
+  PROP_CROP_BOTTOM
+};
+
+enum
+{
+  CROP_LEFT,
+  CROP_TOP,
+  CROP_RIGHT,
+  CROP_BOTTOM
 };
 
 enum
@@ -103,6 +201,12 @@ enum
   POLYNOMIAL
 };
 
+enum
+{
+  GRID_DENSITY_AUTO,
+  GRID_DENSITY_DENSE
+};
+
 enum
 {
   K1,
@@ -159,6 +263,25 @@ vpi_fisheye_mapping_enum_get_type (void)
   return vpi_fisheye_mapping_enum_type;
 }
 
+GType
+vpi_grid_density_enum_get_type (void)
+{
+  static GType vpi_grid_density_enum_type = 0;
+  static const GEnumValue values[] = {
+    {GRID_DENSITY_AUTO, "Sparsest grid within the max-error tolerance, "
+          "denser near the borders", "auto"},
+    {GRID_DENSITY_DENSE, "One control point per pixel", "dense"},
+    {0, NULL, NULL}
+  };
+
+  if (!vpi_grid_density_enum_type) {
+    vpi_grid_density_enum_type =
+        g_enum_register_static ("VpiGridDensity", values);
+  }
+
+  return vpi_grid_density_enum_type;
+}
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (GstVpiUndistort, gst_vpi_undistort,
@@ -190,6 +313,10 @@ gst_vpi_undistort_class_init (GstVpiUndistortClass * klass)
   vpi_filter_class->transform_image =
       GST_DEBUG_FUNCPTR (gst_vpi_undistort_transform_image);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_undistort_stop);
+  base_transform_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_vpi_undistort_transform_caps);
+  base_transform_class->fixate_caps =
+      GST_DEBUG_FUNCPTR (gst_vpi_undistort_fixate_caps);
   gobject_class->set_property = gst_vpi_undistort_set_property;
   gobject_class->get_property = gst_vpi_undistort_get_property;
   gobject_class->finalize = gst_vpi_undistort_finalize;
@@ -293,6 +420,59 @@ gst_vpi_undistort_class_init (GstVpiUndistortClass * klass)
           "Tangential distortion coefficient 2. Only for polynomial model.",
           DEFAULT_PROP_COEF_MIN, DEFAULT_PROP_COEF_MAX, DEFAULT_PROP_COEF,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_GRID_DENSITY,
+      g_param_spec_enum ("grid-density", "Warp map grid density",
+          "Density of the control points of the warp map. Remap interpolates "
+          "between control points, so sparser grids are faster to generate "
+          "and to apply.",
+          VPI_GRID_DENSITIES_ENUM, DEFAULT_PROP_GRID_DENSITY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_ERROR,
+      g_param_spec_double ("max-error", "Maximum reprojection error",
+          "Maximum error in pixels introduced by interpolating between "
+          "control points when grid-density is auto.",
+          DEFAULT_PROP_MAX_ERROR_MIN, DEFAULT_PROP_MAX_ERROR_MAX,
+          DEFAULT_PROP_MAX_ERROR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CACHE_LOCATION,
+      g_param_spec_string ("cache-location", "Warp map cache location",
+          "Directory where generated warp maps are cached and loaded from "
+          "on later starts with the same calibration and resolution. "
+          "Caching is disabled when not set, a typical location is "
+          "$XDG_CACHE_HOME/gst-vpi.",
+          DEFAULT_PROP_CACHE_LOCATION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CROP_LEFT,
+      g_param_spec_uint ("crop-left", "Crop left",
+          "Pixels to crop at the left of the undistorted image, before "
+          "scaling it to the output resolution.",
+          0, G_MAXINT, DEFAULT_PROP_CROP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CROP_TOP,
+      g_param_spec_uint ("crop-top", "Crop top",
+          "Pixels to crop at the top of the undistorted image, before "
+          "scaling it to the output resolution.",
+          0, G_MAXINT, DEFAULT_PROP_CROP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CROP_RIGHT,
+      g_param_spec_uint ("crop-right", "Crop right",
+          "Pixels to crop at the right of the undistorted image, before "
+          "scaling it to the output resolution.",
+          0, G_MAXINT, DEFAULT_PROP_CROP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CROP_BOTTOM,
+      g_param_spec_uint ("crop-bottom", "Crop bottom",
+          "Pixels to crop at the bottom of the undistorted image, before "
+          "scaling it to the output resolution.",
+          0, G_MAXINT, DEFAULT_PROP_CROP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -301,15 +481,36 @@ gst_vpi_undistort_init (GstVpiUndistort * self)
   VPICameraExtrinsic extrinsic = DEFAULT_PROP_EXTRINSIC_MATRIX;
   VPICameraIntrinsic intrinsic = DEFAULT_PROP_INTRINSIC_MATRIX;
   gdouble coefficients[NUM_COEFFICIENTS] = { 0 };
+  guint crop[NUM_CROP_SIDES] = { DEFAULT_PROP_CROP, DEFAULT_PROP_CROP,
+    DEFAULT_PROP_CROP, DEFAULT_PROP_CROP
+  };
 
   self->warp = NULL;
+  self->per_plane = FALSE;
   self->set_intrinsic_matrix = FALSE;
   self->interpolator = DEFAULT_PROP_INTERPOLATOR;
   self->distortion_model = DEFAULT_PROP_DISTORTION_MODEL;
   self->fisheye_mapping = DEFAULT_PROP_FISHEYE_MAPPING;
+  self->grid_density = DEFAULT_PROP_GRID_DENSITY;
+  self->max_error = DEFAULT_PROP_MAX_ERROR;
+  self->cache_location = g_strdup (DEFAULT_PROP_CACHE_LOCATION);
   memcpy (&self->extrinsic, &extrinsic, sizeof (extrinsic));
   memcpy (&self->intrinsic, &intrinsic, sizeof (intrinsic));
   memcpy (&self->coefficients, &coefficients, sizeof (coefficients));
+  memcpy (&self->crop, &crop, sizeof (crop));
+
+  g_mutex_init (&self->rebuild_lock);
+  g_cond_init (&self->rebuild_cond);
+  self->rebuild_thread = NULL;
+  self->rebuild_pending = FALSE;
+  self->rebuild_stop = FALSE;
+  self->pending_warp = NULL;
+  self->format = GST_VIDEO_FORMAT_UNKNOWN;
+  self->in_width = 0;
+  self->in_height = 0;
+  self->out_width = 0;
+  self->out_height = 0;
+  self->backend = VPI_BACKEND_INVALID;
 }
 
 static void
@@ -405,16 +606,1067 @@ gst_vpi_undistort_summarize_properties (GstVpiUndistort * self)
   g_free (summary);
 }
 
+/* Splits an axis in two borders with half the interval of the center,
+   where lens distortion changes the fastest. An interval of 1 and sizes
+   too small to be split use a single region. Returns the region count */
+static gint
+gst_vpi_undistort_split_axis (guint size, guint interval,
+    guint sizes[NUM_GRID_REGIONS], guint intervals[NUM_GRID_REGIONS])
+{
+  guint border_interval = MAX (interval / 2, MIN_GRID_INTERVAL);
+  guint border_size = GST_ROUND_UP_N (size / BORDER_FRACTION,
+      border_interval);
+
+  if (MIN_GRID_INTERVAL == interval || size < 2 * border_size + interval) {
+    sizes[0] = size;
+    intervals[0] = border_interval;
+    return 1;
+  }
+
+  sizes[0] = border_size;
+  sizes[1] = GST_ROUND_DOWN_N (size - 2 * border_size, interval);
+  sizes[2] = size - border_size - sizes[1];
+  intervals[0] = border_interval;
+  intervals[1] = interval;
+  intervals[2] = border_interval;
+
+  return NUM_GRID_REGIONS;
+}
+
+/* Lays out a grid of up to 3x3 regions with the given horizontal and
+   vertical intervals in the center */
+static void
+gst_vpi_undistort_set_grid (VPIWarpGrid * grid, guint width, guint height,
+    guint horiz_interval, guint vert_interval)
+{
+  guint sizes[NUM_GRID_REGIONS] = { 0 };
+  guint intervals[NUM_GRID_REGIONS] = { 0 };
+  gint i = 0;
+
+  g_return_if_fail (grid);
+
+  grid->numHorizRegions = gst_vpi_undistort_split_axis (width,
+      horiz_interval, sizes, intervals);
+  for (i = 0; i < grid->numHorizRegions; i++) {
+    grid->regionWidth[i] = sizes[i];
+    grid->horizInterval[i] = intervals[i];
+  }
+
+  grid->numVertRegions = gst_vpi_undistort_split_axis (height,
+      vert_interval, sizes, intervals);
+  for (i = 0; i < grid->numVertRegions; i++) {
+    grid->regionHeight[i] = sizes[i];
+    grid->vertInterval[i] = intervals[i];
+  }
+}
+
+static VPIStatus
+gst_vpi_undistort_generate_map (const GstVpiUndistortCalibration *
+    calibration, guint width, guint height, guint horiz_interval,
+    guint vert_interval, VPIWarpMap * map)
+{
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (calibration, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (map, VPI_ERROR_INVALID_ARGUMENT);
+
+  gst_vpi_undistort_set_grid (&map->grid, width, height, horiz_interval,
+      vert_interval);
+
+  status = vpiWarpMapAllocData (map);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  if (calibration->distortion_model == FISHEYE) {
+    VPIFisheyeLensDistortionModel fisheye = { calibration->fisheye_mapping,
+      calibration->coefficients[K1], calibration->coefficients[K2],
+      calibration->coefficients[K3], calibration->coefficients[K4]
+    };
+    status =
+        vpiWarpMapGenerateFromFisheyeLensDistortionModel
+        (calibration->intrinsic, calibration->extrinsic,
+        calibration->output_intrinsic, &fisheye, map);
+
+  } else {
+    VPIPolynomialLensDistortionModel polynomial = {
+      calibration->coefficients[K1], calibration->coefficients[K2],
+      calibration->coefficients[K3], calibration->coefficients[K4],
+      calibration->coefficients[K5], calibration->coefficients[K6],
+      calibration->coefficients[P1], calibration->coefficients[P2]
+    };
+    status =
+        vpiWarpMapGenerateFromPolynomialLensDistortionModel
+        (calibration->intrinsic, calibration->extrinsic,
+        calibration->output_intrinsic, &polynomial, map);
+  }
+
+out:
+  return status;
+}
+
+static VPIKeypoint *
+gst_vpi_undistort_map_point (const VPIWarpMap * map, gint row, gint col)
+{
+  return (VPIKeypoint *) ((guint8 *) map->keypoints +
+      row * map->pitchBytes) + col;
+}
+
+/* Control point positions of a grid, as seen by an identity map */
+static gboolean
+gst_vpi_undistort_grid_positions (const VPIWarpGrid * grid, gfloat ** xs,
+    gfloat ** ys, gint * num_xs, gint * num_ys)
+{
+  VPIWarpMap identity = { 0 };
+  gboolean ret = FALSE;
+  gint i = 0;
+
+  g_return_val_if_fail (grid, FALSE);
+
+  identity.grid = *grid;
+  if (VPI_SUCCESS != vpiWarpMapAllocData (&identity)) {
+    goto out;
+  }
+  vpiWarpMapGenerateIdentity (&identity);
+
+  *num_xs = identity.numHorizPoints;
+  *num_ys = identity.numVertPoints;
+  *xs = g_malloc (*num_xs * sizeof (gfloat));
+  *ys = g_malloc (*num_ys * sizeof (gfloat));
+  for (i = 0; i < *num_xs; i++) {
+    (*xs)[i] = gst_vpi_undistort_map_point (&identity, 0, i)->x;
+  }
+  for (i = 0; i < *num_ys; i++) {
+    (*ys)[i] = gst_vpi_undistort_map_point (&identity, i, 0)->y;
+  }
+
+  vpiWarpMapFreeData (&identity);
+  ret = TRUE;
+
+out:
+  return ret;
+}
+
+static gint
+gst_vpi_undistort_find_cell (const gfloat * positions, gint num_positions,
+    gfloat position)
+{
+  gint low = 0;
+  gint high = num_positions - 1;
+  gint mid = 0;
+
+  /* Last index whose position is not greater than the given one */
+  while (high - low > 1) {
+    mid = (low + high) / 2;
+    if (positions[mid] <= position) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+/* Bilinear interpolation of the map at a point, as remap does between
+   control points */
+static void
+gst_vpi_undistort_sample_map (const VPIWarpMap * map, const gfloat * xs,
+    gint num_xs, const gfloat * ys, gint num_ys, gfloat x, gfloat y,
+    VPIKeypoint * point)
+{
+  VPIKeypoint *p00 = NULL, *p01 = NULL, *p10 = NULL, *p11 = NULL;
+  gfloat ax = 0, ay = 0;
+  gint r = 0, c = 0;
+
+  g_return_if_fail (map);
+  g_return_if_fail (xs);
+  g_return_if_fail (ys);
+  g_return_if_fail (point);
+
+  r = gst_vpi_undistort_find_cell (ys, num_ys, y);
+  r = MIN (r, num_ys - 2);
+  ay = (y - ys[r]) / (ys[r + 1] - ys[r]);
+
+  c = gst_vpi_undistort_find_cell (xs, num_xs, x);
+  c = MIN (c, num_xs - 2);
+  ax = (x - xs[c]) / (xs[c + 1] - xs[c]);
+
+  p00 = gst_vpi_undistort_map_point (map, r, c);
+  p01 = gst_vpi_undistort_map_point (map, r, c + 1);
+  p10 = gst_vpi_undistort_map_point (map, r + 1, c);
+  p11 = gst_vpi_undistort_map_point (map, r + 1, c + 1);
+  point->x = (1 - ay) * ((1 - ax) * p00->x + ax * p01->x) +
+      ay * ((1 - ax) * p10->x + ax * p11->x);
+  point->y = (1 - ay) * ((1 - ax) * p00->y + ax * p01->y) +
+      ay * ((1 - ax) * p10->y + ax * p11->y);
+}
+
+/* Exact position in the input of an output pixel, the same lens model the
+   warp map is generated from. Returns FALSE for points behind the camera */
+static gboolean
+gst_vpi_undistort_project (const GstVpiUndistortCalibration * calibration,
+    gfloat u, gfloat v, VPIKeypoint * point)
+{
+  const gdouble *k = NULL;
+  gdouble ray[3] = { 0 };
+  gdouble camera[3] = { 0 };
+  gdouble x = 0, y = 0, xd = 0, yd = 0;
+  gdouble r2 = 0, r = 0, theta = 0, theta2 = 0;
+  gdouble radial = 0, rd = 0;
+  gint i = 0;
+
+  g_return_val_if_fail (calibration, FALSE);
+  g_return_val_if_fail (point, FALSE);
+
+  k = calibration->coefficients;
+
+  /* Ray of the output pixel, moved to the input camera */
+  ray[1] = (v - calibration->output_intrinsic[1][2]) /
+      calibration->output_intrinsic[1][1];
+  ray[0] = (u - calibration->output_intrinsic[0][2] -
+      calibration->output_intrinsic[0][1] * ray[1]) /
+      calibration->output_intrinsic[0][0];
+  ray[2] = 1;
+  for (i = 0; i < 3; i++) {
+    camera[i] = calibration->extrinsic[i][0] * ray[0] +
+        calibration->extrinsic[i][1] * ray[1] +
+        calibration->extrinsic[i][2] * ray[2] + calibration->extrinsic[i][3];
+  }
+
+  if (camera[2] <= 0) {
+    return FALSE;
+  }
+
+  x = camera[0] / camera[2];
+  y = camera[1] / camera[2];
+  r2 = x * x + y * y;
+
+  if (FISHEYE == calibration->distortion_model) {
+    r = sqrt (r2);
+    theta = atan (r);
+    theta2 = theta * theta;
+
+    switch (calibration->fisheye_mapping) {
+      case VPI_FISHEYE_EQUISOLID:
+        rd = 2 * sin (theta / 2);
+        break;
+      case VPI_FISHEYE_ORTHOGRAPHIC:
+        rd = sin (theta);
+        break;
+      case VPI_FISHEYE_STEREOGRAPHIC:
+        rd = 2 * tan (theta / 2);
+        break;
+      default:
+        rd = theta;
+        break;
+    }
+    rd *= 1 + theta2 * (k[K1] + theta2 * (k[K2] + theta2 * (k[K3] +
+                theta2 * k[K4])));
+
+    radial = r > 0 ? rd / r : 1;
+    xd = x * radial;
+    yd = y * radial;
+  } else {
+    radial = (1 + r2 * (k[K1] + r2 * (k[K2] + r2 * k[K3]))) /
+        (1 + r2 * (k[K4] + r2 * (k[K5] + r2 * k[K6])));
+    xd = x * radial + 2 * k[P1] * x * y + k[P2] * (r2 + 2 * x * x);
+    yd = y * radial + k[P1] * (r2 + 2 * y * y) + 2 * k[P2] * x * y;
+  }
+
+  point->x = calibration->intrinsic[0][0] * xd +
+      calibration->intrinsic[0][1] * yd + calibration->intrinsic[0][2];
+  point->y = calibration->intrinsic[1][1] * yd + calibration->intrinsic[1][2];
+
+  return TRUE;
+}
+
+/* Largest distance between the interpolated map and the exact mapping,
+   measured halfway between horizontal and between vertical neighbors,
+   where interpolation errs the most */
+static gboolean
+gst_vpi_undistort_midpoint_error (const GstVpiUndistortCalibration *
+    calibration, const VPIWarpMap * map, gdouble * horiz_error,
+    gdouble * vert_error)
+{
+  gfloat *xs = NULL;
+  gfloat *ys = NULL;
+  gint num_xs = 0;
+  gint num_ys = 0;
+  VPIKeypoint exact = { 0 };
+  VPIKeypoint point = { 0 };
+  gfloat x = 0, y = 0;
+  gboolean ret = FALSE;
+  gint i = 0, j = 0;
+
+  g_return_val_if_fail (calibration, FALSE);
+  g_return_val_if_fail (map, FALSE);
+  g_return_val_if_fail (horiz_error, FALSE);
+  g_return_val_if_fail (vert_error, FALSE);
+
+  if (!gst_vpi_undistort_grid_positions (&map->grid, &xs, &ys, &num_xs,
+          &num_ys)) {
+    goto out;
+  }
+
+  *horiz_error = 0;
+  *vert_error = 0;
+
+  for (i = 0; i < num_ys; i++) {
+    for (j = 0; j < num_xs; j++) {
+      if (j + 1 < num_xs) {
+        x = (xs[j] + xs[j + 1]) / 2;
+        if (gst_vpi_undistort_project (calibration, x, ys[i], &exact)) {
+          gst_vpi_undistort_sample_map (map, xs, num_xs, ys, num_ys, x, ys[i],
+              &point);
+          *horiz_error = MAX (*horiz_error,
+              hypot (point.x - exact.x, point.y - exact.y));
+        }
+      }
+
+      if (i + 1 < num_ys) {
+        y = (ys[i] + ys[i + 1]) / 2;
+        if (gst_vpi_undistort_project (calibration, xs[j], y, &exact)) {
+          gst_vpi_undistort_sample_map (map, xs, num_xs, ys, num_ys, xs[j], y,
+              &point);
+          *vert_error = MAX (*vert_error,
+              hypot (point.x - exact.x, point.y - exact.y));
+        }
+      }
+    }
+  }
+
+  ret = TRUE;
+
+out:
+  g_free (xs);
+  g_free (ys);
+  return ret;
+}
+
+/* Interpolation error grows with the square of the interval, so this is
+   the largest power of two interval expected to be within max-error */
+static guint
+gst_vpi_undistort_refine_interval (guint interval, gdouble error,
+    gdouble max_error)
+{
+  gdouble target = 0;
+
+  if (error <= max_error) {
+    return interval;
+  }
+
+  target = interval * sqrt (max_error / error);
+  while (interval > MIN_GRID_INTERVAL && interval > target) {
+    interval /= 2;
+  }
+
+  return interval;
+}
+
+/* Generates the sparsest map whose interpolation stays within max-error.
+   The coarsest map is measured against the exact mapping and refined once
+   per axis from its error */
+static VPIStatus
+gst_vpi_undistort_generate_auto_map (GstVpiUndistort * self,
+    const GstVpiUndistortCalibration * calibration, guint width, guint height,
+    VPIWarpMap * map)
+{
+  VPIStatus status = VPI_SUCCESS;
+  gdouble horiz_error = 0;
+  gdouble vert_error = 0;
+  guint horiz_interval = MAX_GRID_INTERVAL;
+  guint vert_interval = MAX_GRID_INTERVAL;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (calibration, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (map, VPI_ERROR_INVALID_ARGUMENT);
+
+  status = gst_vpi_undistort_generate_map (calibration, width, height,
+      horiz_interval, vert_interval, map);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  if (!gst_vpi_undistort_midpoint_error (calibration, map, &horiz_error,
+          &vert_error)) {
+    status = VPI_ERROR_OUT_OF_MEMORY;
+    goto out;
+  }
+
+  GST_DEBUG_OBJECT (self, "Grid interval %u has an error of %f pixels "
+      "horizontally and %f pixels vertically", MAX_GRID_INTERVAL,
+      horiz_error, vert_error);
+
+  horiz_interval = gst_vpi_undistort_refine_interval (horiz_interval,
+      horiz_error, calibration->max_error);
+  vert_interval = gst_vpi_undistort_refine_interval (vert_interval,
+      vert_error, calibration->max_error);
+
+  if (MAX_GRID_INTERVAL != horiz_interval
+      || MAX_GRID_INTERVAL != vert_interval) {
+    vpiWarpMapFreeData (map);
+    memset (map, 0, sizeof (*map));
+    status = gst_vpi_undistort_generate_map (calibration, width, height,
+        horiz_interval, vert_interval, map);
+  }
+
+  if (VPI_SUCCESS == status) {
+    GST_INFO_OBJECT (self, "Using a warp map grid interval of %ux%u",
+        horiz_interval, vert_interval);
+  }
+
+out:
+  return status;
+}
+
+/* Cache files start with this header, followed by the rows of control
+   points without padding */
+typedef struct _GstVpiUndistortCacheHeader GstVpiUndistortCacheHeader;
+struct _GstVpiUndistortCacheHeader
+{
+  gchar magic[8];
+  guint32 num_horiz_points;
+  guint32 num_vert_points;
+  VPIWarpGrid grid;
+};
+
+/* Cache file name is a hash of every input of the warp map, or NULL if
+   the cache is disabled */
+static gchar *
+gst_vpi_undistort_get_cache_path (const GstVpiUndistortCalibration *
+    calibration, guint width, guint height)
+{
+  GChecksum *checksum = NULL;
+  gchar *filename = NULL;
+  gchar *path = NULL;
+  guint32 size[2] = { width, height };
+  gint settings[3] = { 0 };
+
+  g_return_val_if_fail (calibration, NULL);
+
+  if (!calibration->cache_location || '\0' == calibration->cache_location[0]) {
+    goto out;
+  }
+
+  settings[0] = calibration->distortion_model;
+  settings[1] = calibration->fisheye_mapping;
+  settings[2] = calibration->grid_density;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) CACHE_MAGIC,
+      sizeof (CACHE_MAGIC));
+  g_checksum_update (checksum, (const guchar *) size, sizeof (size));
+  g_checksum_update (checksum, (const guchar *) settings, sizeof (settings));
+  g_checksum_update (checksum, (const guchar *) & calibration->max_error,
+      sizeof (calibration->max_error));
+  g_checksum_update (checksum, (const guchar *) calibration->coefficients,
+      sizeof (calibration->coefficients));
+  g_checksum_update (checksum, (const guchar *) calibration->intrinsic,
+      sizeof (calibration->intrinsic));
+  g_checksum_update (checksum, (const guchar *) calibration->extrinsic,
+      sizeof (calibration->extrinsic));
+  g_checksum_update (checksum, (const guchar *) calibration->output_intrinsic,
+      sizeof (calibration->output_intrinsic));
+
+  filename = g_strdup_printf ("%s.map", g_checksum_get_string (checksum));
+  path = g_build_filename (calibration->cache_location, filename, NULL);
+
+  g_checksum_free (checksum);
+  g_free (filename);
+
+out:
+  return path;
+}
+
+/* A cache file is only trusted if its grid covers the output and lays out
+   exactly the control points stored after it */
+static gboolean
+gst_vpi_undistort_grid_is_valid (const VPIWarpGrid * grid, guint width,
+    guint height, guint num_horiz_points, guint num_vert_points)
+{
+  VPIWarpMap identity = { 0 };
+  guint grid_width = 0;
+  guint grid_height = 0;
+  gboolean ret = FALSE;
+  gint i = 0;
+
+  g_return_val_if_fail (grid, FALSE);
+
+  if (grid->numHorizRegions < 1 || grid->numHorizRegions > NUM_GRID_REGIONS
+      || grid->numVertRegions < 1
+      || grid->numVertRegions > NUM_GRID_REGIONS) {
+    goto out;
+  }
+
+  for (i = 0; i < grid->numHorizRegions; i++) {
+    if (grid->regionWidth[i] <= 0 || grid->horizInterval[i] <= 0) {
+      goto out;
+    }
+    grid_width += grid->regionWidth[i];
+  }
+
+  for (i = 0; i < grid->numVertRegions; i++) {
+    if (grid->regionHeight[i] <= 0 || grid->vertInterval[i] <= 0) {
+      goto out;
+    }
+    grid_height += grid->regionHeight[i];
+  }
+
+  if (grid_width != width || grid_height != height) {
+    goto out;
+  }
+
+  identity.grid = *grid;
+  if (VPI_SUCCESS != vpiWarpMapAllocData (&identity)) {
+    goto out;
+  }
+
+  ret = identity.numHorizPoints == num_horiz_points
+      && identity.numVertPoints == num_vert_points;
+  vpiWarpMapFreeData (&identity);
+
+out:
+  return ret;
+}
+
+/* Points the map to the control points of the mapped cache file. The map
+   is valid as long as the returned file is. Invalid files return NULL so
+   the map is generated again */
+static GMappedFile *
+gst_vpi_undistort_load_map (GstVpiUndistort * self, const gchar * path,
+    guint width, guint height, VPIWarpMap * map)
+{
+  GMappedFile *file = NULL;
+  GstVpiUndistortCacheHeader header = { {0} };
+  GError *error = NULL;
+  const gchar *contents = NULL;
+  gsize size = 0;
+  gsize row_size = 0;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (path, NULL);
+  g_return_val_if_fail (map, NULL);
+
+  file = g_mapped_file_new (path, FALSE, &error);
+  if (!file) {
+    GST_DEBUG_OBJECT (self, "No cached warp map: %s", error->message);
+    g_error_free (error);
+    goto out;
+  }
+
+  contents = g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  if (size < sizeof (header)) {
+    goto invalid;
+  }
+
+  memcpy (&header, contents, sizeof (header));
+  row_size = header.num_horiz_points * sizeof (VPIKeypoint);
+
+  if (0 != memcmp (header.magic, CACHE_MAGIC, sizeof (header.magic))
+      || size != sizeof (header) + row_size * header.num_vert_points
+      || !gst_vpi_undistort_grid_is_valid (&header.grid, width, height,
+          header.num_horiz_points, header.num_vert_points)) {
+    goto invalid;
+  }
+
+  map->grid = header.grid;
+  map->numHorizPoints = header.num_horiz_points;
+  map->numVertPoints = header.num_vert_points;
+  map->pitchBytes = row_size;
+  map->keypoints = (VPIKeypoint *) (contents + sizeof (header));
+
+  GST_INFO_OBJECT (self, "Loaded cached warp map from %s", path);
+  goto out;
+
+invalid:
+  GST_WARNING_OBJECT (self, "Ignoring invalid warp map cache file %s", path);
+  g_mapped_file_unref (file);
+  file = NULL;
+
+out:
+  return file;
+}
+
+static void
+gst_vpi_undistort_save_map (GstVpiUndistort * self, const gchar * path,
+    const VPIWarpMap * map)
+{
+  GstVpiUndistortCacheHeader header = { CACHE_MAGIC };
+  GError *error = NULL;
+  gchar *dirname = NULL;
+  gchar *contents = NULL;
+  gsize row_size = 0;
+  gsize size = 0;
+  gint row = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (path);
+  g_return_if_fail (map);
+
+  header.num_horiz_points = map->numHorizPoints;
+  header.num_vert_points = map->numVertPoints;
+  header.grid = map->grid;
+
+  row_size = map->numHorizPoints * sizeof (VPIKeypoint);
+  size = sizeof (header) + row_size * map->numVertPoints;
+
+  contents = g_malloc (size);
+  memcpy (contents, &header, sizeof (header));
+  for (row = 0; row < map->numVertPoints; row++) {
+    memcpy (contents + sizeof (header) + row * row_size,
+        (guint8 *) map->keypoints + row * map->pitchBytes, row_size);
+  }
+
+  dirname = g_path_get_dirname (path);
+  if (0 != g_mkdir_with_parents (dirname, 0755)) {
+    GST_WARNING_OBJECT (self, "Could not create warp map cache directory %s",
+        dirname);
+    goto out;
+  }
+
+  /* Written to a temporary file and renamed, so concurrent starts never
+     map a partial file */
+  if (!g_file_set_contents (path, contents, size, &error)) {
+    GST_WARNING_OBJECT (self, "Could not cache warp map: %s", error->message);
+    g_error_free (error);
+    goto out;
+  }
+
+  GST_INFO_OBJECT (self, "Cached warp map in %s", path);
+
+out:
+  g_free (dirname);
+  g_free (contents);
+}
+
+/* Snapshots the properties and folds the crop and the scale from the
+   cropped input to the output into the output camera matrix */
+static gboolean
+gst_vpi_undistort_get_calibration (GstVpiUndistort * self, guint in_width,
+    guint in_height, guint out_width, guint out_height,
+    GstVpiUndistortCalibration * calibration)
+{
+  gboolean ret = TRUE;
+  guint crop_width = 0;
+  guint crop_height = 0;
+  gdouble scale_x = 0;
+  gdouble scale_y = 0;
+  gint i = 0;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (calibration, FALSE);
+
+  GST_OBJECT_LOCK (self);
+  memcpy (&calibration->extrinsic, &self->extrinsic, sizeof (self->extrinsic));
+  memcpy (&calibration->intrinsic, &self->intrinsic, sizeof (self->intrinsic));
+  memcpy (&calibration->coefficients, &self->coefficients,
+      sizeof (self->coefficients));
+  calibration->distortion_model = self->distortion_model;
+  calibration->fisheye_mapping = self->fisheye_mapping;
+  calibration->grid_density = self->grid_density;
+  calibration->max_error = self->max_error;
+  calibration->cache_location = g_strdup (self->cache_location);
+  memcpy (&calibration->crop, &self->crop, sizeof (self->crop));
+  GST_OBJECT_UNLOCK (self);
+
+  if (calibration->crop[CROP_LEFT] + calibration->crop[CROP_RIGHT] >= in_width
+      || calibration->crop[CROP_TOP] + calibration->crop[CROP_BOTTOM] >=
+      in_height) {
+    GST_ERROR_OBJECT (self, "Crop of %u,%u,%u,%u does not fit a %ux%u input",
+        calibration->crop[CROP_LEFT], calibration->crop[CROP_TOP],
+        calibration->crop[CROP_RIGHT], calibration->crop[CROP_BOTTOM],
+        in_width, in_height);
+    ret = FALSE;
+    goto out;
+  }
+
+  crop_width =
+      in_width - calibration->crop[CROP_LEFT] - calibration->crop[CROP_RIGHT];
+  crop_height =
+      in_height - calibration->crop[CROP_TOP] - calibration->crop[CROP_BOTTOM];
+  scale_x = (gdouble) out_width / crop_width;
+  scale_y = (gdouble) out_height / crop_height;
+
+  /* [[fx,s,cx],[0,fy,cy]] with the principal point moved by the crop */
+  for (i = 0; i < COLS_INTRINSIC; i++) {
+    calibration->output_intrinsic[0][i] =
+        scale_x * calibration->intrinsic[0][i];
+    calibration->output_intrinsic[1][i] =
+        scale_y * calibration->intrinsic[1][i];
+  }
+  calibration->output_intrinsic[0][2] -= scale_x * calibration->crop[CROP_LEFT];
+  calibration->output_intrinsic[1][2] -= scale_y * calibration->crop[CROP_TOP];
+
+out:
+  return ret;
+}
+
+/* Chroma map of a half resolution plane, sampled from the luma map at the
+   chroma sample centers */
+static VPIStatus
+gst_vpi_undistort_generate_chroma_map (const VPIWarpMap * map, guint width,
+    guint height, VPIWarpMap * chroma_map)
+{
+  VPIStatus status = VPI_SUCCESS;
+  VPIKeypoint *point = NULL;
+  gfloat *xs = NULL;
+  gfloat *ys = NULL;
+  gfloat *chroma_xs = NULL;
+  gfloat *chroma_ys = NULL;
+  gint num_xs = 0, num_ys = 0;
+  gint num_chroma_xs = 0, num_chroma_ys = 0;
+  guint horiz_interval = 0;
+  guint vert_interval = 0;
+  gint i = 0, j = 0;
+
+  g_return_val_if_fail (map, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (chroma_map, VPI_ERROR_INVALID_ARGUMENT);
+
+  /* Same density as the luma center region */
+  horiz_interval = map->grid.horizInterval[map->grid.numHorizRegions / 2];
+  vert_interval = map->grid.vertInterval[map->grid.numVertRegions / 2];
+  gst_vpi_undistort_set_grid (&chroma_map->grid, width, height,
+      MAX (horiz_interval / 2, MIN_GRID_INTERVAL),
+      MAX (vert_interval / 2, MIN_GRID_INTERVAL));
+
+  status = vpiWarpMapAllocData (chroma_map);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  if (!gst_vpi_undistort_grid_positions (&map->grid, &xs, &ys, &num_xs,
+          &num_ys)
+      || !gst_vpi_undistort_grid_positions (&chroma_map->grid, &chroma_xs,
+          &chroma_ys, &num_chroma_xs, &num_chroma_ys)) {
+    status = VPI_ERROR_OUT_OF_MEMORY;
+    goto out;
+  }
+
+  for (i = 0; i < num_chroma_ys; i++) {
+    for (j = 0; j < num_chroma_xs; j++) {
+      point = gst_vpi_undistort_map_point (chroma_map, i, j);
+      gst_vpi_undistort_sample_map (map, xs, num_xs, ys, num_ys,
+          2 * chroma_xs[j] + 0.5, 2 * chroma_ys[i] + 0.5, point);
+      point->x = (point->x - 0.5) / 2;
+      point->y = (point->y - 0.5) / 2;
+    }
+  }
+
+out:
+  g_free (xs);
+  g_free (ys);
+  g_free (chroma_xs);
+  g_free (chroma_ys);
+  return status;
+}
+
+static void
+gst_vpi_undistort_release_map (GstVpiUndistortWarp * warp)
+{
+  g_return_if_fail (warp);
+
+  vpiWarpMapFreeData (&warp->map);
+  memset (&warp->map, 0, sizeof (warp->map));
+}
+
+/* Copies a map into one allocated by VPI, for maps whose control points
+   are owned by someone else */
+static VPIStatus
+gst_vpi_undistort_copy_map (const VPIWarpMap * src, VPIWarpMap * dest)
+{
+  VPIStatus status = VPI_SUCCESS;
+  gint row = 0;
+
+  g_return_val_if_fail (src, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (dest, VPI_ERROR_INVALID_ARGUMENT);
+
+  dest->grid = src->grid;
+  status = vpiWarpMapAllocData (dest);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  for (row = 0; row < src->numVertPoints; row++) {
+    memcpy ((guint8 *) dest->keypoints + row * dest->pitchBytes,
+        (guint8 *) src->keypoints + row * src->pitchBytes,
+        src->numHorizPoints * sizeof (VPIKeypoint));
+  }
+
+out:
+  return status;
+}
+
+/* Creates the chroma payload from the kept luma map, which is no longer
+   needed after that */
+static VPIStatus
+gst_vpi_undistort_create_chroma_remap (GstVpiUndistortWarp * warp)
+{
+  VPIWarpMap chroma_map = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (warp, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (warp->map.keypoints, VPI_ERROR_INVALID_ARGUMENT);
+
+  status = gst_vpi_undistort_generate_chroma_map (&warp->map,
+      GST_VIDEO_SUB_SCALE (1, warp->width),
+      GST_VIDEO_SUB_SCALE (1, warp->height), &chroma_map);
+  if (VPI_SUCCESS == status) {
+    status = vpiCreateRemap (warp->backend, &chroma_map, &warp->chroma_remap);
+  }
+
+  vpiWarpMapFreeData (&chroma_map);
+  gst_vpi_undistort_release_map (warp);
+
+  return status;
+}
+
+static void
+gst_vpi_undistort_warp_free (GstVpiUndistortWarp * warp)
+{
+  if (!warp) {
+    return;
+  }
+
+  vpiPayloadDestroy (warp->remap);
+  vpiPayloadDestroy (warp->chroma_remap);
+  vpiWarpMapFreeData (&warp->map);
+  g_free (warp);
+}
+
+/* Loads or generates the warp map and creates the remap payloads for it */
+static VPIStatus
+gst_vpi_undistort_build_warp (GstVpiUndistort * self,
+    const GstVpiUndistortCalibration * calibration, guint width, guint height,
+    gint backend, GstVideoFormat format, GstVpiUndistortWarp ** warp)
+{
+  VPIStatus status = VPI_SUCCESS;
+  VPIWarpMap map = { 0 };
+  GstVpiUndistortWarp *new_warp = NULL;
+  GMappedFile *cached_map = NULL;
+  gchar *cache_path = NULL;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (calibration, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (warp, VPI_ERROR_INVALID_ARGUMENT);
+
+  cache_path = gst_vpi_undistort_get_cache_path (calibration, width, height);
+  if (cache_path) {
+    cached_map = gst_vpi_undistort_load_map (self, cache_path, width, height,
+        &map);
+  }
+
+  if (cached_map) {
+    status = VPI_SUCCESS;
+  } else if (GRID_DENSITY_DENSE == calibration->grid_density) {
+    status = gst_vpi_undistort_generate_map (calibration, width, height,
+        MIN_GRID_INTERVAL, MIN_GRID_INTERVAL, &map);
+  } else {
+    status = gst_vpi_undistort_generate_auto_map (self, calibration, width,
+        height, &map);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ERROR_OBJECT (self, "Could not generate warp map: %s",
+        vpiStatusGetName (status));
+    goto out;
+  }
+
+  if (cache_path && !cached_map) {
+    gst_vpi_undistort_save_map (self, cache_path, &map);
+  }
+
+  new_warp = g_malloc0 (sizeof (*new_warp));
+
+  status = vpiCreateRemap (backend, &map, &new_warp->remap);
+  if (VPI_SUCCESS != status) {
+    GST_ERROR_OBJECT (self, "Could not create payload: %s",
+        vpiStatusGetName (status));
+    goto out;
+  }
+
+  new_warp->width = width;
+  new_warp->height = height;
+  new_warp->backend = backend;
+
+  /* The chroma map is derived from the luma one if needed, so there is
+     still a single map generation */
+  if (GST_VIDEO_FORMAT_NV12 == format) {
+    if (cached_map) {
+      status = gst_vpi_undistort_copy_map (&map, &new_warp->map);
+    } else {
+      new_warp->map = map;
+      memset (&map, 0, sizeof (map));
+    }
+    if (VPI_SUCCESS != status) {
+      GST_ERROR_OBJECT (self, "Could not keep the map for chroma: %s",
+          vpiStatusGetName (status));
+      goto out;
+    }
+  }
+
+  *warp = new_warp;
+  new_warp = NULL;
+
+out:
+  gst_vpi_undistort_warp_free (new_warp);
+  if (cached_map) {
+    g_mapped_file_unref (cached_map);
+  } else {
+    vpiWarpMapFreeData (&map);
+  }
+  g_free (cache_path);
+  return status;
+}
+
+/* Rebuilds the payload whenever the calibration changes while streaming.
+   The result is left in pending_warp for the streaming thread to swap in
+   between frames, which keeps using the previous map meanwhile. A
+   "vpiundistort-map-rebuilt" element message is posted for each new map */
+static gpointer
+gst_vpi_undistort_rebuild_thread (gpointer data)
+{
+  GstVpiUndistort *self = GST_VPI_UNDISTORT (data);
+  GstVpiUndistortCalibration calibration = { {{0}} };
+  GstVpiUndistortWarp *warp = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  GstVideoFormat format = GST_VIDEO_FORMAT_UNKNOWN;
+  guint in_width = 0;
+  guint in_height = 0;
+  guint out_width = 0;
+  guint out_height = 0;
+  gint backend = VPI_BACKEND_INVALID;
+
+  g_mutex_lock (&self->rebuild_lock);
+  while (!self->rebuild_stop) {
+    if (!self->rebuild_pending) {
+      g_cond_wait (&self->rebuild_cond, &self->rebuild_lock);
+      continue;
+    }
+
+    self->rebuild_pending = FALSE;
+    in_width = self->in_width;
+    in_height = self->in_height;
+    out_width = self->out_width;
+    out_height = self->out_height;
+    backend = self->backend;
+    format = self->format;
+    g_mutex_unlock (&self->rebuild_lock);
+
+    GST_INFO_OBJECT (self, "Rebuilding warp map with the new calibration");
+
+    if (gst_vpi_undistort_get_calibration (self, in_width, in_height,
+            out_width, out_height, &calibration)) {
+      status = gst_vpi_undistort_build_warp (self, &calibration, out_width,
+          out_height, backend, format, &warp);
+    } else {
+      status = VPI_ERROR_INVALID_ARGUMENT;
+    }
+    g_free (calibration.cache_location);
+    calibration.cache_location = NULL;
+
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_WARNING (self, LIBRARY, FAILED,
+          ("Could not rebuild warp map, keeping the previous one."), (NULL));
+      warp = NULL;
+    }
+
+    /* A newer map replaces one not yet picked up by the streaming thread.
+       Applications are told once it is used from the next frame on, the
+       message is posted unlocked since handlers may set properties */
+    if (warp) {
+      g_mutex_lock (&self->rebuild_lock);
+      gst_vpi_undistort_warp_free (self->pending_warp);
+      self->pending_warp = warp;
+      warp = NULL;
+      g_mutex_unlock (&self->rebuild_lock);
+
+      gst_element_post_message (GST_ELEMENT (self),
+          gst_message_new_element (GST_OBJECT (self),
+              gst_structure_new_empty (MAP_REBUILT_MESSAGE)));
+    }
+
+    g_mutex_lock (&self->rebuild_lock);
+  }
+  g_mutex_unlock (&self->rebuild_lock);
+
+  return NULL;
+}
+
+static void
+gst_vpi_undistort_request_rebuild (GstVpiUndistort * self)
+{
+  g_return_if_fail (self);
+
+  g_mutex_lock (&self->rebuild_lock);
+  if (self->rebuild_thread) {
+    self->rebuild_pending = TRUE;
+    g_cond_signal (&self->rebuild_cond);
+  }
+  g_mutex_unlock (&self->rebuild_lock);
+}
+
+/* Streaming thread only, the previous payload is no longer in use once
+   the last frame was synced */
+static void
+gst_vpi_undistort_swap_warp (GstVpiUndistort * self)
+{
+  GstVpiUndistortWarp *warp = NULL;
+
+  g_return_if_fail (self);
+
+  g_mutex_lock (&self->rebuild_lock);
+  warp = self->pending_warp;
+  self->pending_warp = NULL;
+  g_mutex_unlock (&self->rebuild_lock);
+
+  if (warp) {
+    GST_INFO_OBJECT (self, "Switching to the rebuilt warp map");
+    gst_vpi_undistort_warp_free (self->warp);
+    self->warp = warp;
+  }
+}
+
+static void
+gst_vpi_undistort_stop_rebuild_thread (GstVpiUndistort * self)
+{
+  GThread *thread = NULL;
+
+  g_return_if_fail (self);
+
+  g_mutex_lock (&self->rebuild_lock);
+  thread = self->rebuild_thread;
+  self->rebuild_thread = NULL;
+  self->rebuild_stop = TRUE;
+  self->rebuild_pending = FALSE;
+  g_cond_signal (&self->rebuild_cond);
+  g_mutex_unlock (&self->rebuild_lock);
+
+  if (thread) {
+    g_thread_join (thread);
+  }
+
+  g_mutex_lock (&self->rebuild_lock);
+  gst_vpi_undistort_warp_free (self->pending_warp);
+  self->pending_warp = NULL;
+  self->rebuild_stop = FALSE;
+  g_mutex_unlock (&self->rebuild_lock);
+}
+
 static gboolean
 gst_vpi_undistort_start (GstVpiFilter * filter, GstVideoInfo * in_info,
     GstVideoInfo * out_info)
 {
   GstVpiUndistort *self = NULL;
+  GstVpiUndistortCalibration calibration = { {{0}} };
   gboolean ret = TRUE;
   VPIStatus status = VPI_SUCCESS;
-  VPIWarpMap map = { 0 };
   guint width = 0;
   guint height = 0;
+  guint out_width = 0;
+  guint out_height = 0;
   gint backend = VPI_BACKEND_INVALID;
 
   g_return_val_if_fail (filter, FALSE);
@@ -427,14 +1679,16 @@ gst_vpi_undistort_start (GstVpiFilter * filter, GstVideoInfo * in_info,
 
   width = GST_VIDEO_INFO_WIDTH (in_info);
   height = GST_VIDEO_INFO_HEIGHT (in_info);
+  out_width = GST_VIDEO_INFO_WIDTH (out_info);
+  out_height = GST_VIDEO_INFO_HEIGHT (out_info);
+  backend = gst_vpi_filter_get_backend (filter);
 
-  map.grid.numHorizRegions = 1;
-  map.grid.numVertRegions = 1;
-  map.grid.regionWidth[0] = width;
-  map.grid.regionHeight[0] = height;
-  map.grid.horizInterval[0] = 1;
-  map.grid.vertInterval[0] = 1;
-  vpiWarpMapAllocData (&map);
+  /* Start may be called again on caps changes, stop rebuilding and
+     release the map of the previous size */
+  gst_vpi_undistort_stop_rebuild_thread (self);
+  gst_vpi_undistort_warp_free (self->warp);
+  self->warp = NULL;
+  self->per_plane = FALSE;
 
   /* Create default intrinsic matrix if not provided by user */
   if (!self->set_intrinsic_matrix) {
@@ -444,7 +1698,9 @@ gst_vpi_undistort_start (GstVpiFilter * filter, GstVideoInfo * in_info,
     };
     gchar *intrinsic_str = NULL;
 
+    GST_OBJECT_LOCK (self);
     memcpy (&self->intrinsic, &intrinsic, sizeof (intrinsic));
+    GST_OBJECT_UNLOCK (self);
     intrinsic_str = c_array_to_string (intrinsic, ROWS_INTRINSIC,
         COLS_INTRINSIC);
     GST_WARNING_OBJECT (self,
@@ -452,47 +1708,96 @@ gst_vpi_undistort_start (GstVpiFilter * filter, GstVideoInfo * in_info,
     g_free (intrinsic_str);
   }
 
-  if (self->distortion_model == FISHEYE) {
-    VPIFisheyeLensDistortionModel fisheye = { self->fisheye_mapping,
-      self->coefficients[K1], self->coefficients[K2], self->coefficients[K3],
-      self->coefficients[K4]
-    };
-    status = vpiWarpMapGenerateFromFisheyeLensDistortionModel (self->intrinsic,
-        self->extrinsic, self->intrinsic, &fisheye, &map);
-
-  } else {
-    VPIPolynomialLensDistortionModel polynomial = { self->coefficients[K1],
-      self->coefficients[K2], self->coefficients[K3], self->coefficients[K4],
-      self->coefficients[K5], self->coefficients[K6], self->coefficients[P1],
-      self->coefficients[P2]
-    };
-    status =
-        vpiWarpMapGenerateFromPolynomialLensDistortionModel (self->intrinsic,
-        self->extrinsic, self->intrinsic, &polynomial, &map);
-  }
-
-  if (VPI_SUCCESS != status) {
-    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not generate warp map."), (NULL));
+  if (!gst_vpi_undistort_get_calibration (self, width, height, out_width,
+          out_height, &calibration)) {
+    GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS,
+        ("Crop is larger than the input image."), (NULL));
     ret = FALSE;
     goto out;
   }
 
-  backend = gst_vpi_filter_get_backend (filter);
-  status = vpiCreateRemap (backend, &map, &self->warp);
+  status = gst_vpi_undistort_build_warp (self, &calibration, out_width,
+      out_height, backend, GST_VIDEO_INFO_FORMAT (in_info), &self->warp);
 
   if (VPI_SUCCESS != status) {
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not create payload."), (NULL));
+        ("Could not create undistortion payload."), (NULL));
     ret = FALSE;
+    goto out;
   }
 
+  g_mutex_lock (&self->rebuild_lock);
+  self->in_width = width;
+  self->in_height = height;
+  self->out_width = out_width;
+  self->out_height = out_height;
+  self->backend = backend;
+  self->format = GST_VIDEO_INFO_FORMAT (in_info);
+  self->rebuild_thread = g_thread_new ("vpiundistort-rebuild",
+      gst_vpi_undistort_rebuild_thread, self);
+  g_mutex_unlock (&self->rebuild_lock);
+
 out:
-  vpiWarpMapFreeData (&map);
+  g_free (calibration.cache_location);
   gst_vpi_undistort_summarize_properties (self);
   return ret;
 }
 
+/* Remaps luma and the interleaved chroma of NV12 separately, with chroma
+   viewed as two channels so U and V are interpolated together. The views
+   are cached in the buffers, so they outlive the frame without a sync */
+static VPIStatus
+gst_vpi_undistort_remap_planes (GstVpiUndistort * self, VPIStream stream,
+    VpiFrame * in_frame, VpiFrame * out_frame)
+{
+  VPIImage in_plane = NULL;
+  VPIImage out_plane = NULL;
+  VPIImageFormat formats[NUM_NV12_PLANES] = { VPI_IMAGE_FORMAT_U8,
+    VPI_IMAGE_FORMAT_2U8
+  };
+  VPIPayload payloads[NUM_NV12_PLANES] = { NULL };
+  gint interpolators[NUM_NV12_PLANES] = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  gint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (in_frame, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (out_frame, VPI_ERROR_INVALID_ARGUMENT);
+
+  if (!self->warp->chroma_remap) {
+    status = gst_vpi_undistort_create_chroma_remap (self->warp);
+    if (VPI_SUCCESS != status) {
+      GST_ERROR_OBJECT (self, "Could not create chroma payload: %s",
+          vpiStatusGetName (status));
+      goto out;
+    }
+  }
+
+  payloads[0] = self->warp->remap;
+  payloads[1] = self->warp->chroma_remap;
+  interpolators[0] = self->interpolator;
+  /* Chroma is smooth enough for linear, unless nearest was asked for */
+  interpolators[1] = VPI_INTERP_NEAREST == self->interpolator ?
+      VPI_INTERP_NEAREST : VPI_INTERP_LINEAR;
+
+  for (i = 0; i < NUM_NV12_PLANES && VPI_SUCCESS == status; i++) {
+    status = gst_vpi_frame_get_plane_view (in_frame, i, formats[i],
+        &in_plane);
+    if (VPI_SUCCESS == status) {
+      status = gst_vpi_frame_get_plane_view (out_frame, i, formats[i],
+          &out_plane);
+    }
+    if (VPI_SUCCESS == status) {
+      status = vpiSubmitRemap (stream, payloads[i], in_plane, out_plane,
+          interpolators[i], VPI_BOUNDARY_COND_ZERO);
+    }
+  }
+
+out:
+  return status;
+}
+
 static GstFlowReturn
 gst_vpi_undistort_transform_image (GstVpiFilter * filter, VPIStream stream,
     VpiFrame * in_frame, VpiFrame * out_frame)
@@ -512,17 +1817,154 @@ gst_vpi_undistort_transform_image (GstVpiFilter * filter, VPIStream stream,
 
   GST_LOG_OBJECT (self, "Transform image");
 
-  status =
-      vpiSubmitRemap (stream, self->warp, in_frame->image, out_frame->image,
-      self->interpolator, VPI_BOUNDARY_COND_ZERO);
+  gst_vpi_undistort_swap_warp (self);
+
+  if (!self->per_plane) {
+    status =
+        vpiSubmitRemap (stream, self->warp->remap, in_frame->image,
+        out_frame->image, self->interpolator, VPI_BOUNDARY_COND_ZERO);
+
+    /* Not every backend remaps NV12 as a whole, fall back to its planes.
+       Otherwise the map kept for chroma is not needed */
+    if (VPI_ERROR_INVALID_IMAGE_FORMAT == status
+        && GST_VIDEO_FORMAT_NV12 == self->format) {
+      GST_INFO_OBJECT (self, "Backend can't remap NV12, remapping per plane");
+      self->per_plane = TRUE;
+    } else if (VPI_SUCCESS == status) {
+      gst_vpi_undistort_release_map (self->warp);
+    }
+  }
+
+  if (self->per_plane) {
+    status = gst_vpi_undistort_remap_planes (self, stream, in_frame,
+        out_frame);
+  }
 
   if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Unable to perform remap."), ("%s", vpiStatusGetName (status)));
     ret = GST_FLOW_ERROR;
   }
 
   return ret;
 }
 
+static GstCaps *
+gst_vpi_undistort_get_backend_caps (GstVpiFilter * filter)
+{
+  const gchar *caps = VIDEO_AND_VPIIMAGE_CAPS;
+
+  g_return_val_if_fail (filter, NULL);
+
+  switch (gst_vpi_filter_get_backend (filter)) {
+    case VPI_BACKEND_CPU:
+    case VPI_BACKEND_CUDA:
+      break;
+    default:
+      caps = HW_VIDEO_AND_VPIIMAGE_CAPS;
+      break;
+  }
+
+  return gst_caps_from_string (caps);
+}
+
+static GstCaps *
+gst_vpi_undistort_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+  GstCaps *othercaps = NULL;
+  GstCaps *backend_caps = NULL;
+  GstCaps *tmp = NULL;
+  gint i = 0;
+  const gchar *dir = direction == GST_PAD_SRC ? "src" : "sink";
+  const gchar *otherdir = direction == GST_PAD_SRC ? "sink" : "src";
+
+  GST_DEBUG_OBJECT (trans,
+      "Negotiating %s caps given the following %s caps: %" GST_PTR_FORMAT
+      " and filter: %" GST_PTR_FORMAT, otherdir, dir, caps, filter);
+
+  othercaps = gst_caps_copy (caps);
+
+  for (i = 0; i < gst_caps_get_size (othercaps); ++i) {
+    GstStructure *st = gst_caps_get_structure (othercaps, i);
+
+    /* The crop and the scale are part of the warp map, so the output
+       resolution is free */
+    gst_structure_remove_field (st, "width");
+    gst_structure_remove_field (st, "height");
+  }
+
+  /* Formats are kept, so only the ones the backend remaps can pass */
+  backend_caps = gst_vpi_undistort_get_backend_caps (GST_VPI_FILTER (trans));
+  tmp = othercaps;
+  othercaps = gst_caps_intersect (othercaps, backend_caps);
+  gst_caps_unref (tmp);
+  gst_caps_unref (backend_caps);
+
+  if (filter) {
+    tmp = othercaps;
+    othercaps = gst_caps_intersect (othercaps, filter);
+    gst_caps_unref (tmp);
+  }
+
+  GST_DEBUG_OBJECT (trans, "Transformed %s caps to: %" GST_PTR_FORMAT, otherdir,
+      othercaps);
+
+  return othercaps;
+}
+
+static GstCaps *
+gst_vpi_undistort_fixate_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
+{
+  GstVpiUndistort *self = GST_VPI_UNDISTORT (trans);
+  GstStructure *caps_struct = NULL;
+  GstStructure *othercaps_struct = NULL;
+  gint caps_w = 0, caps_h = 0;
+  gint ref_w = 0, ref_h = 0;
+  gint crop_w = 0, crop_h = 0;
+  gint set_w = 0, set_h = 0;
+
+  othercaps = gst_caps_truncate (othercaps);
+  othercaps = gst_caps_make_writable (othercaps);
+
+  GST_DEBUG_OBJECT (self, "trying to fixate othercaps %" GST_PTR_FORMAT
+      " based on caps %" GST_PTR_FORMAT, othercaps, caps);
+
+  caps_struct = gst_caps_get_structure (caps, 0);
+  othercaps_struct = gst_caps_get_structure (othercaps, 0);
+
+  gst_structure_get_int (caps_struct, "width", &caps_w);
+  gst_structure_get_int (caps_struct, "height", &caps_h);
+
+  GST_OBJECT_LOCK (self);
+  crop_w = self->crop[CROP_LEFT] + self->crop[CROP_RIGHT];
+  crop_h = self->crop[CROP_TOP] + self->crop[CROP_BOTTOM];
+  GST_OBJECT_UNLOCK (self);
+
+  /* Prefer the cropped size without scaling, or a default resolution if
+     the received caps are not fixed either */
+  if (GST_PAD_SINK == direction) {
+    crop_w = -crop_w;
+    crop_h = -crop_h;
+  }
+  ref_w = (caps_w != 0) ? MAX (caps_w + crop_w, 1) : DEFAULT_WIDTH;
+  ref_h = (caps_h != 0) ? MAX (caps_h + crop_h, 1) : DEFAULT_HEIGHT;
+
+  gst_structure_fixate_field_nearest_int (othercaps_struct, "width", ref_w);
+  gst_structure_get_int (othercaps_struct, "width", &set_w);
+  GST_DEBUG_OBJECT (self, "Fixating width to %d", set_w);
+
+  gst_structure_fixate_field_nearest_int (othercaps_struct, "height", ref_h);
+  gst_structure_get_int (othercaps_struct, "height", &set_h);
+  GST_DEBUG_OBJECT (self, "Fixating height to %d", set_h);
+
+  othercaps = gst_caps_fixate (othercaps);
+  GST_DEBUG_OBJECT (self, "Fixated othercaps to %" GST_PTR_FORMAT, othercaps);
+
+  return othercaps;
+}
+
 static float *
 gst_array_to_c_array (const GValue * gst_array, guint * rows, guint * cols)
 {
@@ -639,6 +2081,8 @@ gst_vpi_undistort_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
 {
   GstVpiUndistort *self = GST_VPI_UNDISTORT (object);
+  gboolean rebuild = TRUE;
+  gboolean reconfigure = FALSE;
 
   GST_DEBUG_OBJECT (self, "set_property");
 
@@ -652,7 +2096,9 @@ gst_vpi_undistort_set_property (GObject * object, guint property_id,
           gst_vpi_undistort_set_calibration_matrix (self, value, INTRINSIC);
       break;
     case PROP_INTERPOLATOR:
+      /* Applied on every frame, the map does not depend on it */
       self->interpolator = g_value_get_enum (value);
+      rebuild = FALSE;
       break;
     case PROP_DISTORTION_MODEL:
       self->distortion_model = g_value_get_enum (value);
@@ -660,6 +2106,25 @@ gst_vpi_undistort_set_property (GObject * object, guint property_id,
     case PROP_FISHEYE_MAPPING:
       self->fisheye_mapping = g_value_get_enum (value);
       break;
+    case PROP_GRID_DENSITY:
+      self->grid_density = g_value_get_enum (value);
+      break;
+    case PROP_MAX_ERROR:
+      self->max_error = g_value_get_double (value);
+      break;
+    case PROP_CACHE_LOCATION:
+      g_free (self->cache_location);
+      self->cache_location = g_value_dup_string (value);
+      rebuild = FALSE;
+      break;
+    case PROP_CROP_LEFT:
+    case PROP_CROP_TOP:
+    case PROP_CROP_RIGHT:
+    case PROP_CROP_BOTTOM:
+      self->crop[property_id - PROP_CROP_LEFT] = g_value_get_uint (value);
+      /* The preferred output size follows the cropped size */
+      reconfigure = TRUE;
+      break;
     case PROP_K1:
     case PROP_K2:
     case PROP_K3:
@@ -675,9 +2140,18 @@ gst_vpi_undistort_set_property (GObject * object, guint property_id,
     }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      rebuild = FALSE;
       break;
   }
   GST_OBJECT_UNLOCK (self);
+
+  if (reconfigure) {
+    gst_base_transform_reconfigure_src (GST_BASE_TRANSFORM (self));
+  }
+
+  if (rebuild) {
+    gst_vpi_undistort_request_rebuild (self);
+  }
 }
 
 void
@@ -707,6 +2181,21 @@ gst_vpi_undistort_get_property (GObject * object, guint property_id,
     case PROP_FISHEYE_MAPPING:
       g_value_set_enum (value, self->fisheye_mapping);
       break;
+    case PROP_GRID_DENSITY:
+      g_value_set_enum (value, self->grid_density);
+      break;
+    case PROP_MAX_ERROR:
+      g_value_set_double (value, self->max_error);
+      break;
+    case PROP_CACHE_LOCATION:
+      g_value_set_string (value, self->cache_location);
+      break;
+    case PROP_CROP_LEFT:
+    case PROP_CROP_TOP:
+    case PROP_CROP_RIGHT:
+    case PROP_CROP_BOTTOM:
+      g_value_set_uint (value, self->crop[property_id - PROP_CROP_LEFT]);
+      break;
     case PROP_K1:
     case PROP_K2:
     case PROP_K3:
@@ -717,7 +2206,6 @@ gst_vpi_undistort_get_property (GObject * object, guint property_id,
     case PROP_P2:
     {
       gint idx = property_id - PROP_K1;
-      self->coefficients[idx] = g_value_get_double (value);
       g_value_set_double (value, self->coefficients[idx]);
       break;
     }
@@ -738,7 +2226,9 @@ gst_vpi_undistort_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (self, "stop");
 
-  vpiPayloadDestroy (self->warp);
+  gst_vpi_undistort_stop_rebuild_thread (self);
+
+  gst_vpi_undistort_warp_free (self->warp);
   self->warp = NULL;
 
   return ret;
@@ -751,5 +2241,11 @@ gst_vpi_undistort_finalize (GObject * object)
 
   GST_DEBUG_OBJECT (vpi_undistort, "finalize");
 
+  g_free (vpi_undistort->cache_location);
+  vpi_undistort->cache_location = NULL;
+
+  g_mutex_clear (&vpi_undistort->rebuild_lock);
+  g_cond_clear (&vpi_undistort->rebuild_cond);
+
   G_OBJECT_CLASS (gst_vpi_undistort_parent_class)->finalize (object);
 }
@@ -26,6 +26,9 @@ G_DECLARE_FINAL_TYPE(GstVpiUndistort, gst_vpi_undistort, GST, VPI_UNDISTORT, Gst
 #define VPI_FISHEYE_MAPPINGS_ENUM (vpi_fisheye_mapping_enum_get_type ())
     GType vpi_fisheye_mapping_enum_get_type (void);
 
+#define VPI_GRID_DENSITIES_ENUM (vpi_grid_density_enum_get_type ())
+    GType vpi_grid_density_enum_get_type (void);
+
 G_END_DECLS
 
 #endif
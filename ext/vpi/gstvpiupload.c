@@ -26,6 +26,7 @@
 #include "gstcuda.h"
 #include <gst/gstbuffer.h>
 
+#include "gst-libs/gst/vpi/gstvpi.h"
 #include "gst-libs/gst/vpi/gstvpibufferpool.h"
 #include "gst-libs/gst/vpi/gstcudameta.h"
 #include "gst-libs/gst/vpi/gstcudaallocator.h"
@@ -37,8 +38,10 @@
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_upload_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_upload_debug_category
 
-#define VPI_SUPPORTED_FORMATS "{ GRAY8, GRAY16_BE, GRAY16_LE, NV12, RGB, RGBA, RGBx, BGR, BGRA, BGRx }"
-#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE(VPI_SUPPORTED_FORMATS)
+#define VPI_SUPPORTED_FORMATS GST_VPI_SUPPORTED_FORMATS
+/* Formats VPI can't wrap, converted on upload into a supported one */
+#define VPI_CONVERTED_FORMATS "{ GRAY16_BE, I420, YV12, NV21, P010_10LE }"
+#define VIDEO_CAPS GST_VIDEO_CAPS_MAKE(VPI_SUPPORTED_FORMATS) ";" GST_VIDEO_CAPS_MAKE(VPI_CONVERTED_FORMATS)
 #define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:VPIImage", VPI_SUPPORTED_FORMATS)
 #define VIDEO_AND_NVMM_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", VPI_SUPPORTED_FORMATS)
 
@@ -48,6 +51,8 @@ struct _GstVpiUpload
   GstVideoInfo out_caps_info;
   GstVideoInfo in_caps_info;
   GstVpiBufferPool *upstream_buffer_pool;
+  GstVpiBufferPool *downstream_buffer_pool;
+  GstVideoConverter *converter;
   gboolean is_nvmm;
   EGLDisplay egl_display;
 };
@@ -60,8 +65,14 @@ static gboolean gst_vpi_upload_set_caps (GstBaseTransform * trans,
     GstCaps * incaps, GstCaps * outcaps);
 static gboolean gst_vpi_upload_propose_allocation (GstBaseTransform * trans,
     GstQuery * decide_query, GstQuery * query);
+static gboolean gst_vpi_upload_decide_allocation (GstBaseTransform * trans,
+    GstQuery * query);
 static GstFlowReturn gst_vpi_upload_transform_ip (GstBaseTransform * trans,
     GstBuffer * buf);
+static gboolean gst_vpi_upload_transform_meta (GstBaseTransform * trans,
+    GstBuffer * outbuf, GstMeta * meta, GstBuffer * inbuf);
+static GstFlowReturn gst_vpi_upload_transform (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer * outbuf);
 static void gst_vpi_upload_finalize (GObject * object);
 
 gboolean init_nvmm (GstVpiUpload * self);
@@ -74,7 +85,6 @@ static gboolean initialized = FALSE;
 gboolean gst_cuda_format_from_egl (CUeglColorFormat eglfmt,
     GstCudaFormat * fmt);
 void gst_vpi_image_free (gpointer data);
-VPIImageFormat gst_vpi_video_to_image_format (GstVideoFormat video_format);
 #define VPI_IMAGE_QUARK_STR "VPIImage"
 GQuark _vpi_image_quark;
 /*static*/ GstFlowReturn gst_vpi_filter_prepare_output_buffer (GstBaseTransform
@@ -144,8 +154,14 @@ gst_vpi_upload_class_init (GstVpiUploadClass * klass)
   base_transform_class->set_caps = GST_DEBUG_FUNCPTR (gst_vpi_upload_set_caps);
   base_transform_class->propose_allocation =
       GST_DEBUG_FUNCPTR (gst_vpi_upload_propose_allocation);
+  base_transform_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_vpi_upload_decide_allocation);
   base_transform_class->transform_ip =
       GST_DEBUG_FUNCPTR (gst_vpi_upload_transform_ip);
+  base_transform_class->transform =
+      GST_DEBUG_FUNCPTR (gst_vpi_upload_transform);
+  base_transform_class->transform_meta =
+      GST_DEBUG_FUNCPTR (gst_vpi_upload_transform_meta);
 
 //  base_transform_class->prepare_output_buffer =
 //      GST_DEBUG_FUNCPTR (gst_vpi_filter_prepare_output_buffer);
@@ -211,6 +227,8 @@ static void
 gst_vpi_upload_init (GstVpiUpload * self)
 {
   self->upstream_buffer_pool = NULL;
+  self->downstream_buffer_pool = NULL;
+  self->converter = NULL;
 
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (self), TRUE);
 
@@ -221,6 +239,105 @@ gst_vpi_upload_init (GstVpiUpload * self)
 //  init_nvmm (self);
 }
 
+/* Supported format a buffer in the given format is uploaded as */
+static GstVideoFormat
+gst_vpi_upload_get_supported_format (GstVideoFormat format)
+{
+  GstVideoFormat ret = format;
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_GRAY16_BE:
+      ret = GST_VIDEO_FORMAT_GRAY16_LE;
+      break;
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_P010_10LE:
+      ret = GST_VIDEO_FORMAT_NV12;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_vpi_upload_append_format (GValue * list, GstVideoFormat format)
+{
+  GValue value = G_VALUE_INIT;
+  guint i = 0;
+
+  for (i = 0; i < gst_value_list_get_size (list); i++) {
+    if (gst_video_format_from_string (g_value_get_string
+            (gst_value_list_get_value (list, i))) == format) {
+      return;
+    }
+  }
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, gst_video_format_to_string (format));
+  gst_value_list_append_value (list, &value);
+  g_value_unset (&value);
+}
+
+/* Replaces the format field with the formats it is uploaded as, or with
+   every format that can be uploaded into it */
+static void
+gst_vpi_upload_transform_formats (GstStructure * st, GstPadDirection direction)
+{
+  static const GstVideoFormat converted[] = { GST_VIDEO_FORMAT_GRAY16_BE,
+    GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_YV12, GST_VIDEO_FORMAT_NV21,
+    GST_VIDEO_FORMAT_P010_10LE
+  };
+  const GValue *formats = NULL;
+  const GValue *value = NULL;
+  GValue list = G_VALUE_INIT;
+  GstVideoFormat format = GST_VIDEO_FORMAT_UNKNOWN;
+  guint num_formats = 0;
+  guint i = 0, j = 0;
+
+  formats = gst_structure_get_value (st, "format");
+  if (!formats) {
+    return;
+  }
+
+  num_formats = GST_VALUE_HOLDS_LIST (formats) ?
+      gst_value_list_get_size (formats) : 1;
+  g_value_init (&list, GST_TYPE_LIST);
+
+  for (i = 0; i < num_formats; i++) {
+    value = GST_VALUE_HOLDS_LIST (formats) ?
+        gst_value_list_get_value (formats, i) : formats;
+    if (!G_VALUE_HOLDS_STRING (value)) {
+      continue;
+    }
+    format = gst_video_format_from_string (g_value_get_string (value));
+
+    if (GST_PAD_SINK == direction) {
+      gst_vpi_upload_append_format (&list,
+          gst_vpi_upload_get_supported_format (format));
+    } else {
+      gst_vpi_upload_append_format (&list, format);
+      for (j = 0; j < G_N_ELEMENTS (converted); j++) {
+        if (gst_vpi_upload_get_supported_format (converted[j]) == format) {
+          gst_vpi_upload_append_format (&list, converted[j]);
+        }
+      }
+    }
+  }
+
+  if (0 == gst_value_list_get_size (&list)) {
+    /* Nothing we know about, leave it for the intersection to drop */
+  } else if (1 == gst_value_list_get_size (&list)) {
+    gst_structure_set_value (st, "format", gst_value_list_get_value (&list,
+            0));
+  } else {
+    gst_structure_set_value (st, "format", &list);
+  }
+  g_value_unset (&list);
+}
+
 static GstCaps *
 gst_vpi_upload_transform_downstream_caps (GstVpiUpload * self,
     GstCaps * caps_src)
@@ -237,6 +354,8 @@ gst_vpi_upload_transform_downstream_caps (GstVpiUpload * self,
     /* Add VPIImage to all structures */
     gst_caps_set_features (caps_src, i,
         gst_caps_features_copy (vpiimage_feature));
+    gst_vpi_upload_transform_formats (gst_caps_get_structure (caps_src, i),
+        GST_PAD_SINK);
   }
 
   gst_caps_features_free (vpiimage_feature);
@@ -259,8 +378,10 @@ gst_vpi_upload_transform_upstream_caps (GstVpiUpload * self, GstCaps * caps_src)
 
   /* All the result caps are Linux/NVMM */
   for (i = 0; i < gst_caps_get_size (caps_src); i++) {
-    /* Linux caps */
+    /* Linux caps, which may need a conversion */
     gst_caps_set_features (caps_src, i, NULL);
+    gst_vpi_upload_transform_formats (gst_caps_get_structure (caps_src, i),
+        GST_PAD_SRC);
     /* NVMM caps */
     gst_caps_set_features (featured_caps, i,
         gst_caps_features_copy (nvmm_feature));
@@ -332,6 +453,32 @@ gst_vpi_upload_set_caps (GstBaseTransform * trans, GstCaps * incaps,
     goto out;
   }
 
+  g_clear_pointer (&self->converter, gst_video_converter_free);
+
+  /* Formats VPI can't wrap are converted into our own buffers, everything
+     else is wrapped in place */
+  if (GST_VIDEO_INFO_FORMAT (&self->in_caps_info) !=
+      GST_VIDEO_INFO_FORMAT (&self->out_caps_info)) {
+    GST_INFO_OBJECT (self, "Converting %s into %s on upload",
+        GST_VIDEO_INFO_NAME (&self->in_caps_info),
+        GST_VIDEO_INFO_NAME (&self->out_caps_info));
+    if (GST_VIDEO_INFO_COMP_DEPTH (&self->in_caps_info, 0) >
+        GST_VIDEO_INFO_COMP_DEPTH (&self->out_caps_info, 0)) {
+      GST_ELEMENT_WARNING (self, STREAM, FORMAT,
+          ("%s is reduced to %d bits per component on upload.",
+              GST_VIDEO_INFO_NAME (&self->in_caps_info),
+              GST_VIDEO_INFO_COMP_DEPTH (&self->out_caps_info, 0)), (NULL));
+    }
+    self->converter = gst_video_converter_new (&self->in_caps_info,
+        &self->out_caps_info, NULL);
+    if (!self->converter) {
+      GST_ERROR_OBJECT (self, "Unable to create the format converter");
+      ret = FALSE;
+      goto out;
+    }
+  }
+  gst_base_transform_set_in_place (trans, NULL == self->converter);
+
   ret = TRUE;
 
 out:
@@ -389,6 +536,13 @@ gst_vpi_upload_propose_allocation (GstBaseTransform * trans,
   GstVpiUpload *self = GST_VPI_UPLOAD (trans);
 
   GST_INFO_OBJECT (self, "Proposing upstream allocation");
+
+  if (self->converter) {
+    /* Input is read by the converter, any system memory will do */
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+    return TRUE;
+  }
+
   if (!self->upstream_buffer_pool) {
     self->upstream_buffer_pool = g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
   }
@@ -397,6 +551,119 @@ gst_vpi_upload_propose_allocation (GstBaseTransform * trans,
       self->upstream_buffer_pool, query);
 }
 
+static gboolean
+gst_vpi_upload_decide_allocation (GstBaseTransform * trans, GstQuery * query)
+{
+  GstVpiUpload *self = GST_VPI_UPLOAD (trans);
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  GstCaps *caps = NULL;
+  gsize size = 0;
+  gboolean ret = FALSE;
+
+  if (!self->converter) {
+    ret = GST_BASE_TRANSFORM_CLASS (gst_vpi_upload_parent_class)->
+        decide_allocation (trans, query);
+    goto out;
+  }
+
+  /* Converted frames need unified memory, so downstream pools can't be
+     used */
+  if (!self->downstream_buffer_pool) {
+    self->downstream_buffer_pool =
+        g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
+  }
+
+  gst_query_parse_allocation (query, &caps, NULL);
+
+  pool = GST_BUFFER_POOL (self->downstream_buffer_pool);
+  size = GST_VIDEO_INFO_SIZE (&self->out_caps_info);
+
+  if (gst_buffer_pool_is_active (pool)) {
+    gst_buffer_pool_set_active (pool, FALSE);
+  }
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, 0, 0);
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ERROR_OBJECT (self, "Unable to set pool configuration");
+    goto out;
+  }
+
+  while (gst_query_get_n_allocation_pools (query) > 0) {
+    gst_query_remove_nth_allocation_pool (query, 0);
+  }
+  gst_query_add_allocation_pool (query, pool, size, 2, 0);
+
+  ret = TRUE;
+
+out:
+  return ret;
+}
+
+/* Uploading keeps the size and orientation of the frame, so metas that
+   only depend on them still apply to the output */
+static gboolean
+gst_vpi_upload_transform_meta (GstBaseTransform * trans, GstBuffer * outbuf,
+    GstMeta * meta, GstBuffer * inbuf)
+{
+  const gchar *const *tags = NULL;
+  gboolean ret = TRUE;
+  guint i = 0;
+
+  g_return_val_if_fail (meta, FALSE);
+
+  tags = gst_meta_api_type_get_tags (meta->info->api);
+  for (i = 0; tags && tags[i]; i++) {
+    if (0 != g_strcmp0 (tags[i], GST_META_TAG_VIDEO_STR)
+        && 0 != g_strcmp0 (tags[i], GST_META_TAG_VIDEO_SIZE_STR)
+        && 0 != g_strcmp0 (tags[i], GST_META_TAG_VIDEO_ORIENTATION_STR)) {
+      ret = FALSE;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_vpi_upload_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstVpiUpload *self = GST_VPI_UPLOAD (trans);
+  GstVideoFrame in_frame = { 0 };
+  GstVideoFrame out_frame = { 0 };
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_return_val_if_fail (self->converter, GST_FLOW_ERROR);
+
+  if (!gst_video_frame_map (&in_frame, &self->in_caps_info, inbuf,
+          GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, ("Unable to map input buffer."),
+        (NULL));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  if (!gst_video_frame_map (&out_frame, &self->out_caps_info, outbuf,
+          GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, WRITE, ("Unable to map output buffer."),
+        (NULL));
+    ret = GST_FLOW_ERROR;
+    goto unmap;
+  }
+
+  gst_video_converter_frame (self->converter, &in_frame, &out_frame);
+
+  gst_video_frame_unmap (&out_frame);
+
+unmap:
+  gst_video_frame_unmap (&in_frame);
+
+out:
+  return ret;
+}
+
 static GstFlowReturn
 gst_vpi_upload_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
 {
@@ -466,6 +733,8 @@ gst_vpi_upload_finalize (GObject * object)
   GST_DEBUG_OBJECT (self, "Freeing resources");
 
   g_clear_object (&self->upstream_buffer_pool);
+  g_clear_object (&self->downstream_buffer_pool);
+  g_clear_pointer (&self->converter, gst_video_converter_free);
 
   //Delete the EGL Display
   if (self->egl_display && !eglTerminate (self->egl_display)) {
@@ -530,55 +799,6 @@ gst_vpi_image_free (gpointer data)
   vpiImageDestroy (image);
 }
 
-
-VPIImageFormat
-gst_vpi_video_to_image_format (GstVideoFormat video_format)
-{
-  VPIImageFormat ret;
-
-  switch (video_format) {
-    case GST_VIDEO_FORMAT_GRAY8:{
-      ret = VPI_IMAGE_FORMAT_U8;
-      break;
-    }
-    case GST_VIDEO_FORMAT_GRAY16_BE:{
-      ret = VPI_IMAGE_FORMAT_U16;
-      break;
-    }
-    case GST_VIDEO_FORMAT_GRAY16_LE:{
-      ret = VPI_IMAGE_FORMAT_U16;
-      break;
-    }
-    case GST_VIDEO_FORMAT_NV12:{
-      ret = VPI_IMAGE_FORMAT_NV12;
-      break;
-    }
-    case GST_VIDEO_FORMAT_RGB:{
-      ret = VPI_IMAGE_FORMAT_RGB8;
-      break;
-    }
-    case GST_VIDEO_FORMAT_RGBx:
-    case GST_VIDEO_FORMAT_RGBA:{
-      ret = VPI_IMAGE_FORMAT_RGBA8;
-      break;
-    }
-    case GST_VIDEO_FORMAT_BGR:{
-      ret = VPI_IMAGE_FORMAT_BGR8;
-      break;
-    }
-    case GST_VIDEO_FORMAT_BGRx:
-    case GST_VIDEO_FORMAT_BGRA:{
-      ret = VPI_IMAGE_FORMAT_BGRA8;
-      break;
-    }
-    default:{
-      ret = VPI_IMAGE_FORMAT_INVALID;
-    }
-  }
-
-  return ret;
-}
-
 /*const GstMetaInfo *
 gst_vpi_meta_get_info (void)
 {
@@ -19,36 +19,12 @@
 #include <gst/gst.h>
 #include <vpi/algo/ConvertImageFormat.h>
 
+#include "gst-libs/gst/vpi/gstvpi.h"
+
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_video_convert_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_video_convert_debug_category
 
-#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", "{ GRAY8, GRAY16_LE, NV12, RGB, BGR, RGBA, BGRA, RGBx, BGRx }")
-
-#define VPI_CONVERSION_POLICY_ENUM (vpi_conversion_policy_enum_get_type ())
-GType vpi_conversion_policy_enum_get_type (void);
-
-GType
-vpi_conversion_policy_enum_get_type (void)
-{
-  static GType vpi_conversion_policy_enum_type = 0;
-  static const GEnumValue values[] = {
-    {VPI_CONVERSION_CAST, "Casts input to the output type. Overflows "
-          "and underflows are handled as per C specification, including "
-          "situations of undefined behavior.", "cast"},
-    {VPI_CONVERSION_CLAMP, "Clamps input to output's type range. Overflows "
-          "and underflows are mapped to the output type's maximum and minimum "
-          "representable value, respectively. When output type is floating point, "
-          "clamp behaves like cast.", "clamp"},
-    {0, NULL, NULL}
-  };
-
-  if (!vpi_conversion_policy_enum_type) {
-    vpi_conversion_policy_enum_type =
-        g_enum_register_static ("VpiConversionPolicy", values);
-  }
-
-  return vpi_conversion_policy_enum_type;
-}
+#define VIDEO_AND_VPIIMAGE_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("memory:VPIImage", GST_VPI_SUPPORTED_FORMATS)
 
 struct _GstVpiVideoConvert
 {
@@ -17,6 +17,8 @@
 #include "gstvpivideoscale.h"
 
 #include <gst/gst.h>
+#include <gst/video/gstvideometa.h>
+#include <string.h>
 #include <vpi/algo/Rescale.h>
 
 #include "gst-libs/gst/vpi/gstvpi.h"
@@ -28,6 +30,14 @@ GST_DEBUG_CATEGORY_STATIC (gst_vpi_video_scale_debug_category);
 
 #define DEFAULT_PROP_INTERPOLATOR VPI_INTERP_LINEAR
 #define DEFAULT_PROP_BOUNDARY_COND VPI_BOUNDARY_COND_ZERO
+#define DEFAULT_PROP_ADD_BORDERS FALSE
+#define DEFAULT_PROP_BORDER_COLOR 0xff000000
+
+#define MAX_PIXEL_STRIDE 4
+#define MAX_PLANES 2
+#define NUM_BORDERS 4
+/* Smallest image with a full chroma sample in every format */
+#define BORDER_IMAGE_SIZE 2
 
 #define DEFAULT_WIDTH 1920
 #define DEFAULT_HEIGHT 1080
@@ -38,9 +48,28 @@ struct _GstVpiVideoScale
 
   gint interpolator;
   gint boundary_cond;
+  gboolean add_borders;
+  guint border_color;
+
+  GstVideoFormat format;
+  gint in_width;
+  gint in_height;
+  gint in_par_n;
+  gint in_par_d;
+  gint out_width;
+  gint out_height;
+  gint out_par_n;
+  gint out_par_d;
+
+  VPIImage border_image;
+  guint border_image_color;
+  gboolean border_image_valid;
 };
 
 /* prototypes */
+static gboolean gst_vpi_video_scale_start (GstVpiFilter * filter,
+    GstVideoInfo * in_info, GstVideoInfo * out_info);
+static gboolean gst_vpi_video_scale_stop (GstBaseTransform * trans);
 static GstFlowReturn gst_vpi_video_scale_transform_image (GstVpiFilter *
     filter, VPIStream stream, VpiFrame * in_frame, VpiFrame * out_frame);
 static GstCaps *gst_vpi_video_scale_fixate_caps (GstBaseTransform * base,
@@ -56,7 +85,9 @@ enum
 {
   PROP_0,
   PROP_INTERPOLATOR,
-  PROP_BOUNDARY_COND
+  PROP_BOUNDARY_COND,
+  PROP_ADD_BORDERS,
+  PROP_BORDER_COLOR
 };
 
 /* class initialization */
@@ -85,8 +116,10 @@ gst_vpi_video_scale_class_init (GstVpiVideoScaleClass * klass)
       "Rescales video from one resolution to another using VPI",
       "Jimena Salas <jimena.salas@ridgerun.com>");
 
+  vpi_filter_class->start = GST_DEBUG_FUNCPTR (gst_vpi_video_scale_start);
   vpi_filter_class->transform_image =
       GST_DEBUG_FUNCPTR (gst_vpi_video_scale_transform_image);
+  bt_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_video_scale_stop);
   bt_class->fixate_caps = GST_DEBUG_FUNCPTR (gst_vpi_video_scale_fixate_caps);
   bt_class->transform_caps =
       GST_DEBUG_FUNCPTR (gst_vpi_video_scale_transform_caps);
@@ -105,6 +138,21 @@ gst_vpi_video_scale_class_init (GstVpiVideoScaleClass * klass)
           VPI_BOUNDARY_CONDS_ENUM, DEFAULT_PROP_BOUNDARY_COND,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property (gobject_class, PROP_ADD_BORDERS,
+      g_param_spec_boolean ("add-borders", "Add borders",
+          "Keep the display aspect ratio of the input by adding borders "
+          "instead of stretching it to the output size.",
+          DEFAULT_PROP_ADD_BORDERS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_BORDER_COLOR,
+      g_param_spec_uint ("border-color", "Border color",
+          "Color of the borders added by add-borders, in big-endian ARGB.",
+          0, G_MAXUINT32, DEFAULT_PROP_BORDER_COLOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
   /* Disable any sort of processing if input/output caps are equal */
   bt_class->passthrough_on_same_caps = TRUE;
   bt_class->transform_ip_on_passthrough = FALSE;
@@ -115,6 +163,265 @@ gst_vpi_video_scale_init (GstVpiVideoScale * self)
 {
   self->interpolator = DEFAULT_PROP_INTERPOLATOR;
   self->boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  self->add_borders = DEFAULT_PROP_ADD_BORDERS;
+  self->border_color = DEFAULT_PROP_BORDER_COLOR;
+  self->format = GST_VIDEO_FORMAT_UNKNOWN;
+  self->in_width = 0;
+  self->in_height = 0;
+  self->in_par_n = 1;
+  self->in_par_d = 1;
+  self->out_width = 0;
+  self->out_height = 0;
+  self->out_par_n = 1;
+  self->out_par_d = 1;
+  self->border_image = NULL;
+  self->border_image_color = DEFAULT_PROP_BORDER_COLOR;
+  self->border_image_valid = FALSE;
+}
+
+static gboolean
+gst_vpi_video_scale_start (GstVpiFilter * filter, GstVideoInfo * in_info,
+    GstVideoInfo * out_info)
+{
+  GstVpiVideoScale *self = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (filter, FALSE);
+  g_return_val_if_fail (in_info, FALSE);
+  g_return_val_if_fail (out_info, FALSE);
+
+  self = GST_VPI_VIDEO_SCALE (filter);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  self->format = GST_VIDEO_INFO_FORMAT (out_info);
+  self->in_width = GST_VIDEO_INFO_WIDTH (in_info);
+  self->in_height = GST_VIDEO_INFO_HEIGHT (in_info);
+  self->in_par_n = MAX (GST_VIDEO_INFO_PAR_N (in_info), 1);
+  self->in_par_d = MAX (GST_VIDEO_INFO_PAR_D (in_info), 1);
+  self->out_width = GST_VIDEO_INFO_WIDTH (out_info);
+  self->out_height = GST_VIDEO_INFO_HEIGHT (out_info);
+  self->out_par_n = MAX (GST_VIDEO_INFO_PAR_N (out_info), 1);
+  self->out_par_d = MAX (GST_VIDEO_INFO_PAR_D (out_info), 1);
+
+  /* The borders are stretched out of this image on the stream, so it is
+     only painted by the CPU when the color changes */
+  vpiImageDestroy (self->border_image);
+  self->border_image = NULL;
+  self->border_image_valid = FALSE;
+
+  status = vpiImageCreate (BORDER_IMAGE_SIZE, BORDER_IMAGE_SIZE,
+      gst_vpi_video_to_image_format (self->format), VPI_BACKEND_ALL,
+      &self->border_image);
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Could not create border image."), ("%s",
+            vpiStatusGetName (status)));
+    ret = FALSE;
+  }
+
+  return ret;
+}
+
+/* Largest rectangle of the output that shows the source with its display
+   aspect ratio, centered */
+static void
+gst_vpi_video_scale_get_dest_rect (GstVpiVideoScale * self, gint src_width,
+    gint src_height, GstVideoRectangle * rect)
+{
+  gdouble src_dar = 0;
+  gdouble out_par = 0;
+  gdouble width = 0;
+  gdouble height = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (rect);
+
+  src_dar = (gdouble) src_width * self->in_par_n /
+      ((gdouble) src_height * self->in_par_d);
+  out_par = (gdouble) self->out_par_n / self->out_par_d;
+
+  height = self->out_height;
+  width = src_dar * height / out_par;
+  if (width > self->out_width) {
+    width = self->out_width;
+    height = width * out_par / src_dar;
+  }
+
+  /* Even sizes and offsets keep subsampled chroma aligned */
+  rect->w = CLAMP (GST_ROUND_DOWN_2 ((gint) (width + 0.5)), 1,
+      self->out_width);
+  rect->h = CLAMP (GST_ROUND_DOWN_2 ((gint) (height + 0.5)), 1,
+      self->out_height);
+  rect->x = GST_ROUND_DOWN_2 ((self->out_width - rect->w) / 2);
+  rect->y = GST_ROUND_DOWN_2 ((self->out_height - rect->h) / 2);
+}
+
+/* Bytes of a single pixel of the border color for each plane */
+static void
+gst_vpi_video_scale_get_border_pixel (GstVideoFormat format, guint color,
+    guint8 pixel[MAX_PLANES][MAX_PIXEL_STRIDE])
+{
+  guint8 a = (color >> 24) & 0xff;
+  guint8 r = (color >> 16) & 0xff;
+  guint8 g = (color >> 8) & 0xff;
+  guint8 b = color & 0xff;
+  guint8 luma = (299 * r + 587 * g + 114 * b) / 1000;
+  guint8 rgb[] = { r, g, b, a };
+  guint8 bgr[] = { b, g, r, a };
+
+  memset (pixel, 0, MAX_PLANES * MAX_PIXEL_STRIDE);
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_GRAY8:
+      pixel[0][0] = luma;
+      break;
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+      pixel[0][0] = luma;
+      pixel[0][1] = luma;
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+      /* BT.601 limited range */
+      pixel[0][0] = (16 * 255 + 65.481 * r + 128.553 * g + 24.966 * b) / 255;
+      pixel[1][0] = (128 * 255 - 37.797 * r - 74.203 * g + 112.0 * b) / 255;
+      pixel[1][1] = (128 * 255 + 112.0 * r - 93.786 * g - 18.214 * b) / 255;
+      break;
+    case GST_VIDEO_FORMAT_RGB:
+    case GST_VIDEO_FORMAT_RGBA:
+    case GST_VIDEO_FORMAT_RGBx:
+      memcpy (pixel[0], rgb, sizeof (rgb));
+      break;
+    case GST_VIDEO_FORMAT_BGR:
+    case GST_VIDEO_FORMAT_BGRA:
+    case GST_VIDEO_FORMAT_BGRx:
+      memcpy (pixel[0], bgr, sizeof (bgr));
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+gst_vpi_video_scale_fill_span (guint8 * data, const guint8 * pixel,
+    gint pixel_stride, gint count)
+{
+  gint i = 0;
+
+  for (i = 0; i < count; i++) {
+    memcpy (data + i * pixel_stride, pixel, pixel_stride);
+  }
+}
+
+/* Paints the border image with the color, unless it already has it */
+static VPIStatus
+gst_vpi_video_scale_update_border_image (GstVpiVideoScale * self,
+    guint color)
+{
+  VPIImageData image_data = { 0 };
+  const GstVideoFormatInfo *finfo = NULL;
+  guint8 pixel[MAX_PLANES][MAX_PIXEL_STRIDE] = { {0} };
+  VPIImagePlane *plane = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  gint pixel_stride = 0;
+  guint comp = 0;
+  gint i = 0, row = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (self->border_image, VPI_ERROR_INVALID_ARGUMENT);
+
+  if (self->border_image_valid && self->border_image_color == color) {
+    goto out;
+  }
+
+  status = vpiImageLock (self->border_image, VPI_LOCK_WRITE, &image_data);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+
+  finfo = gst_video_format_get_info (self->format);
+  gst_vpi_video_scale_get_border_pixel (self->format, color, pixel);
+
+  for (i = 0; i < image_data.numPlanes && i < MAX_PLANES; i++) {
+    plane = &image_data.planes[i];
+
+    /* First component stored in this plane */
+    for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); comp++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == i) {
+        break;
+      }
+    }
+
+    pixel_stride = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+    for (row = 0; row < plane->height; row++) {
+      gst_vpi_video_scale_fill_span ((guint8 *) plane->data +
+          row * plane->pitchBytes, pixel[i], pixel_stride, plane->width);
+    }
+  }
+
+  vpiImageUnlock (self->border_image);
+
+  self->border_image_color = color;
+  self->border_image_valid = TRUE;
+
+out:
+  return status;
+}
+
+/* Stretches the border image over the output around rect, leaving the
+   inside untouched for the rescale. The views in borders have to outlive
+   the stream work */
+static VPIStatus
+gst_vpi_video_scale_fill_borders (GstVpiVideoScale * self, VPIStream stream,
+    gint backend, VPIImage image, const GstVideoRectangle * rect,
+    VPIImage borders[NUM_BORDERS])
+{
+  GstVideoRectangle border_rects[NUM_BORDERS] = { {0} };
+  GstVideoRectangle *border = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  gint i = 0;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (stream, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (rect, VPI_ERROR_INVALID_ARGUMENT);
+
+  /* Top, bottom, left and right */
+  border_rects[0].w = self->out_width;
+  border_rects[0].h = rect->y;
+  border_rects[1].y = rect->y + rect->h;
+  border_rects[1].w = self->out_width;
+  border_rects[1].h = self->out_height - border_rects[1].y;
+  border_rects[2].y = rect->y;
+  border_rects[2].w = rect->x;
+  border_rects[2].h = rect->h;
+  border_rects[3].x = rect->x + rect->w;
+  border_rects[3].y = rect->y;
+  border_rects[3].w = self->out_width - border_rects[3].x;
+  border_rects[3].h = rect->h;
+
+  for (i = 0; i < NUM_BORDERS; i++) {
+    border = &border_rects[i];
+    if (border->w <= 0 || border->h <= 0) {
+      continue;
+    }
+
+    status = gst_vpi_image_create_view (image, border->x, border->y,
+        border->w, border->h, &borders[i]);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+
+    /* Nearest keeps the color exact */
+    status = vpiSubmitRescale (stream, backend, self->border_image,
+        borders[i], VPI_INTERP_NEAREST, VPI_BOUNDARY_COND_CLAMP);
+    if (VPI_SUCCESS != status) {
+      goto out;
+    }
+  }
+
+out:
+  return status;
 }
 
 static GstFlowReturn
@@ -124,9 +431,20 @@ gst_vpi_video_scale_transform_image (GstVpiFilter * filter,
   GstVpiVideoScale *self = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   VPIStatus status = VPI_SUCCESS;
+  GstVideoCropMeta *crop = NULL;
+  GstVideoRectangle crop_rect = { 0 };
+  GstVideoRectangle rect = { 0 };
+  VPIImage src_view = NULL;
+  VPIImage dst_view = NULL;
+  VPIImage borders[NUM_BORDERS] = { NULL };
   gint backend = VPI_BACKEND_INVALID;
   guint interpolator = DEFAULT_PROP_INTERPOLATOR;
   guint boundary_cond = DEFAULT_PROP_BOUNDARY_COND;
+  gboolean add_borders = DEFAULT_PROP_ADD_BORDERS;
+  guint border_color = DEFAULT_PROP_BORDER_COLOR;
+  gint src_width = 0;
+  gint src_height = 0;
+  gint i = 0;
 
   g_return_val_if_fail (filter, GST_FLOW_ERROR);
   g_return_val_if_fail (stream, GST_FLOW_ERROR);
@@ -144,11 +462,67 @@ gst_vpi_video_scale_transform_image (GstVpiFilter * filter,
   GST_OBJECT_LOCK (self);
   interpolator = self->interpolator;
   boundary_cond = self->boundary_cond;
+  add_borders = self->add_borders;
+  border_color = self->border_color;
   GST_OBJECT_UNLOCK (self);
 
-  status =
-      vpiSubmitRescale (stream, backend, in_frame->image, out_frame->image,
-      interpolator, boundary_cond);
+  src_width = self->in_width;
+  src_height = self->in_height;
+
+  /* Crops are views into the input, nothing is copied. Subsampled chroma
+     can only be cropped on its own grid */
+  crop = gst_buffer_get_video_crop_meta (in_frame->buffer);
+  if (crop) {
+    crop_rect.x = crop->x;
+    crop_rect.y = crop->y;
+    crop_rect.w = crop->width;
+    crop_rect.h = crop->height;
+  }
+  if (crop && gst_vpi_filter_clip_region (&GST_VIDEO_FILTER (filter)->in_info,
+          &crop_rect) && (crop_rect.x || crop_rect.y
+          || crop_rect.w != src_width || crop_rect.h != src_height)) {
+    status = gst_vpi_image_create_view (in_frame->image, crop_rect.x,
+        crop_rect.y, crop_rect.w, crop_rect.h, &src_view);
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not crop the input to %dx%d+%d+%d.", crop_rect.w,
+              crop_rect.h, crop_rect.x, crop_rect.y), ("%s",
+              vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+    src_width = crop_rect.w;
+    src_height = crop_rect.h;
+  }
+
+  rect.w = self->out_width;
+  rect.h = self->out_height;
+  if (add_borders) {
+    gst_vpi_video_scale_get_dest_rect (self, src_width, src_height, &rect);
+  }
+
+  if (rect.w != self->out_width || rect.h != self->out_height) {
+    status = gst_vpi_video_scale_update_border_image (self, border_color);
+    if (VPI_SUCCESS == status) {
+      status = gst_vpi_video_scale_fill_borders (self, stream, backend,
+          out_frame->image, &rect, borders);
+    }
+    if (VPI_SUCCESS == status) {
+      status = gst_vpi_image_create_view (out_frame->image, rect.x, rect.y,
+          rect.w, rect.h, &dst_view);
+    }
+    if (VPI_SUCCESS != status) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not add borders to the output."), ("%s",
+              vpiStatusGetName (status)));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+  }
+
+  status = vpiSubmitRescale (stream, backend,
+      src_view ? src_view : in_frame->image,
+      dst_view ? dst_view : out_frame->image, interpolator, boundary_cond);
 
   if (VPI_SUCCESS != status) {
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
@@ -156,6 +530,36 @@ gst_vpi_video_scale_transform_image (GstVpiFilter * filter,
     ret = GST_FLOW_ERROR;
   }
 
+out:
+  if (src_view || dst_view || borders[0] || borders[1] || borders[2]
+      || borders[3]) {
+    /* The views have to outlive the rescales */
+    vpiStreamSync (stream);
+    vpiImageDestroy (src_view);
+    vpiImageDestroy (dst_view);
+    for (i = 0; i < NUM_BORDERS; i++) {
+      vpiImageDestroy (borders[i]);
+    }
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_vpi_video_scale_stop (GstBaseTransform * trans)
+{
+  GstVpiVideoScale *self = GST_VPI_VIDEO_SCALE (trans);
+  gboolean ret = TRUE;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_vpi_video_scale_parent_class)->stop
+      (trans);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  vpiImageDestroy (self->border_image);
+  self->border_image = NULL;
+  self->border_image_valid = FALSE;
+
   return ret;
 }
 
@@ -168,6 +572,9 @@ gst_vpi_video_scale_fixate_caps (GstBaseTransform * base,
   GstStructure *othercaps_struct = NULL;
   gint ref_w = 0, ref_h = 0;
   gint set_w = 0, set_h = 0;
+  gint par_n = 1, par_d = 1;
+  gint set_par_n = 1, set_par_d = 1;
+  gboolean add_borders = DEFAULT_PROP_ADD_BORDERS;
   const gchar *dir = direction == GST_PAD_SRC ? "src" : "sink";
   const gchar *otherdir = direction == GST_PAD_SRC ? "sink" : "src";
 
@@ -198,6 +605,27 @@ gst_vpi_video_scale_fixate_caps (GstBaseTransform * base,
   gst_structure_get_int (othercaps_struct, "height", &set_h);
   GST_DEBUG_OBJECT (base, "Fixating height to %d", set_h);
 
+  GST_OBJECT_LOCK (base);
+  add_borders = GST_VPI_VIDEO_SCALE (base)->add_borders;
+  GST_OBJECT_UNLOCK (base);
+
+  /* Fixate pixel aspect ratio. Borders keep the one from the other side,
+     otherwise pick the one that preserves the display aspect ratio */
+  gst_structure_get_fraction (caps_struct, "pixel-aspect-ratio", &par_n,
+      &par_d);
+  if (!add_borders && caps_w && caps_h && set_w && set_h) {
+    gst_util_fraction_multiply (par_n, par_d, caps_w * set_h, caps_h * set_w,
+        &par_n, &par_d);
+  }
+  if (gst_structure_has_field (othercaps_struct, "pixel-aspect-ratio")) {
+    gst_structure_fixate_field_nearest_fraction (othercaps_struct,
+        "pixel-aspect-ratio", par_n, par_d);
+  }
+  gst_structure_get_fraction (othercaps_struct, "pixel-aspect-ratio",
+      &set_par_n, &set_par_d);
+  GST_DEBUG_OBJECT (base, "Fixating pixel aspect ratio to %d/%d", set_par_n,
+      set_par_d);
+
   othercaps = gst_caps_fixate (othercaps);
   GST_DEBUG_OBJECT (base, "Fixated othercaps to %" GST_PTR_FORMAT, othercaps);
 
@@ -223,10 +651,14 @@ gst_vpi_video_scale_transform_caps (GstBaseTransform * trans,
     GstStructure *st = gst_caps_get_structure (othercaps, i);
 
     /* Remove the width and height fields since they are
-       the only ones allowed to change.
+       the only ones allowed to change, along with the pixel aspect ratio.
      */
     gst_structure_remove_field (st, "width");
     gst_structure_remove_field (st, "height");
+    if (gst_structure_has_field (st, "pixel-aspect-ratio")) {
+      gst_structure_set (st, "pixel-aspect-ratio", GST_TYPE_FRACTION_RANGE,
+          1, G_MAXINT, G_MAXINT, 1, NULL);
+    }
   }
 
   if (filter) {
@@ -259,6 +691,12 @@ gst_vpi_video_scale_set_property (GObject * object, guint property_id,
     case PROP_BOUNDARY_COND:
       self->boundary_cond = g_value_get_enum (value);
       break;
+    case PROP_ADD_BORDERS:
+      self->add_borders = g_value_get_boolean (value);
+      break;
+    case PROP_BORDER_COLOR:
+      self->border_color = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -284,6 +722,12 @@ gst_vpi_video_scale_get_property (GObject * object, guint property_id,
     case PROP_BOUNDARY_COND:
       g_value_set_enum (value, self->boundary_cond);
       break;
+    case PROP_ADD_BORDERS:
+      g_value_set_boolean (value, self->add_borders);
+      break;
+    case PROP_BORDER_COLOR:
+      g_value_set_uint (value, self->border_color);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -21,6 +21,7 @@
 #include <vpi/algo/PerspectiveWarp.h>
 
 #include "gst-libs/gst/vpi/gstvpi.h"
+#include "gst-libs/gst/vpi/gstvpitransformmeta.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_warp_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_warp_debug_category
@@ -43,6 +44,10 @@ struct _GstVpiWarp
   GstVpiFilter parent;
   VPIPayload warp;
   VPIPerspectiveTransform transform;
+  /* Inverse of the last direct matrix, reused while it doesn't change */
+  VPIPerspectiveTransform inverse;
+  VPIPerspectiveTransform inverse_source;
+  gboolean inverse_valid;
   gint interpolator;
   guint warp_flag;
   gboolean demo;
@@ -117,7 +122,9 @@ gst_vpi_warp_class_init (GstVpiWarpClass * klass)
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "VPI Warp", "Filter/Video",
-      "VPI based perspective warp converter element.",
+      "VPI based perspective warp converter element. A GstVpiTransformMeta "
+      "on the input buffer takes precedence over the transformation "
+      "property for that frame.",
       "Jimena Salas <jimena.salas@ridgerun.com>");
 
   vpi_filter_class->transform_image =
@@ -143,7 +150,7 @@ gst_vpi_warp_class_init (GstVpiWarpClass * klass)
       gst_param_spec_array ("transformation",
           "Transformation to be applied",
           "3x3 transformation matrix.\nIf not provided, no transformation "
-          "will be performed\n"
+          "will be performed. Ignored for buffers carrying a transform meta.\n"
           "Usage example: <<1.0,0.0,0.0>,<0.0,1.0,0.0>,<0.0,0.0,1.0>>",
           gst_param_spec_array ("matrix-rows", "rows", "rows",
               g_param_spec_double ("matrix-cols", "cols", "cols",
@@ -173,6 +180,7 @@ gst_vpi_warp_init (GstVpiWarp * self)
   self->width = 0;
   self->height = 0;
   self->demo_angle = 0;
+  self->inverse_valid = FALSE;
 
   memcpy (&self->transform, &transform, sizeof (transform));
 }
@@ -196,6 +204,7 @@ gst_vpi_warp_start (GstVpiFilter * filter, GstVideoInfo * in_info,
 
   self->width = GST_VIDEO_INFO_WIDTH (in_info);
   self->height = GST_VIDEO_INFO_HEIGHT (in_info);
+  self->inverse_valid = FALSE;
 
   backend = gst_vpi_filter_get_backend (filter);
 
@@ -232,6 +241,38 @@ matrix_multiply (gfloat result[NUM_ROWS_COLS][NUM_ROWS_COLS],
   }
 }
 
+static gboolean
+matrix_invert (VPIPerspectiveTransform result, VPIPerspectiveTransform m)
+{
+  gdouble det = 0;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (result, FALSE);
+  g_return_val_if_fail (m, FALSE);
+
+  det = m[0][0] * ((gdouble) m[1][1] * m[2][2] - (gdouble) m[1][2] * m[2][1])
+      - m[0][1] * ((gdouble) m[1][0] * m[2][2] - (gdouble) m[1][2] * m[2][0])
+      + m[0][2] * ((gdouble) m[1][0] * m[2][1] - (gdouble) m[1][1] * m[2][0]);
+
+  if (fabs (det) < G_MINDOUBLE) {
+    ret = FALSE;
+    goto out;
+  }
+
+  result[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+  result[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+  result[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+  result[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+  result[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+  result[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+  result[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+  result[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+  result[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+
+out:
+  return ret;
+}
+
 static gdouble
 degrees_to_radians (gdouble degrees)
 {
@@ -273,7 +314,11 @@ gst_vpi_warp_transform_image (GstVpiFilter * filter, VPIStream stream,
   GstVpiWarp *self = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   VPIStatus status = VPI_SUCCESS;
+  GstVpiTransformMeta *meta = NULL;
+  VPIPerspectiveTransform transform = { {0} };
   gboolean demo = DEFAULT_PROP_DEMO;
+  gint interpolator = DEFAULT_PROP_INTERPOLATOR;
+  guint warp_flag = DEFAULT_PROP_WARP_FLAG;
 
   g_return_val_if_fail (filter, GST_FLOW_ERROR);
   g_return_val_if_fail (stream, GST_FLOW_ERROR);
@@ -293,22 +338,61 @@ gst_vpi_warp_transform_image (GstVpiFilter * filter, VPIStream stream,
   if (demo) {
     gdouble angle = degrees_to_radians (self->demo_angle);
     gst_vpi_warp_demo (self, angle, self->width, self->height);
+  } else {
+    meta = gst_buffer_get_vpi_transform_meta (in_frame->buffer);
   }
 
   GST_OBJECT_LOCK (self);
+  if (meta) {
+    memcpy (transform, meta->transform, sizeof (transform));
+  } else {
+    memcpy (transform, self->transform, sizeof (transform));
+  }
+  interpolator = self->interpolator;
+  warp_flag = self->warp_flag;
+  GST_OBJECT_UNLOCK (self);
+
+  /* Invert here instead of in VPI, so a matrix shared by many frames is
+     only inverted once */
+  if (!(warp_flag & VPI_WARP_INVERSE)) {
+    if (!self->inverse_valid || 0 != memcmp (transform, self->inverse_source,
+            sizeof (transform))) {
+      self->inverse_valid = matrix_invert (self->inverse, transform);
+      memcpy (self->inverse_source, transform, sizeof (transform));
+    }
+
+    if (!self->inverse_valid) {
+      GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+          ("Could not apply the perspective warp."),
+          ("The transformation matrix is not invertible."));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+
+    memcpy (transform, self->inverse, sizeof (transform));
+    warp_flag |= VPI_WARP_INVERSE;
+  }
+
   status =
       vpiSubmitPerspectiveWarp (stream, self->warp, in_frame->image,
-      self->transform, out_frame->image, self->interpolator,
-      VPI_BOUNDARY_COND_ZERO, self->warp_flag);
-  GST_OBJECT_UNLOCK (self);
+      transform, out_frame->image, interpolator,
+      VPI_BOUNDARY_COND_ZERO, warp_flag);
 
   if (VPI_SUCCESS != status) {
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
         ("Could not apply the perspective warp."), ("%s",
             vpiStatusGetName (status)));
     ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  /* The matrix has been applied, downstream must not warp again */
+  meta = gst_buffer_get_vpi_transform_meta (out_frame->buffer);
+  if (meta) {
+    gst_buffer_remove_meta (out_frame->buffer, (GstMeta *) meta);
   }
 
+out:
   return ret;
 }
 
@@ -12,6 +12,8 @@
 
 #include "gstvpi.h"
 
+#include <vpi/algo/ConvertImageFormat.h>
+
 VPIImageFormat
 gst_vpi_video_to_image_format (GstVideoFormat video_format)
 {
@@ -22,11 +24,9 @@ gst_vpi_video_to_image_format (GstVideoFormat video_format)
       ret = VPI_IMAGE_FORMAT_U8;
       break;
     }
-    case GST_VIDEO_FORMAT_GRAY16_BE:{
-      ret = VPI_IMAGE_FORMAT_U16;
-      break;
-    }
     case GST_VIDEO_FORMAT_GRAY16_LE:{
+      /* VPI samples are in host order. Big endian data has to be
+         swapped before it gets here */
       ret = VPI_IMAGE_FORMAT_U16;
       break;
     }
@@ -34,6 +34,18 @@ gst_vpi_video_to_image_format (GstVideoFormat video_format)
       ret = VPI_IMAGE_FORMAT_NV12;
       break;
     }
+    case GST_VIDEO_FORMAT_NV24:{
+      ret = VPI_IMAGE_FORMAT_NV24;
+      break;
+    }
+    case GST_VIDEO_FORMAT_YUY2:{
+      ret = VPI_IMAGE_FORMAT_YUYV;
+      break;
+    }
+    case GST_VIDEO_FORMAT_UYVY:{
+      ret = VPI_IMAGE_FORMAT_UYVY;
+      break;
+    }
     case GST_VIDEO_FORMAT_RGB:{
       ret = VPI_IMAGE_FORMAT_RGB8;
       break;
@@ -71,13 +83,25 @@ gst_vpi_image_to_video_format (VPIImageFormat image_format)
       break;
     }
     case VPI_IMAGE_FORMAT_U16:{
-      ret = GST_VIDEO_FORMAT_GRAY16_BE;
+      ret = GST_VIDEO_FORMAT_GRAY16_LE;
       break;
     }
     case VPI_IMAGE_FORMAT_NV12:{
       ret = GST_VIDEO_FORMAT_NV12;
       break;
     }
+    case VPI_IMAGE_FORMAT_NV24:{
+      ret = GST_VIDEO_FORMAT_NV24;
+      break;
+    }
+    case VPI_IMAGE_FORMAT_YUYV:{
+      ret = GST_VIDEO_FORMAT_YUY2;
+      break;
+    }
+    case VPI_IMAGE_FORMAT_UYVY:{
+      ret = GST_VIDEO_FORMAT_UYVY;
+      break;
+    }
     case VPI_IMAGE_FORMAT_RGB8:{
       ret = GST_VIDEO_FORMAT_RGB;
       break;
@@ -102,6 +126,143 @@ gst_vpi_image_to_video_format (VPIImageFormat image_format)
   return ret;
 }
 
+VPIStatus
+gst_vpi_image_create_view (VPIImage image, guint x, guint y, guint width,
+    guint height, VPIImage * view)
+{
+  VPIImageData image_data = { 0 };
+  GstVideoFormat format = GST_VIDEO_FORMAT_UNKNOWN;
+  const GstVideoFormatInfo *finfo = NULL;
+  VPIImagePlane *plane = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  guint comp = 0;
+  gint i = 0;
+
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (view, VPI_ERROR_INVALID_ARGUMENT);
+
+  /* The pointers stay valid after unlocking since the memory is not owned
+     by VPI */
+  status = vpiImageLock (image, VPI_LOCK_READ_WRITE, &image_data);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+  vpiImageUnlock (image);
+
+  if (x + width > image_data.planes[0].width
+      || y + height > image_data.planes[0].height || 0 == width
+      || 0 == height) {
+    status = VPI_ERROR_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  format = gst_vpi_image_to_video_format (image_data.type);
+  if (GST_VIDEO_FORMAT_UNKNOWN == format) {
+    status = VPI_ERROR_INVALID_IMAGE_FORMAT;
+    goto out;
+  }
+  finfo = gst_video_format_get_info (format);
+
+  for (i = 0; i < image_data.numPlanes; i++) {
+    plane = &image_data.planes[i];
+
+    /* First component stored in this plane */
+    for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); comp++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == i) {
+        break;
+      }
+    }
+
+    plane->data = (guint8 *) plane->data +
+        (y >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, comp)) * plane->pitchBytes +
+        (x >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp)) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+    plane->width = GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_W_SUB (finfo,
+            comp), width);
+    plane->height = GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_H_SUB (finfo,
+            comp), height);
+  }
+
+  status = vpiImageCreateCudaMemWrapper (&image_data, VPI_BACKEND_ALL, view);
+
+out:
+  return status;
+}
+
+VPIStatus
+gst_vpi_image_create_plane_view (VPIImage image, guint plane,
+    VPIImageFormat format, VPIImage * view)
+{
+  VPIImageData image_data = { 0 };
+  VPIImageData plane_data = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (view, VPI_ERROR_INVALID_ARGUMENT);
+
+  /* The pointers stay valid after unlocking since the memory is not owned
+     by VPI */
+  status = vpiImageLock (image, VPI_LOCK_READ_WRITE, &image_data);
+  if (VPI_SUCCESS != status) {
+    goto out;
+  }
+  vpiImageUnlock (image);
+
+  if (plane >= image_data.numPlanes) {
+    status = VPI_ERROR_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  plane_data.type = format;
+  plane_data.numPlanes = 1;
+  plane_data.planes[0] = image_data.planes[plane];
+
+  status = vpiImageCreateCudaMemWrapper (&plane_data, VPI_BACKEND_ALL, view);
+
+out:
+  return status;
+}
+
+void
+gst_vpi_attach_mem_to_stream (GstElement * element, cudaStream_t stream,
+    gpointer mem, gint attach_flag)
+{
+  cudaError_t cuda_status = cudaSuccess;
+
+  g_return_if_fail (element);
+  g_return_if_fail (mem);
+
+  cuda_status = cudaStreamAttachMemAsync (stream, mem, 0, attach_flag);
+
+  cudaStreamSynchronize (stream);
+
+  if (cudaSuccess != cuda_status) {
+    GST_ELEMENT_ERROR (element, LIBRARY, FAILED,
+        ("Could not attach buffer to CUDA %s stream. Error: %s",
+            stream == NULL ? "global" : "custom",
+            cudaGetErrorString (cuda_status)), (NULL));
+  }
+}
+
+GType
+vpi_backend_enum_get_type (void)
+{
+  static GType vpi_backend_enum_type = 0;
+  static const GEnumValue values[] = {
+    {VPI_BACKEND_CPU, "CPU Backend", "cpu"},
+    {VPI_BACKEND_CUDA, "CUDA Backend", "cuda"},
+    {VPI_BACKEND_PVA, "PVA Backend (Xavier only)", "pva"},
+    {VPI_BACKEND_VIC, "VIC Backend", "vic"},
+    {0, NULL, NULL}
+  };
+
+  if (!vpi_backend_enum_type) {
+    vpi_backend_enum_type = g_enum_register_static ("VpiBackend", values);
+  }
+
+  return vpi_backend_enum_type;
+}
+
 GType
 vpi_boundary_cond_enum_get_type (void)
 {
@@ -143,3 +304,26 @@ vpi_interpolator_enum_get_type (void)
 
   return vpi_interpolator_enum_type;
 }
+
+GType
+vpi_conversion_policy_enum_get_type (void)
+{
+  static GType vpi_conversion_policy_enum_type = 0;
+  static const GEnumValue values[] = {
+    {VPI_CONVERSION_CAST, "Casts input to the output type. Overflows "
+          "and underflows are handled as per C specification, including "
+          "situations of undefined behavior.", "cast"},
+    {VPI_CONVERSION_CLAMP, "Clamps input to output's type range. Overflows "
+          "and underflows are mapped to the output type's maximum and minimum "
+          "representable value, respectively. When output type is floating point, "
+          "clamp behaves like cast.", "clamp"},
+    {0, NULL, NULL}
+  };
+
+  if (!vpi_conversion_policy_enum_type) {
+    vpi_conversion_policy_enum_type =
+        g_enum_register_static ("VpiConversionPolicy", values);
+  }
+
+  return vpi_conversion_policy_enum_type;
+}
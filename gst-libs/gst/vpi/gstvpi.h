@@ -13,21 +13,81 @@
 #ifndef __GST_VPI_H__
 #define __GST_VPI_H__
 
+#include <cuda_runtime.h>
 #include <gst/video/video.h>
 #include <vpi/Image.h>
 
 G_BEGIN_DECLS
 
+/* Video formats that can be wrapped in a VPIImage without conversion */
+#define GST_VPI_SUPPORTED_FORMATS "{ GRAY8, GRAY16_LE, NV12, NV24, YUY2, UYVY, RGB, BGR, RGBA, BGRA, RGBx, BGRx }"
+
 VPIImageFormat gst_vpi_video_to_image_format (GstVideoFormat video_format);
 
 GstVideoFormat gst_vpi_image_to_video_format (VPIImageFormat image_format);
 
+/**
+ * gst_vpi_image_create_view
+ * @image: (in) a #VPIImage wrapping externally allocated memory
+ * @x: (in) left edge of the view
+ * @y: (in) top edge of the view
+ * @width: (in) width of the view
+ * @height: (in) height of the view
+ * @view: (out) the new #VPIImage
+ *
+ * Wraps a rectangle of @image in a new #VPIImage without copying. The view
+ * shares the memory of @image, so it must be destroyed before the memory of
+ * @image is released. For subsampled formats @x and @y are rounded down to
+ * the chroma grid.
+ *
+ * Returns: VPI_SUCCESS if the view was created.
+ */
+VPIStatus gst_vpi_image_create_view (VPIImage image, guint x, guint y,
+    guint width, guint height, VPIImage * view);
+
+/**
+ * gst_vpi_image_create_plane_view
+ * @image: (in) a #VPIImage wrapping externally allocated memory
+ * @plane: (in) index of the plane to wrap
+ * @format: (in) single plane format to interpret the plane as
+ * @view: (out) the new #VPIImage
+ *
+ * Wraps a single plane of @image in a new #VPIImage without copying, for
+ * example the luma or the interleaved chroma of NV12. Each pixel of
+ * @format must take as many bytes as a sample of the plane. The view must
+ * be destroyed before the memory of @image is released.
+ *
+ * Returns: VPI_SUCCESS if the view was created.
+ */
+VPIStatus gst_vpi_image_create_plane_view (VPIImage image, guint plane,
+    VPIImageFormat format, VPIImage * view);
+
+/**
+ * gst_vpi_attach_mem_to_stream
+ * @element: (in) the #GstElement errors are posted on
+ * @stream: (in) CUDA stream to attach to, NULL for the global one
+ * @mem: (in) managed memory to attach
+ * @attach_flag: (in) cudaMemAttachSingle to use @mem on @stream, or
+ * cudaMemAttachHost to hand it back to the CPU
+ *
+ * Attaches managed memory to @stream and waits until the attachment takes
+ * effect.
+ */
+void gst_vpi_attach_mem_to_stream (GstElement * element, cudaStream_t stream,
+    gpointer mem, gint attach_flag);
+
+#define VPI_BACKEND_ENUM (vpi_backend_enum_get_type ())
+    GType vpi_backend_enum_get_type (void);
+
 #define VPI_BOUNDARY_CONDS_ENUM (vpi_boundary_cond_enum_get_type ())
     GType vpi_boundary_cond_enum_get_type (void);
 
 #define VPI_INTERPOLATORS_ENUM (vpi_interpolator_enum_get_type ())
     GType vpi_interpolator_enum_get_type (void);
 
+#define VPI_CONVERSION_POLICY_ENUM (vpi_conversion_policy_enum_get_type ())
+    GType vpi_conversion_policy_enum_get_type (void);
+
 G_END_DECLS
 
 #endif // __GST_VPI_H__
@@ -17,36 +17,16 @@
 #include "gstvpifilter.h"
 
 #include <cuda_runtime.h>
+#include <string.h>
 
 #include "eval.h"
 #include "gstcudameta.h"
+#include "gstvpi.h"
 #include "gstvpibufferpool.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_vpi_filter_debug_category);
 #define GST_CAT_DEFAULT gst_vpi_filter_debug_category
 
-#define VPI_BACKEND_ENUM (vpi_backend_enum_get_type ())
-GType vpi_backend_enum_get_type (void);
-
-GType
-vpi_backend_enum_get_type (void)
-{
-  static GType vpi_backend_enum_type = 0;
-  static const GEnumValue values[] = {
-    {VPI_BACKEND_CPU, "CPU Backend", "cpu"},
-    {VPI_BACKEND_CUDA, "CUDA Backend", "cuda"},
-    {VPI_BACKEND_PVA, "PVA Backend (Xavier only)", "pva"},
-    {VPI_BACKEND_VIC, "VIC Backend", "vic"},
-    {0, NULL, NULL}
-  };
-
-  if (!vpi_backend_enum_type) {
-    vpi_backend_enum_type = g_enum_register_static ("VpiBackend", values);
-  }
-
-  return vpi_backend_enum_type;
-}
-
 typedef struct _GstVpiFilterPrivate GstVpiFilterPrivate;
 
 struct _GstVpiFilterPrivate
@@ -55,8 +35,31 @@ struct _GstVpiFilterPrivate
   VPIStream vpi_stream;
   cudaStream_t cuda_stream;
   gint backend;
+  /* Configured regions as <x, y, w, h> quadruplets */
+  GArray *regions;
+  GQuark roi_type;
+  /* Regions of the frame being processed, clipped and aligned */
+  GArray *frame_regions;
+  /* Views of the frame being processed, released after the stream sync */
+  GPtrArray *region_views;
+  /* Whether transform_image can write to the scratch buffer and the result
+     be copied back over the input, the caps must match */
+  gboolean in_place_supported;
+  /* Frame sized buffer in place transforms write to */
+  GstVpiBufferPool *scratch_pool;
+  GstBuffer *scratch;
+};
+
+enum
+{
+  REGION_X,
+  REGION_Y,
+  REGION_WIDTH,
+  REGION_HEIGHT
 };
 
+#define NUM_REGION_PARAMS 4
+
 static GstFlowReturn gst_vpi_filter_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 static GstFlowReturn gst_vpi_filter_transform_frame_ip (GstVideoFilter * filter,
@@ -65,12 +68,17 @@ static gboolean gst_vpi_filter_set_info (GstVideoFilter * filter, GstCaps *
     incaps, GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info);
 static gboolean gst_vpi_filter_start (GstBaseTransform * trans);
 static gboolean gst_vpi_filter_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_vpi_filter_transform (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer * outbuf);
 static gboolean gst_vpi_filter_decide_allocation (GstBaseTransform * trans,
     GstQuery * query);
 static GstFlowReturn gst_vpi_filter_prepare_output_buffer (GstBaseTransform *
     trans, GstBuffer * input, GstBuffer ** outbuf);
 static GstFlowReturn gst_vpi_filter_prepare_output_buffer_ip (GstBaseTransform *
     trans, GstBuffer * input, GstBuffer ** outbuf);
+static gsize gst_vpi_filter_compute_size (GstVpiFilter * self,
+    GstVideoInfo * info);
+static void gst_vpi_filter_free_scratch (GstVpiFilter * self);
 static void gst_vpi_filter_finalize (GObject * object);
 static void gst_vpi_filter_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
@@ -81,9 +89,15 @@ enum
 {
   PROP_0,
   PROP_BACKEND,
+  PROP_REGIONS,
+  PROP_ROI_TYPE,
 };
 
 #define PROP_BACKEND_DEFAULT VPI_BACKEND_CUDA
+#define PROP_REGION_MIN 0
+#define PROP_REGION_MAX G_MAXINT
+#define PROP_REGION_DEFAULT 0
+#define PROP_ROI_TYPE_DEFAULT NULL
 
 /* class initialization */
 G_DEFINE_TYPE_WITH_CODE (GstVpiFilter, gst_vpi_filter, GST_TYPE_VIDEO_FILTER,
@@ -107,6 +121,8 @@ gst_vpi_filter_class_init (GstVpiFilterClass * klass)
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_vpi_filter_set_info);
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vpi_filter_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vpi_filter_stop);
+  base_transform_class->transform =
+      GST_DEBUG_FUNCPTR (gst_vpi_filter_transform);
   base_transform_class->decide_allocation =
       GST_DEBUG_FUNCPTR (gst_vpi_filter_decide_allocation);
   base_transform_class->prepare_output_buffer =
@@ -120,6 +136,33 @@ gst_vpi_filter_class_init (GstVpiFilterClass * klass)
           "Backend to use to execute VPI algorithms.",
           VPI_BACKEND_ENUM, PROP_BACKEND_DEFAULT,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_REGIONS,
+      gst_param_spec_array ("regions",
+          "Regions",
+          "Nx4 matrix where N is the number of regions. Each region "
+          "(<x, y, w, h>) contains the position of its top left corner and "
+          "its width and height. When regions are given, only them are "
+          "processed: filters forward the rest of the frame untouched and "
+          "detectors only look inside them. Regions are clipped to the "
+          "frame. Leave empty to process the full frame. Elements that do "
+          "not support regions ignore it.\n"
+          "Usage example: <<0,360,640,360>,<640,360,640,360>>",
+          gst_param_spec_array ("region", "region", "region",
+              g_param_spec_int ("region-params", "params", "params",
+                  PROP_REGION_MIN, PROP_REGION_MAX, PROP_REGION_DEFAULT,
+                  (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)),
+              (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)),
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ROI_TYPE,
+      g_param_spec_string ("roi-type", "Region of interest type",
+          "Type of the region of interest metas on the input buffers to "
+          "process, together with the regions property. When set, frames "
+          "without such metas and without configured regions are not "
+          "processed. Elements that do not support regions ignore it.",
+          PROP_ROI_TYPE_DEFAULT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -133,6 +176,13 @@ gst_vpi_filter_init (GstVpiFilter * self)
   priv->vpi_stream = NULL;
   priv->cuda_stream = NULL;
   priv->backend = PROP_BACKEND_DEFAULT;
+  priv->regions = g_array_new (FALSE, FALSE, sizeof (gint));
+  priv->roi_type = 0;
+  priv->frame_regions = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  priv->region_views = g_ptr_array_new ();
+  priv->in_place_supported = FALSE;
+  priv->scratch_pool = NULL;
+  priv->scratch = NULL;
 }
 
 static gboolean
@@ -208,10 +258,20 @@ gst_vpi_filter_set_info (GstVideoFilter * filter, GstCaps *
 {
   GstVpiFilter *self = GST_VPI_FILTER (filter);
   GstVpiFilterClass *vpi_filter_class = GST_VPI_FILTER_GET_CLASS (self);
+  GstVpiFilterPrivate *priv =
+      G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
   gboolean ret = TRUE;
 
   GST_DEBUG_OBJECT (self, "set_info");
 
+  gst_vpi_filter_free_scratch (self);
+
+  /* Results are written back over the input, which is only possible if
+     the output looks the same */
+  priv->in_place_supported = NULL != vpi_filter_class->transform_image
+      && gst_video_info_is_equal (in_info, out_info);
+
   if (vpi_filter_class->start) {
     /* Call child class start method when caps are already known */
     ret = vpi_filter_class->start (self, in_info, out_info);
@@ -220,25 +280,606 @@ gst_vpi_filter_set_info (GstVideoFilter * filter, GstCaps *
   return ret;
 }
 
+/* TRUE if the regions or roi-type properties restrict processing */
+static gboolean
+gst_vpi_filter_is_restricted (GstVpiFilter * self)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  gboolean restricted = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  if (!GST_VPI_FILTER_GET_CLASS (self)->supports_roi) {
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (self);
+  restricted = 0 != priv->regions->len || 0 != priv->roi_type;
+  GST_OBJECT_UNLOCK (self);
+
+out:
+  return restricted;
+}
+
+/* TRUE if transform_image is run on regions instead of the full frame */
+static gboolean
+gst_vpi_filter_uses_regions (GstVpiFilter * self)
+{
+  GstVpiFilterPrivate *priv = NULL;
+
+  g_return_val_if_fail (self, FALSE);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  return priv->in_place_supported && gst_vpi_filter_is_restricted (self);
+}
+
+gboolean
+gst_vpi_filter_clip_region (GstVideoInfo * info, GstVideoRectangle * region)
+{
+  gint align_x = 0;
+  gint align_y = 0;
+  gint left = 0;
+  gint top = 0;
+  gint right = 0;
+  gint bottom = 0;
+
+  g_return_val_if_fail (info, FALSE);
+  g_return_val_if_fail (region, FALSE);
+
+  align_x = 1 << GST_VIDEO_FORMAT_INFO_W_SUB (info->finfo, GST_VIDEO_COMP_U);
+  align_y = 1 << GST_VIDEO_FORMAT_INFO_H_SUB (info->finfo, GST_VIDEO_COMP_U);
+
+  left = CLAMP (region->x, 0, GST_VIDEO_INFO_WIDTH (info));
+  top = CLAMP (region->y, 0, GST_VIDEO_INFO_HEIGHT (info));
+  right = CLAMP (region->x + region->w, 0, GST_VIDEO_INFO_WIDTH (info));
+  bottom = CLAMP (region->y + region->h, 0, GST_VIDEO_INFO_HEIGHT (info));
+
+  left -= left % align_x;
+  top -= top % align_y;
+  right = MIN (GST_ROUND_UP_N (right, align_x), GST_VIDEO_INFO_WIDTH (info));
+  bottom = MIN (GST_ROUND_UP_N (bottom, align_y),
+      GST_VIDEO_INFO_HEIGHT (info));
+
+  region->x = left;
+  region->y = top;
+  region->w = right - left;
+  region->h = bottom - top;
+
+  return region->w > 0 && region->h > 0;
+}
+
+/* Gathers the regions to process on this buffer, ready to take views of */
 static void
-gst_vpi_filter_attach_mem_to_stream (GstVpiFilter * self, cudaStream_t stream,
-    void *mem, gint attach_flag)
+gst_vpi_filter_collect_frame_regions (GstVpiFilter * self,
+    GstBuffer * buffer, GstVideoInfo * info)
 {
+  GstVpiFilterPrivate *priv = NULL;
+  guint i = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (buffer);
+  g_return_if_fail (info);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  gst_vpi_filter_get_regions (self, buffer, priv->frame_regions);
+
+  while (i < priv->frame_regions->len) {
+    if (gst_vpi_filter_clip_region (info, &g_array_index (priv->frame_regions,
+                GstVideoRectangle, i))) {
+      i++;
+    } else {
+      g_array_remove_index_fast (priv->frame_regions, i);
+    }
+  }
+}
+
+/* Destroys the views of the frame, the stream must be synced */
+static void
+gst_vpi_filter_release_views (GstVpiFilter * self)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  guint i = 0;
+
+  g_return_if_fail (self);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  for (i = 0; i < priv->region_views->len; i++) {
+    vpiImageDestroy (g_ptr_array_index (priv->region_views, i));
+  }
+  g_ptr_array_set_size (priv->region_views, 0);
+}
+
+VPIStatus
+gst_vpi_filter_get_plane_view (GstVpiFilter * self, VpiFrame * frame,
+    guint plane, VPIImageFormat format, VPIImage * view)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  VPIStatus status = VPI_SUCCESS;
+
+  g_return_val_if_fail (self, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (frame, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (view, VPI_ERROR_INVALID_ARGUMENT);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  /* Full frames have their views cached in the buffer */
+  status = gst_vpi_frame_get_plane_view (frame, plane, format, view);
+  if (VPI_SUCCESS == status) {
+    goto out;
+  }
+
+  /* Views of regions live until the sync that follows the frame */
+  status = gst_vpi_image_create_plane_view (frame->image, plane, format,
+      view);
+  if (VPI_SUCCESS == status) {
+    g_ptr_array_add (priv->region_views, *view);
+  }
+
+out:
+  return status;
+}
+
+/* Runs transform_image on views of each region of the frame, grown by the
+   kernel radius so their borders see the pixels around them. Both images
+   must have the size of the frame, the stream must be synced before the
+   views are released */
+static GstFlowReturn
+gst_vpi_filter_transform_regions (GstVpiFilter * self, VpiFrame * in_frame,
+    VpiFrame * out_frame)
+{
+  GstVideoFilter *video_filter = GST_VIDEO_FILTER (self);
+  GstVpiFilterClass *vpi_filter_class = NULL;
+  GstVpiFilterPrivate *priv = NULL;
+  GstVideoRectangle padded = { 0 };
+  VpiFrame in_region = { 0 };
+  VpiFrame out_region = { 0 };
+  VPIStatus status = VPI_SUCCESS;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gint radius_x = 0;
+  gint radius_y = 0;
+  guint i = 0;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (in_frame, GST_FLOW_ERROR);
+  g_return_val_if_fail (out_frame, GST_FLOW_ERROR);
+
+  vpi_filter_class = GST_VPI_FILTER_GET_CLASS (self);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  if (vpi_filter_class->get_kernel_radius) {
+    vpi_filter_class->get_kernel_radius (self, &radius_x, &radius_y);
+  }
+
+  in_region.buffer = in_frame->buffer;
+  out_region.buffer = out_frame->buffer;
+
+  for (i = 0; i < priv->frame_regions->len && GST_FLOW_OK == ret; i++) {
+    padded = g_array_index (priv->frame_regions, GstVideoRectangle, i);
+    padded.x -= radius_x;
+    padded.y -= radius_y;
+    padded.w += 2 * radius_x;
+    padded.h += 2 * radius_y;
+    gst_vpi_filter_clip_region (&video_filter->in_info, &padded);
+
+    status = gst_vpi_image_create_view (in_frame->image, padded.x,
+        padded.y, padded.w, padded.h, &in_region.image);
+    if (VPI_SUCCESS != status) {
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    g_ptr_array_add (priv->region_views, in_region.image);
+
+    status = gst_vpi_image_create_view (out_frame->image, padded.x,
+        padded.y, padded.w, padded.h, &out_region.image);
+    if (VPI_SUCCESS != status) {
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    g_ptr_array_add (priv->region_views, out_region.image);
+
+    ret = vpi_filter_class->transform_image (self, priv->vpi_stream,
+        &in_region, &out_region);
+  }
+
+  if (VPI_SUCCESS != status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not create region view."), ("%s", vpiStatusGetName (status)));
+  }
+
+  return ret;
+}
+
+/* Queues a copy of the pixels of a region between frames of the same
+   format on the CUDA stream */
+static cudaError_t
+gst_vpi_filter_copy_region (GstVpiFilter * self, GstVideoFrame * dest,
+    GstVideoFrame * src, const GstVideoRectangle * region)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  const GstVideoFormatInfo *finfo = NULL;
   cudaError_t cuda_status = cudaSuccess;
+  guint comp = 0;
+  gint plane = 0;
+  gint x = 0;
+  gint y = 0;
+  gint width = 0;
+  gint height = 0;
+
+  g_return_val_if_fail (self, cudaErrorInvalidValue);
+  g_return_val_if_fail (dest, cudaErrorInvalidValue);
+  g_return_val_if_fail (src, cudaErrorInvalidValue);
+  g_return_val_if_fail (region, cudaErrorInvalidValue);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+  finfo = dest->info.finfo;
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (dest)
+      && cudaSuccess == cuda_status; plane++) {
+    /* First component stored in this plane */
+    for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); comp++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == plane) {
+        break;
+      }
+    }
+
+    x = (region->x >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp)) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+    y = region->y >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, comp);
+    width = GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp),
+        region->w) * GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+    height = GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_H_SUB (finfo, comp),
+        region->h);
+
+    cuda_status = cudaMemcpy2DAsync ((guint8 *)
+        GST_VIDEO_FRAME_PLANE_DATA (dest, plane) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (dest, plane) + x,
+        GST_VIDEO_FRAME_PLANE_STRIDE (dest, plane), (guint8 *)
+        GST_VIDEO_FRAME_PLANE_DATA (src, plane) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (src, plane) + x,
+        GST_VIDEO_FRAME_PLANE_STRIDE (src, plane), width, height,
+        cudaMemcpyDefault, priv->cuda_stream);
+  }
+
+  return cuda_status;
+}
+
+static GstBuffer *
+gst_vpi_filter_get_scratch (GstVpiFilter * self)
+{
+  GstVideoFilter *video_filter = GST_VIDEO_FILTER (self);
+  GstVpiFilterPrivate *priv = NULL;
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  GstCaps *caps = NULL;
+  gsize size = 0;
+
+  g_return_val_if_fail (self, NULL);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  if (priv->scratch) {
+    goto out;
+  }
+
+  if (!priv->scratch_pool) {
+    priv->scratch_pool = g_object_new (GST_VPI_TYPE_BUFFER_POOL, NULL);
+  }
+  pool = GST_BUFFER_POOL (priv->scratch_pool);
+
+  caps = gst_video_info_to_caps (&video_filter->in_info);
+  size = gst_vpi_filter_compute_size (self, &video_filter->in_info);
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, 1, 1);
+  gst_caps_unref (caps);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to set scratch pool configuration."), (NULL));
+    goto out;
+  }
+
+  if (!gst_buffer_pool_set_active (pool, TRUE)
+      || GST_FLOW_OK != gst_buffer_pool_acquire_buffer (pool, &priv->scratch,
+          NULL)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to allocate scratch buffer."), (NULL));
+    priv->scratch = NULL;
+  }
+
+out:
+  return priv->scratch;
+}
+
+static void
+gst_vpi_filter_free_scratch (GstVpiFilter * self)
+{
+  GstVpiFilterPrivate *priv = NULL;
 
   g_return_if_fail (self);
-  g_return_if_fail (mem);
 
-  cuda_status = cudaStreamAttachMemAsync (stream, mem, 0, attach_flag);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
 
-  cudaStreamSynchronize (stream);
+  if (priv->scratch) {
+    gst_buffer_unref (priv->scratch);
+    priv->scratch = NULL;
+  }
 
-  if (cudaSuccess != cuda_status) {
+  if (priv->scratch_pool) {
+    gst_buffer_pool_set_active (GST_BUFFER_POOL (priv->scratch_pool), FALSE);
+  }
+}
+
+/* TRUE if the memory of the scratch buffer can replace the one of the
+   frame as is. Memory shared with other buffers must stay with them */
+static gboolean
+gst_vpi_filter_can_swap_scratch (GstVideoFrame * frame,
+    GstVideoFrame * scratch_frame)
+{
+  GstMemory *memory = NULL;
+  GstMemory *scratch_memory = NULL;
+  gboolean ret = FALSE;
+  guint i = 0;
+
+  g_return_val_if_fail (frame, FALSE);
+  g_return_val_if_fail (scratch_frame, FALSE);
+
+  if (1 != gst_buffer_n_memory (frame->buffer)
+      || 1 != gst_buffer_n_memory (scratch_frame->buffer)
+      || !gst_buffer_is_all_memory_writable (frame->buffer)
+      || !gst_buffer_get_meta (frame->buffer, GST_VPI_META_API_TYPE)
+      || !gst_buffer_get_meta (scratch_frame->buffer, GST_VPI_META_API_TYPE)) {
+    goto out;
+  }
+
+  memory = gst_buffer_peek_memory (frame->buffer, 0);
+  scratch_memory = gst_buffer_peek_memory (scratch_frame->buffer, 0);
+  if (memory->allocator != scratch_memory->allocator
+      || memory->maxsize != scratch_memory->maxsize
+      || memory->offset != scratch_memory->offset
+      || memory->size != scratch_memory->size) {
+    goto out;
+  }
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    if (GST_VIDEO_INFO_PLANE_OFFSET (&frame->info, i) !=
+        GST_VIDEO_INFO_PLANE_OFFSET (&scratch_frame->info, i)
+        || GST_VIDEO_FRAME_PLANE_STRIDE (frame, i) !=
+        GST_VIDEO_FRAME_PLANE_STRIDE (scratch_frame, i)) {
+      goto out;
+    }
+  }
+
+  ret = TRUE;
+
+out:
+  return ret;
+}
+
+/* Hands the memory of the scratch buffer, which holds the result, to
+   buffer and keeps the old one as the next scratch. Neither may be
+   mapped */
+static void
+gst_vpi_filter_swap_scratch (GstVpiFilter * self, GstBuffer * buffer)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  GstMemory *memory = NULL;
+  GstMemory *scratch_memory = NULL;
+  GstVpiMeta *vpi_meta = NULL;
+  GstVpiMeta *scratch_meta = NULL;
+  VPIImage image = NULL;
+
+  g_return_if_fail (self);
+  g_return_if_fail (buffer);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  memory = gst_buffer_get_memory (buffer, 0);
+  scratch_memory = gst_buffer_get_memory (priv->scratch, 0);
+  gst_buffer_replace_memory (buffer, 0, scratch_memory);
+  gst_buffer_replace_memory (priv->scratch, 0, memory);
+
+  /* Same allocator and layout, so the pools can keep recycling them */
+  GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+  GST_BUFFER_FLAG_UNSET (priv->scratch, GST_BUFFER_FLAG_TAG_MEMORY);
+
+  /* The images belong to the memories, so they move along */
+  vpi_meta = (GstVpiMeta *) gst_buffer_get_meta (buffer,
+      GST_VPI_META_API_TYPE);
+  scratch_meta = (GstVpiMeta *) gst_buffer_get_meta (priv->scratch,
+      GST_VPI_META_API_TYPE);
+  image = vpi_meta->vpi_frame.image;
+  vpi_meta->vpi_frame.image = scratch_meta->vpi_frame.image;
+  scratch_meta->vpi_frame.image = image;
+}
+
+/* Runs transform_image from src into the scratch buffer and copies the
+   result to dest, which may be src itself. When restricted to regions,
+   only they are filtered and copied, the rest of dest is a copy of src.
+   If swap is given and the whole frame was filtered in place, it may be
+   set instead of copying, and the caller swaps the memories once the
+   frame is unmapped */
+static GstFlowReturn
+gst_vpi_filter_transform_scratch (GstVpiFilter * self, GstVideoFrame * src,
+    GstVideoFrame * dest, gboolean * swap)
+{
+  GstVideoFilter *video_filter = GST_VIDEO_FILTER (self);
+  GstVpiFilterClass *vpi_filter_class = NULL;
+  GstVpiFilterPrivate *priv = NULL;
+  GstVideoFrame scratch_frame = { 0 };
+  GstVideoRectangle full_frame = { 0 };
+  GstBuffer *scratch = NULL;
+  GstVpiMeta *vpi_meta = NULL;
+  GstVpiMeta *scratch_meta = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  cudaError_t cuda_status = cudaSuccess;
+  gboolean use_regions = FALSE;
+  guint i = 0;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (src, GST_FLOW_ERROR);
+  g_return_val_if_fail (dest, GST_FLOW_ERROR);
+
+  vpi_filter_class = GST_VPI_FILTER_GET_CLASS (self);
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  full_frame.w = GST_VIDEO_FRAME_WIDTH (src);
+  full_frame.h = GST_VIDEO_FRAME_HEIGHT (src);
+
+  use_regions = gst_vpi_filter_is_restricted (self);
+  if (use_regions) {
+    gst_vpi_filter_collect_frame_regions (self, src->buffer,
+        &video_filter->in_info);
+    if (0 == priv->frame_regions->len && src == dest) {
+      goto out;
+    }
+  }
+
+  scratch = gst_vpi_filter_get_scratch (self);
+  if (!scratch) {
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  vpi_meta = (GstVpiMeta *) gst_buffer_get_meta (src->buffer,
+      GST_VPI_META_API_TYPE);
+  scratch_meta = (GstVpiMeta *) gst_buffer_get_meta (scratch,
+      GST_VPI_META_API_TYPE);
+  if (!vpi_meta || !scratch_meta) {
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
-        ("Could not attach buffer to CUDA %s stream. Error: %s",
-            stream == NULL ? "global" : "custom",
+        ("Cannot process buffers that do not contain the VPI meta."), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  if (!gst_video_frame_map (&scratch_frame, &video_filter->in_info, scratch,
+          GST_MAP_READWRITE)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to map scratch buffer."), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
+      src->map->data, cudaMemAttachSingle);
+  if (src != dest) {
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
+        dest->map->data, cudaMemAttachSingle);
+  }
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
+      scratch_frame.map->data, cudaMemAttachSingle);
+
+  if (use_regions && src != dest) {
+    /* The rest of the frame is forwarded untouched */
+    cuda_status = gst_vpi_filter_copy_region (self, dest, src, &full_frame);
+  }
+
+  if (use_regions) {
+    ret = gst_vpi_filter_transform_regions (self, &vpi_meta->vpi_frame,
+        &scratch_meta->vpi_frame);
+  } else {
+    ret = vpi_filter_class->transform_image (self, priv->vpi_stream,
+        &vpi_meta->vpi_frame, &scratch_meta->vpi_frame);
+  }
+
+  /* The views have to outlive the work submitted on them */
+  vpiStreamSync (priv->vpi_stream);
+  gst_vpi_filter_release_views (self);
+
+  if (swap) {
+    *swap = !use_regions && src == dest
+        && gst_vpi_filter_can_swap_scratch (src, &scratch_frame);
+  }
+
+  if (GST_FLOW_OK == ret && cudaSuccess == cuda_status) {
+    if (use_regions) {
+      for (i = 0; i < priv->frame_regions->len && cudaSuccess == cuda_status;
+          i++) {
+        cuda_status = gst_vpi_filter_copy_region (self, dest,
+            &scratch_frame, &g_array_index (priv->frame_regions,
+                GstVideoRectangle, i));
+      }
+    } else if (!swap || !*swap) {
+      cuda_status = gst_vpi_filter_copy_region (self, dest, &scratch_frame,
+          &full_frame);
+    }
+  }
+  cudaStreamSynchronize (priv->cuda_stream);
+
+  /* Attach memory to global stream to detach it from CUDA stream */
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, src->map->data,
+      cudaMemAttachHost);
+  if (src != dest) {
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, dest->map->data,
+        cudaMemAttachHost);
+  }
+  gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL,
+      scratch_frame.map->data, cudaMemAttachHost);
+
+  if (GST_FLOW_OK != ret) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Child VPI element processing failed."), (NULL));
+  } else if (cudaSuccess != cuda_status) {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED,
+        ("Could not copy the result to the output buffer. Error: %s",
             cudaGetErrorString (cuda_status)), (NULL));
+    ret = GST_FLOW_ERROR;
   }
+
+  gst_video_frame_unmap (&scratch_frame);
+
+out:
+  return ret;
+}
+
+/* Filters a writable buffer through the scratch buffer, so no output
+   buffer is needed. Full frames take the memory of the scratch buffer
+   when possible instead of copying the result back */
+static GstFlowReturn
+gst_vpi_filter_transform_in_place (GstVpiFilter * self, GstBuffer * buffer)
+{
+  GstVideoFilter *video_filter = GST_VIDEO_FILTER (self);
+  GstVideoFrame frame = { 0 };
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean swap = FALSE;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (buffer, GST_FLOW_ERROR);
+
+  if (!gst_video_frame_map (&frame, &video_filter->in_info, buffer,
+          GST_MAP_READWRITE)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to map input buffer."), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto out;
+  }
+
+  ret = gst_vpi_filter_transform_scratch (self, &frame, &frame, &swap);
+
+  gst_video_frame_unmap (&frame);
+
+  if (GST_FLOW_OK == ret && swap) {
+    gst_vpi_filter_swap_scratch (self, buffer);
+  }
+
+out:
+  return ret;
 }
 
 #ifdef EVAL
@@ -289,22 +930,26 @@ gst_vpi_filter_transform_frame (GstVideoFilter * filter,
       ((GstVpiMeta *) gst_buffer_get_meta (outframe->buffer,
           GST_VPI_META_API_TYPE));
 
-  if (in_vpi_meta && out_vpi_meta) {
-
-    gst_vpi_filter_attach_mem_to_stream (self, priv->cuda_stream,
+  if (in_vpi_meta && out_vpi_meta && gst_vpi_filter_uses_regions (self)) {
+    /* The input could not be written to, so the regions are filtered
+       through the scratch buffer and copied over the forwarded input */
+    ret = gst_vpi_filter_transform_scratch (self, inframe, outframe, NULL);
+  } else if (in_vpi_meta && out_vpi_meta) {
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
         inframe->map->data, cudaMemAttachSingle);
-    gst_vpi_filter_attach_mem_to_stream (self, priv->cuda_stream,
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
         outframe->map->data, cudaMemAttachSingle);
 
     ret = vpi_filter_class->transform_image (self, priv->vpi_stream,
         &in_vpi_meta->vpi_frame, &out_vpi_meta->vpi_frame);
 
     vpiStreamSync (priv->vpi_stream);
+    gst_vpi_filter_release_views (self);
 
     /* Attach memory to global stream to detach it from CUDA stream */
-    gst_vpi_filter_attach_mem_to_stream (self, NULL, inframe->map->data,
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, inframe->map->data,
         cudaMemAttachHost);
-    gst_vpi_filter_attach_mem_to_stream (self, NULL, outframe->map->data,
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, outframe->map->data,
         cudaMemAttachHost);
 
     if (GST_FLOW_OK != ret) {
@@ -324,6 +969,31 @@ gst_vpi_filter_transform_frame (GstVideoFilter * filter,
   return ret;
 }
 
+static GstFlowReturn
+gst_vpi_filter_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstVpiFilter *self = GST_VPI_FILTER (trans);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (inbuf == outbuf) {
+    /* prepare_output_buffer handed back the input to be processed in
+       place */
+    ret = gst_vpi_filter_transform_in_place (self, inbuf);
+#ifdef EVAL
+    if (GST_FLOW_OK == ret) {
+      ret = gst_vpi_filter_check_eval (self);
+    }
+#endif
+  } else {
+    ret =
+        GST_BASE_TRANSFORM_CLASS (gst_vpi_filter_parent_class)->transform
+        (trans, inbuf, outbuf);
+  }
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_vpi_filter_transform_frame_ip (GstVideoFilter * filter,
     GstVideoFrame * frame)
@@ -352,16 +1022,17 @@ gst_vpi_filter_transform_frame_ip (GstVideoFilter * filter,
           GST_VPI_META_API_TYPE));
 
   if (vpi_meta) {
-    gst_vpi_filter_attach_mem_to_stream (self, priv->cuda_stream,
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), priv->cuda_stream,
         frame->map->data, cudaMemAttachSingle);
 
     ret = vpi_filter_class->transform_image_ip (self, priv->vpi_stream,
         &vpi_meta->vpi_frame);
 
     vpiStreamSync (priv->vpi_stream);
+    gst_vpi_filter_release_views (self);
 
     /* Attach memory to global stream to detach it from CUDA stream */
-    gst_vpi_filter_attach_mem_to_stream (self, NULL, frame->map->data,
+    gst_vpi_attach_mem_to_stream (GST_ELEMENT (self), NULL, frame->map->data,
         cudaMemAttachHost);
 
     if (GST_FLOW_OK != ret) {
@@ -483,6 +1154,8 @@ gst_vpi_filter_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (self, "stop");
 
+  gst_vpi_filter_free_scratch (self);
+
   vpiStreamDestroy (priv->vpi_stream);
   priv->vpi_stream = NULL;
 
@@ -516,10 +1189,17 @@ gst_vpi_filter_prepare_output_buffer (GstBaseTransform * trans,
     GstBuffer * input, GstBuffer ** outbuf)
 {
   GstVpiFilterClass *klass = GST_VPI_FILTER_GET_CLASS (trans);
+  GstVpiFilterPrivate *priv = G_TYPE_INSTANCE_GET_PRIVATE (trans,
+      GST_TYPE_VPI_FILTER, GstVpiFilterPrivate);
   GstFlowReturn ret = GST_FLOW_ERROR;
 
   if (klass->transform_image_ip && gst_base_transform_is_passthrough (trans)) {
     ret = gst_vpi_filter_prepare_output_buffer_ip (trans, input, outbuf);
+  } else if (priv->in_place_supported && gst_buffer_is_writable (input)) {
+    /* Nobody else sees the input, so the result is written back to it
+       instead of taking a new buffer from the pool */
+    *outbuf = input;
+    ret = GST_FLOW_OK;
   } else {
     ret =
         GST_BASE_TRANSFORM_CLASS
@@ -539,10 +1219,85 @@ gst_vpi_filter_finalize (GObject * object)
   GST_INFO_OBJECT (object, "Finalize VPI filter");
 
   g_clear_object (&priv->downstream_buffer_pool);
+  g_clear_object (&priv->scratch_pool);
+
+  g_array_unref (priv->regions);
+  priv->regions = NULL;
+
+  g_array_unref (priv->frame_regions);
+  priv->frame_regions = NULL;
+
+  g_ptr_array_unref (priv->region_views);
+  priv->region_views = NULL;
 
   G_OBJECT_CLASS (gst_vpi_filter_parent_class)->finalize (object);
 }
 
+static void
+gst_vpi_filter_set_regions (GstVpiFilter * self, const GValue * gst_array)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  const GValue *region = NULL;
+  gint value = 0;
+  guint num_regions = 0;
+  guint i = 0;
+  guint j = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (gst_array);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  g_array_set_size (priv->regions, 0);
+  num_regions = gst_value_array_get_size (gst_array);
+
+  for (i = 0; i < num_regions; i++) {
+    region = gst_value_array_get_value (gst_array, i);
+
+    if (NUM_REGION_PARAMS != gst_value_array_get_size (region)) {
+      GST_WARNING ("Regions must have 4 parameters. Discarding region %u.",
+          i);
+      continue;
+    }
+
+    for (j = 0; j < NUM_REGION_PARAMS; j++) {
+      value = g_value_get_int (gst_value_array_get_value (region, j));
+      g_array_append_val (priv->regions, value);
+    }
+  }
+}
+
+static void
+gst_vpi_filter_get_regions_property (GstVpiFilter * self, GValue * gst_array)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  GValue region = G_VALUE_INIT;
+  GValue value = G_VALUE_INIT;
+  guint i = 0;
+  guint j = 0;
+
+  g_return_if_fail (self);
+  g_return_if_fail (gst_array);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  for (i = 0; i < priv->regions->len; i += NUM_REGION_PARAMS) {
+    g_value_init (&region, GST_TYPE_ARRAY);
+
+    for (j = 0; j < NUM_REGION_PARAMS; j++) {
+      g_value_init (&value, G_TYPE_INT);
+      g_value_set_int (&value, g_array_index (priv->regions, gint, i + j));
+      gst_value_array_append_value (&region, &value);
+      g_value_unset (&value);
+    }
+
+    gst_value_array_append_value (gst_array, &region);
+    g_value_unset (&region);
+  }
+}
+
 static void
 gst_vpi_filter_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
@@ -559,6 +1314,13 @@ gst_vpi_filter_set_property (GObject * object, guint property_id,
     case PROP_BACKEND:
       priv->backend = g_value_get_enum (value);
       break;
+    case PROP_REGIONS:
+      gst_vpi_filter_set_regions (self, value);
+      break;
+    case PROP_ROI_TYPE:
+      priv->roi_type = g_value_get_string (value) ?
+          g_quark_from_string (g_value_get_string (value)) : 0;
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -582,6 +1344,12 @@ gst_vpi_filter_get_property (GObject * object, guint property_id,
     case PROP_BACKEND:
       g_value_set_enum (value, priv->backend);
       break;
+    case PROP_REGIONS:
+      gst_vpi_filter_get_regions_property (self, value);
+      break;
+    case PROP_ROI_TYPE:
+      g_value_set_string (value, g_quark_to_string (priv->roi_type));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -606,3 +1374,62 @@ gst_vpi_filter_get_backend (GstVpiFilter * self)
 
   return backend;
 }
+
+gboolean
+gst_vpi_filter_get_regions (GstVpiFilter * self, GstBuffer * buffer,
+    GArray * regions)
+{
+  GstVpiFilterPrivate *priv = NULL;
+  GstVideoRegionOfInterestMeta *meta = NULL;
+  GstVideoRectangle rectangle = { 0 };
+  gpointer state = NULL;
+  gint *region = NULL;
+  GQuark roi_type = 0;
+  gboolean restricted = FALSE;
+  guint i = 0;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (buffer, FALSE);
+  g_return_val_if_fail (regions, FALSE);
+
+  priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GST_TYPE_VPI_FILTER,
+      GstVpiFilterPrivate);
+
+  g_array_set_size (regions, 0);
+
+  if (!GST_VPI_FILTER_GET_CLASS (self)->supports_roi) {
+    goto out;
+  }
+
+  GST_OBJECT_LOCK (self);
+  roi_type = priv->roi_type;
+  for (i = 0; i < priv->regions->len; i += NUM_REGION_PARAMS) {
+    region = &g_array_index (priv->regions, gint, i);
+    rectangle.x = region[REGION_X];
+    rectangle.y = region[REGION_Y];
+    rectangle.w = region[REGION_WIDTH];
+    rectangle.h = region[REGION_HEIGHT];
+    g_array_append_val (regions, rectangle);
+  }
+  restricted = 0 != priv->regions->len || 0 != roi_type;
+  GST_OBJECT_UNLOCK (self);
+
+  if (0 == roi_type) {
+    goto out;
+  }
+
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    if (roi_type == meta->roi_type) {
+      rectangle.x = meta->x;
+      rectangle.y = meta->y;
+      rectangle.w = meta->w;
+      rectangle.h = meta->h;
+      g_array_append_val (regions, rectangle);
+    }
+  }
+
+out:
+  return restricted;
+}
@@ -36,10 +36,71 @@ struct _GstVpiFilterClass
                                     VpiFrame *in_frame, VpiFrame *out_frame);
   GstFlowReturn (*transform_image_ip) (GstVpiFilter *self, VPIStream stream,
                                        VpiFrame *frame);
+  void (*get_kernel_radius) (GstVpiFilter *self, gint *radius_x,
+                             gint *radius_y);
+
+  /* Set in class_init by subclasses that honor the regions and roi-type
+     properties. Subclasses implementing transform_image then get views of
+     the regions grown by the radius get_kernel_radius returns, so their
+     borders see the pixels around them. Only the regions themselves are
+     written out */
+  gboolean supports_roi;
 };
 
 VPIBackend gst_vpi_filter_get_backend (GstVpiFilter *self);
 
+/**
+ * gst_vpi_filter_get_regions
+ * @self: (in) a #GstVpiFilter
+ * @buffer: (in) the buffer being processed
+ * @regions: (out) array of #GstVideoRectangle to fill
+ *
+ * Gathers the regions set through the regions property and the ones of
+ * the region of interest metas of @buffer whose type matches the roi-type
+ * property. Regions are in frame coordinates and are not clipped. Classes
+ * without supports_roi never have any.
+ *
+ * Subclasses implementing transform_image get views of the regions
+ * automatically, as long as the input and output caps match.
+ *
+ * Returns: TRUE if processing is restricted to regions, even if @buffer
+ * has none.
+ */
+gboolean gst_vpi_filter_get_regions (GstVpiFilter *self, GstBuffer *buffer,
+                                     GArray *regions);
+
+/**
+ * gst_vpi_filter_get_plane_view
+ * @self: (in) a #GstVpiFilter
+ * @frame: (in) a frame handed to transform_image or transform_image_ip
+ * @plane: (in) index of the plane to wrap
+ * @format: (in) single plane format to interpret the plane as
+ * @view: (out) (transfer none) the view of the plane
+ *
+ * Gets a view of a plane of @frame, as created by
+ * gst_vpi_image_create_plane_view(). Full frames reuse the view cached in
+ * the buffer, views of regions are released by the base class after the
+ * frame is done, so no extra sync is needed.
+ *
+ * Returns: VPI_SUCCESS if @view was set.
+ */
+VPIStatus gst_vpi_filter_get_plane_view (GstVpiFilter *self, VpiFrame *frame,
+                                         guint plane, VPIImageFormat format,
+                                         VPIImage *view);
+
+/**
+ * gst_vpi_filter_clip_region
+ * @info: (in) video info of the frame the region belongs to
+ * @region: (inout) region to clip, in frame coordinates
+ *
+ * Clips @region to the frame and grows it to the chroma grid, so views
+ * and copies of every plane cover the same pixels.
+ *
+ * Returns: FALSE if nothing is left of @region.
+ */
+gboolean gst_vpi_filter_clip_region (GstVideoInfo *info,
+                                     GstVideoRectangle *region);
+
 G_END_DECLS
 
 #endif
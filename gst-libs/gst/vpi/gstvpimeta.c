@@ -24,6 +24,8 @@ static gboolean gst_vpi_meta_copy (GstVpiMeta * dst, GstVpiMeta * src);
 static void gst_vpi_image_free (gpointer data);
 
 #define VPI_IMAGE_QUARK_STR "VPIImage"
+#define VPI_PLANE_VIEW_QUARK_FORMAT VPI_IMAGE_QUARK_STR "-plane%u-%" \
+    G_GINT64_MODIFIER "x"
 static GQuark _vpi_image_quark;
 
 GType
@@ -131,6 +133,53 @@ gst_buffer_add_vpi_meta (GstBuffer * buffer, GstVideoInfo * video_info)
   return self;
 }
 
+VPIStatus
+gst_vpi_frame_get_plane_view (VpiFrame * frame, guint plane,
+    VPIImageFormat format, VPIImage * view)
+{
+  GstMiniObject *mem = NULL;
+  VPIStatus status = VPI_SUCCESS;
+  gchar *name = NULL;
+  GQuark quark = 0;
+
+  g_return_val_if_fail (frame, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (frame->buffer, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (frame->image, VPI_ERROR_INVALID_ARGUMENT);
+  g_return_val_if_fail (view, VPI_ERROR_INVALID_ARGUMENT);
+
+  /* The view is only as long lived as the memory if the image is the one
+     associated to it */
+  if (1 != gst_buffer_n_memory (frame->buffer)) {
+    status = VPI_ERROR_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  mem = GST_MINI_OBJECT_CAST (gst_buffer_peek_memory (frame->buffer, 0));
+  if (frame->image != gst_mini_object_get_qdata (mem, _vpi_image_quark)) {
+    status = VPI_ERROR_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  name = g_strdup_printf (VPI_PLANE_VIEW_QUARK_FORMAT, plane,
+      (guint64) format);
+  quark = g_quark_from_string (name);
+
+  *view = gst_mini_object_get_qdata (mem, quark);
+  if (*view) {
+    goto out;
+  }
+
+  status = gst_vpi_image_create_plane_view (frame->image, plane, format,
+      view);
+  if (VPI_SUCCESS == status) {
+    gst_mini_object_set_qdata (mem, quark, *view, gst_vpi_image_free);
+  }
+
+out:
+  g_free (name);
+  return status;
+}
+
 static gboolean
 gst_vpi_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
 {
@@ -54,6 +54,24 @@ struct _GstVpiMeta
  */
 GstVpiMeta * gst_buffer_add_vpi_meta (GstBuffer * buffer, GstVideoInfo * video_info);
 
+/**
+ * gst_vpi_frame_get_plane_view
+ * @frame: (in) (transfer none) a #VpiFrame of a #GstVpiMeta
+ * @plane: (in) index of the plane to wrap
+ * @format: (in) single plane format to interpret the plane as
+ * @view: (out) (transfer none) the view of the plane
+ *
+ * Gets a view of a plane of the full frame image, as created by
+ * gst_vpi_image_create_plane_view(). The view is created on first use and
+ * cached in the memory of the buffer, so it lives as long as the image
+ * does and recycled buffers reuse it. Views of images that do not wrap a
+ * single memory of the buffer are not supported.
+ *
+ * Returns: VPI_SUCCESS if @view was set.
+ */
+VPIStatus gst_vpi_frame_get_plane_view (VpiFrame * frame, guint plane,
+    VPIImageFormat format, VPIImage * view);
+
 GType gst_vpi_meta_api_get_type (void);
 const GstMetaInfo *gst_vpi_meta_get_info (void);
 
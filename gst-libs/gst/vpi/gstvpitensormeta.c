@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#include "gstvpitensormeta.h"
+
+#include <string.h>
+
+static gboolean gst_vpi_tensor_meta_init (GstMeta * meta,
+    gpointer params, GstBuffer * buffer);
+static gboolean gst_vpi_tensor_meta_transform (GstBuffer * dest,
+    GstMeta * meta, GstBuffer * buffer, GQuark type, gpointer data);
+
+GType
+gst_vpi_tensor_meta_api_get_type (void)
+{
+  static volatile GType type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstVpiTensorMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_vpi_tensor_meta_get_info (void)
+{
+  static const GstMetaInfo *info = NULL;
+
+  if (g_once_init_enter (&info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_VPI_TENSOR_META_API_TYPE,
+        "GstVpiTensorMeta",
+        sizeof (GstVpiTensorMeta),
+        gst_vpi_tensor_meta_init,
+        NULL,
+        gst_vpi_tensor_meta_transform);
+    g_once_init_leave (&info, meta);
+  }
+  return info;
+}
+
+GstVpiTensorMeta *
+gst_buffer_add_vpi_tensor_meta (GstBuffer * buffer, GstVpiTensorType type,
+    guint num_dims, const gsize * dims)
+{
+  GstVpiTensorMeta *meta = NULL;
+
+  g_return_val_if_fail (buffer != NULL, NULL);
+  g_return_val_if_fail (dims != NULL, NULL);
+  g_return_val_if_fail (num_dims > 0
+      && num_dims <= GST_VPI_TENSOR_MAX_DIMS, NULL);
+
+  GST_LOG ("Adding VPI tensor meta to buffer %p", buffer);
+
+  meta = (GstVpiTensorMeta *) gst_buffer_add_meta (buffer,
+      GST_VPI_TENSOR_META_INFO, NULL);
+  if (meta) {
+    meta->type = type;
+    meta->num_dims = num_dims;
+    memcpy (meta->dims, dims, num_dims * sizeof (gsize));
+  }
+
+  return meta;
+}
+
+gsize
+gst_vpi_tensor_type_get_size (GstVpiTensorType type)
+{
+  gsize ret = 0;
+
+  switch (type) {
+    case GST_VPI_TENSOR_TYPE_FLOAT32:
+      ret = sizeof (gfloat);
+      break;
+    case GST_VPI_TENSOR_TYPE_FLOAT16:
+      ret = sizeof (guint16);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_vpi_tensor_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  GstVpiTensorMeta *tensor_meta = (GstVpiTensorMeta *) meta;
+
+  tensor_meta->type = GST_VPI_TENSOR_TYPE_FLOAT32;
+  tensor_meta->num_dims = 0;
+  memset (tensor_meta->dims, 0, sizeof (tensor_meta->dims));
+
+  return TRUE;
+}
+
+static gboolean
+gst_vpi_tensor_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstVpiTensorMeta *tensor_meta = (GstVpiTensorMeta *) meta;
+
+  /* The shape only describes the whole, unmodified memory */
+  if (!GST_META_TRANSFORM_IS_COPY (type)) {
+    return FALSE;
+  }
+
+  return NULL != gst_buffer_add_vpi_tensor_meta (dest, tensor_meta->type,
+      tensor_meta->num_dims, tensor_meta->dims);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifndef __GST_VPI_TENSOR_META_H__
+#define __GST_VPI_TENSOR_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS 
+
+#define GST_VPI_TENSOR_META_API_TYPE (gst_vpi_tensor_meta_api_get_type())
+#define GST_VPI_TENSOR_META_INFO  (gst_vpi_tensor_meta_get_info())
+
+#define gst_buffer_get_vpi_tensor_meta(b) \
+  ((GstVpiTensorMeta *) gst_buffer_get_meta ((b), GST_VPI_TENSOR_META_API_TYPE))
+
+#define GST_VPI_TENSOR_MAX_DIMS 4
+
+typedef struct _GstVpiTensorMeta GstVpiTensorMeta;
+
+/**
+ * GstVpiTensorType:
+ * @GST_VPI_TENSOR_TYPE_FLOAT32: IEEE 754 single precision elements
+ * @GST_VPI_TENSOR_TYPE_FLOAT16: IEEE 754 half precision elements
+ *
+ * Type of the elements stored in a tensor.
+ */
+typedef enum
+{
+  GST_VPI_TENSOR_TYPE_FLOAT32,
+  GST_VPI_TENSOR_TYPE_FLOAT16,
+} GstVpiTensorType;
+
+/**
+ * GstVpiTensorMeta:
+ * @meta: parent #GstMeta
+ * @type: type of the elements
+ * @num_dims: number of valid entries in @dims
+ * @dims: size of each dimension, outermost first
+ *
+ * Extra buffer metadata describing a dense tensor stored in the buffer
+ * memory. For images the dimensions are N, C, H and W, in that order.
+ */
+struct _GstVpiTensorMeta
+{
+  GstMeta meta;
+  GstVpiTensorType type;
+  guint num_dims;
+  gsize dims[GST_VPI_TENSOR_MAX_DIMS];
+};
+
+/**
+ * gst_buffer_add_vpi_tensor_meta
+ * @buffer: (in) (transfer none) a #GstBuffer
+ * @type: (in) type of the elements
+ * @num_dims: (in) number of dimensions, up to GST_VPI_TENSOR_MAX_DIMS
+ * @dims: (in) (array length=num_dims) size of each dimension
+ *
+ * Attaches GstVpiTensorMeta metadata to @buffer with
+ * the given parameters.
+ *
+ * Returns: (transfer none): the #GstVpiTensorMeta on @buffer.
+ */
+GstVpiTensorMeta * gst_buffer_add_vpi_tensor_meta (GstBuffer * buffer,
+    GstVpiTensorType type, guint num_dims, const gsize * dims);
+
+/**
+ * gst_vpi_tensor_type_get_size
+ * @type: (in) type of the elements
+ *
+ * Returns: the size in bytes of a single element of @type.
+ */
+gsize gst_vpi_tensor_type_get_size (GstVpiTensorType type);
+
+GType gst_vpi_tensor_meta_api_get_type (void);
+const GstMetaInfo *gst_vpi_tensor_meta_get_info (void);
+
+G_END_DECLS
+
+#endif // __GST_VPI_TENSOR_META_H__
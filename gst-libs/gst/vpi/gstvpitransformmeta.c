@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#include "gstvpitransformmeta.h"
+
+#include <gst/video/video.h>
+#include <string.h>
+
+static gboolean gst_vpi_transform_meta_init (GstMeta * meta,
+    gpointer params, GstBuffer * buffer);
+static gboolean gst_vpi_transform_meta_transform (GstBuffer * dest,
+    GstMeta * meta, GstBuffer * buffer, GQuark type, gpointer data);
+
+GType
+gst_vpi_transform_meta_api_get_type (void)
+{
+  static volatile GType type = 0;
+  /* The matrix is in pixel coordinates, so elements that resize or rotate
+     the frame must drop it */
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR,
+    GST_META_TAG_VIDEO_SIZE_STR, GST_META_TAG_VIDEO_ORIENTATION_STR, NULL
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstVpiTransformMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_vpi_transform_meta_get_info (void)
+{
+  static const GstMetaInfo *info = NULL;
+
+  if (g_once_init_enter (&info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_VPI_TRANSFORM_META_API_TYPE,
+        "GstVpiTransformMeta",
+        sizeof (GstVpiTransformMeta),
+        gst_vpi_transform_meta_init,
+        NULL,
+        gst_vpi_transform_meta_transform);
+    g_once_init_leave (&info, meta);
+  }
+  return info;
+}
+
+GstVpiTransformMeta *
+gst_buffer_add_vpi_transform_meta (GstBuffer * buffer,
+    VPIPerspectiveTransform transform)
+{
+  GstVpiTransformMeta *meta = NULL;
+
+  g_return_val_if_fail (buffer != NULL, NULL);
+  g_return_val_if_fail (transform != NULL, NULL);
+
+  GST_LOG ("Adding VPI transform meta to buffer %p", buffer);
+
+  meta = (GstVpiTransformMeta *) gst_buffer_add_meta (buffer,
+      GST_VPI_TRANSFORM_META_INFO, NULL);
+  if (meta) {
+    memcpy (meta->transform, transform, sizeof (meta->transform));
+  }
+
+  return meta;
+}
+
+static gboolean
+gst_vpi_transform_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstVpiTransformMeta *transform_meta = (GstVpiTransformMeta *) meta;
+
+  memset (transform_meta->transform, 0, sizeof (transform_meta->transform));
+  transform_meta->transform[0][0] = 1;
+  transform_meta->transform[1][1] = 1;
+  transform_meta->transform[2][2] = 1;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vpi_transform_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstVpiTransformMeta *transform_meta = (GstVpiTransformMeta *) meta;
+
+  /* Only plain copies keep the pixel coordinates the matrix refers to */
+  if (!GST_META_TRANSFORM_IS_COPY (type)) {
+    return FALSE;
+  }
+
+  return NULL != gst_buffer_add_vpi_transform_meta (dest,
+      transform_meta->transform);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#ifndef __GST_VPI_TRANSFORM_META_H__
+#define __GST_VPI_TRANSFORM_META_H__
+
+#include <gst/gst.h>
+#include <vpi/Types.h>
+
+G_BEGIN_DECLS
+
+#define GST_VPI_TRANSFORM_META_API_TYPE (gst_vpi_transform_meta_api_get_type())
+#define GST_VPI_TRANSFORM_META_INFO  (gst_vpi_transform_meta_get_info())
+
+#define gst_buffer_get_vpi_transform_meta(b) \
+  ((GstVpiTransformMeta *) gst_buffer_get_meta ((b), GST_VPI_TRANSFORM_META_API_TYPE))
+
+typedef struct _GstVpiTransformMeta GstVpiTransformMeta;
+
+/**
+ * GstVpiTransformMeta:
+ * @meta: parent #GstMeta
+ * @transform: 3x3 perspective transformation to apply to this frame.
+ *
+ * Extra buffer metadata carrying a per-frame perspective transformation,
+ * expressed in pixel coordinates of the buffer it is attached to.
+ */
+struct _GstVpiTransformMeta
+{
+  GstMeta meta;
+  VPIPerspectiveTransform transform;
+};
+
+/**
+ * gst_buffer_add_vpi_transform_meta
+ * @buffer: (in) (transfer none) a #GstBuffer
+ * @transform: (in) the 3x3 transformation matrix
+ *
+ * Attaches GstVpiTransformMeta metadata to @buffer with
+ * the given parameters.
+ *
+ * Returns: (transfer none): the #GstVpiTransformMeta on @buffer.
+ */
+GstVpiTransformMeta * gst_buffer_add_vpi_transform_meta (GstBuffer * buffer,
+    VPIPerspectiveTransform transform);
+
+GType gst_vpi_transform_meta_api_get_type (void);
+const GstMetaInfo *gst_vpi_transform_meta_get_info (void);
+
+G_END_DECLS
+
+#endif // __GST_VPI_TRANSFORM_META_H__
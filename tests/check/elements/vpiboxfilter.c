@@ -10,10 +10,34 @@
  * back to RidgeRun without any encumbrance.
  */
 
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
 #include "tests/check/test_utils.h"
 
+#define FRAME_CAPS "video/x-raw,format=GRAY8,width=64,height=48,framerate=30/1"
+/* Largest kernel both VPI and the summed-area table run */
+#define INTEGRAL_FILTER "vpiupload ! vpiboxfilter backend=cpu size-x=11 size-y=11 boundary=%s integral-area=%u ! vpidownload"
+/* Areas that force the summed-area table, and one that leaves every
+   11x11 kernel to VPI */
+#define INTEGRAL_AREA_ALWAYS 1
+#define INTEGRAL_AREA_NEVER 122
+/* Both round the average, but not necessarily the same way */
+#define INTEGRAL_TOLERANCE 1
+
 static const gchar *test_pipes[] = {
   "videotestsrc ! vpiupload ! vpiboxfilter ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=GRAY16_LE ! vpiupload "
+      "! vpiboxfilter size-x=31 size-y=17 boundary=clamp "
+      "! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=GRAY8 ! vpiupload "
+      "! vpiboxfilter size-x=15 size-y=15 regions=\"<<10,10,80,40>>\" "
+      "! vpidownload ! fakesink",
+  "videotestsrc num-buffers=1 ! video/x-raw,format=GRAY8,width=64,height=48 "
+      "! tee name=raw ! queue ! fakesink name=reference signal-handoffs=true "
+      "raw. ! queue ! vpiupload ! tee name=t ! queue ! vpiboxfilter "
+      "! vpidownload ! fakesink t. ! queue ! vpidownload "
+      "! fakesink name=shared signal-handoffs=true",
   NULL,
 };
 
@@ -21,6 +45,9 @@ enum
 {
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES,
+  TEST_LARGE_KERNEL,
+  TEST_REGIONS,
+  TEST_SHARED_INPUT,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times)
@@ -30,6 +57,194 @@ GST_START_TEST (test_playing_to_null_multiple_times)
 
 GST_END_TEST;
 
+GST_START_TEST (test_large_kernel)
+{
+  test_states_change (test_pipes[TEST_LARGE_KERNEL]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_regions)
+{
+  test_states_change (test_pipes[TEST_REGIONS]);
+}
+
+GST_END_TEST;
+
+static void
+keep_buffer (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  GstBuffer **kept = user_data;
+
+  if (!*kept) {
+    *kept = gst_buffer_ref (buffer);
+  }
+}
+
+static void
+keep_buffer_of (GstElement * pipeline, const gchar * sink_name,
+    GstBuffer ** kept)
+{
+  GstElement *sink = gst_bin_get_by_name (GST_BIN (pipeline), sink_name);
+
+  fail_unless (sink);
+  g_signal_connect (sink, "handoff", G_CALLBACK (keep_buffer), kept);
+  gst_object_unref (sink);
+}
+
+GST_START_TEST (test_shared_input)
+{
+  GstElement *pipeline = NULL;
+  GstBus *bus = NULL;
+  GstMessage *message = NULL;
+  GstBuffer *reference = NULL;
+  GstBuffer *shared = NULL;
+  GstCaps *caps = gst_caps_from_string (FRAME_CAPS);
+  GstVideoInfo info = { 0 };
+  GstVideoFrame reference_frame = { 0 };
+  GstVideoFrame shared_frame = { 0 };
+  guint8 *reference_row = NULL;
+  guint8 *shared_row = NULL;
+  gint y = 0;
+
+  pipeline = test_create_pipeline (test_pipes[TEST_SHARED_INPUT]);
+  keep_buffer_of (pipeline, "reference", &reference);
+  keep_buffer_of (pipeline, "shared", &shared);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  message = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (message), GST_MESSAGE_EOS);
+  gst_message_unref (message);
+  gst_object_unref (bus);
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  /* The filter must not have written to the buffer the other branch got */
+  fail_unless (reference && shared);
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  fail_unless (gst_video_frame_map (&reference_frame, &info, reference,
+          GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&shared_frame, &info, shared,
+          GST_MAP_READ));
+  for (y = 0; y < GST_VIDEO_INFO_HEIGHT (&info); y++) {
+    reference_row = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&reference_frame,
+        0) + y * GST_VIDEO_FRAME_PLANE_STRIDE (&reference_frame, 0);
+    shared_row = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&shared_frame, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&shared_frame, 0);
+    fail_unless (0 == memcmp (reference_row, shared_row,
+            GST_VIDEO_INFO_WIDTH (&info)), "row %d was modified", y);
+  }
+  gst_video_frame_unmap (&shared_frame);
+  gst_video_frame_unmap (&reference_frame);
+
+  gst_buffer_unref (shared);
+  gst_buffer_unref (reference);
+  gst_caps_unref (caps);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static guint8
+pattern_value (gint x, gint y)
+{
+  return (x * 7 + y * 13) % 251 + 1;
+}
+
+/* Filters the pattern with the summed-area table or with VPI */
+static GstBuffer *
+filter_pattern (GstVideoInfo * info, const gchar * boundary,
+    guint integral_area)
+{
+  GstHarness *h = NULL;
+  GstVideoFrame frame = { 0 };
+  GstBuffer *buffer = NULL;
+  gchar *pipe_desc = NULL;
+  guint8 *data = NULL;
+  gint x = 0, y = 0;
+
+  pipe_desc = g_strdup_printf (INTEGRAL_FILTER, boundary, integral_area);
+  h = gst_harness_new_parse (pipe_desc);
+  gst_harness_set_src_caps_str (h, FRAME_CAPS);
+
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (info), NULL);
+  fail_unless (gst_video_frame_map (&frame, info, buffer, GST_MAP_WRITE));
+  for (y = 0; y < GST_VIDEO_FRAME_HEIGHT (&frame); y++) {
+    data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+    for (x = 0; x < GST_VIDEO_FRAME_WIDTH (&frame); x++) {
+      data[x] = pattern_value (x, y);
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+
+  gst_harness_teardown (h);
+  g_free (pipe_desc);
+
+  return buffer;
+}
+
+static void
+check_integral_matches_vpi (const gchar * boundary)
+{
+  GstCaps *caps = gst_caps_from_string (FRAME_CAPS);
+  GstVideoInfo info = { 0 };
+  GstVideoFrame integral = { 0 };
+  GstVideoFrame vpi = { 0 };
+  GstBuffer *integral_buffer = NULL;
+  GstBuffer *vpi_buffer = NULL;
+  guint8 *integral_row = NULL;
+  guint8 *vpi_row = NULL;
+  gint x = 0, y = 0;
+
+  fail_unless (gst_video_info_from_caps (&info, caps));
+
+  integral_buffer = filter_pattern (&info, boundary, INTEGRAL_AREA_ALWAYS);
+  vpi_buffer = filter_pattern (&info, boundary, INTEGRAL_AREA_NEVER);
+
+  fail_unless (gst_video_frame_map (&integral, &info, integral_buffer,
+          GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&vpi, &info, vpi_buffer, GST_MAP_READ));
+  for (y = 0; y < GST_VIDEO_INFO_HEIGHT (&info); y++) {
+    integral_row = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&integral, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&integral, 0);
+    vpi_row = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&vpi, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&vpi, 0);
+    for (x = 0; x < GST_VIDEO_INFO_WIDTH (&info); x++) {
+      fail_unless (ABS (integral_row[x] - vpi_row[x]) <= INTEGRAL_TOLERANCE,
+          "pixel %d,%d is %u with the summed-area table and %u with VPI",
+          x, y, integral_row[x], vpi_row[x]);
+    }
+  }
+  gst_video_frame_unmap (&vpi);
+  gst_video_frame_unmap (&integral);
+
+  gst_buffer_unref (vpi_buffer);
+  gst_buffer_unref (integral_buffer);
+  gst_caps_unref (caps);
+}
+
+GST_START_TEST (test_integral_zero)
+{
+  check_integral_matches_vpi ("zero");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_integral_clamp)
+{
+  check_integral_matches_vpi ("clamp");
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_box_filter_suite (void)
 {
@@ -38,6 +253,11 @@ gst_vpi_box_filter_suite (void)
 
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_large_kernel);
+  tcase_add_test (tc, test_regions);
+  tcase_add_test (tc, test_shared_input);
+  tcase_add_test (tc, test_integral_zero);
+  tcase_add_test (tc, test_integral_clamp);
 
   return suite;
 }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#include <gst/check/gstharness.h>
+
+#include "tests/check/test_utils.h"
+
+static const gchar *test_pipes[] = {
+  "videotestsrc ! video/x-raw,format=NV12,width=1920,height=1080 ! vpiupload ! vpiconvertscale ! video/x-raw(memory:VPIImage),format=RGBx,width=640,height=360 ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=GRAY8,width=320,height=240 ! vpiupload ! vpiconvertscale ! video/x-raw(memory:VPIImage),format=RGBA,width=640,height=480 ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=BGR,width=320,height=240 ! vpiupload ! vpiconvertscale ! video/x-raw(memory:VPIImage),format=RGB ! vpidownload ! fakesink",
+  NULL,
+};
+
+enum
+{
+  /* test names */
+  TEST_SCALE_FIRST,
+  TEST_CONVERT_FIRST,
+  TEST_CONVERT_ONLY,
+};
+
+GST_START_TEST (test_scale_first)
+{
+  test_states_change (test_pipes[TEST_SCALE_FIRST]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_convert_first)
+{
+  test_states_change (test_pipes[TEST_CONVERT_FIRST]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_convert_only)
+{
+  test_states_change (test_pipes[TEST_CONVERT_ONLY]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bypass_on_same_caps)
+{
+  GstHarness *h;
+  GstBuffer *in_buf;
+  GstBuffer *out_buf;
+  const gchar *caps =
+      "video/x-raw(memory:VPIImage),format=GRAY8,width=320,height=240,framerate=30/1";
+  const gsize size = 320 * 240;
+
+  h = gst_harness_new ("vpiconvertscale");
+
+  /* Define caps */
+  gst_harness_set_src_caps_str (h, caps);
+  gst_harness_set_sink_caps_str (h, caps);
+
+  /* Create a dummy buffer */
+  in_buf = gst_harness_create_buffer (h, size);
+
+  /* Push the buffer */
+  gst_harness_push (h, in_buf);
+
+  /* Pull out the buffer */
+  out_buf = gst_harness_pull (h);
+
+  /* validate the buffer in is the same as buffer out */
+  fail_unless (in_buf == out_buf);
+
+  /* cleanup */
+  gst_buffer_unref (out_buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_vpi_convert_scale_suite (void)
+{
+  Suite *suite = suite_create ("vpiconvertscale");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (suite, tc);
+  tcase_add_test (tc, test_scale_first);
+  tcase_add_test (tc, test_convert_first);
+  tcase_add_test (tc, test_convert_only);
+  tcase_add_test (tc, test_bypass_on_same_caps);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_vpi_convert_scale);
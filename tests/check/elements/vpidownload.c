@@ -13,10 +13,11 @@
 #include <gst/check/gstcheck.h>
 
 static const gchar *test_pipes[] = {
-  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=I420,framerate=30/1 ! vpidownload name=download ! fakesink",
-  "fakesrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=I420,framerate=30/1 ! vpidownload ! fakesink",
-  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=I420,framerate=30/1 ! vpidownload ! capsfilter caps=video/x-raw(memory:VPIImage) ! fakesink",
-  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=I420,framerate=30/1 ! vpidownload ! capsfilter caps=video/x-raw,width=640,height=480 ! fakesink",
+  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=NV12,framerate=30/1 ! vpidownload name=download ! fakesink",
+  "fakesrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=NV12,framerate=30/1 ! vpidownload ! fakesink",
+  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=NV12,framerate=30/1 ! vpidownload ! capsfilter caps=video/x-raw(memory:VPIImage) ! fakesink",
+  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=NV12,framerate=30/1 ! vpidownload ! capsfilter caps=video/x-raw,width=640,height=480 ! fakesink",
+  "fakesrc ! capsfilter caps=video/x-raw(memory:VPIImage),width=1280,height=720,format=GRAY16_BE,framerate=30/1 ! vpidownload ! fakesink",
   NULL,
 };
 
@@ -26,7 +27,8 @@ enum
   TEST_SUCCESS_NEGOTIATION,
   TEST_FAIL_PAD_COMPATIBILITY_SINK,
   TEST_FAIL_PAD_COMPATIBILITY_SRC,
-  TEST_FAIL_PAD_COMPATIBILITY_WIDTH_HEIGHT
+  TEST_FAIL_PAD_COMPATIBILITY_WIDTH_HEIGHT,
+  TEST_FAIL_PAD_COMPATIBILITY_FORMAT
 };
 
 GST_START_TEST (test_success_negotiation)
@@ -124,6 +126,14 @@ GST_START_TEST (test_fail_pad_compatibility_width_height)
 
 GST_END_TEST;
 
+/* VPI can't hold frames in formats it doesn't wrap */
+GST_START_TEST (test_fail_pad_compatibility_format)
+{
+  fail_pad_compatibility (test_pipes[TEST_FAIL_PAD_COMPATIBILITY_FORMAT]);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_download_suite (void)
 {
@@ -135,6 +145,7 @@ gst_vpi_download_suite (void)
   tcase_add_test (tc, test_fail_pad_compatibility_sink);
   tcase_add_test (tc, test_fail_pad_compatibility_src);
   tcase_add_test (tc, test_fail_pad_compatibility_width_height);
+  tcase_add_test (tc, test_fail_pad_compatibility_format);
 
   return suite;
 }
@@ -10,10 +10,43 @@
  * back to RidgeRun without any encumbrance.
  */
 
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+#include <math.h>
+
 #include "tests/check/test_utils.h"
 
+/* Three passes on luma, a single exact one on NV12 chroma */
+#define STEP_FILTER "vpiupload ! vpigaussianfilter boundary=clamp size-x=21 size-y=21 sigma-x=3 sigma-y=3 ! vpidownload"
+#define STEP_GRAY8_CAPS "video/x-raw,format=GRAY8,width=64,height=64,framerate=30/1"
+#define STEP_NV12_CAPS "video/x-raw,format=NV12,width=64,height=64,framerate=30/1"
+#define STEP_SIGMA 3.0
+/* Rounding of the intermediates and the sampled kernels */
+#define STEP_TOLERANCE 6
+/* Starts at the edge, so it is only right if the filter sees the pixels
+   to its left */
+#define STEP_REGION_FILTER "vpiupload ! vpigaussianfilter boundary=clamp size-x=21 size-y=21 sigma-x=3 sigma-y=3 regions=\"<<32,8,16,48>>\" ! vpidownload"
+#define STEP_REGION_X 32
+#define STEP_REGION_Y 8
+#define STEP_REGION_WIDTH 16
+#define STEP_REGION_HEIGHT 48
+/* A sigma below a pyramid level still blurs interleaved frames, with a
+   warning */
+#define SMALL_SIGMA_FILTER "vpiupload ! vpigaussianfilter sigma-x=1 sigma-y=1 ! vpidownload"
+#define SMALL_SIGMA_CAPS "video/x-raw,format=RGBx,width=64,height=64,framerate=30/1"
+
 static const gchar *test_pipes[] = {
   "videotestsrc ! vpiupload ! vpigaussianfilter ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=GRAY8 ! vpiupload "
+      "! vpigaussianfilter size-x=31 size-y=31 sigma-x=0 sigma-y=0 "
+      "! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=NV12 ! vpiupload "
+      "! vpigaussianfilter size-x=15 size-y=15 ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=RGBx ! vpiupload "
+      "! vpigaussianfilter ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=NV12 ! vpiupload "
+      "! vpigaussianfilter regions=\"<<0,0,64,64>,<101,51,33,21>>\" "
+      "! vpidownload ! fakesink",
   NULL,
 };
 
@@ -21,6 +54,10 @@ enum
 {
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES,
+  TEST_LARGE_KERNEL,
+  TEST_NV12,
+  TEST_RGBX,
+  TEST_REGIONS,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times)
@@ -30,6 +67,201 @@ GST_START_TEST (test_playing_to_null_multiple_times)
 
 GST_END_TEST;
 
+GST_START_TEST (test_large_kernel)
+{
+  test_states_change (test_pipes[TEST_LARGE_KERNEL]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nv12)
+{
+  test_states_change (test_pipes[TEST_NV12]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_rgbx)
+{
+  test_states_change (test_pipes[TEST_RGBX]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_regions)
+{
+  test_states_change (test_pipes[TEST_REGIONS]);
+}
+
+GST_END_TEST;
+
+/* Value of a vertical edge in the middle of the component, blurred with
+   sigma if it is not 0. The third component falls instead of rising */
+static gint
+step_value (gint x, gint width, guint comp, gdouble sigma)
+{
+  gdouble edge = width / 2 - 0.5;
+  gdouble value = 0;
+
+  if (0 == sigma) {
+    value = x > edge ? 255 : 0;
+  } else {
+    value = 255 * 0.5 * (1 + erf ((x - edge) / (sigma * G_SQRT2)));
+  }
+
+  return round (2 == comp ? 255 - value : value);
+}
+
+/* Fills the frame with the edge, or checks it is there with the blur of
+   each component inside region, or everywhere if it is NULL */
+static void
+process_step (GstVideoFrame * frame, gboolean check, gdouble sigma,
+    gint tolerance, const GstVideoRectangle * region)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  guint8 *data = NULL;
+  gdouble comp_sigma = 0;
+  gboolean blurred = FALSE;
+  gint value = 0;
+  gint x = 0, y = 0;
+  guint comp = 0;
+
+  for (comp = 0; comp < GST_VIDEO_FRAME_N_COMPONENTS (frame); comp++) {
+    comp_sigma = sigma / (1 << GST_VIDEO_FORMAT_INFO_W_SUB (finfo, comp));
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (frame, comp); y++) {
+      data = (guint8 *) GST_VIDEO_FRAME_COMP_DATA (frame, comp) +
+          y * GST_VIDEO_FRAME_COMP_STRIDE (frame, comp);
+      for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (frame, comp); x++) {
+        blurred = check && (!region || (x >= region->x
+                && x < region->x + region->w && y >= region->y
+                && y < region->y + region->h));
+        value = step_value (x, GST_VIDEO_FRAME_COMP_WIDTH (frame, comp), comp,
+            blurred ? comp_sigma : 0);
+        if (check) {
+          fail_unless (ABS (data[x * GST_VIDEO_FRAME_COMP_PSTRIDE (frame,
+                          comp)] - value) <= tolerance,
+              "component %u at %d,%d is %u instead of %d", comp, x, y,
+              data[x * GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp)], value);
+        } else {
+          data[x * GST_VIDEO_FRAME_COMP_PSTRIDE (frame, comp)] = value;
+        }
+      }
+    }
+  }
+}
+
+/* Pushes a frame with an edge through the pipeline and checks every
+   component of the output is the edge blurred with sigma */
+static void
+check_step_blur (const gchar * pipe_desc, const gchar * caps_str,
+    gdouble sigma, gint tolerance, const GstVideoRectangle * region)
+{
+  GstHarness *h = NULL;
+  GstCaps *caps = gst_caps_from_string (caps_str);
+  GstVideoInfo info = { 0 };
+  GstVideoFrame frame = { 0 };
+  GstBuffer *buffer = NULL;
+
+  h = gst_harness_new_parse (pipe_desc);
+  gst_harness_set_src_caps_str (h, caps_str);
+
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE));
+  process_step (&frame, FALSE, 0, 0, NULL);
+  gst_video_frame_unmap (&frame);
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_READ));
+  process_step (&frame, TRUE, sigma, tolerance, region);
+  gst_video_frame_unmap (&frame);
+
+  gst_buffer_unref (buffer);
+  gst_caps_unref (caps);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_gray8_passes)
+{
+  check_step_blur (STEP_FILTER, STEP_GRAY8_CAPS, STEP_SIGMA, STEP_TOLERANCE,
+      NULL);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nv12_planes)
+{
+  check_step_blur (STEP_FILTER, STEP_NV12_CAPS, STEP_SIGMA, STEP_TOLERANCE,
+      NULL);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_region_borders)
+{
+  GstVideoRectangle region = { STEP_REGION_X, STEP_REGION_Y,
+    STEP_REGION_WIDTH, STEP_REGION_HEIGHT
+  };
+
+  check_step_blur (STEP_REGION_FILTER, STEP_GRAY8_CAPS, STEP_SIGMA,
+      STEP_TOLERANCE, &region);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_interleaved_small_sigma)
+{
+  GstHarness *h = NULL;
+  GstBus *bus = gst_bus_new ();
+  GstMessage *message = NULL;
+  GstCaps *caps = gst_caps_from_string (SMALL_SIGMA_CAPS);
+  GstVideoInfo info = { 0 };
+  GstVideoFrame frame = { 0 };
+  GstBuffer *buffer = NULL;
+  guint8 *data = NULL;
+  gint width = 0;
+  gint x = 0;
+  gboolean blurred = FALSE;
+
+  h = gst_harness_new_parse (SMALL_SIGMA_FILTER);
+  gst_element_set_bus (h->element, bus);
+  gst_harness_set_src_caps_str (h, SMALL_SIGMA_CAPS);
+
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE));
+  process_step (&frame, FALSE, 0, 0, NULL);
+  gst_video_frame_unmap (&frame);
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+
+  /* The edge must not come back untouched */
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_READ));
+  data = GST_VIDEO_FRAME_COMP_DATA (&frame, 0);
+  width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, 0);
+  for (x = 0; x < width; x++) {
+    blurred |= data[x * GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, 0)] !=
+        step_value (x, width, 0, 0);
+  }
+  fail_unless (blurred);
+  gst_video_frame_unmap (&frame);
+
+  message = gst_bus_pop_filtered (bus, GST_MESSAGE_WARNING);
+  fail_unless (message);
+  gst_message_unref (message);
+
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_buffer_unref (buffer);
+  gst_caps_unref (caps);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_gaussian_filter_suite (void)
 {
@@ -38,6 +270,14 @@ gst_vpi_gaussian_filter_suite (void)
 
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_large_kernel);
+  tcase_add_test (tc, test_nv12);
+  tcase_add_test (tc, test_rgbx);
+  tcase_add_test (tc, test_regions);
+  tcase_add_test (tc, test_gray8_passes);
+  tcase_add_test (tc, test_nv12_planes);
+  tcase_add_test (tc, test_region_borders);
+  tcase_add_test (tc, test_interleaved_small_sigma);
 
   return suite;
 }
@@ -12,11 +12,44 @@
 
 #include <glib/gprintf.h>
 
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
 #include "tests/check/test_utils.h"
 
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define SQUARE_SIZE 60
+#define SHIFT_X 4
+#define SHIFT_Y 2
+/* Metas carry truncated integer positions */
+#define POSITION_TOLERANCE 2
+#define CHECKER_SIZE 16
+#define SQUARE_X 100
+#define SQUARE_Y 80
+/* One pixel of a half scale detection is two frame pixels */
+#define SCALED_TOLERANCE 4
+
 static const gchar *test_pipes[] = {
   "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
       "vpiupload ! vpiharrisdetector ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector detect-interval=5 propagation=flow ! "
+      "vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector regions=\"<<0,360,640,360>, "
+      "<1000,600,400,400>>\" ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector max-keypoints=200 grid-columns=8 "
+      "grid-rows=5 ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector detect-scale=0.5 ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector capacity=64 ! vpiharrisdetector "
+      "capacity=64 ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY16_LE ! "
+      "vpiupload ! vpiharrisdetector detect-interval=5 propagation=flow ! "
+      "vpidownload ! fakesink",
   NULL,
 };
 
@@ -24,6 +57,12 @@ enum
 {
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_GRAY8,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_FLOW,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_REGIONS,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_MAX_KEYPOINTS,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_DETECT_SCALE,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_CAPACITY,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_FLOW_GRAY16,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times_gray8)
@@ -33,6 +72,255 @@ GST_START_TEST (test_playing_to_null_multiple_times_gray8)
 
 GST_END_TEST;
 
+GST_START_TEST (test_playing_to_null_multiple_times_flow)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_FLOW]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_regions)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_REGIONS]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_max_keypoints)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_MAX_KEYPOINTS]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_detect_scale)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_DETECT_SCALE]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_capacity)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_CAPACITY]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_flow_gray16)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_FLOW_GRAY16]);
+}
+
+GST_END_TEST;
+
+/* Black GRAY8 frame with a white square, whose corners are the only
+   keypoints */
+static GstBuffer *
+create_square_frame (guint x, guint y)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (FRAME_WIDTH * FRAME_HEIGHT);
+  GstMapInfo map = { 0 };
+  guint row = 0;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  for (row = y; row < y + SQUARE_SIZE; row++) {
+    memset (map.data + row * FRAME_WIDTH + x, 255, SQUARE_SIZE);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+/* GRAY8 checkerboard, with a corner every CHECKER_SIZE pixels */
+static GstBuffer *
+create_checkers_frame (void)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (FRAME_WIDTH * FRAME_HEIGHT);
+  GstMapInfo map = { 0 };
+  guint row = 0;
+  guint col = 0;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (row = 0; row < FRAME_HEIGHT; row++) {
+    for (col = 0; col < FRAME_WIDTH; col++) {
+      map.data[row * FRAME_WIDTH + col] =
+          ((row / CHECKER_SIZE + col / CHECKER_SIZE) % 2) ? 255 : 0;
+    }
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static GArray *
+get_keypoints (GstBuffer * buffer)
+{
+  GArray *keypoints = g_array_new (FALSE, FALSE, sizeof (GstVideoRectangle));
+  GstVideoRegionOfInterestMeta *meta = NULL;
+  GstVideoRectangle keypoint = { 0 };
+  gpointer state = NULL;
+
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    keypoint.x = meta->x;
+    keypoint.y = meta->y;
+    g_array_append_val (keypoints, keypoint);
+  }
+
+  return keypoints;
+}
+
+GST_START_TEST (test_flow_propagation)
+{
+  GstHarness *h = NULL;
+  GstBuffer *detected = NULL;
+  GstBuffer *propagated = NULL;
+  GArray *before = NULL;
+  GArray *after = NULL;
+  GstVideoRectangle *moved = NULL;
+  GstVideoRectangle *original = NULL;
+  gboolean found = FALSE;
+  guint i = 0;
+  guint j = 0;
+
+  h = gst_harness_new_parse ("vpiupload ! vpiharrisdetector detect-interval=2 "
+      "propagation=flow ! vpidownload");
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=320,"
+      "height=240,framerate=30/1");
+
+  /* The first frame is detected, the second one only propagated */
+  fail_unless_equals_int (gst_harness_push (h, create_square_frame (SQUARE_X,
+              SQUARE_Y)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_square_frame (SQUARE_X + SHIFT_X, SQUARE_Y + SHIFT_Y)),
+      GST_FLOW_OK);
+
+  detected = gst_harness_pull (h);
+  propagated = gst_harness_pull (h);
+  before = get_keypoints (detected);
+  after = get_keypoints (propagated);
+
+  fail_unless (before->len > 0);
+  fail_unless (after->len > 0);
+
+  /* Every propagated keypoint followed the square */
+  for (i = 0; i < after->len; i++) {
+    moved = &g_array_index (after, GstVideoRectangle, i);
+    found = FALSE;
+    for (j = 0; j < before->len && !found; j++) {
+      original = &g_array_index (before, GstVideoRectangle, j);
+      found = ABS (moved->x - original->x - SHIFT_X) <= POSITION_TOLERANCE
+          && ABS (moved->y - original->y - SHIFT_Y) <= POSITION_TOLERANCE;
+    }
+    fail_unless (found, "Keypoint %d,%d was not moved with the frame",
+        moved->x, moved->y);
+  }
+
+  g_array_unref (before);
+  g_array_unref (after);
+  gst_buffer_unref (detected);
+  gst_buffer_unref (propagated);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+test_max_keypoints (guint max_keypoints, guint grid_columns, guint grid_rows)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GArray *keypoints = NULL;
+  gchar *launch = NULL;
+
+  launch = g_strdup_printf ("vpiupload ! vpiharrisdetector max-keypoints=%u "
+      "grid-columns=%u grid-rows=%u ! vpidownload", max_keypoints,
+      grid_columns, grid_rows);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=320,"
+      "height=240,framerate=30/1");
+
+  fail_unless_equals_int (gst_harness_push (h, create_checkers_frame ()),
+      GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+  keypoints = get_keypoints (buffer);
+
+  fail_unless (keypoints->len > 0);
+  fail_unless (keypoints->len <= max_keypoints,
+      "Got %u keypoints, more than max-keypoints=%u", keypoints->len,
+      max_keypoints);
+
+  g_array_unref (keypoints);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_max_keypoints_per_cell)
+{
+  test_max_keypoints (80, 4, 4);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_max_keypoints_more_cells_than_keypoints)
+{
+  /* 40 cells for 10 keypoints */
+  test_max_keypoints (10, 8, 5);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_detect_scale_coordinates)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GArray *keypoints = NULL;
+  GstVideoRectangle *keypoint = NULL;
+  gint corners_x[2] = { SQUARE_X, SQUARE_X + SQUARE_SIZE - 1 };
+  gint corners_y[2] = { SQUARE_Y, SQUARE_Y + SQUARE_SIZE - 1 };
+  gboolean found = FALSE;
+  guint i = 0;
+  guint c = 0;
+
+  h = gst_harness_new_parse ("vpiupload ! vpiharrisdetector detect-scale=0.5 "
+      "! vpidownload");
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=320,"
+      "height=240,framerate=30/1");
+
+  fail_unless_equals_int (gst_harness_push (h,
+          create_square_frame (SQUARE_X, SQUARE_Y)), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+  keypoints = get_keypoints (buffer);
+
+  fail_unless (keypoints->len > 0);
+
+  /* Keypoints found on the half scale image are reported at the corners of
+     the square in the full resolution frame */
+  for (i = 0; i < keypoints->len; i++) {
+    keypoint = &g_array_index (keypoints, GstVideoRectangle, i);
+    found = FALSE;
+    for (c = 0; c < 4 && !found; c++) {
+      found = ABS (keypoint->x - corners_x[c % 2]) <= SCALED_TOLERANCE
+          && ABS (keypoint->y - corners_y[c / 2]) <= SCALED_TOLERANCE;
+    }
+    fail_unless (found, "Keypoint %d,%d is not on a corner of the square",
+        keypoint->x, keypoint->y);
+  }
+
+  g_array_unref (keypoints);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_harris_detector_suite (void)
 {
@@ -41,6 +329,16 @@ gst_vpi_harris_detector_suite (void)
 
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times_gray8);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_flow);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_regions);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_max_keypoints);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_detect_scale);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_capacity);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_flow_gray16);
+  tcase_add_test (tc, test_flow_propagation);
+  tcase_add_test (tc, test_max_keypoints_per_cell);
+  tcase_add_test (tc, test_max_keypoints_more_cells_than_keypoints);
+  tcase_add_test (tc, test_detect_scale_coordinates);
   return suite;
 }
 
@@ -14,8 +14,10 @@
 
 #include "tests/check/test_utils.h"
 
-#define MAX_BOXES 64
+#define MAX_BOXES 4096
+#define BOXES_PER_PAYLOAD 64
 #define NUMBER_PARAMS 4
+#define NUMBER_TRACK_PARAMS 5
 #define SLEEP_TIME 500000
 
 static const gchar *test_pipes[] = {
@@ -28,6 +30,9 @@ static const gchar *test_pipes[] = {
   "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720 ! "
       "vpiupload ! vpiklttracker name=tracker boxes=\"<<613,332,23,23>, "
       "<669,329,30,29>>\" ! vpidownload ! fakesink",
+  "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,format=GRAY8 ! "
+      "vpiupload ! vpiharrisdetector ! vpiklttracker seed-type=keypoint ! "
+      "vpidownload ! fakesink",
   NULL,
 };
 
@@ -37,6 +42,7 @@ enum
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_GRAY8,
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_GRAY16,
   TEST_REDEFINING_BOXES_ON_THE_FLY,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_SEEDED,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times_gray8)
@@ -53,27 +59,35 @@ GST_START_TEST (test_playing_to_null_multiple_times_gray_16)
 
 GST_END_TEST;
 
-GST_START_TEST (test_discard_when_more_than_64_box_provided)
+GST_START_TEST (test_playing_to_null_multiple_times_seeded)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_SEEDED]);
+}
+
+GST_END_TEST;
+
+static void
+test_number_of_boxes (gint num_boxes, gint expected_boxes)
 {
   GstElement *pipeline = NULL;
   GstElement *tracker = NULL;
-  gint num_boxes = 68;
-  gchar pipe[2048];
+  GString *pipe = NULL;
   gchar box[] = "<613,332,23,23>";
   gint i = 0;
   GValue get_gst_array = G_VALUE_INIT;
 
-  g_sprintf (pipe, "videotestsrc ! capsfilter caps=video/x-raw,width=1280,"
+  pipe = g_string_new ("videotestsrc ! capsfilter caps=video/x-raw,width=1280,"
       "height=720 ! vpiupload ! vpiklttracker name=tracker boxes=\"<");
 
-  for (i = 0; i < num_boxes; i++) {
-    g_sprintf (pipe, "%s%s,", pipe, box);
+  for (i = 0; i < num_boxes - 1; i++) {
+    g_string_append_printf (pipe, "%s,", box);
   }
-  g_sprintf (pipe, "%s%s>\" ! vpidownload ! fakesink", pipe, box);
+  g_string_append_printf (pipe, "%s>\" ! vpidownload ! fakesink", box);
 
   g_value_init (&get_gst_array, GST_TYPE_ARRAY);
 
-  pipeline = test_create_pipeline (pipe);
+  pipeline = test_create_pipeline (pipe->str);
+  g_string_free (pipe, TRUE);
 
   tracker = gst_bin_get_by_name (GST_BIN (pipeline), "tracker");
 
@@ -84,15 +98,31 @@ GST_START_TEST (test_discard_when_more_than_64_box_provided)
 
   g_object_get_property (G_OBJECT (tracker), "boxes", &get_gst_array);
 
-  /* Test if other boxes were discarded */
-  fail_unless_equals_int (gst_value_array_get_size (&get_gst_array), MAX_BOXES);
+  fail_unless_equals_int (gst_value_array_get_size (&get_gst_array),
+      expected_boxes);
 
   fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
       GST_STATE_CHANGE_SUCCESS);
 
+  g_value_unset (&get_gst_array);
+  gst_object_unref (tracker);
   gst_object_unref (pipeline);
 }
 
+GST_START_TEST (test_more_than_64_boxes_provided)
+{
+  /* Boxes beyond a single payload are tracked by additional shards */
+  test_number_of_boxes (BOXES_PER_PAYLOAD + 5, BOXES_PER_PAYLOAD + 5);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_discard_when_more_than_max_boxes_provided)
+{
+  /* Test if other boxes were discarded */
+  test_number_of_boxes (MAX_BOXES + 5, MAX_BOXES);
+}
+
 GST_END_TEST;
 
 static void
@@ -197,6 +227,7 @@ append_boxes_on_the_fly (gint set_array[][NUMBER_PARAMS],
   GstElement *pipeline = NULL;
   GstElement *tracker = NULL;
   GValue get_gst_array = G_VALUE_INIT;
+  guint id = 0;
   gint i = 0;
 
   g_value_init (&get_gst_array, GST_TYPE_ARRAY);
@@ -213,7 +244,7 @@ append_boxes_on_the_fly (gint set_array[][NUMBER_PARAMS],
 
   for (i = 0; i < set_boxes; i++) {
     g_signal_emit_by_name (tracker, "new-box", set_array[i][0], set_array[i][1],
-        set_array[i][2], set_array[i][3]);
+        set_array[i][2], set_array[i][3], &id);
   }
 
   g_object_get_property (G_OBJECT (tracker), "boxes", &get_gst_array);
@@ -226,6 +257,137 @@ append_boxes_on_the_fly (gint set_array[][NUMBER_PARAMS],
   gst_object_unref (pipeline);
 }
 
+static void
+remove_boxes_on_the_fly (guint * indexes, gint get_array[][NUMBER_PARAMS],
+    gint remove_boxes, gint get_boxes)
+{
+  GstElement *pipeline = NULL;
+  GstElement *tracker = NULL;
+  GValue get_gst_array = G_VALUE_INIT;
+  gint i = 0;
+
+  g_value_init (&get_gst_array, GST_TYPE_ARRAY);
+
+  pipeline =
+      test_create_pipeline (test_pipes[TEST_REDEFINING_BOXES_ON_THE_FLY]);
+
+  tracker = gst_bin_get_by_name (GST_BIN (pipeline), "tracker");
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL, -1),
+      GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < remove_boxes; i++) {
+    g_signal_emit_by_name (tracker, "remove-box", indexes[i]);
+  }
+
+  g_object_get_property (G_OBJECT (tracker), "boxes", &get_gst_array);
+  /* Test if what gst gets is what was expected */
+  compare_c_array_with_gst_array (&get_gst_array, get_array, get_boxes);
+
+  /* Test that the boxes are still the same once merged */
+  g_usleep (SLEEP_TIME);
+  g_value_reset (&get_gst_array);
+  g_object_get_property (G_OBJECT (tracker), "boxes", &get_gst_array);
+  fail_unless_equals_int (gst_value_array_get_size (&get_gst_array),
+      get_boxes);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  g_value_unset (&get_gst_array);
+  gst_object_unref (tracker);
+  gst_object_unref (pipeline);
+}
+
+static void
+compare_tracks (GstElement * tracker, gint tracks[][NUMBER_TRACK_PARAMS],
+    guint num_tracks)
+{
+  GValue gst_array = G_VALUE_INIT;
+  const GValue *row = NULL;
+  guint i = 0;
+  guint j = 0;
+
+  g_value_init (&gst_array, GST_TYPE_ARRAY);
+  g_object_get_property (G_OBJECT (tracker), "tracks", &gst_array);
+
+  fail_unless_equals_int (gst_value_array_get_size (&gst_array), num_tracks);
+  for (i = 0; i < num_tracks; i++) {
+    row = gst_value_array_get_value (&gst_array, i);
+    fail_unless_equals_int (gst_value_array_get_size (row),
+        NUMBER_TRACK_PARAMS);
+    for (j = 0; j < NUMBER_TRACK_PARAMS; j++) {
+      fail_unless_equals_int (g_value_get_int (gst_value_array_get_value (row,
+                  j)), tracks[i][j]);
+    }
+  }
+
+  g_value_unset (&gst_array);
+}
+
+GST_START_TEST (test_remove_box_by_id)
+{
+  GstElement *pipeline = NULL;
+  GstElement *tracker = NULL;
+  guint id = 0;
+  gint initial[2][NUMBER_TRACK_PARAMS] = { {0, 613, 332, 23, 23}
+  , {1, 669, 329, 30, 29}
+  };
+  gint appended[3][NUMBER_TRACK_PARAMS] = { {0, 613, 332, 23, 23}
+  , {1, 669, 329, 30, 29}
+  , {2, 790, 376, 41, 22}
+  };
+  gint removed[2][NUMBER_TRACK_PARAMS] = { {1, 669, 329, 30, 29}
+  , {2, 790, 376, 41, 22}
+  };
+
+  pipeline =
+      test_create_pipeline (test_pipes[TEST_REDEFINING_BOXES_ON_THE_FLY]);
+  tracker = gst_bin_get_by_name (GST_BIN (pipeline), "tracker");
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL, -1),
+      GST_STATE_CHANGE_SUCCESS);
+
+  compare_tracks (tracker, initial, 2);
+
+  g_signal_emit_by_name (tracker, "new-box", 790, 376, 41, 22, &id);
+  fail_unless_equals_int (id, 2);
+  compare_tracks (tracker, appended, 3);
+
+  /* The IDs of the remaining boxes do not shift, so removing the same ID
+     twice removes a single box */
+  g_signal_emit_by_name (tracker, "remove-box", 0);
+  g_signal_emit_by_name (tracker, "remove-box", 0);
+  compare_tracks (tracker, removed, 2);
+
+  /* Still the same once merged by the streaming thread */
+  g_usleep (SLEEP_TIME);
+  compare_tracks (tracker, removed, 2);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_object_unref (tracker);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_remove_boxes_on_the_fly)
+{
+  guint indexes[2] = { 0, 5 /* This one does not exist */  };
+  gint get_array[1][NUMBER_PARAMS] = { {669, 329, 30, 29}
+  };
+
+  remove_boxes_on_the_fly (indexes, get_array, 2, 1);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_append_boxes_on_the_fly)
 {
   gint set_array[3][NUMBER_PARAMS] = { {613, 332, 34, 23}
@@ -292,11 +454,15 @@ gst_vpi_klt_tracker_suite (void)
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times_gray8);
   tcase_add_test (tc, test_playing_to_null_multiple_times_gray_16);
-  tcase_add_test (tc, test_discard_when_more_than_64_box_provided);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_seeded);
+  tcase_add_test (tc, test_more_than_64_boxes_provided);
+  tcase_add_test (tc, test_discard_when_more_than_max_boxes_provided);
   tcase_add_test (tc, test_redefine_to_more_boxes_on_the_fly);
   tcase_add_test (tc, test_redefine_to_less_boxes_on_the_fly);
   tcase_add_test (tc, test_redefine_and_discard_boxes_on_the_fly);
   tcase_add_test (tc, test_append_boxes_on_the_fly);
+  tcase_add_test (tc, test_remove_boxes_on_the_fly);
+  tcase_add_test (tc, test_remove_box_by_id);
 
   return suite;
 }
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#include <gst/check/gstharness.h>
+#include "tests/check/test_utils.h"
+
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define FRAME_CAPS "video/x-raw,format=GRAY8,width=320,height=240,framerate=30/1"
+#define BLOCK_SIZE 16
+#define CAMERA_SHAKE 8
+/* Tracking is subpixel accurate, so a few pixels on block edges may round
+   differently with nearest interpolation */
+#define MAX_MISMATCH_RATIO 0.01
+
+static const gchar *test_pipes[] = {
+  "videotestsrc pattern=ball ! video/x-raw,format=GRAY8 ! vpiupload "
+      "! vpistabilize ! vpidownload ! fakesink",
+  "videotestsrc pattern=ball ! video/x-raw,format=NV12 ! vpiupload "
+      "! vpistabilize smoothing-window=5 ! vpidownload ! fakesink",
+  NULL,
+};
+
+enum
+{
+  /* test names */
+  TEST_GRAY8_PLAYING_TO_NULL_MULTIPLE_TIMES,
+  TEST_NV12_PLAYING_TO_NULL_MULTIPLE_TIMES,
+};
+
+/* Blocks of pseudo random gray levels, their corners are easy to track */
+static guint8
+block_value (gint x, gint y)
+{
+  guint bx = (x + FRAME_WIDTH) / BLOCK_SIZE;
+  guint by = y / BLOCK_SIZE;
+
+  return ((bx * 73856093u) ^ (by * 19349663u)) % 8 * 32;
+}
+
+/* Frame of a camera moved by @offset pixels, the scene moves the other
+   way */
+static GstBuffer *
+create_shaken_frame (gint offset)
+{
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+  gint x = 0, y = 0;
+
+  buffer = gst_buffer_new_allocate (NULL, FRAME_WIDTH * FRAME_HEIGHT, NULL);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_WRITE));
+  for (y = 0; y < FRAME_HEIGHT; y++) {
+    for (x = 0; x < FRAME_WIDTH; x++) {
+      info.data[y * FRAME_WIDTH + x] = block_value (x + offset, y);
+    }
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+/* Compares the frame with the scene seen from @offset, away from the
+   borders the warp fills with zeros */
+static gdouble
+mismatch_ratio (GstBuffer * buffer, gint offset)
+{
+  GstMapInfo info = { 0 };
+  guint mismatches = 0;
+  guint total = 0;
+  gint x = 0, y = 0;
+
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  for (y = BLOCK_SIZE; y < FRAME_HEIGHT - BLOCK_SIZE; y++) {
+    for (x = BLOCK_SIZE; x < FRAME_WIDTH - BLOCK_SIZE; x++) {
+      mismatches += info.data[y * FRAME_WIDTH + x] != block_value (x + offset,
+          y);
+      total++;
+    }
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  return (gdouble) mismatches / total;
+}
+
+static GstBuffer *
+stabilize_frame (GstHarness * h, gint offset)
+{
+  fail_unless_equals_int (gst_harness_push (h, create_shaken_frame (offset)),
+      GST_FLOW_OK);
+  return gst_harness_pull (h);
+}
+
+GST_START_TEST (test_smoothed_transform)
+{
+  GstHarness *h = NULL;
+  GstBuffer *first = NULL;
+  GstBuffer *second = NULL;
+
+  h = gst_harness_new_parse ("vpiupload ! vpistabilize smoothing-window=2 "
+      "interpolator=nearest ! vpidownload");
+  gst_harness_set_src_caps_str (h, FRAME_CAPS);
+
+  /* The first frame defines the trajectory, it is left untouched */
+  first = stabilize_frame (h, 0);
+  fail_unless (mismatch_ratio (first, 0) < MAX_MISMATCH_RATIO);
+
+  /* The camera moves, the window averages the positions of both frames so
+     the output is only moved halfway */
+  second = stabilize_frame (h, CAMERA_SHAKE);
+  fail_unless (mismatch_ratio (second, CAMERA_SHAKE / 2) < MAX_MISMATCH_RATIO);
+  fail_if (mismatch_ratio (second, CAMERA_SHAKE) < MAX_MISMATCH_RATIO);
+
+  gst_buffer_unref (first);
+  gst_buffer_unref (second);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gray8_playing_to_null_multiple_times)
+{
+  test_states_change (test_pipes[TEST_GRAY8_PLAYING_TO_NULL_MULTIPLE_TIMES]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nv12_playing_to_null_multiple_times)
+{
+  test_states_change (test_pipes[TEST_NV12_PLAYING_TO_NULL_MULTIPLE_TIMES]);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_vpi_stabilize_suite (void)
+{
+  Suite *suite = suite_create ("vpistabilize");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (suite, tc);
+  tcase_add_test (tc, test_gray8_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_nv12_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_smoothed_transform);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_vpi_stabilize);
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2020-2021 RidgeRun, LLC (http://www.ridgerun.com)
+ * All Rights Reserved.
+ *
+ * The contents of this software are proprietary and confidential to RidgeRun,
+ * LLC.  No part of this program may be photocopied, reproduced or translated
+ * into another programming language without prior written consent of
+ * RidgeRun, LLC.  The user is free to modify the source code after obtaining
+ * a software license from RidgeRun.  All source code changes must be provided
+ * back to RidgeRun without any encumbrance.
+ */
+
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+#include "gst-libs/gst/vpi/gstvpitensormeta.h"
+#include "tests/check/test_utils.h"
+
+static const gchar *test_pipes[] = {
+  "videotestsrc ! video/x-raw,format=NV12,width=640,height=480 ! vpiupload "
+      "! vpitensorize mean=<0.485,0.456,0.406> std=<0.229,0.224,0.225> "
+      "! application/x-vpi-tensor,width=224,height=224 ! fakesink",
+  "videotestsrc num-buffers=1 ! video/x-raw,format=BGRx,width=320,height=240 "
+      "! vpiupload ! vpitensorize swap-channels=true "
+      "! application/x-vpi-tensor,type=float16,width=160,height=120 "
+      "! fakesink name=sink",
+  NULL,
+};
+
+enum
+{
+  /* test names */
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES,
+  TEST_TENSOR_SHAPE,
+};
+
+GST_START_TEST (test_playing_to_null_multiple_times)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES]);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+keep_first_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstBuffer **buffer = user_data;
+
+  if (!*buffer) {
+    *buffer = gst_buffer_ref (GST_PAD_PROBE_INFO_BUFFER (info));
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_tensor_shape)
+{
+  GstElement *pipeline = NULL;
+  GstElement *sink = NULL;
+  GstPad *pad = NULL;
+  GstMessage *msg = NULL;
+  GstBuffer *buffer = NULL;
+  GstVpiTensorMeta *meta = NULL;
+  GError *error = NULL;
+
+  pipeline = gst_parse_launch (test_pipes[TEST_TENSOR_SHAPE], &error);
+
+  /* Check for errors creating pipeline */
+  fail_if (error != NULL, error);
+  fail_if (pipeline == NULL, error);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, keep_first_buffer,
+      &buffer, NULL);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  fail_unless (buffer != NULL);
+
+  /* Three planes of half floats, described by the meta */
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 3 * 160 * 120 * 2);
+
+  meta = gst_buffer_get_vpi_tensor_meta (buffer);
+  fail_unless (meta != NULL);
+  fail_unless_equals_int (meta->type, GST_VPI_TENSOR_TYPE_FLOAT16);
+  fail_unless_equals_int (meta->num_dims, 4);
+  fail_unless_equals_int (meta->dims[0], 1);
+  fail_unless_equals_int (meta->dims[1], 3);
+  fail_unless_equals_int (meta->dims[2], 120);
+  fail_unless_equals_int (meta->dims[3], 160);
+
+  /* Clean up */
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_buffer_unref (buffer);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+/* Pushes a width x 2 RGB frame whose pixel x, y holds base + x + width * y
+   in every channel, plus 0, 100 and 200 for R, G and B when spread is set */
+static GstBuffer *
+tensorize_frame (GstHarness * h, gint width, gboolean spread)
+{
+  GstVideoInfo info = { 0 };
+  GstVideoFrame frame = { 0 };
+  GstBuffer *buffer = NULL;
+  guint8 *data = NULL;
+  gint x = 0, y = 0, c = 0;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_RGB, width, 2);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE));
+  for (y = 0; y < 2; y++) {
+    data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame, 0) +
+        y * GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+    for (x = 0; x < width; x++) {
+      for (c = 0; c < 3; c++) {
+        data[x * 3 + c] = x + width * y + (spread ? 100 * c : 0);
+      }
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+
+  return gst_harness_pull (h);
+}
+
+GST_START_TEST (test_normalized_values)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+  const gfloat *tensor = NULL;
+  const gdouble mean[] = { 0.5, 0.25, 0.125 };
+  const gdouble std[] = { 0.5, 0.25, 2.0 };
+  gdouble expected = 0;
+  gint c = 0, i = 0;
+
+  h = gst_harness_new_parse ("vpiupload ! vpitensorize swap-channels=true "
+      "mean=<0.5,0.25,0.125> std=<0.5,0.25,2.0>");
+  gst_harness_set_src_caps_str (h,
+      "video/x-raw,format=RGB,width=4,height=2,framerate=30/1");
+  gst_harness_set_sink_caps_str (h,
+      "application/x-vpi-tensor,type=float32,width=4,height=2");
+
+  buffer = tensorize_frame (h, 4, TRUE);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  fail_unless_equals_int (info.size, 3 * 4 * 2 * sizeof (gfloat));
+  tensor = (const gfloat *) info.data;
+
+  /* Planes are B, G and R, each with its own mean and std */
+  for (c = 0; c < 3; c++) {
+    for (i = 0; i < 4 * 2; i++) {
+      expected = ((i + 100 * (2 - c)) / 255.0 - mean[c]) / std[c];
+      fail_unless (ABS (tensor[c * 4 * 2 + i] - expected) < 1e-5,
+          "channel %d element %d is %f instead of %f", c, i,
+          tensor[c * 4 * 2 + i], expected);
+    }
+  }
+
+  gst_buffer_unmap (buffer, &info);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_half_rounding)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+  const guint16 *tensor = NULL;
+  /* Above 2048 halves are 2 apart, so odd values are ties */
+  const guint16 expected[] = { 0x6800, 0x6800, 0x6801, 0x6802 };
+  gint c = 0, i = 0;
+
+  /* A std of 1/255 and a mean of -2048/255 map pixel p to 2048 + p */
+  h = gst_harness_new_parse ("vpiupload ! vpitensorize "
+      "mean=<-8.031372549019608,-8.031372549019608,-8.031372549019608> "
+      "std=<0.00392156862745098,0.00392156862745098,0.00392156862745098>");
+  gst_harness_set_src_caps_str (h,
+      "video/x-raw,format=RGB,width=2,height=2,framerate=30/1");
+  gst_harness_set_sink_caps_str (h,
+      "application/x-vpi-tensor,type=float16,width=2,height=2");
+
+  buffer = tensorize_frame (h, 2, FALSE);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  fail_unless_equals_int (info.size, 3 * 2 * 2 * sizeof (guint16));
+  tensor = (const guint16 *) info.data;
+
+  /* Ties round to even */
+  for (c = 0; c < 3; c++) {
+    for (i = 0; i < 2 * 2; i++) {
+      fail_unless_equals_int (tensor[c * 2 * 2 + i], expected[i]);
+    }
+  }
+
+  gst_buffer_unmap (buffer, &info);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_vpi_tensorize_suite (void)
+{
+  Suite *suite = suite_create ("vpitensorize");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (suite, tc);
+  tcase_add_test (tc, test_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_tensor_shape);
+  tcase_add_test (tc, test_normalized_values);
+  tcase_add_test (tc, test_half_rounding);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_vpi_tensorize);
@@ -10,11 +10,31 @@
  * back to RidgeRun without any encumbrance.
  */
 
+#include <glib/gstdio.h>
+#include <gst/check/gstharness.h>
 #include "tests/check/test_utils.h"
 
+#define FRAME_WIDTH 320
+#define FRAME_HEIGHT 240
+#define CHECKER_SIZE 16
+#define FRAME_CAPS "video/x-raw,format=GRAY8,width=320,height=240,framerate=30/1"
+#define NV12_FRAME_CAPS "video/x-raw,format=NV12,width=320,height=240,framerate=30/1"
+#define CHROMA_U 64
+#define CHROMA_V 192
+#define CHROMA_TOLERANCE 1
+#define MAP_REBUILT_MESSAGE "vpiundistort-map-rebuilt"
+
+/* The grid follows the magic and the point counts in the file header */
+#define CACHE_GRID_OFFSET 16
+
 static const gchar *test_pipes[] = {
   "videotestsrc ! vpiupload ! vpiundistort ! vpidownload ! fakesink",
   "videotestsrc ! vpiupload ! vpiundistort ! vpiundistort ! vpidownload ! fakesink",
+  "videotestsrc ! vpiupload ! vpiundistort grid-density=dense ! vpidownload ! fakesink",
+  "videotestsrc ! vpiupload ! vpiundistort cache-location=\"\" ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,width=1280,height=720 ! vpiupload ! vpiundistort crop-left=40 crop-right=40 crop-top=20 crop-bottom=20 ! video/x-raw(memory:VPIImage),width=640,height=360 ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=GRAY8 ! vpiupload ! vpiundistort ! vpidownload ! fakesink",
+  "videotestsrc ! video/x-raw,format=RGBx ! vpiupload ! vpiundistort ! vpidownload ! fakesink",
   NULL,
 };
 
@@ -23,6 +43,11 @@ enum
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_SINGLE_UNDISTORT,
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_DOUBLE_UNDISTORT,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_DENSE_UNDISTORT,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_UNCACHED_UNDISTORT,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_CROP_AND_SCALE,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_GRAY8,
+  TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_RGBX,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times_single_undistort)
@@ -41,6 +66,363 @@ GST_START_TEST (test_playing_to_null_multiple_times_double_undistort)
 
 GST_END_TEST;
 
+GST_START_TEST (test_playing_to_null_multiple_times_dense_undistort)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_DENSE_UNDISTORT]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_uncached_undistort)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_UNCACHED_UNDISTORT]);
+}
+
+GST_END_TEST;
+
+static void
+fill_checkers (guint8 * data)
+{
+  guint x = 0, y = 0;
+
+  for (y = 0; y < FRAME_HEIGHT; y++) {
+    for (x = 0; x < FRAME_WIDTH; x++) {
+      data[y * FRAME_WIDTH + x] =
+          ((x / CHECKER_SIZE + y / CHECKER_SIZE) % 2) ? 255 : 0;
+    }
+  }
+}
+
+static GstBuffer *
+create_checkers_frame (void)
+{
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+
+  buffer = gst_buffer_new_allocate (NULL, FRAME_WIDTH * FRAME_HEIGHT, NULL);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_WRITE));
+  fill_checkers (info.data);
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+/* Checkers luma with a flat chroma, U and V differ so swapping or mixing
+   them shows */
+static GstBuffer *
+create_nv12_frame (void)
+{
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+  guint i = 0;
+
+  buffer = gst_buffer_new_allocate (NULL, FRAME_WIDTH * FRAME_HEIGHT * 3 / 2,
+      NULL);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_WRITE));
+  fill_checkers (info.data);
+  for (i = FRAME_WIDTH * FRAME_HEIGHT; i < info.size; i += 2) {
+    info.data[i] = CHROMA_U;
+    info.data[i + 1] = CHROMA_V;
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+static GstHarness *
+create_undistort_harness (const gchar * properties, const gchar * caps)
+{
+  GstHarness *h = NULL;
+  gchar *launch = NULL;
+
+  launch = g_strdup_printf ("vpiupload ! vpiundistort name=undistort %s "
+      "! vpidownload", properties);
+  h = gst_harness_new_parse (launch);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (launch);
+
+  return h;
+}
+
+static GstBuffer *
+undistort_frame (GstHarness * h)
+{
+  fail_unless_equals_int (gst_harness_push (h, create_checkers_frame ()),
+      GST_FLOW_OK);
+  return gst_harness_pull (h);
+}
+
+static gboolean
+buffers_are_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo a_info = { 0 };
+  GstMapInfo b_info = { 0 };
+  gboolean ret = FALSE;
+
+  fail_unless (gst_buffer_map (a, &a_info, GST_MAP_READ));
+  fail_unless (gst_buffer_map (b, &b_info, GST_MAP_READ));
+
+  ret = a_info.size == b_info.size
+      && 0 == memcmp (a_info.data, b_info.data, a_info.size);
+
+  gst_buffer_unmap (a, &a_info);
+  gst_buffer_unmap (b, &b_info);
+  return ret;
+}
+
+GST_START_TEST (test_recalibrating_on_the_fly)
+{
+  GstHarness *h = NULL;
+  GstHarness *reference = NULL;
+  GstElement *undistort = NULL;
+  GstBus *bus = NULL;
+  GstMessage *msg = NULL;
+  GstBuffer *before = NULL;
+  GstBuffer *after = NULL;
+  GstBuffer *expected = NULL;
+
+  h = create_undistort_harness ("", FRAME_CAPS);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+  undistort = gst_bin_get_by_name (GST_BIN (h->element), "undistort");
+
+  before = undistort_frame (h);
+
+  /* Streaming continues while the map is rebuilt in the background, the
+     new map is used from the frame after the message */
+  g_object_set (undistort, "model", 1, "k1", -0.2, "k2", 0.05, NULL);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_ELEMENT | GST_MESSAGE_WARNING);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_ELEMENT);
+  fail_unless (gst_message_has_name (msg, MAP_REBUILT_MESSAGE));
+  gst_message_unref (msg);
+
+  after = undistort_frame (h);
+  fail_if (buffers_are_equal (before, after));
+
+  /* Same output as an element calibrated from the start */
+  reference = create_undistort_harness ("model=polynomial k1=-0.2 k2=0.05",
+      FRAME_CAPS);
+  expected = undistort_frame (reference);
+  fail_unless (buffers_are_equal (after, expected));
+
+  gst_buffer_unref (before);
+  gst_buffer_unref (after);
+  gst_buffer_unref (expected);
+  gst_harness_teardown (reference);
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (undistort);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_crop_and_scale)
+{
+  test_states_change (test_pipes
+      [TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_CROP_AND_SCALE]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_gray8)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_GRAY8]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_playing_to_null_multiple_times_rgbx)
+{
+  test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES_RGBX]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_crop_on_the_fly)
+{
+  GstHarness *h = NULL;
+  GstHarness *reference = NULL;
+  GstElement *undistort = NULL;
+  GstBuffer *cropped = NULL;
+  GstBuffer *expected = NULL;
+  GstCaps *caps = NULL;
+  GstStructure *st = NULL;
+  gint width = 0;
+  gint height = 0;
+
+  h = create_undistort_harness ("", FRAME_CAPS);
+  undistort = gst_bin_get_by_name (GST_BIN (h->element), "undistort");
+  gst_buffer_unref (undistort_frame (h));
+
+  /* The output renegotiates to the cropped size */
+  g_object_set (undistort, "crop-left", 40, "crop-right", 40, "crop-top", 20,
+      "crop-bottom", 20, NULL);
+  cropped = undistort_frame (h);
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  st = gst_caps_get_structure (caps, 0);
+  fail_unless (gst_structure_get_int (st, "width", &width));
+  fail_unless (gst_structure_get_int (st, "height", &height));
+  fail_unless_equals_int (width, FRAME_WIDTH - 80);
+  fail_unless_equals_int (height, FRAME_HEIGHT - 40);
+
+  /* Same output as an element cropped from the start */
+  reference = create_undistort_harness ("crop-left=40 crop-right=40 "
+      "crop-top=20 crop-bottom=20", FRAME_CAPS);
+  expected = undistort_frame (reference);
+  fail_unless (buffers_are_equal (cropped, expected));
+
+  gst_caps_unref (caps);
+  gst_buffer_unref (cropped);
+  gst_buffer_unref (expected);
+  gst_harness_teardown (reference);
+  gst_object_unref (undistort);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nv12)
+{
+  GstHarness *h = NULL;
+  GstHarness *reference = NULL;
+  GstBuffer *out = NULL;
+  GstBuffer *expected = NULL;
+  GstMapInfo info = { 0 };
+  GstMapInfo expected_info = { 0 };
+  guint i = 0;
+
+  h = create_undistort_harness ("", NV12_FRAME_CAPS);
+  fail_unless_equals_int (gst_harness_push (h, create_nv12_frame ()),
+      GST_FLOW_OK);
+  out = gst_harness_pull (h);
+
+  reference = create_undistort_harness ("", FRAME_CAPS);
+  expected = undistort_frame (reference);
+
+  fail_unless (gst_buffer_map (out, &info, GST_MAP_READ));
+  fail_unless (gst_buffer_map (expected, &expected_info, GST_MAP_READ));
+  fail_unless_equals_uint64 (info.size, FRAME_WIDTH * FRAME_HEIGHT * 3 / 2);
+
+  /* Luma is remapped as a gray image would be */
+  fail_unless (0 == memcmp (info.data, expected_info.data,
+          FRAME_WIDTH * FRAME_HEIGHT));
+
+  /* The default lens only samples inside the input, so interpolating U
+     and V together keeps the flat chroma */
+  for (i = FRAME_WIDTH * FRAME_HEIGHT; i < info.size; i += 2) {
+    fail_unless (ABS (info.data[i] - CHROMA_U) <= CHROMA_TOLERANCE);
+    fail_unless (ABS (info.data[i + 1] - CHROMA_V) <= CHROMA_TOLERANCE);
+  }
+
+  gst_buffer_unmap (expected, &expected_info);
+  gst_buffer_unmap (out, &info);
+  gst_buffer_unref (expected);
+  gst_buffer_unref (out);
+  gst_harness_teardown (reference);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+run_cached_undistort (const gchar * location)
+{
+  GstHarness *h = NULL;
+  gchar *properties = NULL;
+
+  properties = g_strdup_printf ("cache-location=\"%s\"", location);
+  h = create_undistort_harness (properties, FRAME_CAPS);
+  gst_buffer_unref (undistort_frame (h));
+
+  gst_harness_teardown (h);
+  g_free (properties);
+}
+
+static gchar *
+get_cache_file (const gchar * location)
+{
+  GDir *dir = NULL;
+  const gchar *name = NULL;
+  gchar *path = NULL;
+
+  dir = g_dir_open (location, 0, NULL);
+  fail_unless (dir != NULL);
+
+  /* A single resolution and calibration produce a single map */
+  while ((name = g_dir_read_name (dir))) {
+    fail_unless (path == NULL);
+    path = g_build_filename (location, name, NULL);
+  }
+  g_dir_close (dir);
+
+  fail_unless (path != NULL);
+  return path;
+}
+
+static guint64
+get_inode (const gchar * path)
+{
+  GStatBuf st = { 0 };
+
+  fail_unless_equals_int (g_stat (path, &st), 0);
+  return st.st_ino;
+}
+
+GST_START_TEST (test_cache_hit_and_miss)
+{
+  gchar *location = NULL;
+  gchar *path = NULL;
+  gchar *contents = NULL;
+  gchar *corrupted = NULL;
+  gchar *regenerated = NULL;
+  gsize size = 0;
+  gsize regenerated_size = 0;
+  guint64 inode = 0;
+
+  location = g_dir_make_tmp ("vpiundistort-XXXXXX", NULL);
+  fail_unless (location != NULL);
+
+  /* A miss generates the map and saves it */
+  run_cached_undistort (location);
+  path = get_cache_file (location);
+  fail_unless (g_file_get_contents (path, &contents, &size, NULL));
+  fail_unless (size > CACHE_GRID_OFFSET);
+
+  /* A hit maps the file and leaves it untouched. Saving replaces the file,
+     which would change its inode */
+  inode = get_inode (path);
+  run_cached_undistort (location);
+  fail_unless_equals_uint64 (get_inode (path), inode);
+
+  /* A grid that does not lay out the stored points is regenerated */
+  corrupted = g_memdup (contents, size);
+  corrupted[CACHE_GRID_OFFSET] = G_MAXINT8;
+  fail_unless (g_file_set_contents (path, corrupted, size, NULL));
+  inode = get_inode (path);
+
+  run_cached_undistort (location);
+  fail_if (get_inode (path) == inode);
+  fail_unless (g_file_get_contents (path, &regenerated, &regenerated_size,
+          NULL));
+  fail_unless_equals_uint64 (regenerated_size, size);
+  fail_unless (0 == memcmp (regenerated, contents, size));
+
+  g_remove (path);
+  g_rmdir (location);
+  g_free (regenerated);
+  g_free (corrupted);
+  g_free (contents);
+  g_free (path);
+  g_free (location);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_undistort_suite (void)
 {
@@ -50,6 +432,15 @@ gst_vpi_undistort_suite (void)
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times_single_undistort);
   tcase_add_test (tc, test_playing_to_null_multiple_times_double_undistort);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_dense_undistort);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_uncached_undistort);
+  tcase_add_test (tc, test_recalibrating_on_the_fly);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_crop_and_scale);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_gray8);
+  tcase_add_test (tc, test_playing_to_null_multiple_times_rgbx);
+  tcase_add_test (tc, test_cache_hit_and_miss);
+  tcase_add_test (tc, test_crop_on_the_fly);
+  tcase_add_test (tc, test_nv12);
 
   return suite;
 }
@@ -17,6 +17,8 @@ static const gchar *test_pipes[] = {
   "fakesrc ! capsfilter caps=video/x-raw,width=1280,height=720,framerate=30/1 ! vpiupload ! capsfilter caps=video/x-raw(memory:VPIImage) ! fakesink",
   "videotestsrc ! vpiupload ! capsfilter caps=video/x-raw ! fakesink",
   "videotestsrc ! capsfilter caps=video/x-raw,width=1280,height=720,framerate=30/1 ! vpiupload ! capsfilter caps=video/x-raw(memory:VPIImage),width=640,height=480 ! fakesink",
+  "videotestsrc num-buffers=5 ! capsfilter caps=video/x-raw,format=I420 ! vpiupload name=upload ! capsfilter caps=video/x-raw(memory:VPIImage) ! fakesink",
+  "videotestsrc num-buffers=1 ! capsfilter caps=video/x-raw,format=P010_10LE ! vpiupload ! fakesink",
   NULL,
 };
 
@@ -26,7 +28,9 @@ enum
   TEST_SUCCESS_CAPS_NEGOTIATION,
   TEST_PIPE_NOT_PLAYABLE,
   TEST_FAIL_PADS_COMPATIBILITY_SRC,
-  TEST_FAIL_PADS_COMPATIBILITY_WIDTH_HEIGHT
+  TEST_FAIL_PADS_COMPATIBILITY_WIDTH_HEIGHT,
+  TEST_CONVERTED_FORMAT,
+  TEST_REDUCED_DEPTH
 };
 
 GST_START_TEST (test_success_caps_negotiation)
@@ -145,6 +149,86 @@ GST_START_TEST (test_fail_pads_compatibility_width_height)
 
 GST_END_TEST;
 
+GST_START_TEST (test_converted_format)
+{
+  GstElement *pipeline = NULL;
+  GstElement *vpiupload = NULL;
+  GstMessage *msg = NULL;
+  GError *error = NULL;
+  GstPad *src_pad = NULL;
+  GstCaps *src_caps = NULL;
+  GstStructure *st = NULL;
+
+  pipeline = gst_parse_launch (test_pipes[TEST_CONVERTED_FORMAT], &error);
+
+  /* Check for errors creating pipeline */
+  fail_if (error != NULL, error);
+  fail_if (pipeline == NULL, error);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL, -1),
+      GST_STATE_CHANGE_SUCCESS);
+
+  /* I420 can't be wrapped by VPI, it should be uploaded as NV12 */
+  vpiupload = gst_bin_get_by_name (GST_BIN (pipeline), "upload");
+  src_pad = gst_element_get_static_pad (vpiupload, "src");
+  src_caps = gst_pad_get_current_caps (src_pad);
+  fail_unless (src_caps != NULL);
+
+  st = gst_caps_get_structure (src_caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (st, "format"), "NV12");
+
+  gst_caps_unref (src_caps);
+  gst_object_unref (src_pad);
+  gst_object_unref (vpiupload);
+
+  /* Converted frames should flow until EOS */
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* Clean up */
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reduced_depth)
+{
+  GstElement *pipeline = NULL;
+  GstMessage *msg = NULL;
+  GError *error = NULL;
+
+  pipeline = gst_parse_launch (test_pipes[TEST_REDUCED_DEPTH], &error);
+
+  /* Check for errors creating pipeline */
+  fail_if (error != NULL, error);
+  fail_if (pipeline == NULL, error);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  /* P010 is uploaded as NV12, losing its two lower bits */
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_WARNING | GST_MESSAGE_EOS |
+      GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_WARNING);
+  gst_message_unref (msg);
+
+  /* Clean up */
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_upload_suite (void)
 {
@@ -156,6 +240,8 @@ gst_vpi_upload_suite (void)
   tcase_add_test (tc, test_pipe_not_playable);
   tcase_add_test (tc, test_fail_pads_compatibility_src);
   tcase_add_test (tc, test_fail_pads_compatibility_width_height);
+  tcase_add_test (tc, test_converted_format);
+  tcase_add_test (tc, test_reduced_depth);
 
   return suite;
 }
@@ -17,6 +17,7 @@
 static const gchar *test_pipes[] = {
   "videotestsrc ! video/x-raw,format=BGR ! vpiupload ! vpivideoconvert ! vpidownload ! video/x-raw,format=RGB ! fakesink",
   "videotestsrc ! video/x-raw,format=BGR,width=320,height=240 ! vpiupload ! vpivideoconvert ! vpidownload ! video/x-raw,format=RGB,width=640,height=480 ! fakesink",
+  "videotestsrc ! video/x-raw,format=YUY2 ! vpiupload ! vpivideoconvert ! vpidownload ! video/x-raw,format=NV12 ! fakesink",
   NULL,
 };
 
@@ -25,6 +26,7 @@ enum
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES,
   TEST_BLOCK_RESOLUTION_CHANGE,
+  TEST_PACKED_YUV,
 };
 
 GST_START_TEST (test_playing_to_null_multiple_times)
@@ -85,6 +87,13 @@ GST_START_TEST (test_block_resolution_change)
 
 GST_END_TEST;
 
+GST_START_TEST (test_packed_yuv)
+{
+  test_states_change (test_pipes[TEST_PACKED_YUV]);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_video_convert_suite (void)
 {
@@ -95,6 +104,7 @@ gst_vpi_video_convert_suite (void)
   tcase_add_test (tc, test_playing_to_null_multiple_times);
   tcase_add_test (tc, test_bypass_on_same_caps);
   tcase_add_test (tc, test_block_resolution_change);
+  tcase_add_test (tc, test_packed_yuv);
 
   return suite;
 }
@@ -11,12 +11,14 @@
  */
 
 #include <gst/check/gstharness.h>
+#include <gst/video/video.h>
 
 #include "tests/check/test_utils.h"
 
 static const gchar *test_pipes[] = {
   "videotestsrc ! video/x-raw,width=640,height=480 ! vpiupload ! vpivideoscale ! vpidownload ! video/x-raw,width=1920,height=1080 ! fakesink",
   "videotestsrc ! video/x-raw,format=BGR,width=320,height=240 ! vpiupload ! vpivideoscale ! vpidownload ! video/x-raw,format=RGB,width=640,height=480 ! fakesink",
+  "videotestsrc ! video/x-raw,format=NV12,width=640,height=480,pixel-aspect-ratio=1/1 ! vpiupload ! vpivideoscale add-borders=true border-color=0xff0000ff ! vpidownload ! video/x-raw,width=1280,height=720,pixel-aspect-ratio=1/1 ! fakesink",
   NULL,
 };
 
@@ -25,8 +27,12 @@ enum
   /* test names */
   TEST_PLAYING_TO_NULL_MULTIPLE_TIMES,
   TEST_BLOCK_FORMAT_CHANGE,
+  TEST_ADD_BORDERS,
 };
 
+#define CROP_CAPS "video/x-raw,format=NV12,width=64,height=48,framerate=30/1"
+#define BORDER_CAPS "video/x-raw,format=GRAY8,width=32,height=32,pixel-aspect-ratio=1/1,framerate=30/1"
+
 GST_START_TEST (test_playing_to_null_multiple_times)
 {
   test_states_change (test_pipes[TEST_PLAYING_TO_NULL_MULTIPLE_TIMES]);
@@ -84,6 +90,161 @@ GST_START_TEST (test_block_format_change)
 
 GST_END_TEST;
 
+GST_START_TEST (test_add_borders)
+{
+  test_states_change (test_pipes[TEST_ADD_BORDERS]);
+}
+
+GST_END_TEST;
+
+static guint8
+pattern_value (gint x, gint y)
+{
+  return (x * 7 + y * 13) % 251 + 1;
+}
+
+/* Fills every plane with the pattern on its own grid */
+static GstBuffer *
+create_pattern_frame (const gchar * caps_str)
+{
+  GstCaps *caps = gst_caps_from_string (caps_str);
+  GstVideoInfo info = { 0 };
+  GstVideoFrame frame = { 0 };
+  GstBuffer *buffer = NULL;
+  guint8 *data = NULL;
+  gint x = 0, y = 0;
+  guint plane = 0;
+
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE));
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame); plane++) {
+    data = GST_VIDEO_FRAME_PLANE_DATA (&frame, plane);
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, plane); y++) {
+      for (x = 0; x < GST_VIDEO_FRAME_PLANE_STRIDE (&frame, plane); x++) {
+        data[y * GST_VIDEO_FRAME_PLANE_STRIDE (&frame, plane) + x] =
+            pattern_value (x, y);
+      }
+    }
+  }
+  gst_video_frame_unmap (&frame);
+  gst_caps_unref (caps);
+
+  return buffer;
+}
+
+/* Checks the width x height area at x0, y0 of every plane of the output
+   matches the pattern at src_x, src_y, or value if negative */
+static void
+check_area (GstVideoFrame * frame, gint x0, gint y0, gint width,
+    gint height, gint src_x, gint src_y, gint value)
+{
+  guint8 *data = NULL;
+  gint stride = 0;
+  gint x = 0, y = 0;
+  guint plane = 0;
+  guint wsub = 0, hsub = 0;
+  gint pstride = 0;
+  gint expected = 0;
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (frame); plane++) {
+    data = GST_VIDEO_FRAME_PLANE_DATA (frame, plane);
+    stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, plane);
+    pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (frame, plane);
+    wsub = GST_VIDEO_FORMAT_INFO_W_SUB (frame->info.finfo, plane);
+    hsub = GST_VIDEO_FORMAT_INFO_H_SUB (frame->info.finfo, plane);
+    for (y = 0; y < height >> hsub; y++) {
+      for (x = 0; x < (width >> wsub) * pstride; x++) {
+        expected = value >= 0 ? value :
+            pattern_value ((src_x >> wsub) * pstride + x, (src_y >> hsub) + y);
+        fail_unless_equals_int (data[((y0 >> hsub) + y) * stride +
+                (x0 >> wsub) * pstride + x], expected);
+      }
+    }
+  }
+}
+
+/* Pushes the pattern, with a crop meta if width is not 0, and maps the
+   output */
+static GstBuffer *
+scale_frame (GstHarness * h, const gchar * in_caps, const gchar * out_caps,
+    guint crop_x, guint crop_y, guint width, guint height,
+    GstVideoFrame * frame)
+{
+  GstBuffer *buffer = create_pattern_frame (in_caps);
+  GstCaps *caps = gst_caps_from_string (out_caps);
+  GstVideoCropMeta *crop = NULL;
+  GstVideoInfo info = { 0 };
+
+  if (width) {
+    crop = gst_buffer_add_video_crop_meta (buffer);
+    crop->x = crop_x;
+    crop->y = crop_y;
+    crop->width = width;
+    crop->height = height;
+  }
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+
+  fail_unless (gst_video_info_from_caps (&info, caps));
+  fail_unless (gst_video_frame_map (frame, &info, buffer, GST_MAP_READ));
+  gst_caps_unref (caps);
+
+  return buffer;
+}
+
+GST_START_TEST (test_crop_meta)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GstVideoFrame frame = { 0 };
+  const gchar *out_caps =
+      "video/x-raw,format=NV12,width=34,height=26,framerate=30/1";
+
+  h = gst_harness_new_parse ("vpiupload ! vpivideoscale interpolator=nearest "
+      "! vpidownload");
+  gst_harness_set_src_caps_str (h, CROP_CAPS);
+  gst_harness_set_sink_caps_str (h, out_caps);
+
+  /* An odd 32x24+5+3 crop grows to the 34x26+4+2 chroma grid, which
+     matches the output and is copied as is */
+  buffer = scale_frame (h, CROP_CAPS, out_caps, 5, 3, 32, 24, &frame);
+  check_area (&frame, 0, 0, 34, 26, 4, 2, -1);
+
+  gst_video_frame_unmap (&frame);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_border_pixels)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+  GstVideoFrame frame = { 0 };
+  const gchar *out_caps = "video/x-raw,format=GRAY8,width=64,height=32,"
+      "pixel-aspect-ratio=1/1,framerate=30/1";
+
+  h = gst_harness_new_parse ("vpiupload ! vpivideoscale interpolator=nearest "
+      "add-borders=true border-color=0xffffffff ! vpidownload");
+  gst_harness_set_src_caps_str (h, BORDER_CAPS);
+  gst_harness_set_sink_caps_str (h, out_caps);
+
+  /* The square input is centered with white on both sides */
+  buffer = scale_frame (h, BORDER_CAPS, out_caps, 0, 0, 0, 0, &frame);
+  check_area (&frame, 0, 0, 16, 32, 0, 0, 255);
+  check_area (&frame, 16, 0, 32, 32, 0, 0, -1);
+  check_area (&frame, 48, 0, 16, 32, 0, 0, 255);
+
+  gst_video_frame_unmap (&frame);
+  gst_buffer_unref (buffer);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_video_scale_suite (void)
 {
@@ -94,6 +255,9 @@ gst_vpi_video_scale_suite (void)
   tcase_add_test (tc, test_playing_to_null_multiple_times);
   tcase_add_test (tc, test_bypass_on_same_caps);
   tcase_add_test (tc, test_block_format_change);
+  tcase_add_test (tc, test_add_borders);
+  tcase_add_test (tc, test_crop_meta);
+  tcase_add_test (tc, test_border_pixels);
 
   return suite;
 }
@@ -10,8 +10,15 @@
  * back to RidgeRun without any encumbrance.
  */
 
+#include <gst/check/gstharness.h>
+#include "gst-libs/gst/vpi/gstvpitransformmeta.h"
 #include "tests/check/test_utils.h"
 
+#define FRAME_WIDTH 64
+#define FRAME_HEIGHT 48
+#define FRAME_CAPS "video/x-raw,format=GRAY8,width=64,height=48,framerate=30/1"
+#define SHIFT 8
+
 static const gchar *test_pipes[] = {
   "videotestsrc ! vpiupload ! vpiwarp ! vpidownload ! fakesink",
   NULL,
@@ -30,6 +37,143 @@ GST_START_TEST (test_playing_to_null_multiple_times)
 
 GST_END_TEST;
 
+static guint8
+pattern_value (gint x, gint y)
+{
+  return (x * 7 + y * 13) % 251 + 1;
+}
+
+/* Non zero pattern, so pixels filled by the warp boundary stand out */
+static GstBuffer *
+create_pattern_frame (void)
+{
+  GstBuffer *buffer = NULL;
+  GstMapInfo info = { 0 };
+  gint x = 0, y = 0;
+
+  buffer = gst_buffer_new_allocate (NULL, FRAME_WIDTH * FRAME_HEIGHT, NULL);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_WRITE));
+  for (y = 0; y < FRAME_HEIGHT; y++) {
+    for (x = 0; x < FRAME_WIDTH; x++) {
+      info.data[y * FRAME_WIDTH + x] = pattern_value (x, y);
+    }
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+static void
+set_translation (VPIPerspectiveTransform transform, gint dx)
+{
+  memset (transform, 0, sizeof (VPIPerspectiveTransform));
+  transform[0][0] = 1;
+  transform[1][1] = 1;
+  transform[2][2] = 1;
+  transform[0][2] = dx;
+}
+
+/* Pushes the pattern, with a horizontal translation meta unless
+   with_meta is FALSE */
+static GstBuffer *
+warp_frame (GstHarness * h, gboolean with_meta, gint dx)
+{
+  GstBuffer *buffer = create_pattern_frame ();
+  VPIPerspectiveTransform transform = { {0} };
+
+  if (with_meta) {
+    set_translation (transform, dx);
+    fail_unless (gst_buffer_add_vpi_transform_meta (buffer, transform));
+  }
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (h);
+
+  /* The matrix has been consumed */
+  fail_unless (NULL == gst_buffer_get_vpi_transform_meta (buffer));
+
+  return buffer;
+}
+
+/* Checks the pattern was moved dx pixels to the right */
+static void
+check_translation (GstBuffer * buffer, gint dx)
+{
+  GstMapInfo info = { 0 };
+  gint x = 0, y = 0;
+  gint src_x = 0;
+  guint8 expected = 0;
+
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  for (y = 0; y < FRAME_HEIGHT; y++) {
+    for (x = 0; x < FRAME_WIDTH; x++) {
+      src_x = x - dx;
+      expected = src_x >= 0 && src_x < FRAME_WIDTH ?
+          pattern_value (src_x, y) : 0;
+      fail_unless_equals_int (info.data[y * FRAME_WIDTH + x], expected);
+    }
+  }
+  gst_buffer_unmap (buffer, &info);
+}
+
+GST_START_TEST (test_meta_over_property)
+{
+  GstHarness *h = NULL;
+  GstBuffer *buffer = NULL;
+
+  h = gst_harness_new_parse ("vpiupload ! vpiwarp interpolator=nearest "
+      "transformation=\"<<1.0, 0.0, 8.0>, <0.0, 1.0, 0.0>, "
+      "<0.0, 0.0, 1.0>>\" ! vpidownload");
+  gst_harness_set_src_caps_str (h, FRAME_CAPS);
+
+  /* The meta of the frame wins over the property */
+  buffer = warp_frame (h, TRUE, 0);
+  check_translation (buffer, 0);
+  gst_buffer_unref (buffer);
+
+  buffer = warp_frame (h, TRUE, -SHIFT);
+  check_translation (buffer, -SHIFT);
+  gst_buffer_unref (buffer);
+
+  /* Frames without meta fall back to the property */
+  buffer = warp_frame (h, FALSE, 0);
+  check_translation (buffer, SHIFT);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_cached_inverse)
+{
+  GstHarness *h = NULL;
+  GstBuffer *first = NULL;
+  GstBuffer *second = NULL;
+  GstBuffer *third = NULL;
+
+  h = gst_harness_new_parse ("vpiupload ! vpiwarp interpolator=nearest "
+      "! vpidownload");
+  gst_harness_set_src_caps_str (h, FRAME_CAPS);
+
+  /* The second frame reuses the inverse of the first one */
+  first = warp_frame (h, TRUE, SHIFT);
+  check_translation (first, SHIFT);
+  second = warp_frame (h, TRUE, SHIFT);
+  check_translation (second, SHIFT);
+
+  /* A new matrix must not be served the cached inverse */
+  third = warp_frame (h, TRUE, -SHIFT / 2);
+  check_translation (third, -SHIFT / 2);
+
+  gst_buffer_unref (first);
+  gst_buffer_unref (second);
+  gst_buffer_unref (third);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_vpi_warp_filter_suite (void)
 {
@@ -38,6 +182,8 @@ gst_vpi_warp_filter_suite (void)
 
   suite_add_tcase (suite, tc);
   tcase_add_test (tc, test_playing_to_null_multiple_times);
+  tcase_add_test (tc, test_meta_over_property);
+  tcase_add_test (tc, test_cached_inverse);
 
   return suite;
 }